@@ -0,0 +1,56 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+//Layout of /luma/boottrace.bin, written by arm9 and shown by rosalina (also read by arm9/tools/boottrace.py).
+//Only uses the standard integer types, since it is included with both the arm9 and libctru types.h
+
+#pragma once
+
+#include <stdint.h>
+
+#define BOOTTRACE_MAGIC         "BTRC"
+#define BOOTTRACE_VERSION       3
+#define BOOTTRACE_MAX_ENTRIES   32
+
+typedef struct BootTraceEntry
+{
+    char name[8]; //Not NUL-terminated if 8 characters long
+    uint64_t ticks;
+} BootTraceEntry;
+
+typedef struct BootTrace
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t nbEntries;
+    uint32_t ticksPerSec;
+    uint32_t ctrNandReadSize; //Total decrypted CTRNAND bytes read
+    uint64_t ctrNandReadTicks; //Time spent reading them
+    uint32_t sdReadSize; //Same for the SD card, as seen by FatFs
+    uint32_t reserved;
+    uint64_t sdReadTicks;
+    BootTraceEntry entries[BOOTTRACE_MAX_ENTRIES];
+} BootTrace;
@@ -0,0 +1,76 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+//The counter arithmetic of crypto.c. The host tests, see arm9/test, replace this header with
+//plain C versions
+
+#pragma once
+
+/* original version by megazig */
+
+#ifndef __thumb__
+#define BSWAP32(x) {\
+    __asm__\
+    (\
+        "eor r1, %1, %1, ror #16\n\t"\
+        "bic r1, r1, #0xFF0000\n\t"\
+        "mov %0, %1, ror #8\n\t"\
+        "eor %0, %0, r1, lsr #8\n\t"\
+        :"=r"(x)\
+        :"0"(x)\
+        :"r1"\
+    );\
+};
+
+#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
+__asm__\
+    (\
+        "adds %0, %4\n\t"\
+        "addcss %1, %1, #1\n\t"\
+        "addcss %2, %2, #1\n\t"\
+        "addcs %3, %3, #1\n\t"\
+        : "+r"(u128_0), "+r"(u128_1), "+r"(u128_2), "+r"(u128_3)\
+        : "r"(u32_0)\
+        : "cc"\
+    );\
+}
+#else
+#define BSWAP32(x) {x = __builtin_bswap32(x);}
+
+#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
+__asm__\
+    (\
+        "mov r4, #0\n\t"\
+        "add %0, %0, %4\n\t"\
+        "adc %1, %1, r4\n\t"\
+        "adc %2, %2, r4\n\t"\
+        "adc %3, %3, r4\n\t"\
+        : "+r"(u128_0), "+r"(u128_1), "+r"(u128_2), "+r"(u128_3)\
+        : "r"(u32_0)\
+        : "cc", "r4"\
+    );\
+}
+#endif /*__thumb__*/
@@ -0,0 +1,74 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include "boottrace.h"
+#include "utils.h"
+#include "fs.h"
+#include "memory.h"
+
+static BootTrace bootTrace;
+
+void bootTraceStart(void)
+{
+    startChrono();
+
+    memcpy(bootTrace.magic, BOOTTRACE_MAGIC, 4);
+    bootTrace.version = BOOTTRACE_VERSION;
+    bootTrace.ticksPerSec = (u32)TICKS_PER_SEC;
+
+    bootTraceMark("start");
+}
+
+//Marks the end of the stage named "name"
+void bootTraceMark(const char *name)
+{
+    if(bootTrace.nbEntries == BOOTTRACE_MAX_ENTRIES) return;
+
+    BootTraceEntry *entry = &bootTrace.entries[bootTrace.nbEntries++];
+    entry->ticks = chronoTicks();
+    for(u32 i = 0; i < sizeof(entry->name); i++)
+        entry->name[i] = *name != 0 ? *name++ : 0;
+}
+
+void bootTraceCountCtrNandRead(u32 size, u64 ticks)
+{
+    bootTrace.ctrNandReadSize += size;
+    bootTrace.ctrNandReadTicks += ticks;
+}
+
+void bootTraceCountSdRead(u32 size, u64 ticks)
+{
+    bootTrace.sdReadSize += size;
+    bootTrace.sdReadTicks += ticks;
+}
+
+void bootTraceSave(void)
+{
+    bootTraceMark("end");
+
+    u32 size = (u32)((u8 *)&bootTrace.entries[bootTrace.nbEntries] - (u8 *)&bootTrace);
+    fileWrite(&bootTrace, BOOTTRACE_FILE, size);
+}
@@ -39,6 +39,7 @@
 #include "pin.h"
 #include "i2c.h"
 #include "ini.h"
+#include "crypto.h"
 
 #include "config_template_ini.h" // note that it has an extra NUL byte inserted
 
@@ -71,6 +72,8 @@ static const char *singleOptionIniNamesMisc[] = {
     "use_dev_unitinfo",
     "disable_arm11_exception_handlers",
     "enable_safe_firm_rosalina",
+    "cache_patched_native_firm",
+    "save_boot_trace",
 };
 
 static const char *keyNames[] = {
@@ -466,11 +469,31 @@ static int configIniHandler(void* user, const char* section, const char* name, c
             CHECK_PARSE_OPTION(parseBoolOption(&opt, value));
             cfg->pluginLoaderFlags = opt ? cfg->pluginLoaderFlags | 1 : cfg->pluginLoaderFlags & ~1;
             return 1;
+        } else if (strcmp(name, "plugin_loader_swap_compression") == 0) {
+            bool opt;
+            CHECK_PARSE_OPTION(parseBoolOption(&opt, value));
+            cfg->pluginLoaderFlags = opt ? cfg->pluginLoaderFlags | 2 : cfg->pluginLoaderFlags & ~2;
+            return 1;
+        } else if (strcmp(name, "plugin_loader_cache_size_mb") == 0) {
+            s64 opt;
+            CHECK_PARSE_OPTION(parseDecIntOption(&opt, value, 0, 16));
+            cfg->pluginLoaderFlags = (cfg->pluginLoaderFlags & ~0xFF00) | ((u32)opt << 8);
+            return 1;
         } else if (strcmp(name, "ntp_tz_offset_min") == 0) {
             s64 opt;
             CHECK_PARSE_OPTION(parseDecIntOption(&opt, value, -779, 899));
             cfg->ntpTzOffetMinutes = (s16)opt;
             return 1;
+        } else if (strcmp(name, "screenshot_format") == 0) {
+            if (strcasecmp(value, "bmp") == 0) {
+                cfg->screenshotFormat = 0;
+                return 1;
+            } else if (strcasecmp(value, "qoi") == 0) {
+                cfg->screenshotFormat = 1;
+                return 1;
+            } else {
+                CHECK_PARSE_OPTION(-1);
+            }
         } else {
             CHECK_PARSE_OPTION(-1);
         }
@@ -585,6 +608,7 @@ static size_t saveLumaIniConfigToStr(char *out)
     const char *n3dsCpuStr;
     const char *autobootModeStr;
     const char *forceAudioOutputStr;
+    const char *screenshotFormatStr;
 
     switch (MULTICONFIG(SPLASH)) {
         default: case 0: splashPosStr = "off"; break;
@@ -599,6 +623,11 @@ static size_t saveLumaIniConfigToStr(char *out)
         case 3: n3dsCpuStr = "clock+l2"; break;
     }
 
+    switch (cfg->screenshotFormat) {
+        default: case 0: screenshotFormatStr = "bmp"; break;
+        case 1: screenshotFormatStr = "qoi"; break;
+    }
+
     switch (MULTICONFIG(AUTOBOOTMODE)) {
         default: case 0: autobootModeStr = "off"; break;
         case 1: autobootModeStr = "3ds"; break;
@@ -658,7 +687,8 @@ static size_t saveLumaIniConfigToStr(char *out)
         autobootModeStr,
 
         cfg->hbldr3dsxTitleId, rosalinaMenuComboStr, (int)(cfg->pluginLoaderFlags & 1),
-        (int)cfg->ntpTzOffetMinutes,
+        (int)((cfg->pluginLoaderFlags >> 1) & 1), (int)((cfg->pluginLoaderFlags >> 8) & 0xFF),
+        (int)cfg->ntpTzOffetMinutes, screenshotFormatStr,
 
         (int)cfg->topScreenFilter.cct, (int)cfg->bottomScreenFilter.cct,
         topScreenFilterGammaStr, bottomScreenFilterGammaStr,
@@ -671,7 +701,8 @@ static size_t saveLumaIniConfigToStr(char *out)
         forceAudioOutputStr,
 
         (int)CONFIG(PATCHUNITINFO), (int)CONFIG(DISABLEARM11EXCHANDLERS),
-        (int)CONFIG(ENABLESAFEFIRMROSALINA)
+        (int)CONFIG(ENABLESAFEFIRMROSALINA), (int)CONFIG(CACHENATIVEFIRM),
+        (int)CONFIG(SAVEBOOTTRACE)
     );
 
     return n < 0 ? 0 : (size_t)n;
@@ -679,14 +710,76 @@ static size_t saveLumaIniConfigToStr(char *out)
 
 static char tmpIniBuffer[0x2000];
 
+#define CONFIG_SNAPSHOT_PATH    "cache/config.bin"
+#define CONFIG_SNAPSHOT_VERSION 1
+
+//config.ini as parsed by the build that wrote it, valid for as long as the text is the same
+typedef struct ConfigSnapshot
+{
+    char magic[4];
+    u16 version;
+    u16 cfgDataSize;
+    u32 commitHash;
+    u32 iniSize;
+    u8 iniHash[SHA_256_HASH_SIZE];
+    CfgData cfg;
+} ConfigSnapshot;
+
+static bool readConfigSnapshot(const u8 *iniHash, u32 iniSize)
+{
+    ConfigSnapshot snapshot;
+
+    if(fileRead(&snapshot, CONFIG_SNAPSHOT_PATH, sizeof(snapshot)) != sizeof(snapshot) ||
+       memcmp(snapshot.magic, "LCFG", 4) != 0 || snapshot.version != CONFIG_SNAPSHOT_VERSION ||
+       snapshot.cfgDataSize != sizeof(CfgData) || snapshot.commitHash != COMMIT_HASH ||
+       snapshot.iniSize != iniSize || memcmp(snapshot.iniHash, iniHash, sizeof(snapshot.iniHash)) != 0)
+        return false;
+
+    configData = snapshot.cfg;
+    return true;
+}
+
+static void writeConfigSnapshot(const u8 *iniHash, u32 iniSize)
+{
+    ConfigSnapshot snapshot;
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    memcpy(snapshot.magic, "LCFG", 4);
+    snapshot.version = CONFIG_SNAPSHOT_VERSION;
+    snapshot.cfgDataSize = sizeof(CfgData);
+    snapshot.commitHash = COMMIT_HASH;
+    snapshot.iniSize = iniSize;
+    memcpy(snapshot.iniHash, iniHash, sizeof(snapshot.iniHash));
+    snapshot.cfg = configData;
+
+    fileWrite(&snapshot, CONFIG_SNAPSHOT_PATH, sizeof(snapshot));
+}
+
 static bool readLumaIniConfig(void)
 {
-    u32 rd = fileRead(tmpIniBuffer, "config.ini", sizeof(tmpIniBuffer) - 1);
+    //Rosalina deletes config.ini right before renaming its fully written replacement over it.
+    //Only when that left no config.ini at all is the replacement read instead
+    bool isTmp = getFileSize("config.ini") == 0;
+    u32 rd = fileRead(tmpIniBuffer, isTmp ? "config.ini.tmp" : "config.ini", sizeof(tmpIniBuffer) - 1);
     if (rd == 0) return false;
 
     tmpIniBuffer[rd] = '\0';
 
-    return ini_parse_string(tmpIniBuffer, &configIniHandler, &configData) >= 0 && !hasIniParseError;
+    //Only run the parser when config.ini changed since the snapshot was taken
+    __attribute__((aligned(4))) u8 iniHash[SHA_256_HASH_SIZE];
+    sha(iniHash, tmpIniBuffer, rd, SHA_256_MODE);
+
+    if (!readConfigSnapshot(iniHash, rd))
+    {
+        if (ini_parse_string(tmpIniBuffer, &configIniHandler, &configData) < 0 || hasIniParseError) return false;
+
+        writeConfigSnapshot(iniHash, rd);
+    }
+
+    //Finish what Rosalina started, so that the replacement can't take over from a later config.ini
+    if (isTmp && fileWrite(tmpIniBuffer, "config.ini", rd)) fileDelete("config.ini.tmp");
+
+    return true;
 }
 
 static bool writeLumaIniConfig(void)
@@ -66,6 +66,8 @@ enum singleOptions
     PATCHUNITINFO,
     DISABLEARM11EXCHANDLERS,
     ENABLESAFEFIRMROSALINA,
+    CACHENATIVEFIRM,
+    SAVEBOOTTRACE,
 
     NUMCONFIGURABLE = PATCHUNITINFO,
 };
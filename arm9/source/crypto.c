@@ -38,57 +38,13 @@
 #include "alignedseqmemcpy.h"
 #include "strings.h"
 #include "fatfs/sdmmc/sdmmc.h"
+#include "boottrace.h"
+#include "crypto_asm.h"
 
 /****************************************************************
 *                  Crypto libs
 ****************************************************************/
 
-/* original version by megazig */
-
-#ifndef __thumb__
-#define BSWAP32(x) {\
-    __asm__\
-    (\
-        "eor r1, %1, %1, ror #16\n\t"\
-        "bic r1, r1, #0xFF0000\n\t"\
-        "mov %0, %1, ror #8\n\t"\
-        "eor %0, %0, r1, lsr #8\n\t"\
-        :"=r"(x)\
-        :"0"(x)\
-        :"r1"\
-    );\
-};
-
-#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
-__asm__\
-    (\
-        "adds %0, %4\n\t"\
-        "addcss %1, %1, #1\n\t"\
-        "addcss %2, %2, #1\n\t"\
-        "addcs %3, %3, #1\n\t"\
-        : "+r"(u128_0), "+r"(u128_1), "+r"(u128_2), "+r"(u128_3)\
-        : "r"(u32_0)\
-        : "cc"\
-    );\
-}
-#else
-#define BSWAP32(x) {x = __builtin_bswap32(x);}
-
-#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
-__asm__\
-    (\
-        "mov r4, #0\n\t"\
-        "add %0, %0, %4\n\t"\
-        "adc %1, %1, r4\n\t"\
-        "adc %2, %2, r4\n\t"\
-        "adc %3, %3, r4\n\t"\
-        : "+r"(u128_0), "+r"(u128_1), "+r"(u128_2), "+r"(u128_3)\
-        : "r"(u32_0)\
-        : "cc", "r4"\
-    );\
-}
-#endif /*__thumb__*/
-
 static void aes_setkey(u8 keyslot, const void *key, u32 keyType, u32 mode)
 {
     u32 *key32 = (u32 *)key;
@@ -203,39 +159,60 @@ static void aes_change_ctrmode(void *ctr, u32 fromMode, u32 toMode)
     }
 }
 
-static void aes_batch(void *dst, const void *src, u32 blockCount)
+//State of the batch being fed to the AES FIFOs, see aes_batch_pump
+static struct
+{
+    const u32 *src32;
+    u32 *dst32;
+    u32 wbc;
+    u32 rbc;
+} aesBatch;
+
+static void aes_batch_start(void *dst, const void *src, u32 blockCount)
 {
     *REG_AESBLKCNT = blockCount << 16;
     *REG_AESCNT |=  AES_CNT_START;
 
-    const u32 *src32    = (const u32 *)src;
-    u32 *dst32          = (u32 *)dst;
-
-    u32 wbc = blockCount;
-    u32 rbc = blockCount;
+    aesBatch.src32  = (const u32 *)src;
+    aesBatch.dst32  = (u32 *)dst;
+    aesBatch.wbc    = blockCount;
+    aesBatch.rbc    = blockCount;
+}
 
-    while(rbc)
+//Moves at most one block in each direction without waiting, so that it can run between SDMMC polls
+static void aes_batch_pump(void)
+{
+    if(aesBatch.wbc && ((*REG_AESCNT & 0x1F) <= 0xC)) //There's space for at least 4 ints
     {
-        if(wbc && ((*REG_AESCNT & 0x1F) <= 0xC)) //There's space for at least 4 ints
-        {
-            *REG_AESWRFIFO = *src32++;
-            *REG_AESWRFIFO = *src32++;
-            *REG_AESWRFIFO = *src32++;
-            *REG_AESWRFIFO = *src32++;
-            wbc--;
-        }
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        *REG_AESWRFIFO = *aesBatch.src32++;
+        aesBatch.wbc--;
+    }
 
-        if(rbc && ((*REG_AESCNT & (0x1F << 0x5)) >= (0x4 << 0x5))) //At least 4 ints available for read
-        {
-            *dst32++ = *REG_AESRDFIFO;
-            *dst32++ = *REG_AESRDFIFO;
-            *dst32++ = *REG_AESRDFIFO;
-            *dst32++ = *REG_AESRDFIFO;
-            rbc--;
-        }
+    if(aesBatch.rbc && ((*REG_AESCNT & (0x1F << 0x5)) >= (0x4 << 0x5))) //At least 4 ints available for read
+    {
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        *aesBatch.dst32++ = *REG_AESRDFIFO;
+        aesBatch.rbc--;
     }
 }
 
+static void aes_batch_finish(void)
+{
+    while(aesBatch.rbc)
+        aes_batch_pump();
+}
+
+static void aes_batch(void *dst, const void *src, u32 blockCount)
+{
+    aes_batch_start(dst, src, blockCount);
+    aes_batch_finish();
+}
+
 static void aes(void *dst, const void *src, u32 blockCount, void *iv, u32 mode, u32 ivMode)
 {
     *REG_AESCNT =   mode |
@@ -284,23 +261,51 @@ static void sha_wait_idle()
     while(*REG_SHA_CNT & 1);
 }
 
-void sha(void *res, const void *src, u32 size, u32 mode)
+//State of the hash being fed by shaStreamFeed
+static struct
+{
+    const u8 *src;
+    u32 size;
+    u32 mode;
+} shaStream;
+
+void shaStreamStart(const void *src, u32 size, u32 mode)
 {
     sha_wait_idle();
     *REG_SHA_CNT = mode | SHA_CNT_OUTPUT_ENDIAN | SHA_NORMAL_ROUND;
 
-    const u8 *src8 = (const u8 *)src;
-    while(size >= 0x40)
+    shaStream.src = (const u8 *)src;
+    shaStream.size = size;
+    shaStream.mode = mode;
+}
+
+//Feeds the whole blocks below "end" for as long as the engine is idle, returns the size left to hash
+u32 shaStreamFeed(const void *end)
+{
+    while(shaStream.size >= 0x40 && shaStream.src + 0x40 <= (const u8 *)end && !(*REG_SHA_CNT & 1))
+    {
+        alignedseqmemcpy((void *)REG_SHA_INFIFO, shaStream.src, 0x40);
+
+        shaStream.src += 0x40;
+        shaStream.size -= 0x40;
+    }
+
+    return shaStream.size;
+}
+
+void shaStreamFinish(void *res)
+{
+    while(shaStream.size >= 0x40)
     {
         sha_wait_idle();
-        alignedseqmemcpy((void *)REG_SHA_INFIFO, src8, 0x40);
+        alignedseqmemcpy((void *)REG_SHA_INFIFO, shaStream.src, 0x40);
 
-        src8 += 0x40;
-        size -= 0x40;
+        shaStream.src += 0x40;
+        shaStream.size -= 0x40;
     }
 
     sha_wait_idle();
-    alignedseqmemcpy((void *)REG_SHA_INFIFO, src8, size);
+    alignedseqmemcpy((void *)REG_SHA_INFIFO, shaStream.src, shaStream.size);
 
     *REG_SHA_CNT = (*REG_SHA_CNT & ~SHA_NORMAL_ROUND) | SHA_FINAL_ROUND;
 
@@ -308,17 +313,26 @@ void sha(void *res, const void *src, u32 size, u32 mode)
     sha_wait_idle();
 
     u32 hashSize = SHA_256_HASH_SIZE;
-    if(mode == SHA_224_MODE)
+    if(shaStream.mode == SHA_224_MODE)
         hashSize = SHA_224_HASH_SIZE;
-    else if(mode == SHA_1_MODE)
+    else if(shaStream.mode == SHA_1_MODE)
         hashSize = SHA_1_HASH_SIZE;
 
     alignedseqmemcpy(res, (void *)REG_SHA_HASH, hashSize);
 }
 
+void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    shaStreamStart(src, size, mode);
+    shaStreamFinish(res);
+}
+
 /*****************************************************************/
 
 __attribute__((aligned(4))) static u8 nandCtr[AES_BLOCK_SIZE];
+//Sectors per pipelined CTRNAND read, a chunk is decrypted while the next one is transferred
+#define CTRNAND_CHUNK_SECTORS   0x40
+
 static u8 nandSlot;
 static u32 fatStart = 0;
 
@@ -367,25 +381,55 @@ int ctrNandInit(void)
     return result;
 }
 
+static int ctrNandReadSectors(u32 sector, u32 sectorCount, u8 *outbuf)
+{
+    if(firmSource == FIRMWARE_SYSNAND)
+        return sdmmc_nand_readsectors(sector + fatStart, sectorCount, outbuf);
+
+    return sdmmc_sdcard_readsectors(sector + emuOffset + fatStart, sectorCount, outbuf);
+}
+
 int ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
 {
+    u64 startTicks = chronoTicks();
+
     __attribute__((aligned(4))) u8 tmpCtr[sizeof(nandCtr)];
     memcpy(tmpCtr, nandCtr, sizeof(nandCtr));
     aes_advctr(tmpCtr, ((sector + fatStart) * 0x200) / AES_BLOCK_SIZE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
-    //Read
-    int result;
-    if(firmSource == FIRMWARE_SYSNAND)
-        result = sdmmc_nand_readsectors(sector + fatStart, sectorCount, outbuf);
-    else
+    aes_use_keyslot(nandSlot);
+    *REG_AESCNT =   AES_CTR_MODE |
+                    AES_CNT_INPUT_ORDER | AES_CNT_OUTPUT_ORDER |
+                    AES_CNT_INPUT_ENDIAN | AES_CNT_OUTPUT_ENDIAN |
+                    AES_CNT_FLUSH_READ | AES_CNT_FLUSH_WRITE;
+
+    //Decrypt each chunk in place while the next one is being read
+    u32 chunkStart = 0,
+        chunkCount = sectorCount < CTRNAND_CHUNK_SECTORS ? sectorCount : CTRNAND_CHUNK_SECTORS;
+    int result = ctrNandReadSectors(sector, chunkCount, outbuf);
+
+    while(!result && chunkCount != 0)
     {
-        sector += emuOffset;
-        result = sdmmc_sdcard_readsectors(sector + fatStart, sectorCount, outbuf);
+        u8 *chunk = outbuf + chunkStart * 0x200;
+        u32 blockCount = chunkCount * 0x200 / AES_BLOCK_SIZE;
+
+        aes_setiv(tmpCtr, AES_INPUT_BE | AES_INPUT_NORMAL);
+        aes_batch_start(chunk, chunk, blockCount);
+        aes_advctr(tmpCtr, blockCount, AES_INPUT_BE | AES_INPUT_NORMAL);
+
+        chunkStart += chunkCount;
+        chunkCount = sectorCount - chunkStart < CTRNAND_CHUNK_SECTORS ? sectorCount - chunkStart : CTRNAND_CHUNK_SECTORS;
+        if(chunkCount != 0)
+        {
+            sdmmc_idle_callback previousCallback = sdmmc_set_idle_callback(aes_batch_pump);
+            result = ctrNandReadSectors(sector + chunkStart, chunkCount, outbuf + chunkStart * 0x200);
+            sdmmc_set_idle_callback(previousCallback);
+        }
+
+        aes_batch_finish();
     }
 
-    //Decrypt
-    aes_use_keyslot(nandSlot);
-    aes(outbuf, outbuf, sectorCount * 0x200 / AES_BLOCK_SIZE, tmpCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+    bootTraceCountCtrNandRead(sectorCount * 0x200, chronoTicks() - startTicks);
 
     return result;
 }
@@ -417,16 +461,20 @@ int ctrNandWrite(u32 sector, u32 sectorCount, const u8 *inbuf)
     return result;
 }
 
-u32 decryptExeFs(Cxi *cxi)
+static u32 getExeFsSize(const Cxi *cxi)
 {
     if(memcmp(cxi->ncch.magic, "NCCH", 4) != 0) return 0;
 
     if(cxi->ncch.exeFsOffset != 5) return 0;
 
-    u8 *exeFsOffset = (u8 *)cxi + 6 * 0x200;
     u32 exeFsSize = (cxi->ncch.exeFsSize - 1) * 0x200;
 
-    if(exeFsSize > 0x400000) return 0;
+    return exeFsSize > 0x400000 ? 0 : exeFsSize;
+}
+
+static void decryptExeFsData(Cxi *cxi, void *dst, u32 size)
+{
+    const u8 *exeFsOffset = (const u8 *)cxi + 6 * 0x200;
 
     __attribute__((aligned(4))) u8 ncchCtr[AES_BLOCK_SIZE] = {0};
 
@@ -437,11 +485,29 @@ u32 decryptExeFs(Cxi *cxi)
     aes_setkey(0x2C, cxi, AES_KEYY, AES_INPUT_BE | AES_INPUT_NORMAL);
     aes_advctr(ncchCtr, 0x200 / AES_BLOCK_SIZE, AES_INPUT_BE | AES_INPUT_NORMAL);
     aes_use_keyslot(0x2C);
-    aes(cxi, exeFsOffset, exeFsSize / AES_BLOCK_SIZE, ncchCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+    aes(dst, exeFsOffset, size / AES_BLOCK_SIZE, ncchCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
+}
+
+u32 decryptExeFs(Cxi *cxi)
+{
+    u32 exeFsSize = getExeFsSize(cxi);
+
+    if(!exeFsSize) return 0;
+
+    decryptExeFsData(cxi, cxi, exeFsSize);
 
     return memcmp(cxi, "FIRM", 4) == 0 ? exeFsSize : 0;
 }
 
+bool decryptExeFsFirmHeader(Cxi *cxi, Firm *firmHeader)
+{
+    if(getExeFsSize(cxi) < sizeof(Firm)) return false;
+
+    decryptExeFsData(cxi, firmHeader, sizeof(Firm));
+
+    return memcmp(firmHeader->magic, "FIRM", 4) == 0;
+}
+
 u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize)
 {
     if(memcmp(ticket->sigIssuer, "Root", 4) != 0) return 0;
@@ -558,32 +624,27 @@ void setupKeyslots(void)
     }
 }
 
-void kernel9Loader(Arm9Bin *arm9Section)
+static u32 getKernel9LoaderVersion(const Arm9Bin *arm9Section)
 {
-    //Determine the kernel9loader version
-    u32 k9lVersion;
     switch(arm9Section->magic[3])
     {
         case 0xFF:
-            k9lVersion = 0;
-            break;
+            return 0;
         case '1':
-            k9lVersion = 1;
-            break;
+            return 1;
         default:
-            k9lVersion = 2;
+            return 2;
     }
+}
 
-    u32 *startOfArm9Bin = (u32 *)((u8 *)arm9Section + 0x800);
-    if(*startOfArm9Bin == 0x47704770 || *startOfArm9Bin == 0xB0862000) return; //Already decrypted
+void kernel9LoaderSetupKeys(const Arm9Bin *arm9Section)
+{
+    u32 k9lVersion = getKernel9LoaderVersion(arm9Section);
 
     aes_setkey(0x11, k9lVersion == 2 ? key2s[ISDEVUNIT ? 1 : 0] : key1s[ISDEVUNIT ? 1 : 0], AES_KEYNORMAL, AES_INPUT_BE | AES_INPUT_NORMAL);
 
     u8 arm9BinSlot = k9lVersion == 0 ? 0x15 : 0x16;
 
-    // Get size
-    u32 arm9SectionSize = decAtoi(arm9Section->size, 8);
-
     //Set keyX
     __attribute__((aligned(4))) u8 keyX[AES_BLOCK_SIZE];
     aes_use_keyslot(0x11);
@@ -594,6 +655,19 @@ void kernel9Loader(Arm9Bin *arm9Section)
     __attribute__((aligned(4))) u8 keyY[AES_BLOCK_SIZE];
     memcpy(keyY, arm9Section->keyY, sizeof(keyY));
     aes_setkey(arm9BinSlot, keyY, AES_KEYY, AES_INPUT_BE | AES_INPUT_NORMAL);
+}
+
+bool kernel9Loader(Arm9Bin *arm9Section)
+{
+    u32 *startOfArm9Bin = (u32 *)((u8 *)arm9Section + 0x800);
+    if(*startOfArm9Bin == 0x47704770 || *startOfArm9Bin == 0xB0862000) return false; //Already decrypted
+
+    kernel9LoaderSetupKeys(arm9Section);
+
+    u8 arm9BinSlot = getKernel9LoaderVersion(arm9Section) == 0 ? 0x15 : 0x16;
+
+    // Get size
+    u32 arm9SectionSize = decAtoi(arm9Section->size, 8);
 
     //Set CTR
     __attribute__((aligned(4))) u8 arm9BinCtr[AES_BLOCK_SIZE];
@@ -604,6 +678,8 @@ void kernel9Loader(Arm9Bin *arm9Section)
     aes(startOfArm9Bin, startOfArm9Bin, arm9SectionSize / AES_BLOCK_SIZE, arm9BinCtr, AES_CTR_MODE, AES_INPUT_BE | AES_INPUT_NORMAL);
 
     if(*startOfArm9Bin != 0x47704770 && *startOfArm9Bin != 0xB0862000) error("Failed to decrypt the Arm9 binary.");
+
+    return true;
 }
 
 void computePinHash(u8 *outbuf, const u8 *inbuf)
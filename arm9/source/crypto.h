@@ -113,12 +113,17 @@
 extern FirmwareSource firmSource;
 
 void sha(void *res, const void *src, u32 size, u32 mode);
+void shaStreamStart(const void *src, u32 size, u32 mode);
+u32 shaStreamFeed(const void *end);
+void shaStreamFinish(void *res);
 
 int ctrNandInit(void);
 int ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf);
 int ctrNandWrite(u32 sector, u32 sectorCount, const u8 *inbuf);
 u32 decryptExeFs(Cxi *cxi);
+bool decryptExeFsFirmHeader(Cxi *cxi, Firm *firmHeader);
 u32 decryptNusFirm(const Ticket *ticket, Cxi *cxi, u32 ncchSize);
 void setupKeyslots(void);
-void kernel9Loader(Arm9Bin *arm9Section);
+void kernel9LoaderSetupKeys(const Arm9Bin *arm9Section);
+bool kernel9Loader(Arm9Bin *arm9Section);
 void computePinHash(u8 *outbuf, const u8 *inbuf);
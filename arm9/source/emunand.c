@@ -31,6 +31,7 @@
 
 #include "emunand.h"
 #include "memory.h"
+#include "patches.h"
 #include "utils.h"
 #include "fatfs/sdmmc/sdmmc.h"
 #include "large_patches.h"
@@ -104,10 +105,8 @@ void locateEmuNand(FirmwareSource *nandType)
 
 static inline bool getFreeK9Space(u8 *pos, u32 size, u8 **freeK9Space)
 {
-    static const u8 pattern[] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
-
     //Looking for the last free space before Process9
-    *freeK9Space = memsearch(pos, pattern, size, sizeof(pattern));
+    *freeK9Space = getPatchSite(pos, size, PATCH_SITE_EMUNAND_FREE_K9_SPACE);
 
     if(*freeK9Space == NULL || (u32)(pos + size - *freeK9Space) < 0x455 + emunandPatchSize ||
        *(u32 *)(*freeK9Space + 0x455 + emunandPatchSize - 4) != 0xFFFFFFFF) return false;
@@ -138,9 +137,7 @@ static inline u32 getOldSdmmc(u32 *sdmmc, u32 firmVersion)
 static inline u32 getSdmmc(u8 *pos, u32 size, u32 *sdmmc)
 {
     //Look for struct code
-    static const u8 pattern[] = {0x21, 0x20, 0x18, 0x20};
-
-    const u8 *off = memsearch(pos, pattern, size, sizeof(pattern));
+    const u8 *off = getPatchSite(pos, size, PATCH_SITE_EMUNAND_SDMMC);
 
     if(off == NULL) return 1;
 
@@ -154,7 +151,7 @@ static inline u32 patchNandRw(u8 *pos, u32 size, u32 branchOffset)
     //Look for read/write code
     static const u8 pattern[] = {0x1E, 0x00, 0xC8, 0x05};
 
-    u16 *readOffset = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *readOffset = (u16 *)getPatchSite(pos, size, PATCH_SITE_EMUNAND_NAND_RW);
 
     if(readOffset == NULL) return 1;
 
@@ -175,9 +172,7 @@ static inline u32 patchNandRw(u8 *pos, u32 size, u32 branchOffset)
 static inline u32 patchMpu(u8 *pos, u32 size)
 {
     //Look for MPU pattern
-    static const u8 pattern[] = {0x03, 0x00, 0x24, 0x00};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_EMUNAND_MPU);
 
     if(off == NULL) return 1;
 
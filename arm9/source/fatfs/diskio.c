@@ -12,6 +12,8 @@
 #include "sdmmc/sdmmc.h"
 #include "../crypto.h"
 #include "../i2c.h"
+#include "../utils.h"
+#include "../boottrace.h"
 
 /* Definitions of physical drive number for each drive */
 #define SDCARD        0
@@ -60,8 +62,16 @@ DRESULT disk_read (
     UINT count		/* Number of sectors to read */
 )
 {
-    return ((pdrv == SDCARD && !sdmmc_sdcard_readsectors(sector, count, buff)) ||
-            (pdrv == CTRNAND && !ctrNandRead(sector, count, buff))) ? RES_OK : RES_PARERR;
+    if(pdrv == SDCARD)
+    {
+        u64 startTicks = chronoTicks();
+        int result = sdmmc_sdcard_readsectors(sector, count, buff);
+
+        bootTraceCountSdRead(count * 0x200, chronoTicks() - startTicks);
+        return !result ? RES_OK : RES_PARERR;
+    }
+
+    return (pdrv == CTRNAND && !ctrNandRead(sector, count, buff)) ? RES_OK : RES_PARERR;
 }
 
 
@@ -24,29 +24,12 @@
 
 #include "sdmmc.h"
 #include "delay.h"
+#include "sdmmc_regs.h"
+#include "../../cache.h"
 
 static struct mmcdevice handleNAND;
 static struct mmcdevice handleSD;
-
-static inline u16 sdmmc_read16(u16 reg)
-{
-    return *(vu16 *)(SDMMC_BASE + reg);
-}
-
-static inline void sdmmc_write16(u16 reg, u16 val)
-{
-    *(vu16 *)(SDMMC_BASE + reg) = val;
-}
-
-static inline u32 sdmmc_read32(u16 reg)
-{
-    return *(vu32 *)(SDMMC_BASE + reg);
-}
-
-static inline void sdmmc_write32(u16 reg, u32 val)
-{
-    *(vu32 *)(SDMMC_BASE + reg) = val;
-}
+static sdmmc_idle_callback idleCallback;
 
 static inline void sdmmc_mask16(u16 reg, const u16 clear, const u16 set)
 {
@@ -69,6 +52,50 @@ mmcdevice *getMMCDevice(int drive)
     return &handleSD;
 }
 
+//Called on every poll of the controller while a command is in flight, returns the previous one
+sdmmc_idle_callback sdmmc_set_idle_callback(sdmmc_idle_callback callback)
+{
+    sdmmc_idle_callback previous = idleCallback;
+    idleCallback = callback;
+    return previous;
+}
+
+//Whether a transfer of numsectors to or from addr is left to NDMA. The buffer must be made of
+//whole cache lines, so that the CPU touches none of them while the channel does, and it must be
+//out of the TCMs, which the channel can't reach (ITCM below 0x08000000, DTCM at 0xFFF00000)
+static bool sdmmc_use_ndma(u32 addr, u32 numsectors)
+{
+    if(!SDMMC_USE_NDMA || numsectors < SDMMC_NDMA_MIN_SECTORS || (addr & 0x1F) != 0) return false;
+
+    return addr >= 0x08000000 && addr < 0xFFF00000 && numsectors << 9 <= 0xFFF00000 - addr;
+}
+
+static void sdmmc_start_ndma(bool isRead, const u8 *buf, u32 size)
+{
+    const u32 fifo = SDMMC_BASE + REG_SDFIFO32;
+
+    //Dirty lines would be evicted over what the channel stores, and it reads from memory
+    flushDCacheRange((void *)buf, size);
+    ndma_write32(REG_NDMAGCNT, ndma_read32(REG_NDMAGCNT) | NDMA_GCNT_ENABLE);
+    ndma_write32(REG_NDMASAD(SDMMC_NDMA_CHANNEL), isRead ? fifo : (u32)buf);
+    ndma_write32(REG_NDMADAD(SDMMC_NDMA_CHANNEL), isRead ? (u32)buf : fifo);
+    ndma_write32(REG_NDMATCNT(SDMMC_NDMA_CHANNEL), size / 4);
+    ndma_write32(REG_NDMAWCNT(SDMMC_NDMA_CHANNEL), 0x200 / 4);
+    ndma_write32(REG_NDMABCNT(SDMMC_NDMA_CHANNEL), 0);
+    ndma_write32(REG_NDMACNT(SDMMC_NDMA_CHANNEL), NDMA_ENABLE | NDMA_STARTUP_SDMMC | NDMA_BURST_16_WORDS | (isRead ? NDMA_SRC_FIXED : NDMA_DST_FIXED));
+
+    //The FIFO requests the channel for each block, as it would raise its interrupt
+    sdmmc_mask16(REG_DATACTL32, 0, isRead ? 0x800 : 0x1000);
+}
+
+static void sdmmc_stop_ndma(bool wait)
+{
+    if(wait)
+        while(ndma_read32(REG_NDMACNT(SDMMC_NDMA_CHANNEL)) & NDMA_ENABLE);
+    ndma_write32(REG_NDMACNT(SDMMC_NDMA_CHANNEL), 0);
+    sdmmc_mask16(REG_DATACTL32, 0x1800, 0);
+}
+
 static int geterror(struct mmcdevice *ctx)
 {
     return (int)((ctx->error << 29) >> 31);
@@ -99,9 +126,6 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
     sdmmc_write16(REG_SDSTATUS0, 0);
     sdmmc_write16(REG_SDSTATUS1, 0);
     sdmmc_mask16(REG_DATACTL32, 0x1800, 0);
-    sdmmc_write16(REG_SDCMDARG0, args & 0xFFFF);
-    sdmmc_write16(REG_SDCMDARG1, args >> 16);
-    sdmmc_write16(REG_SDCMD, cmd & 0xFFFF);
 
     u32 size = ctx->size;
     u8 *rDataPtr = ctx->rData;
@@ -110,12 +134,21 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
     bool rUseBuf = rDataPtr != NULL;
     bool tUseBuf = tDataPtr != NULL;
 
+    //The CPU doesn't touch the FIFO while the channel has it
+    const u8 *ndmaPtr = readdata && rUseBuf ? rDataPtr : (writedata && tUseBuf ? tDataPtr : NULL);
+    const bool useNdma = ndmaPtr != NULL && sdmmc_use_ndma((u32)ndmaPtr, size >> 9);
+    if(useNdma) sdmmc_start_ndma(readdata != 0, ndmaPtr, size);
+
+    sdmmc_write16(REG_SDCMDARG0, args & 0xFFFF);
+    sdmmc_write16(REG_SDCMDARG1, args >> 16);
+    sdmmc_write16(REG_SDCMD, cmd & 0xFFFF);
+
     u16 status0 = 0;
     while(true)
     {
         vu16 status1 = sdmmc_read16(REG_SDSTATUS1);
         vu16 ctl32 = sdmmc_read16(REG_DATACTL32);
-        if((ctl32 & 0x100))
+        if(!useNdma && (ctl32 & 0x100))
         {
             if(readdata)
             {
@@ -124,15 +157,31 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
                     sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_RXRDY, 0);
                     if(size > 0x1FF)
                     {
-                        //Gabriel Marcano: This implementation doesn't assume alignment.
-                        //I've removed the alignment check doen with former rUseBuf32 as a result
-                        for(int i = 0; i < 0x200; i += 4)
+                        //Most transfers are to word-aligned buffers, store whole words for those
+                        if(((u32)rDataPtr & 3) == 0)
                         {
-                            u32 data = sdmmc_read32(REG_SDFIFO32);
-                            *rDataPtr++ = data;
-                            *rDataPtr++ = data >> 8;
-                            *rDataPtr++ = data >> 16;
-                            *rDataPtr++ = data >> 24;
+                            u32 *rDataPtr32 = (u32 *)rDataPtr;
+                            for(int i = 0; i < 0x200; i += 16)
+                            {
+                                *rDataPtr32++ = sdmmc_read32(REG_SDFIFO32);
+                                *rDataPtr32++ = sdmmc_read32(REG_SDFIFO32);
+                                *rDataPtr32++ = sdmmc_read32(REG_SDFIFO32);
+                                *rDataPtr32++ = sdmmc_read32(REG_SDFIFO32);
+                            }
+                            rDataPtr += 0x200;
+                        }
+                        else
+                        {
+                            //Gabriel Marcano: This implementation doesn't assume alignment.
+                            //I've removed the alignment check doen with former rUseBuf32 as a result
+                            for(int i = 0; i < 0x200; i += 4)
+                            {
+                                u32 data = sdmmc_read32(REG_SDFIFO32);
+                                *rDataPtr++ = data;
+                                *rDataPtr++ = data >> 8;
+                                *rDataPtr++ = data >> 16;
+                                *rDataPtr++ = data >> 24;
+                            }
                         }
                         size -= 0x200;
                     }
@@ -141,7 +190,7 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
                 sdmmc_mask16(REG_DATACTL32, 0x800, 0);
             }
         }
-        if(!(ctl32 & 0x200))
+        if(!useNdma && !(ctl32 & 0x200))
         {
             if(writedata)
             {
@@ -150,13 +199,28 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
                     sdmmc_mask16(REG_SDSTATUS1, TMIO_STAT1_TXRQ, 0);
                     if(size > 0x1FF)
                     {
-                        for(int i = 0; i < 0x200; i += 4)
+                        if(((u32)tDataPtr & 3) == 0)
+                        {
+                            const u32 *tDataPtr32 = (const u32 *)tDataPtr;
+                            for(int i = 0; i < 0x200; i += 16)
+                            {
+                                sdmmc_write32(REG_SDFIFO32, *tDataPtr32++);
+                                sdmmc_write32(REG_SDFIFO32, *tDataPtr32++);
+                                sdmmc_write32(REG_SDFIFO32, *tDataPtr32++);
+                                sdmmc_write32(REG_SDFIFO32, *tDataPtr32++);
+                            }
+                            tDataPtr += 0x200;
+                        }
+                        else
                         {
-                            u32 data = *tDataPtr++;
-                            data |= (u32)*tDataPtr++ << 8;
-                            data |= (u32)*tDataPtr++ << 16;
-                            data |= (u32)*tDataPtr++ << 24;
-                            sdmmc_write32(REG_SDFIFO32, data);
+                            for(int i = 0; i < 0x200; i += 4)
+                            {
+                                u32 data = *tDataPtr++;
+                                data |= (u32)*tDataPtr++ << 8;
+                                data |= (u32)*tDataPtr++ << 16;
+                                data |= (u32)*tDataPtr++ << 24;
+                                sdmmc_write32(REG_SDFIFO32, data);
+                            }
                         }
                         size -= 0x200;
                     }
@@ -186,7 +250,11 @@ static void __attribute__((noinline)) sdmmc_send_command(struct mmcdevice *ctx,
             if((status0 & flags) == flags)
                 break;
         }
+
+        if(idleCallback != NULL) idleCallback();
     }
+    //Unless the transfer failed, the channel may still be storing the last block
+    if(useNdma) sdmmc_stop_ndma((ctx->error & 4) == 0);
     ctx->stat0 = sdmmc_read16(REG_SDSTATUS0);
     ctx->stat1 = sdmmc_read16(REG_SDSTATUS1);
     sdmmc_write16(REG_SDSTATUS0, 0);
@@ -74,6 +74,32 @@
 #define TMIO_MASK_READOP  (TMIO_STAT1_RXRDY | TMIO_STAT1_DATAEND)
 #define TMIO_MASK_WRITEOP (TMIO_STAT1_TXRQ | TMIO_STAT1_DATAEND)
 
+//Large transfers can be left to an NDMA channel, fed by the controller's FIFO, instead of the CPU.
+//Not enabled by default: build with -DSDMMC_USE_NDMA=1 to try it
+#ifndef SDMMC_USE_NDMA
+#define SDMMC_USE_NDMA          0
+#endif
+
+#define SDMMC_NDMA_MIN_SECTORS  8 //Smaller transfers are cheaper to copy than to set up a channel for
+#define SDMMC_NDMA_CHANNEL      1
+
+#define NDMA_BASE               0x10002000
+
+#define REG_NDMAGCNT            0x00
+#define REG_NDMASAD(n)          (0x04 + (n) * 0x1C)
+#define REG_NDMADAD(n)          (0x08 + (n) * 0x1C)
+#define REG_NDMATCNT(n)         (0x0C + (n) * 0x1C) //Total words
+#define REG_NDMAWCNT(n)         (0x10 + (n) * 0x1C) //Words per request of the peripheral
+#define REG_NDMABCNT(n)         (0x14 + (n) * 0x1C)
+#define REG_NDMACNT(n)          (0x1C + (n) * 0x1C)
+
+#define NDMA_GCNT_ENABLE        0x00000001
+#define NDMA_DST_FIXED          0x00000800
+#define NDMA_SRC_FIXED          0x00004000
+#define NDMA_BURST_16_WORDS     0x00040000
+#define NDMA_STARTUP_SDMMC      0x06000000
+#define NDMA_ENABLE             0x80000000 //Cleared by the channel once done
+
 typedef struct mmcdevice {
     u8 *rData;
     const u8 *tData;
@@ -91,10 +117,13 @@ typedef struct mmcdevice {
     u32 res;
 } mmcdevice;
 
+typedef void (*sdmmc_idle_callback)(void);
+
 u32 sdmmc_sdcard_init();
 int sdmmc_sdcard_readsectors(u32 sector_no, u32 numsectors, u8 *out);
 int sdmmc_sdcard_writesectors(u32 sector_no, u32 numsectors, const u8 *in);
 int sdmmc_nand_readsectors(u32 sector_no, u32 numsectors, u8 *out);
 int sdmmc_nand_writesectors(u32 sector_no, u32 numsectors, const u8 *in);
 void sdmmc_get_cid(bool isNand, u32 *info);
-mmcdevice *getMMCDevice(int drive);
\ No newline at end of file
+mmcdevice *getMMCDevice(int drive);
+sdmmc_idle_callback sdmmc_set_idle_callback(sdmmc_idle_callback callback);
\ No newline at end of file
@@ -37,9 +37,69 @@
 #include "screen.h"
 #include "fmt.h"
 #include "chainloader.h"
+#include "boottrace.h"
+#include "large_patches.h"
+#include "fatfs/sdmmc/sdmmc.h"
+
+extern u16 launchedPath[];
+extern u8 __start__[], __rodata_end__[];
 
 static Firm *firm = (Firm *)0x20001000;
 
+#define NATIVE_FIRM_CACHE_PATH          "cache/native_firm.bin"
+#define NATIVE_FIRM_CACHE_TIMING_PATH   "cache/native_firm_timing.txt"
+#define NATIVE_FIRM_CACHE_VERSION       2
+
+//Everything the patched NATIVE_FIRM image depends on
+typedef struct NativeFirmCacheKey
+{
+    u8 payloadsHash[0x20];
+    u32 contentId;
+    u32 flags;
+    u32 nandType, firmSource;
+    u32 emuOffset, emuHeader;
+    u16 launchedPath[80+1];
+    u8 sectionHashes[4][0x20];
+} NativeFirmCacheKey;
+
+//Stored after the image, so that the latter can be read in place
+typedef struct NativeFirmCacheTrailer
+{
+    char magic[4];
+    u32 version;
+    NativeFirmCacheKey key;
+    u32 imageSize;
+    u32 flags;
+    void *k11ExtOriginalHandlers[4];
+    u32 uncachedTimeMs;
+    __attribute__((aligned(4))) u8 imageHash[0x20];
+} NativeFirmCacheTrailer;
+
+#define NATIVE_FIRM_CACHE_K9L_KEYS  (1 << 0)
+#define NATIVE_FIRM_CACHE_K11EXT    (1 << 1)
+
+static struct
+{
+    NativeFirmCacheKey key;
+    bool isKeyValid;
+    u32 flags;
+    u32 section0Size;
+    u64 startTime;
+} nativeFirmCache;
+
+//Section hashes computed while the FIRM is still being read, see readFirmHashed
+static struct
+{
+    u32 readSize;
+    bool isHeaderParsed;
+    bool isSectionStarted;
+    u32 nbSections;
+    u32 currentSection;
+    u32 order[4];
+    bool isHashed[4];
+    __attribute__((aligned(4))) u8 hashes[4][0x20];
+} firmHashStream;
+
 static __attribute__((noinline)) bool overlaps(u32 as, u32 ae, u32 bs, u32 be)
 {
     if(as <= bs && bs <= ae)
@@ -58,6 +118,11 @@ static __attribute__((noinline)) bool inRange(u32 as, u32 ae, u32 bs, u32 be)
 
 static bool checkFirm(u32 firmSize)
 {
+    //Hashes from readFirmHashed are only valid for the FIRM it has just read, none may outlive this check
+    bool isHashed[4];
+    memcpy(isHashed, firmHashStream.isHashed, sizeof(isHashed));
+    memset(firmHashStream.isHashed, 0, sizeof(firmHashStream.isHashed));
+
     if(memcmp(firm->magic, "FIRM", 4) != 0 || firm->arm9Entry == NULL) //Allow for the Arm11 entrypoint to be zero in which case nothing is done on the Arm11 side
         return false;
 
@@ -90,7 +155,8 @@ static bool checkFirm(u32 firmSize)
 
         __attribute__((aligned(4))) u8 hash[0x20];
 
-        sha(hash, (u8 *)firm + section->offset, section->size, SHA_256_MODE);
+        if(isHashed[i]) memcpy(hash, firmHashStream.hashes[i], sizeof(hash));
+        else sha(hash, (u8 *)firm + section->offset, section->size, SHA_256_MODE);
 
         if(memcmp(hash, section->hash, 0x20) != 0)
             return false;
@@ -105,6 +171,85 @@ static bool checkFirm(u32 firmSize)
     return arm9EpFound && (firm->arm11Entry == NULL || arm11EpFound);
 }
 
+//Runs from the SDMMC idle callback, hashes the sections in file order as far as they have been read
+static void firmHashPump(void)
+{
+    if(!firmHashStream.isHeaderParsed)
+    {
+        if(firmHashStream.readSize < 0x200) return;
+
+        firmHashStream.isHeaderParsed = true;
+        if(memcmp(firm->magic, "FIRM", 4) != 0) return;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            const FirmSection *section = &firm->section[i];
+
+            //Whatever is skipped here is left to checkFirm
+            if(section->size == 0 || section->offset + section->size < section->offset) continue;
+
+            u32 j;
+            for(j = firmHashStream.nbSections; j > 0 && firm->section[firmHashStream.order[j - 1]].offset > section->offset; j--)
+                firmHashStream.order[j] = firmHashStream.order[j - 1];
+
+            firmHashStream.order[j] = i;
+            firmHashStream.nbSections++;
+        }
+    }
+
+    while(firmHashStream.currentSection < firmHashStream.nbSections)
+    {
+        u32 i = firmHashStream.order[firmHashStream.currentSection];
+        const FirmSection *section = &firm->section[i];
+
+        if(firmHashStream.readSize <= section->offset) return;
+
+        if(!firmHashStream.isSectionStarted)
+        {
+            shaStreamStart((u8 *)firm + section->offset, section->size, SHA_256_MODE);
+            firmHashStream.isSectionStarted = true;
+        }
+
+        //Only the final round is left once the whole section is there
+        if(shaStreamFeed((u8 *)firm + firmHashStream.readSize) >= 0x40 || section->offset + section->size > firmHashStream.readSize) return;
+
+        shaStreamFinish(firmHashStream.hashes[i]);
+        firmHashStream.isHashed[i] = true;
+        firmHashStream.isSectionStarted = false;
+        firmHashStream.currentSection++;
+    }
+}
+
+//Reads a FIRM, hashing its sections while the rest is being transferred so that checkFirm doesn't have to
+static u32 readFirmHashed(const char *path, u32 maxSize)
+{
+    memset(&firmHashStream, 0, sizeof(firmHashStream));
+
+    sdmmc_idle_callback previousCallback = sdmmc_set_idle_callback(firmHashPump);
+    u32 firmSize = fileReadWithProgress(firm, path, maxSize, &firmHashStream.readSize);
+    sdmmc_set_idle_callback(previousCallback);
+
+    //Nothing hashed from a failed read may be used
+    if(!firmSize)
+    {
+        memset(&firmHashStream, 0, sizeof(firmHashStream));
+        return 0;
+    }
+
+    //Hash whatever is left over, the sections which aren't fully there are left to checkFirm
+    firmHashStream.readSize = firmSize;
+    firmHashPump(); //The header may not have been parsed yet, if no idle callback came after it was read
+    while(firmHashStream.currentSection < firmHashStream.nbSections)
+    {
+        const FirmSection *section = &firm->section[firmHashStream.order[firmHashStream.currentSection]];
+
+        if(section->offset + section->size > firmSize) break;
+        firmHashPump();
+    }
+
+    return firmSize;
+}
+
 static inline u32 loadFirmFromStorage(FirmwareType firmType)
 {
     static const char *firmwareFiles[] = {
@@ -122,7 +267,7 @@ static inline u32 loadFirmFromStorage(FirmwareType firmType)
         "cetk_sysupdater"
     };
 
-    u32 firmSize = fileRead(firm, firmwareFiles[(u32)firmType], 0x400000 + sizeof(Cxi) + 0x200);
+    u32 firmSize = readFirmHashed(firmwareFiles[(u32)firmType], 0x400000 + sizeof(Cxi) + 0x200);
 
     if(!firmSize) return 0;
 
@@ -160,6 +305,7 @@ u32 loadNintendoFirm(FirmwareType *firmType, FirmwareSource nandType, bool loadF
     {
         //Load FIRM from CTRNAND
         firmVersion = firmRead(firm, (u32)*firmType);
+        bootTraceMark("firmread");
 
         if(firmVersion == 0xFFFFFFFF) ctrNandError = true;
         else
@@ -167,6 +313,7 @@ u32 loadNintendoFirm(FirmwareType *firmType, FirmwareSource nandType, bool loadF
             firmSize = decryptExeFs((Cxi *)firm);
 
             if(!firmSize || !checkFirm(firmSize)) ctrNandError = true;
+            bootTraceMark("decrypt");
         }
     }
 
@@ -180,6 +327,7 @@ u32 loadNintendoFirm(FirmwareType *firmType, FirmwareSource nandType, bool loadF
         {
             loadedFromStorage = true;
             firmSize = result;
+            bootTraceMark("extfirm");
         }
         else if(ctrNandError) error("Unable to mount CTRNAND or load the CTRNAND FIRM.\nPlease use an external one.");
     }
@@ -246,7 +394,7 @@ void loadHomebrewFirm(u32 pressed)
     if(!found) return;
 
     u32 maxPayloadSize = (u32)((u8 *)0x27FFE000 - (u8 *)firm),
-        payloadSize = fileRead(firm, path, maxPayloadSize);
+        payloadSize = readFirmHashed(path, maxPayloadSize);
 
     if(payloadSize <= 0x200 || !checkFirm(payloadSize)) error("The payload is invalid or corrupted.");
 
@@ -264,7 +412,7 @@ void loadHomebrewFirm(u32 pressed)
     launchFirm(wantsScreenInit ? 2 : 1, argv);
 }
 
-static inline void mergeSection0(FirmwareType firmType, u32 firmVersion, bool loadFromStorage)
+static inline u32 mergeSection0(FirmwareType firmType, u32 firmVersion, bool loadFromStorage)
 {
     u32 srcModuleSize,
         nbModules = 0;
@@ -350,6 +498,8 @@ static inline void mergeSection0(FirmwareType firmType, u32 firmVersion, bool lo
         if(patchK11ModuleLoading(firm->section[0].size, dst - firm->section[0].address, (u8 *)firm + firm->section[1].offset, firm->section[1].size) != 0)
             error("Failed to inject custom sysmodule");
     }
+
+    return dst - firm->section[0].address;
 }
 
 u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStorage, bool isFirmProtEnabled, bool needToInitSd, bool doUnitinfoPatch)
@@ -359,7 +509,7 @@ u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStora
     if(ISN3DS)
     {
         //Decrypt Arm9Bin and patch Arm9 entrypoint to skip kernel9loader
-        kernel9Loader((Arm9Bin *)arm9Section);
+        if(kernel9Loader((Arm9Bin *)arm9Section)) nativeFirmCache.flags |= NATIVE_FIRM_CACHE_K9L_KEYS;
         firm->arm9Entry = (u8 *)0x801B01C;
     }
 
@@ -384,12 +534,17 @@ u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStora
             *arm11SvcTable = getKernel11Info(arm11Section1, firm->section[1].size, &baseK11VA, &freeK11Space, &arm11SvcHandler, &arm11ExceptionsPage);
 
         ret += installK11Extension(arm11Section1, firm->section[1].size, needToInitSd, baseK11VA, arm11ExceptionsPage, &freeK11Space);
+        nativeFirmCache.flags |= NATIVE_FIRM_CACHE_K11EXT;
         ret += patchKernel11(arm11Section1, firm->section[1].size, baseK11VA, arm11SvcTable, arm11ExceptionsPage);
     }
 #else
     (void)needToInitSd;
 #endif
 
+    //Locate all the Process9 and Kernel9 patch sites before patching them
+    scanPatchSites(process9Offset, process9Size, PATCH_SECTION_PROCESS9);
+    scanPatchSites(arm9Section, kernel9Size, PATCH_SECTION_KERNEL9);
+
     //Apply signature patches
     ret += patchSignatureChecks(process9Offset, process9Size);
 
@@ -430,9 +585,11 @@ u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStora
     ret += patchKernel9Panic(arm9Section, kernel9Size);
 
     ret += patchP9AccessChecks(process9Offset, process9Size);
+    bootTraceMark("patch");
 
-    mergeSection0(NATIVE_FIRM, firmVersion, loadFromStorage);
+    nativeFirmCache.section0Size = mergeSection0(NATIVE_FIRM, firmVersion, loadFromStorage);
     firm->section[0].size = 0;
+    bootTraceMark("modules");
 
     return ret;
 }
@@ -460,6 +617,8 @@ u32 patchTwlFirm(u32 firmVersion, bool loadFromStorage, bool doUnitinfoPatch)
     u32 kernel9Size = (u32)(process9Offset - arm9Section) - sizeof(Cxi) - 0x200,
         ret = 0;
 
+    scanPatchSites(process9Offset, process9Size, PATCH_SECTION_LGY_PROCESS9);
+
     ret += patchLgySignatureChecks(process9Offset, process9Size);
     ret += patchTwlInvalidSignatureChecks(process9Offset, process9Size);
     ret += patchTwlNintendoLogoChecks(process9Offset, process9Size);
@@ -499,6 +658,8 @@ u32 patchAgbFirm(bool loadFromStorage, bool doUnitinfoPatch)
     u32 kernel9Size = (u32)(process9Offset - arm9Section) - sizeof(Cxi) - 0x200,
         ret = 0;
 
+    scanPatchSites(process9Offset, process9Size, PATCH_SECTION_LGY_PROCESS9);
+
     ret += patchLgySignatureChecks(process9Offset, process9Size);
     if(CONFIG(SHOWGBABOOT)) ret += patchAgbBootSplash(process9Offset, process9Size);
 
@@ -521,7 +682,7 @@ u32 patch1x2xNativeAndSafeFirm(void)
     if(ISN3DS)
     {
         //Decrypt Arm9Bin and patch Arm9 entrypoint to skip kernel9loader
-        kernel9Loader((Arm9Bin *)arm9Section);
+        if(kernel9Loader((Arm9Bin *)arm9Section)) nativeFirmCache.flags |= NATIVE_FIRM_CACHE_K9L_KEYS;
         firm->arm9Entry = (u8 *)0x801B01C;
     }
 
@@ -533,6 +694,9 @@ u32 patch1x2xNativeAndSafeFirm(void)
     u32 kernel9Size = (u32)(process9Offset - arm9Section) - sizeof(Cxi) - 0x200,
         ret = 0;
 
+    if(ISN3DS) scanPatchSites(process9Offset, process9Size, PATCH_SECTION_PROCESS9);
+    scanPatchSites(arm9Section, kernel9Size, PATCH_SECTION_KERNEL9);
+
     ret += ISN3DS ? patchFirmWrites(process9Offset, process9Size) : patchOldFirmWrites(process9Offset, process9Size);
 
     ret += ISN3DS ? patchSignatureChecks(process9Offset, process9Size) : patchOldSignatureChecks(process9Offset, process9Size);
@@ -570,6 +734,135 @@ u32 patch1x2xNativeAndSafeFirm(void)
     return ret;
 }
 
+static void writeNativeFirmCacheTiming(u32 uncachedTimeMs, u32 cachedTimeMs)
+{
+    char timing[96];
+    u32 len = sprintf(timing, "Decryption and patching: %lu ms\nCached image: %lu ms\n", uncachedTimeMs, cachedTimeMs);
+
+    fileWrite(timing, NATIVE_FIRM_CACHE_TIMING_PATH, len);
+}
+
+//Hashes what the patched image is built from besides the FIRM itself: our own code and patches,
+//the kernel11 extension and the sysmodules, as loaded. Unlike the commit hash, this also tells
+//apart builds made from a modified tree
+static void hashPayloads(u8 *res)
+{
+    __attribute__((aligned(4))) u8 hashes[5][0x20];
+    u32 k11ExtCodeSize, sysmodulesSize = 0;
+    const void *k11ExtCode = getK11ExtensionCode(&k11ExtCodeSize);
+
+    for(const u8 *src = (const u8 *)0x18180000; memcmp(((const Cxi *)src)->ncch.magic, "NCCH", 4) == 0; src += ((const Cxi *)src)->ncch.contentSize * 0x200)
+        sysmodulesSize += ((const Cxi *)src)->ncch.contentSize * 0x200;
+
+    sha(hashes[0], __start__, (u32)(__rodata_end__ - __start__), SHA_256_MODE);
+    sha(hashes[1], emunandPatch, emunandPatchSize, SHA_256_MODE);
+    sha(hashes[2], rebootPatch, rebootPatchSize, SHA_256_MODE);
+    sha(hashes[3], k11ExtCode, k11ExtCodeSize, SHA_256_MODE);
+    sha(hashes[4], (const void *)0x18180000, sysmodulesSize, SHA_256_MODE);
+    sha(res, hashes, sizeof(hashes), SHA_256_MODE);
+}
+
+bool loadCachedNativeFirm(FirmwareSource nandType, bool isFirmProtEnabled, bool needToInitSd, bool doUnitinfoPatch)
+{
+    startChrono();
+    nativeFirmCache.startTime = chrono();
+
+    if(isSdMode && !mountFs(false, false)) return false;
+
+    //Only the FIRM header is needed to identify the CTRNAND FIRM, skip reading and decrypting the rest
+    Cxi *cxi = (Cxi *)firm;
+    __attribute__((aligned(4))) Firm firmHeader;
+    u32 contentId = firmReadHeader(cxi, (u32)NATIVE_FIRM);
+
+    if(contentId == 0xFFFFFFFF || !decryptExeFsFirmHeader(cxi, &firmHeader)) return false;
+
+    NativeFirmCacheKey *key = &nativeFirmCache.key;
+    memset(key, 0, sizeof(NativeFirmCacheKey));
+    hashPayloads(key->payloadsHash);
+    key->contentId = contentId;
+    key->flags = (ISN3DS ? 1 : 0) | (ISDEVUNIT ? 2 : 0) | ((u32)isFirmProtEnabled << 3) | ((u32)doUnitinfoPatch << 4);
+    key->nandType = (u32)nandType;
+    key->firmSource = (u32)firmSource;
+    key->emuOffset = emuOffset;
+    key->emuHeader = emuHeader;
+    memcpy(key->launchedPath, launchedPath, sizeof(key->launchedPath));
+    for(u32 i = 0; i < 4; i++)
+        memcpy(key->sectionHashes[i], firmHeader.section[i].hash, sizeof(key->sectionHashes[i]));
+
+    nativeFirmCache.isKeyValid = true;
+
+    u32 maxCacheSize = (u32)((u8 *)0x27FFE000 - (u8 *)firm),
+        cacheSize = fileRead(firm, NATIVE_FIRM_CACHE_PATH, maxCacheSize);
+
+    if(cacheSize < 0x200 + sizeof(NativeFirmCacheTrailer)) return false;
+
+    NativeFirmCacheTrailer trailer;
+    memcpy(&trailer, (u8 *)firm + cacheSize - sizeof(NativeFirmCacheTrailer), sizeof(NativeFirmCacheTrailer));
+
+    if(memcmp(firm->magic, "FIRM", 4) != 0 || memcmp(trailer.magic, "LFWC", 4) != 0 || trailer.version != NATIVE_FIRM_CACHE_VERSION ||
+       trailer.imageSize != cacheSize - sizeof(NativeFirmCacheTrailer) ||
+       memcmp(&trailer.key, key, sizeof(NativeFirmCacheKey)) != 0)
+        return false;
+
+    for(u32 i = 0; i < 4; i++)
+        if(firm->section[i].size != 0 && (firm->section[i].offset < 0x200 || firm->section[i].offset + firm->section[i].size > trailer.imageSize)) return false;
+
+    __attribute__((aligned(4))) u8 hash[0x20];
+
+    sha(hash, firm, trailer.imageSize, SHA_256_MODE);
+
+    if(memcmp(hash, trailer.imageHash, sizeof(hash)) != 0) return false;
+
+    //Redo what patching did outside of the image itself
+    if(trailer.flags & NATIVE_FIRM_CACHE_K9L_KEYS) kernel9LoaderSetupKeys((const Arm9Bin *)((u8 *)firm + firm->section[2].offset));
+    if(trailer.flags & NATIVE_FIRM_CACHE_K11EXT) setK11ExtensionParameters(trailer.k11ExtOriginalHandlers, needToInitSd);
+
+    if(getFileSize(NATIVE_FIRM_CACHE_TIMING_PATH) == 0)
+        writeNativeFirmCacheTiming(trailer.uncachedTimeMs, (u32)(chrono() - nativeFirmCache.startTime));
+
+    return true;
+}
+
+void saveCachedNativeFirm(void)
+{
+    //Only cache what was read from the CTRNAND FIRM identified by the key
+    if(!nativeFirmCache.isKeyValid) return;
+
+    for(u32 i = 0; i < 4; i++)
+        if(memcmp(firm->section[i].hash, nativeFirmCache.key.sectionHashes[i], sizeof(firm->section[i].hash)) != 0) return;
+
+    //The merged modules were written in place, store them as a regular section after the others
+    u32 imageSize = 0x200;
+    for(u32 i = 1; i < 4; i++)
+        if(firm->section[i].offset + firm->section[i].size > imageSize) imageSize = firm->section[i].offset + firm->section[i].size;
+
+    u32 section0Offset = firm->section[0].offset,
+        section0Size = nativeFirmCache.section0Size;
+
+    firm->section[0].offset = imageSize;
+    firm->section[0].size = section0Size;
+    memcpy((u8 *)firm + imageSize, firm->section[0].address, section0Size);
+    imageSize += section0Size;
+
+    NativeFirmCacheTrailer *trailer = (NativeFirmCacheTrailer *)((u8 *)firm + imageSize);
+    memcpy(trailer->magic, "LFWC", 4);
+    trailer->version = NATIVE_FIRM_CACHE_VERSION;
+    memcpy(&trailer->key, &nativeFirmCache.key, sizeof(NativeFirmCacheKey));
+    trailer->imageSize = imageSize;
+    trailer->flags = nativeFirmCache.flags;
+    if(trailer->flags & NATIVE_FIRM_CACHE_K11EXT) getK11ExtensionOriginalHandlers(trailer->k11ExtOriginalHandlers);
+    else memset(trailer->k11ExtOriginalHandlers, 0, sizeof(trailer->k11ExtOriginalHandlers));
+    trailer->uncachedTimeMs = (u32)(chrono() - nativeFirmCache.startTime);
+    sha(trailer->imageHash, firm, imageSize, SHA_256_MODE);
+
+    if(fileWrite(firm, NATIVE_FIRM_CACHE_PATH, imageSize + sizeof(NativeFirmCacheTrailer)))
+        fileDelete(NATIVE_FIRM_CACHE_TIMING_PATH);
+
+    //The modules are already in place
+    firm->section[0].offset = section0Offset;
+    firm->section[0].size = 0;
+}
+
 void launchFirm(int argc, char **argv)
 {
     prepareArm11ForFirmlaunch();
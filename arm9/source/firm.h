@@ -35,4 +35,6 @@ u32 patchNativeFirm(u32 firmVersion, FirmwareSource nandType, bool loadFromStora
 u32 patchTwlFirm(u32 firmVersion, bool loadFromStorage, bool doUnitinfoPatch);
 u32 patchAgbFirm(bool loadFromStorage, bool doUnitinfoPatch);
 u32 patch1x2xNativeAndSafeFirm(void);
+bool loadCachedNativeFirm(FirmwareSource nandType, bool isFirmProtEnabled, bool needToInitSd, bool doUnitinfoPatch);
+void saveCachedNativeFirm(void);
 void launchFirm(int argc, char **argv);
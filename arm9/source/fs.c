@@ -33,6 +33,7 @@
 #include "draw.h"
 #include "utils.h"
 #include "fatfs/ff.h"
+#include "fatfs/diskio.h"
 #include "buttons.h"
 #include "firm.h"
 #include "crypto.h"
@@ -43,6 +44,14 @@
 static FATFS sdFs,
              nandFs;
 
+//Cluster link map used by fileRead, enough for 127 fragments
+static DWORD fileLinkMap[0x100];
+
+//The SD/MMC block count register is 16-bit
+#define MAX_READ_SECTORS 0x8000
+//Smaller transfers so that progress is reported while the rest of the file is still being read
+#define PROGRESS_READ_SECTORS 0x100
+
 static bool switchToMainDir(bool isSd)
 {
     const char *mainDir = isSd ? "/luma" : "/rw/luma";
@@ -75,7 +84,74 @@ bool mountFs(bool isSd, bool switchToCtrNand)
     }
 }
 
-u32 fileRead(void *dest, const char *path, u32 maxSize)
+static bool fileCreateLinkMap(FIL *file, DWORD *linkMap, u32 linkMapSize)
+{
+    file->cltbl = linkMap;
+    linkMap[0] = linkMapSize;
+
+    if(f_lseek(file, CREATE_LINKMAP) == FR_OK) return true;
+
+    //Too fragmented, keep following the FAT chain
+    file->cltbl = NULL;
+    return false;
+}
+
+static FRESULT fileReadContiguous(FIL *file, void *dest, u32 size, u32 *read, u32 maxTransferSectors)
+{
+    FSIZE_t pos = f_tell(file);
+
+    if(size > f_size(file) - pos) size = (u32)(f_size(file) - pos);
+
+    *read = 0;
+
+    //Only whole sectors can be read directly
+    if(file->cltbl == NULL || pos % FF_MAX_SS != 0) return f_read(file, dest, size, (UINT *)read);
+
+    FATFS *fs = file->obj.fs;
+    u8 *buf = (u8 *)dest;
+    FSIZE_t fragmentStart = 0;
+
+    //Each fragment is a run of consecutive clusters, read as few large transfers
+    for(const DWORD *fragment = file->cltbl + 1; fragment[0] != 0 && size >= FF_MAX_SS; fragment += 2)
+    {
+        FSIZE_t fragmentEnd = fragmentStart + (FSIZE_t)fragment[0] * fs->csize * FF_MAX_SS;
+
+        while(pos < fragmentEnd && size >= FF_MAX_SS)
+        {
+            u32 count = (u32)((fragmentEnd - pos) / FF_MAX_SS);
+
+            if(count > size / FF_MAX_SS) count = size / FF_MAX_SS;
+            if(count > maxTransferSectors) count = maxTransferSectors;
+
+            LBA_t sector = fs->database + (LBA_t)fs->csize * (fragment[1] - 2) + (LBA_t)((pos - fragmentStart) / FF_MAX_SS);
+
+            if(disk_read(fs->pdrv, buf, sector, count) != RES_OK) return FR_DISK_ERR;
+
+            buf += count * FF_MAX_SS;
+            pos += count * FF_MAX_SS;
+            size -= count * FF_MAX_SS;
+            *read += count * FF_MAX_SS;
+        }
+
+        fragmentStart = fragmentEnd;
+    }
+
+    //Partial last sector
+    FRESULT result = f_lseek(file, pos);
+
+    if(result == FR_OK && size != 0)
+    {
+        UINT tailRead;
+
+        result = f_read(file, buf, size, &tailRead);
+        *read += tailRead;
+    }
+
+    return result;
+}
+
+//"progress" is kept up to date with the number of bytes read so far, for consumers running from the SDMMC idle callback
+u32 fileReadWithProgress(void *dest, const char *path, u32 maxSize, u32 *progress)
 {
     FIL file;
     FRESULT result = FR_OK;
@@ -83,15 +159,33 @@ u32 fileRead(void *dest, const char *path, u32 maxSize)
 
     if(f_open(&file, path, FA_READ) != FR_OK) return ret;
 
-    u32 size = f_size(&file);
+    //exFAT file sizes are 64-bit, a size which doesn't fit is reported as the largest one and never read
+    FSIZE_t fileSize = f_size(&file);
+    u32 size = fileSize > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)fileSize;
+
     if(dest == NULL) ret = size;
-    else if(size <= maxSize)
-        result = f_read(&file, dest, size, (unsigned int *)&ret);
+    else if(fileSize <= maxSize)
+    {
+        //Files within a single cluster are already read in one go
+        if(size > file.obj.fs->csize * FF_MAX_SS) fileCreateLinkMap(&file, fileLinkMap, sizeof(fileLinkMap) / sizeof(DWORD));
+
+        if(progress == NULL) result = fileReadContiguous(&file, dest, size, &ret, MAX_READ_SECTORS);
+        else
+        {
+            result = fileReadContiguous(&file, dest, size, progress, PROGRESS_READ_SECTORS);
+            ret = *progress;
+        }
+    }
     result |= f_close(&file);
 
     return result == FR_OK ? ret : 0;
 }
 
+u32 fileRead(void *dest, const char *path, u32 maxSize)
+{
+    return fileReadWithProgress(dest, path, maxSize, NULL);
+}
+
 u32 getFileSize(const char *path)
 {
     return fileRead(NULL, path, 0);
@@ -143,7 +237,14 @@ bool fileCopy(const char *pathSrc, const char *pathDst, bool replace, void *tmpB
     if (res != FR_OK)
         return true; // Succeed if the source file doesn't exist
 
-    size_t szSrc = f_size(&fileSrc), rem = szSrc;
+    // exFAT files may be 4 GiB or larger, more than the size_t counts below can hold
+    if (f_size(&fileSrc) > 0xFFFFFFFF)
+    {
+        f_close(&fileSrc);
+        return false;
+    }
+
+    size_t szSrc = (size_t)f_size(&fileSrc), rem = szSrc;
 
     res = f_open(&fileDst, pathDst, FA_WRITE | (replace ? FA_CREATE_ALWAYS : FA_CREATE_NEW));
 
@@ -335,7 +436,7 @@ bool payloadMenu(char *path, bool *hasDisplayedMenu)
     return false;
 }
 
-u32 firmRead(void *dest, u32 firmType)
+static u32 findFirmContent(char *path, u32 firmType)
 {
     static const char *firmFolders[][2] = {{"00000002", "20000002"},
                                            {"00000102", "20000102"},
@@ -343,8 +444,7 @@ u32 firmRead(void *dest, u32 firmType)
                                            {"00000003", "20000003"},
                                            {"00000001", "20000001"}};
 
-    char folderPath[64],
-         path[128];
+    char folderPath[64];
 
     sprintf(folderPath, "nand:/title/00040138/%s/content", firmFolders[firmType][ISN3DS ? 1 : 0]);
 
@@ -367,17 +467,47 @@ u32 firmRead(void *dest, u32 firmType)
         if(tempVersion < firmVersion) firmVersion = tempVersion;
     }
 
-    if(f_closedir(&dir) != FR_OK || firmVersion == 0xFFFFFFFF) goto exit;
+    if(f_closedir(&dir) != FR_OK || firmVersion == 0xFFFFFFFF)
+    {
+        firmVersion = 0xFFFFFFFF;
+        goto exit;
+    }
 
     //Complete the string with the .app name
     sprintf(path, "%s/%08lx.app", folderPath, firmVersion);
 
-    if(fileRead(dest, path, 0x400000 + sizeof(Cxi) + 0x200) <= sizeof(Cxi) + 0x400) firmVersion = 0xFFFFFFFF;
-
 exit:
     return firmVersion;
 }
 
+u32 firmRead(void *dest, u32 firmType)
+{
+    char path[128];
+    u32 firmVersion = findFirmContent(path, firmType);
+
+    if(firmVersion != 0xFFFFFFFF && fileRead(dest, path, 0x400000 + sizeof(Cxi) + 0x200) <= sizeof(Cxi) + 0x400) firmVersion = 0xFFFFFFFF;
+
+    return firmVersion;
+}
+
+u32 firmReadHeader(void *dest, u32 firmType)
+{
+    char path[128];
+    u32 firmVersion = findFirmContent(path, firmType);
+
+    if(firmVersion == 0xFFFFFFFF) return firmVersion;
+
+    //NCCH header, ExHeader, ExeFS header and FIRM header
+    FIL file;
+    unsigned int read = 0;
+
+    if(f_open(&file, path, FA_READ) != FR_OK) return 0xFFFFFFFF;
+    if(f_read(&file, dest, sizeof(Cxi) + 0x400, &read) != FR_OK || read != sizeof(Cxi) + 0x400) firmVersion = 0xFFFFFFFF;
+    f_close(&file);
+
+    return firmVersion;
+}
+
 void findDumpFile(const char *folderPath, char *fileName)
 {
     DIR dir;
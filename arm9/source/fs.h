@@ -32,6 +32,7 @@
 
 bool mountFs(bool isSd, bool switchToCtrNand);
 u32 fileRead(void *dest, const char *path, u32 maxSize);
+u32 fileReadWithProgress(void *dest, const char *path, u32 maxSize, u32 *progress);
 u32 getFileSize(const char *path);
 bool fileWrite(const void *buffer, const char *path, u32 size);
 bool fileDelete(const char *path);
@@ -39,6 +40,7 @@ bool fileCopy(const char *pathSrc, const char *pathDst, bool replace, void *tmpB
 bool findPayload(char *path, u32 pressed);
 bool payloadMenu(char *path, bool *hasDisplayedMenu);
 u32 firmRead(void *dest, u32 firmType);
+u32 firmReadHeader(void *dest, u32 firmType);
 void findDumpFile(const char *folderPath, char *fileName);
 
 bool doLumaUpgradeProcess(void);
@@ -39,6 +39,7 @@
 #include "screen.h"
 #include "i2c.h"
 #include "fmt.h"
+#include "boottrace.h"
 #include "fatfs/sdmmc/sdmmc.h"
 
 extern u8 __itcm_start__[], __itcm_lma__[], __itcm_bss_start__[], __itcm_end__[];
@@ -69,6 +70,8 @@ void main(int argc, char **argv, u32 magicWord)
     const vu32 *bootPartitionsStatus = (const vu32 *)0x1FFFE010;
     u32 firmlaunchTidLow = 0;
 
+    bootTraceStart();
+
     //Shell closed, no error booting NTRCARD, NAND paritions not even considered
     isNtrBoot = bootMediaStatus[3] == 2 && !bootMediaStatus[1] && !bootPartitionsStatus[0] && !bootPartitionsStatus[1];
 
@@ -138,6 +141,7 @@ void main(int argc, char **argv, u32 magicWord)
     if (mcuFwVerHi < 1) error("Unsupported MCU FW version %d.%d.", (int)mcuFwVerHi, (int)mcuFwVerLo);
 
     I2C_readRegBuf(I2C_DEV_MCU, 0x7F, mcuConsoleInfo, 9);
+    bootTraceMark("mcu");
 
     if(isInvalidLoader) error("Launched using an unsupported loader.");
 
@@ -178,10 +182,13 @@ void main(int argc, char **argv, u32 magicWord)
         error("Launched from an unsupported location: %s.", mountPoint);
     }
 
+    bootTraceMark("mount");
+
     detectAndProcessExceptionDumps();
 
     //Attempt to read the configuration file
     needConfig = readConfig() ? MODIFY_CONFIGURATION : CREATE_CONFIGURATION;
+    bootTraceMark("config");
 
     //Determine if this is a firmlaunch boot
     if(bootType == FIRMLAUNCH)
@@ -277,6 +284,8 @@ void main(int argc, char **argv, u32 magicWord)
         pressed = HID_PAD;
     }
 
+    if(pinExists || shouldLoadConfigMenu) bootTraceMark("menus");
+
     if(!CFG_BOOTENV && pressed == SAFE_MODE)
     {
         nandType = FIRMWARE_SYSNAND;
@@ -290,7 +299,11 @@ void main(int argc, char **argv, u32 magicWord)
 
     u32 splashMode = MULTICONFIG(SPLASH);
 
-    if(splashMode == 1 && loadSplash()) pressed = HID_PAD;
+    if(splashMode == 1 && loadSplash())
+    {
+        bootTraceMark("splash");
+        pressed = HID_PAD;
+    }
 
     bool autoBootEmu = CONFIG(AUTOBOOTEMU);
 
@@ -302,7 +315,11 @@ void main(int argc, char **argv, u32 magicWord)
     else if((((pressed & SINGLE_PAYLOAD_BUTTONS) || (!autoBootEmu && (pressed & DPAD_BUTTONS))) && !(pressed & (BUTTON_L1 | BUTTON_R1))) ||
             (((pressed & L_PAYLOAD_BUTTONS) || (autoBootEmu && (pressed & DPAD_BUTTONS))) && (pressed & BUTTON_L1))) loadHomebrewFirm(pressed);
 
-    if(splashMode == 2 && loadSplash()) pressed = HID_PAD;
+    if(splashMode == 2 && loadSplash())
+    {
+        bootTraceMark("splash");
+        pressed = HID_PAD;
+    }
 
     //Check SAFE_MODE combo again
     if(!CFG_BOOTENV && pressed == SAFE_MODE)
@@ -384,22 +401,45 @@ boot:
     else if(firmSource != FIRMWARE_SYSNAND)
         locateEmuNand(&firmSource);
 
+    bootTraceMark("emunand");
+
     if(bootType != FIRMLAUNCH)
     {
         configData.bootConfig = ((bootType == NTR ? 1 : 0) << 7) | ((u32)isNoForceFlagSet << 6) | ((u32)firmSource << 3) | (u32)nandType;
         writeConfig(false);
     }
 
-    bool loadFromStorage = CONFIG(LOADEXTFIRMSANDMODULES);
+    bool loadFromStorage = CONFIG(LOADEXTFIRMSANDMODULES),
+         doUnitinfoPatch = CONFIG(PATCHUNITINFO),
+         useNativeFirmCache = firmType == NATIVE_FIRM && !loadFromStorage && CONFIG(CACHENATIVEFIRM);
+
+    //Boot the already patched image straight away if it is still valid
+    if(useNativeFirmCache)
+    {
+        bool isCached = loadCachedNativeFirm(nandType, isFirmProtEnabled, needToInitSd, doUnitinfoPatch);
+        bootTraceMark("fwcache");
+
+        if(isCached)
+        {
+            if(CONFIG(SAVEBOOTTRACE)) bootTraceSave();
+            if(bootType != FIRMLAUNCH) deinitScreens();
+            launchFirm(0, NULL);
+        }
+    }
+
     u32 firmVersion = loadNintendoFirm(&firmType, firmSource, loadFromStorage, isSafeMode);
 
-    bool doUnitinfoPatch = CONFIG(PATCHUNITINFO);
     u32 res = 0;
     switch(firmType)
     {
         case NATIVE_FIRM:
         {
             res = patchNativeFirm(firmVersion, nandType, loadFromStorage, isFirmProtEnabled, needToInitSd, doUnitinfoPatch);
+            if(res == 0 && useNativeFirmCache)
+            {
+                saveCachedNativeFirm();
+                bootTraceMark("cachesav");
+            }
             break;
         }
         case TWL_FIRM:
@@ -417,6 +457,8 @@ boot:
 
     if(res != 0) error("Failed to apply %u FIRM patch(es).", res);
 
+    if(CONFIG(SAVEBOOTTRACE)) bootTraceSave();
+
     if(bootType != FIRMLAUNCH) deinitScreens();
     launchFirm(0, NULL);
 }
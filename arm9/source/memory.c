@@ -55,6 +55,67 @@ u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize)
     return NULL;
 }
 
+//Finds the first occurrence of up to MEMSEARCH_MULTI_MAX_PATTERNS patterns in a single pass (any more take further ones),
+//same results as calling memsearch for each of them
+void memsearchMulti(u8 *startPos, u32 size, const MemSearchPattern *patterns, u32 nbPatterns, u8 **results)
+{
+    //Each pattern has a bit in the masks below
+    if(nbPatterns > MEMSEARCH_MULTI_MAX_PATTERNS)
+    {
+        memsearchMulti(startPos, size, patterns + MEMSEARCH_MULTI_MAX_PATTERNS, nbPatterns - MEMSEARCH_MULTI_MAX_PATTERNS,
+                       results + MEMSEARCH_MULTI_MAX_PATTERNS);
+        nbPatterns = MEMSEARCH_MULTI_MAX_PATTERNS;
+    }
+
+    u32 candidates[256] = {0},
+        pending = 0,
+        windowSize = 0xFFFFFFFF;
+    u8 table[256];
+
+    for(u32 i = 0; i < nbPatterns; i++)
+    {
+        results[i] = NULL;
+        if(patterns[i].size == 0 || patterns[i].size > size) continue;
+
+        pending |= 1u << i;
+        if(patterns[i].size < windowSize) windowSize = patterns[i].size;
+    }
+
+    if(pending == 0) return;
+    if(windowSize > 0xFF) windowSize = 0xFF;
+
+    //Preprocessing, shared over a window as long as the shortest pattern
+    memset(table, windowSize, sizeof(table));
+    for(u32 i = 0; i < nbPatterns; i++)
+    {
+        if(((pending >> i) & 1) == 0) continue;
+
+        const u8 *patternc = (const u8 *)patterns[i].pattern;
+        for(u32 j = 0; j < windowSize - 1; j++)
+            if(windowSize - j - 1 < table[patternc[j]]) table[patternc[j]] = windowSize - j - 1;
+        candidates[patternc[windowSize - 1]] |= 1u << i;
+    }
+
+    //Searching
+    u32 j = 0;
+    while(pending != 0 && j <= size - windowSize)
+    {
+        u8 c = startPos[j + windowSize - 1];
+
+        for(u32 matches = candidates[c] & pending; matches != 0; matches &= matches - 1)
+        {
+            u32 i = __builtin_ctz(matches);
+            if(j + patterns[i].size <= size && memcmp(patterns[i].pattern, startPos + j, patterns[i].size) == 0)
+            {
+                results[i] = startPos + j;
+                pending &= ~(1u << i);
+            }
+        }
+
+        j += table[c];
+    }
+}
+
 void *copyFromLegacyModeFcram(void *dst, const void *src, size_t size)
 {
     // Copy 2 bytes with a stride of 8
@@ -33,6 +33,16 @@
 #include <string.h>
 #include "types.h"
 
+//Most patterns memsearchMulti looks for in a single pass
+#define MEMSEARCH_MULTI_MAX_PATTERNS    32
+
+typedef struct MemSearchPattern
+{
+    const void *pattern;
+    u32 size;
+} MemSearchPattern;
+
 u8 *memsearch(u8 *startPos, const void *pattern, u32 size, u32 patternSize);
+void memsearchMulti(u8 *startPos, u32 size, const MemSearchPattern *patterns, u32 nbPatterns, u8 **results);
 void *copyFromLegacyModeFcram(void *dst, const void *src, size_t size);
 void *copyToLegacyModeFcram(void *dst, const void *src, size_t size);
@@ -33,6 +33,7 @@
 *   TWL_FIRM patches by Steveice10 and others
 */
 
+#include <assert.h>
 #include "patches.h"
 #include "fs.h"
 #include "exceptions.h"
@@ -46,6 +47,94 @@
 
 extern u16 launchedPath[];
 
+typedef struct PatchSignature
+{
+    PatchSiteSection section;
+    u32 size;
+    u8 pattern[12];
+} PatchSignature;
+
+static const PatchSignature patchSignatures[PATCH_SITE_COUNT] = {
+    [PATCH_SITE_SIGNATURE_CHECKS]                   = {PATCH_SECTION_PROCESS9, 4, {0xC0, 0x1C, 0x76, 0xE7}},
+    [PATCH_SITE_SIGNATURE_CHECKS_2]                 = {PATCH_SECTION_PROCESS9, 4, {0xB5, 0x22, 0x4D, 0x0C}},
+    [PATCH_SITE_FIRM_WRITES]                        = {PATCH_SECTION_PROCESS9, 4, {'e', 'x', 'e', ':'}},
+    [PATCH_SITE_FIRMLAUNCHES]                       = {PATCH_SECTION_PROCESS9, 4, {0xE2, 0x20, 0x20, 0x90}},
+    [PATCH_SITE_TITLE_INSTALL_MIN_VERSION_CHECKS]   = {PATCH_SECTION_PROCESS9, 4, {0xFF, 0x00, 0x00, 0x02}},
+    [PATCH_SITE_ZERO_KEY_NCCH_ENCRYPTION_CHECK]     = {PATCH_SECTION_PROCESS9, 4, {0x28, 0x2A, 0xD0, 0x08}},
+    [PATCH_SITE_NAND_NCCH_ENCRYPTION_CHECK]         = {PATCH_SECTION_PROCESS9, 4, {0x07, 0xD1, 0x28, 0x7A}},
+    [PATCH_SITE_DEV_COMMON_KEY_CHECK]               = {PATCH_SECTION_PROCESS9, 4, {0x03, 0x7C, 0x28, 0x00}},
+    [PATCH_SITE_P9_ACCESS_CHECKS]                   = {PATCH_SECTION_PROCESS9, 4, {0x00, 0x08, 0x49, 0x68}},
+    [PATCH_SITE_RT_MEMCLR]                          = {PATCH_SECTION_PROCESS9, 12, {0x00, 0x20, 0xA0, 0xE3, 0x04, 0x00, 0x51, 0xE3, 0x07, 0x00, 0x00, 0x3A}},
+    [PATCH_SITE_P9_AM_TICKET_WRAPPER]               = {PATCH_SECTION_PROCESS9, 4, {0x20, 0x21, 0xA6, 0xA8}},
+    [PATCH_SITE_EMUNAND_SDMMC]                      = {PATCH_SECTION_PROCESS9, 4, {0x21, 0x20, 0x18, 0x20}},
+    [PATCH_SITE_EMUNAND_NAND_RW]                    = {PATCH_SECTION_PROCESS9, 4, {0x1E, 0x00, 0xC8, 0x05}},
+
+    [PATCH_SITE_EMUNAND_FREE_K9_SPACE]              = {PATCH_SECTION_KERNEL9, 6, {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00}},
+    [PATCH_SITE_EMUNAND_MPU]                        = {PATCH_SECTION_KERNEL9, 4, {0x03, 0x00, 0x24, 0x00}},
+    [PATCH_SITE_UNITINFO_VALUE_SET]                 = {PATCH_SECTION_KERNEL9, 4, {0x01, 0x10, 0xA0, 0x13}},
+    [PATCH_SITE_ARM9_EXCEPTION_HANDLERS_INSTALL]    = {PATCH_SECTION_KERNEL9, 4, {0x80, 0xE5, 0x40, 0x1C}},
+    [PATCH_SITE_SVC_BREAK9]                         = {PATCH_SECTION_KERNEL9, 4, {0x00, 0xE0, 0x4F, 0xE1}}, //mrs lr, spsr
+    [PATCH_SITE_KERNEL9_PANIC]                      = {PATCH_SECTION_KERNEL9, 4, {0x00, 0x20, 0x92, 0x15}},
+
+    [PATCH_SITE_LGY_SIGNATURE_CHECKS]               = {PATCH_SECTION_LGY_PROCESS9, 4, {0x47, 0xC1, 0x17, 0x49}},
+    [PATCH_SITE_TWL_INVALID_SIGNATURE_CHECKS]       = {PATCH_SECTION_LGY_PROCESS9, 4, {0x20, 0xF6, 0xE7, 0x7F}},
+    [PATCH_SITE_TWL_NINTENDO_LOGO_CHECKS]           = {PATCH_SECTION_LGY_PROCESS9, 4, {0xC0, 0x30, 0x06, 0xF0}},
+    [PATCH_SITE_TWL_WHITELIST_CHECKS]               = {PATCH_SECTION_LGY_PROCESS9, 4, {0x22, 0x00, 0x20, 0x30}},
+    [PATCH_SITE_TWL_FLASHCART_CHECKS]               = {PATCH_SECTION_LGY_PROCESS9, 4, {0x25, 0x20, 0x00, 0x0E}},
+    [PATCH_SITE_OLD_TWL_FLASHCART_CHECKS]           = {PATCH_SECTION_LGY_PROCESS9, 4, {0x06, 0xF0, 0xA0, 0xFD}},
+    [PATCH_SITE_TWL_SHA_HASH_CHECKS]                = {PATCH_SECTION_LGY_PROCESS9, 4, {0x10, 0xB5, 0x14, 0x22}},
+    [PATCH_SITE_AGB_BOOT_SPLASH]                    = {PATCH_SECTION_LGY_PROCESS9, 4, {0x00, 0x00, 0x01, 0xEF}},
+};
+
+//Each section is scanned in a single memsearchMulti pass
+static_assert(PATCH_SITE_COUNT <= MEMSEARCH_MULTI_MAX_PATTERNS, "Too many patch signatures for a single scan");
+
+static struct
+{
+    u8 *pos;
+    u32 size;
+} scannedSections[PATCH_SECTION_COUNT];
+
+static u8 *patchSiteOffsets[PATCH_SITE_COUNT];
+
+//Looks for all the signatures of a section at once. The offsets are those of the unpatched section,
+//so this must run before any patch is applied to it
+void scanPatchSites(u8 *pos, u32 size, PatchSiteSection section)
+{
+    MemSearchPattern patterns[PATCH_SITE_COUNT];
+    u8 *results[PATCH_SITE_COUNT];
+    PatchSite sites[PATCH_SITE_COUNT];
+    u32 nbPatterns = 0;
+
+    for(u32 i = 0; i < PATCH_SITE_COUNT; i++)
+    {
+        if(patchSignatures[i].section != section) continue;
+
+        patterns[nbPatterns].pattern = patchSignatures[i].pattern;
+        patterns[nbPatterns].size = patchSignatures[i].size;
+        sites[nbPatterns++] = (PatchSite)i;
+    }
+
+    memsearchMulti(pos, size, patterns, nbPatterns, results);
+
+    for(u32 i = 0; i < nbPatterns; i++)
+        patchSiteOffsets[sites[i]] = results[i];
+
+    scannedSections[section].pos = pos;
+    scannedSections[section].size = size;
+}
+
+u8 *getPatchSite(u8 *pos, u32 size, PatchSite site)
+{
+    const PatchSignature *signature = &patchSignatures[site];
+
+    if(scannedSections[signature->section].pos == pos && scannedSections[signature->section].size == size)
+        return patchSiteOffsets[site];
+
+    //Region wasn't scanned, search it the slow way
+    return memsearch(pos, signature->pattern, size, signature->size);
+}
+
 u8 *getProcess9Info(u8 *pos, u32 size, u32 *process9Size, u32 *process9MemAddr)
 {
     u8 *temp = memsearch(pos, "NCCH", size, 4);
@@ -105,57 +194,118 @@ static inline u32 *getKernel11HandlerVAPos(u8 *pos, u32 *arm11ExceptionsPage, u3
     return (u32 *)(pos + pointedInstructionVA - baseK11VA + 8);
 }
 
-u32 installK11Extension(u8 *pos, u32 size, bool needToInitSd, u32 baseK11VA, u32 *arm11ExceptionsPage, u8 **freeK11Space)
+//The parameters to be passed on to the kernel ext
+//Please keep that in sync with the definition in k11_extension/source/main.c
+struct KExtParameters
 {
-    //The parameters to be passed on to the kernel ext
-    //Please keep that in sync with the definition in k11_extension/source/main.c
-    struct KExtParameters
-    {
-        u32 basePA;
-        u32 stolenSystemMemRegionSize;
-        void *originalHandlers[4];
-        u32 L1MMUTableAddrs[4];
+    u32 basePA;
+    u32 stolenSystemMemRegionSize;
+    void *originalHandlers[4];
+    u32 L1MMUTableAddrs[4];
 
-        volatile bool done;
+    volatile bool done;
 
-        struct CfwInfo
-        {
-            char magic[4];
+    struct CfwInfo
+    {
+        char magic[4];
 
-            u8 versionMajor;
-            u8 versionMinor;
-            u8 versionBuild;
-            u8 flags;
+        u8 versionMajor;
+        u8 versionMinor;
+        u8 versionBuild;
+        u8 flags;
 
-            u32 commitHash;
+        u32 commitHash;
 
-            u16 configFormatVersionMajor, configFormatVersionMinor;
-            u32 config, multiConfig, bootConfig;
-            u32 splashDurationMsec;
-            u64 hbldr3dsxTitleId;
-            u32 rosalinaMenuCombo;
-            u32 pluginLoaderFlags;
-            s16 ntpTzOffetMinutes;
+        u16 configFormatVersionMajor, configFormatVersionMinor;
+        u32 config, multiConfig, bootConfig;
+        u32 splashDurationMsec;
+        u64 hbldr3dsxTitleId;
+        u32 rosalinaMenuCombo;
+        u32 pluginLoaderFlags;
+        s16 ntpTzOffetMinutes;
 
-            ScreenFiltersCfgData topScreenFilter;
-            ScreenFiltersCfgData bottomScreenFilter;
+        ScreenFiltersCfgData topScreenFilter;
+        ScreenFiltersCfgData bottomScreenFilter;
 
-            u64 autobootTwlTitleId;
-            u8 autobootCtrAppmemtype;
+        u64 autobootTwlTitleId;
+        u8 autobootCtrAppmemtype;
+        u8 screenshotFormat;
 
-            u16 launchedPath[80+1];
-        } info;
-    };
+        u16 launchedPath[80+1];
+    } info;
+};
 
-    static const u8 patternHook1[] = {0x02, 0xC2, 0xA0, 0xE3, 0xFF}; //MMU setup hook
-    static const u8 patternHook2[] = {0x08, 0x00, 0xA4, 0xE5, 0x02, 0x10, 0x80, 0xE0, 0x08, 0x10, 0x84, 0xE5}; //FCRAM layout setup hook
-    static const u8 patternHook3_4[] = {0x00, 0x00, 0xA0, 0xE1, 0x03, 0xF0, 0x20, 0xE3, 0xFD, 0xFF, 0xFF, 0xEA}; //SGI0 setup code, etc.
+static inline struct KExtParameters *getK11ExtensionParameters(void)
+{
+    return (struct KExtParameters *)(*(u32 *)0x18000024 - K11EXT_VA + 0x18000000);
+}
 
+void setK11ExtensionParameters(void *const originalHandlers[4], bool needToInitSd)
+{
     //Our kernel11 extension is initially loaded in VRAM
     u32 kextTotalSize = *(u32 *)0x18000020 - K11EXT_VA;
     u32 stolenSystemMemRegionSize = kextTotalSize; // no need to steal any more mem on N3DS. Currently, everything fits in BASE on O3DS too (?)
     u32 dstKextPA = (ISN3DS ? 0x2E000000 : 0x26C00000) - stolenSystemMemRegionSize; // start of BASE memregion (note: linear heap ---> <--- the rest)
 
+    struct KExtParameters *p = getK11ExtensionParameters();
+    p->basePA = dstKextPA;
+    p->done = false;
+    p->stolenSystemMemRegionSize = stolenSystemMemRegionSize;
+
+    for(u32 i = 0; i < 4; i++)
+        p->originalHandlers[i] = originalHandlers[i];
+
+    struct CfwInfo *info = &p->info;
+    memcpy(&info->magic, "LUMA", 4);
+    info->commitHash = COMMIT_HASH;
+    info->configFormatVersionMajor = configData.formatVersionMajor;
+    info->configFormatVersionMinor = configData.formatVersionMinor;
+    info->config = configData.config;
+    info->multiConfig = configData.multiConfig;
+    info->bootConfig = configData.bootConfig;
+    info->splashDurationMsec = configData.splashDurationMsec;
+    info->hbldr3dsxTitleId = configData.hbldr3dsxTitleId;
+    info->rosalinaMenuCombo = configData.rosalinaMenuCombo;
+    info->pluginLoaderFlags = configData.pluginLoaderFlags;
+    info->ntpTzOffetMinutes = configData.ntpTzOffetMinutes;
+    info->topScreenFilter = configData.topScreenFilter;
+    info->bottomScreenFilter = configData.bottomScreenFilter;
+    info->autobootTwlTitleId = configData.autobootTwlTitleId;
+    info->autobootCtrAppmemtype = configData.autobootCtrAppmemtype;
+    info->screenshotFormat = configData.screenshotFormat;
+    info->versionMajor = VERSION_MAJOR;
+    info->versionMinor = VERSION_MINOR;
+    info->versionBuild = VERSION_BUILD;
+
+    if(ISRELEASE) info->flags = 1;
+    if(ISN3DS) info->flags |= 1 << 4;
+    if(needToInitSd) info->flags |= 1 << 5;
+    if(isSdMode) info->flags |= 1 << 6;
+
+    memcpy(info->launchedPath, launchedPath, sizeof(info->launchedPath));
+}
+
+void getK11ExtensionOriginalHandlers(void *originalHandlers[4])
+{
+    const struct KExtParameters *p = getK11ExtensionParameters();
+
+    for(u32 i = 0; i < 4; i++)
+        originalHandlers[i] = p->originalHandlers[i];
+}
+
+//Everything in front of the parameters, which are written to: code and read-only data
+const void *getK11ExtensionCode(u32 *size)
+{
+    *size = (u32)getK11ExtensionParameters() - 0x18000000;
+    return (const void *)0x18000000;
+}
+
+u32 installK11Extension(u8 *pos, u32 size, bool needToInitSd, u32 baseK11VA, u32 *arm11ExceptionsPage, u8 **freeK11Space)
+{
+    static const u8 patternHook1[] = {0x02, 0xC2, 0xA0, 0xE3, 0xFF}; //MMU setup hook
+    static const u8 patternHook2[] = {0x08, 0x00, 0xA4, 0xE5, 0x02, 0x10, 0x80, 0xE0, 0x08, 0x10, 0x84, 0xE5}; //FCRAM layout setup hook
+    static const u8 patternHook3_4[] = {0x00, 0x00, 0xA0, 0xE1, 0x03, 0xF0, 0x20, 0xE3, 0xFD, 0xFF, 0xFF, 0xEA}; //SGI0 setup code, etc.
+
     u32 *hookVeneers = (u32 *)*freeK11Space;
     u32 relocBase = 0xFFFF0000 + (*freeK11Space - (u8 *)arm11ExceptionsPage);
 
@@ -194,45 +344,15 @@ u32 installK11Extension(u8 *pos, u32 size, bool needToInitSd, u32 baseK11VA, u32
     off += 4;
     *off = MAKE_BRANCH_LINK(baseK11VA + ((u8 *)off - pos), relocBase + 24);
 
-    struct KExtParameters *p = (struct KExtParameters *)(*(u32 *)0x18000024 - K11EXT_VA + 0x18000000);
-    p->basePA = dstKextPA;
-    p->done = false;
-    p->stolenSystemMemRegionSize = stolenSystemMemRegionSize;
-
+    void *originalHandlers[4];
     for(u32 i = 0; i < 4; i++)
     {
         u32 *handlerPos = getKernel11HandlerVAPos(pos, arm11ExceptionsPage, baseK11VA, 1 + i);
-        p->originalHandlers[i] = (void *)*handlerPos;
+        originalHandlers[i] = (void *)*handlerPos;
         *handlerPos = K11EXT_VA + 0x10 + 4 * i;
     }
 
-    struct CfwInfo *info = &p->info;
-    memcpy(&info->magic, "LUMA", 4);
-    info->commitHash = COMMIT_HASH;
-    info->configFormatVersionMajor = configData.formatVersionMajor;
-    info->configFormatVersionMinor = configData.formatVersionMinor;
-    info->config = configData.config;
-    info->multiConfig = configData.multiConfig;
-    info->bootConfig = configData.bootConfig;
-    info->splashDurationMsec = configData.splashDurationMsec;
-    info->hbldr3dsxTitleId = configData.hbldr3dsxTitleId;
-    info->rosalinaMenuCombo = configData.rosalinaMenuCombo;
-    info->pluginLoaderFlags = configData.pluginLoaderFlags;
-    info->ntpTzOffetMinutes = configData.ntpTzOffetMinutes;
-    info->topScreenFilter = configData.topScreenFilter;
-    info->bottomScreenFilter = configData.bottomScreenFilter;
-    info->autobootTwlTitleId = configData.autobootTwlTitleId;
-    info->autobootCtrAppmemtype = configData.autobootCtrAppmemtype;
-    info->versionMajor = VERSION_MAJOR;
-    info->versionMinor = VERSION_MINOR;
-    info->versionBuild = VERSION_BUILD;
-
-    if(ISRELEASE) info->flags = 1;
-    if(ISN3DS) info->flags |= 1 << 4;
-    if(needToInitSd) info->flags |= 1 << 5;
-    if(isSdMode) info->flags |= 1 << 6;
-
-    memcpy(info->launchedPath, launchedPath, sizeof(info->launchedPath));
+    setK11ExtensionParameters(originalHandlers, needToInitSd);
 
     return 0;
 }
@@ -310,11 +430,8 @@ u32 patchKernel11(u8 *pos, u32 size, u32 baseK11VA, u32 *arm11SvcTable, u32 *arm
 u32 patchSignatureChecks(u8 *pos, u32 size)
 {
     //Look for signature checks
-    static const u8 pattern[] = {0xC0, 0x1C, 0x76, 0xE7},
-                    pattern2[] = {0xB5, 0x22, 0x4D, 0x0C};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
-    u8 *temp = memsearch(pos, pattern2, size, sizeof(pattern2));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_SIGNATURE_CHECKS);
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_SIGNATURE_CHECKS_2);
 
     if(off == NULL || temp == NULL) return 1;
 
@@ -345,15 +462,13 @@ u32 patchOldSignatureChecks(u8 *pos, u32 size)
 
 u32 patchFirmlaunches(u8 *pos, u32 size, u32 process9MemAddr)
 {
-    //Look for firmlaunch code
-    static const u8 pattern[] = {0xE2, 0x20, 0x20, 0x90};
-
     u32 pathLen;
     for(pathLen = 0; pathLen < sizeof(launchedPath)/2 && launchedPath[pathLen] != 0; pathLen++);
 
     if(launchedPath[pathLen] != 0) return 1;
 
-    u8 *off = memsearch(pos, pattern, size, sizeof(pattern));
+    //Look for firmlaunch code
+    u8 *off = getPatchSite(pos, size, PATCH_SITE_FIRMLAUNCHES);
 
     if(off == NULL) return 1;
 
@@ -377,7 +492,7 @@ u32 patchFirmlaunches(u8 *pos, u32 size, u32 process9MemAddr)
 u32 patchFirmWrites(u8 *pos, u32 size)
 {
     //Look for FIRM writing code
-    u8 *off = memsearch(pos, "exe:", size, 4);
+    u8 *off = getPatchSite(pos, size, PATCH_SITE_FIRM_WRITES);
 
     if(off == NULL) return 1;
 
@@ -410,9 +525,7 @@ u32 patchOldFirmWrites(u8 *pos, u32 size)
 
 u32 patchTitleInstallMinVersionChecks(u8 *pos, u32 size, u32 firmVersion)
 {
-    static const u8 pattern[] = {0xFF, 0x00, 0x00, 0x02};
-
-    u8 *off = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *off = getPatchSite(pos, size, PATCH_SITE_TITLE_INSTALL_MIN_VERSION_CHECKS);
 
     if(off == NULL) return firmVersion == 0xFFFFFFFF ? 0 : 1;
 
@@ -426,9 +539,7 @@ u32 patchTitleInstallMinVersionChecks(u8 *pos, u32 size, u32 firmVersion)
 
 u32 patchZeroKeyNcchEncryptionCheck(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x28, 0x2A, 0xD0, 0x08};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_ZERO_KEY_NCCH_ENCRYPTION_CHECK);
 
     if(temp == NULL) return 1;
 
@@ -440,9 +551,7 @@ u32 patchZeroKeyNcchEncryptionCheck(u8 *pos, u32 size)
 
 u32 patchNandNcchEncryptionCheck(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x07, 0xD1, 0x28, 0x7A};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_NAND_NCCH_ENCRYPTION_CHECK);
 
     if(off == NULL) return 1;
 
@@ -454,9 +563,7 @@ u32 patchNandNcchEncryptionCheck(u8 *pos, u32 size)
 
 u32 patchCheckForDevCommonKey(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x03, 0x7C, 0x28, 0x00};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_DEV_COMMON_KEY_CHECK);
 
     if(off == NULL) return 1;
 
@@ -494,9 +601,7 @@ u32 patchK11ModuleLoading(u32 section0size, u32 modulesSize, u8 *pos, u32 size)
 
 u32 patchArm9ExceptionHandlersInstall(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x80, 0xE5, 0x40, 0x1C};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_ARM9_EXCEPTION_HANDLERS_INSTALL);
 
     if(temp == NULL) return 1;
 
@@ -530,9 +635,7 @@ u32 patchSvcBreak9(u8 *pos, u32 size, u32 kernel9Address)
     //Stub svcBreak with "bkpt 65535" so we can debug the panic
 
     //Look for the svc handler
-    static const u8 pattern[] = {0x00, 0xE0, 0x4F, 0xE1}; //mrs lr, spsr
-
-    u32 *arm9SvcTable = (u32 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u32 *arm9SvcTable = (u32 *)getPatchSite(pos, size, PATCH_SITE_SVC_BREAK9);
 
     if(arm9SvcTable == NULL) return 1;
 
@@ -554,9 +657,7 @@ u32 patchSvcBreak9(u8 *pos, u32 size, u32 kernel9Address)
 
 u32 patchKernel9Panic(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x00, 0x20, 0x92, 0x15};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_KERNEL9_PANIC);
 
     if(temp == NULL) return 1;
 
@@ -568,9 +669,7 @@ u32 patchKernel9Panic(u8 *pos, u32 size)
 
 u32 patchP9AccessChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x00, 0x08, 0x49, 0x68};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_P9_ACCESS_CHECKS);
 
     if(temp == NULL) return 1;
 
@@ -584,9 +683,7 @@ u32 patchP9AccessChecks(u8 *pos, u32 size)
 u32 patchUnitInfoValueSet(u8 *pos, u32 size)
 {
     //Look for UNITINFO value being set during kernel sync
-    static const u8 pattern[] = {0x01, 0x10, 0xA0, 0x13};
-
-    u8 *off = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *off = getPatchSite(pos, size, PATCH_SITE_UNITINFO_VALUE_SET);
 
     if(off == NULL) return 1;
 
@@ -598,11 +695,8 @@ u32 patchUnitInfoValueSet(u8 *pos, u32 size)
 
 u32 patchP9AMTicketWrapperZeroKeyIV(u8 *pos, u32 size, u32 firmVersion)
 {
-    static const u8 __rt_memclr_pattern[] = {0x00, 0x20, 0xA0, 0xE3, 0x04, 0x00, 0x51, 0xE3, 0x07, 0x00, 0x00, 0x3A};
-    static const u8 pattern[] = {0x20, 0x21, 0xA6, 0xA8};
-
-    u32 function = (u32)memsearch(pos, __rt_memclr_pattern, size, sizeof(__rt_memclr_pattern));
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u32 function = (u32)getPatchSite(pos, size, PATCH_SITE_RT_MEMCLR);
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_P9_AM_TICKET_WRAPPER);
 
     if(function == 0 || off == NULL) return firmVersion == 0xFFFFFFFF ? 0 : 1;
 
@@ -626,9 +720,7 @@ u32 patchP9AMTicketWrapperZeroKeyIV(u8 *pos, u32 size, u32 firmVersion)
 
 u32 patchLgySignatureChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x47, 0xC1, 0x17, 0x49};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_LGY_SIGNATURE_CHECKS);
 
     if(temp == NULL) return 1;
 
@@ -642,9 +734,7 @@ u32 patchLgySignatureChecks(u8 *pos, u32 size)
 
 u32 patchTwlInvalidSignatureChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x20, 0xF6, 0xE7, 0x7F};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_TWL_INVALID_SIGNATURE_CHECKS);
 
     if(temp == NULL) return 1;
 
@@ -656,9 +746,7 @@ u32 patchTwlInvalidSignatureChecks(u8 *pos, u32 size)
 
 u32 patchTwlNintendoLogoChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0xC0, 0x30, 0x06, 0xF0};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_TWL_NINTENDO_LOGO_CHECKS);
 
     if(off == NULL) return 1;
 
@@ -670,9 +758,7 @@ u32 patchTwlNintendoLogoChecks(u8 *pos, u32 size)
 
 u32 patchTwlWhitelistChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x22, 0x00, 0x20, 0x30};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_TWL_WHITELIST_CHECKS);
 
     if(off == NULL) return 1;
 
@@ -684,9 +770,7 @@ u32 patchTwlWhitelistChecks(u8 *pos, u32 size)
 
 u32 patchTwlFlashcartChecks(u8 *pos, u32 size, u32 firmVersion)
 {
-    static const u8 pattern[] = {0x25, 0x20, 0x00, 0x0E};
-
-    u8 *temp = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *temp = getPatchSite(pos, size, PATCH_SITE_TWL_FLASHCART_CHECKS);
 
     if(temp == NULL)
     {
@@ -704,9 +788,7 @@ u32 patchTwlFlashcartChecks(u8 *pos, u32 size, u32 firmVersion)
 
 u32 patchOldTwlFlashcartChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x06, 0xF0, 0xA0, 0xFD};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_OLD_TWL_FLASHCART_CHECKS);
 
     if(off == NULL) return 1;
 
@@ -718,9 +800,7 @@ u32 patchOldTwlFlashcartChecks(u8 *pos, u32 size)
 
 u32 patchTwlShaHashChecks(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x10, 0xB5, 0x14, 0x22};
-
-    u16 *off = (u16 *)memsearch(pos, pattern, size, sizeof(pattern));
+    u16 *off = (u16 *)getPatchSite(pos, size, PATCH_SITE_TWL_SHA_HASH_CHECKS);
 
     if(off == NULL) return 1;
 
@@ -732,9 +812,7 @@ u32 patchTwlShaHashChecks(u8 *pos, u32 size)
 
 u32 patchAgbBootSplash(u8 *pos, u32 size)
 {
-    static const u8 pattern[] = {0x00, 0x00, 0x01, 0xEF};
-
-    u8 *off = memsearch(pos, pattern, size, sizeof(pattern));
+    u8 *off = getPatchSite(pos, size, PATCH_SITE_AGB_BOOT_SPLASH);
 
     if(off == NULL) return 1;
 
@@ -37,8 +37,60 @@
 
 #include "types.h"
 
+//FIRM regions whose patch signatures are looked up with a single scan
+typedef enum PatchSiteSection
+{
+    PATCH_SECTION_PROCESS9 = 0,
+    PATCH_SECTION_KERNEL9,
+    PATCH_SECTION_LGY_PROCESS9,
+    PATCH_SECTION_COUNT
+} PatchSiteSection;
+
+typedef enum PatchSite
+{
+    //NATIVE_FIRM Process9
+    PATCH_SITE_SIGNATURE_CHECKS = 0,
+    PATCH_SITE_SIGNATURE_CHECKS_2,
+    PATCH_SITE_FIRM_WRITES,
+    PATCH_SITE_FIRMLAUNCHES,
+    PATCH_SITE_TITLE_INSTALL_MIN_VERSION_CHECKS,
+    PATCH_SITE_ZERO_KEY_NCCH_ENCRYPTION_CHECK,
+    PATCH_SITE_NAND_NCCH_ENCRYPTION_CHECK,
+    PATCH_SITE_DEV_COMMON_KEY_CHECK,
+    PATCH_SITE_P9_ACCESS_CHECKS,
+    PATCH_SITE_RT_MEMCLR,
+    PATCH_SITE_P9_AM_TICKET_WRAPPER,
+    PATCH_SITE_EMUNAND_SDMMC,
+    PATCH_SITE_EMUNAND_NAND_RW,
+
+    //NATIVE_FIRM Kernel9
+    PATCH_SITE_EMUNAND_FREE_K9_SPACE,
+    PATCH_SITE_EMUNAND_MPU,
+    PATCH_SITE_UNITINFO_VALUE_SET,
+    PATCH_SITE_ARM9_EXCEPTION_HANDLERS_INSTALL,
+    PATCH_SITE_SVC_BREAK9,
+    PATCH_SITE_KERNEL9_PANIC,
+
+    //TWL_FIRM/AGB_FIRM Process9
+    PATCH_SITE_LGY_SIGNATURE_CHECKS,
+    PATCH_SITE_TWL_INVALID_SIGNATURE_CHECKS,
+    PATCH_SITE_TWL_NINTENDO_LOGO_CHECKS,
+    PATCH_SITE_TWL_WHITELIST_CHECKS,
+    PATCH_SITE_TWL_FLASHCART_CHECKS,
+    PATCH_SITE_OLD_TWL_FLASHCART_CHECKS,
+    PATCH_SITE_TWL_SHA_HASH_CHECKS,
+    PATCH_SITE_AGB_BOOT_SPLASH,
+
+    PATCH_SITE_COUNT
+} PatchSite;
+
+void scanPatchSites(u8 *pos, u32 size, PatchSiteSection section);
+u8 *getPatchSite(u8 *pos, u32 size, PatchSite site);
 u8 *getProcess9Info(u8 *pos, u32 size, u32 *process9Size, u32 *process9MemAddr);
 u32 *getKernel11Info(u8 *pos, u32 size, u32 *baseK11VA, u8 **freeK11Space, u32 **arm11SvcHandler, u32 **arm11ExceptionsPage);
+void setK11ExtensionParameters(void *const originalHandlers[4], bool needToInitSd);
+void getK11ExtensionOriginalHandlers(void *originalHandlers[4]);
+const void *getK11ExtensionCode(u32 *size);
 u32 installK11Extension(u8 *pos, u32 size, bool needToInitSd, u32 baseK11VA, u32 *arm11ExceptionsPage, u8 **freeK11Space);
 u32 patchKernel11(u8 *pos, u32 size, u32 baseK11VA, u32 *arm11SvcTable, u32 *arm11ExceptionsPage);
 u32 patchSignatureChecks(u8 *pos, u32 size);
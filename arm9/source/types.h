@@ -85,6 +85,7 @@ typedef struct CfgData {
 
     u64 autobootTwlTitleId;
     u8 autobootCtrAppmemtype;
+    u8 screenshotFormat;
 } CfgData;
 
 typedef struct
@@ -40,6 +40,7 @@
 #define MAKE_BRANCH_LINK(src,dst) (0xEB000000 | ((u32)((((u8 *)(dst) - (u8 *)(src)) >> 2) - 2) & 0xFFFFFF))
 
 void startChrono(void);
+u64 chronoTicks(void);
 u64 chrono(void);
 
 u32 waitInput(bool isMenu);
@@ -0,0 +1,318 @@
+// Host test of config.ini handling (config.c and ini.c): any valid configuration must survive
+// being written out and parsed back, and readLumaIniConfig must always end up with what parsing
+// the current config.ini gives, whether it parses it or loads the snapshot of cache/config.bin.
+
+#include "../source/config.c" //First, it sets _GNU_SOURCE
+#include "../source/ini.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_common.h"
+
+// In-memory SD card, with just the files config.c uses
+#define MAX_FILES       4
+#define MAX_FILE_SIZE   0x4000
+
+static struct
+{
+    char path[64];
+    u8 data[MAX_FILE_SIZE];
+    u32 size;
+} files[MAX_FILES];
+
+static u32 nbFileWrites;
+
+static s32 findFile(const char *path, bool create)
+{
+    for(u32 i = 0; i < MAX_FILES; i++)
+        if(strcmp(files[i].path, path) == 0) return i;
+    if(!create) return -1;
+
+    for(u32 i = 0; i < MAX_FILES; i++)
+    {
+        if(files[i].path[0] == 0)
+        {
+            strcpy(files[i].path, path);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+u32 fileRead(void *dest, const char *path, u32 maxSize)
+{
+    s32 i = findFile(path, false);
+
+    if(i < 0 || files[i].size > maxSize) return 0;
+    memcpy(dest, files[i].data, files[i].size);
+    return files[i].size;
+}
+
+bool fileWrite(const void *buffer, const char *path, u32 size)
+{
+    s32 i = findFile(path, true);
+
+    if(i < 0 || size > MAX_FILE_SIZE) return false;
+    memcpy(files[i].data, buffer, size);
+    files[i].size = size;
+    nbFileWrites++;
+    return true;
+}
+
+u32 getFileSize(const char *path)
+{
+    s32 i = findFile(path, false);
+
+    return i < 0 ? 0 : files[i].size;
+}
+
+bool fileDelete(const char *path)
+{
+    s32 i = findFile(path, false);
+
+    if(i < 0) return false;
+    memset(&files[i], 0, sizeof(files[i]));
+    return true;
+}
+
+// Stand-in for SHA-256, the snapshot only needs different texts to hash differently
+void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    u64 h = 0xCBF29CE484222325ull ^ mode;
+
+    for(u32 i = 0; i < size; i++)
+        h = (h ^ ((const u8 *)src)[i]) * 0x100000001B3ull;
+    h ^= size;
+    for(u32 i = 0; i < SHA_256_HASH_SIZE; i++)
+    {
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        ((u8 *)res)[i] = (u8)(h >> 56);
+    }
+}
+
+// Any configuration config.ini can hold; bits and fields it has no option for are random too
+static void randomConfig(CfgData *cfg)
+{
+    u32 validKeys = 0;
+
+    for(u32 i = 0; i < sizeof(*cfg); i++)
+        ((u8 *)cfg)[i] = (u8)rnd();
+
+    for(u32 i = 0; i < sizeof(keyNames) / sizeof(keyNames[0]); i++)
+        if(strcmp(keyNames[i], "?") != 0) validKeys |= 1u << i;
+    cfg->rosalinaMenuCombo &= validKeys;
+
+    cfg->pluginLoaderFlags = (cfg->pluginLoaderFlags & 3) | ((rnd() % 17) << 8);
+    cfg->ntpTzOffetMinutes = (s16)(rnd() % 1679) - 779;
+    cfg->autobootCtrAppmemtype = rnd() % 5;
+    cfg->screenshotFormat = rnd() % 2;
+
+    ScreenFiltersCfgData *filters[2] = { &cfg->topScreenFilter, &cfg->bottomScreenFilter };
+    for(u32 i = 0; i < 2; i++)
+    {
+        filters[i]->cct = 1000 + rnd() % 24101;
+        filters[i]->invert = rnd() % 2;
+        filters[i]->gammaEnc = (s64)(rnd() % 1411) * FLOAT_CONV_MULT + rnd() % FLOAT_CONV_MULT;
+        filters[i]->contrastEnc = (s64)(rnd() % 255) * FLOAT_CONV_MULT + rnd() % FLOAT_CONV_MULT;
+        filters[i]->brightnessEnc = (rnd() % 2 ? 1 : -1) * (s64)(rnd() % FLOAT_CONV_MULT);
+    }
+}
+
+static bool parseIni(const char *ini, CfgData *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    hasIniParseError = false;
+    return ini_parse_string(ini, &configIniHandler, cfg) >= 0 && !hasIniParseError;
+}
+
+static void testRoundTrip(void)
+{
+    static char ini[0x2000], ini2[0x2000];
+
+    for(u32 n = 0; n < 20000; n++)
+    {
+        CfgData cfg;
+
+        randomConfig(&configData);
+        size_t size = saveLumaIniConfigToStr(ini);
+        CHECK(size != 0 && size < sizeof(tmpIniBuffer));
+
+        CHECK(parseIni(ini, &cfg));
+        configData = cfg;
+        CHECK(saveLumaIniConfigToStr(ini2) == size);
+        CHECK(strcmp(ini, ini2) == 0);
+    }
+}
+
+static bool boot(CfgData *cfg)
+{
+    memset(&configData, 0, sizeof(configData));
+    hasIniParseError = false;
+    nbFileWrites = 0;
+
+    bool ok = readLumaIniConfig();
+
+    *cfg = configData;
+    return ok;
+}
+
+// The first boot parses config.ini and takes a snapshot, the next ones load it instead
+static void testSnapshot(void)
+{
+    static char ini[0x2000];
+
+    for(u32 n = 0; n < 500; n++)
+    {
+        CfgData cfg1, cfg2, expected;
+
+        memset(files, 0, sizeof(files));
+        randomConfig(&configData);
+        size_t size = saveLumaIniConfigToStr(ini);
+        fileWrite(ini, "config.ini", size);
+        CHECK(parseIni(ini, &expected));
+
+        CHECK(boot(&cfg1));
+        CHECK(nbFileWrites == 1);
+        CHECK(boot(&cfg2));
+        CHECK(nbFileWrites == 0);
+        CHECK(memcmp(&cfg1, &expected, sizeof(CfgData)) == 0);
+        CHECK(memcmp(&cfg2, &expected, sizeof(CfgData)) == 0);
+
+        // A snapshot from another build or of another size is never loaded
+        s32 i = findFile(CONFIG_SNAPSHOT_PATH, false);
+        ConfigSnapshot *snapshot = (ConfigSnapshot *)files[i].data;
+        switch(n % 4)
+        {
+            case 0: snapshot->version++; break;
+            case 1: snapshot->commitHash ^= 1; break;
+            case 2: snapshot->cfgDataSize--; break;
+            case 3: files[i].size--; break;
+        }
+        memset(&snapshot->cfg, 0xFF, sizeof(CfgData));
+
+        CHECK(boot(&cfg1));
+        CHECK(nbFileWrites == 1);
+        CHECK(memcmp(&cfg1, &expected, sizeof(CfgData)) == 0);
+    }
+}
+
+// config.ini edited by hand, with whatever snapshot is there: the result is always the parse of
+// the text, and a text which doesn't parse never leaves a snapshot behind
+static void testEditedIni(void)
+{
+    static char ini[0x2000];
+
+    memset(files, 0, sizeof(files));
+    randomConfig(&configData);
+    size_t size = saveLumaIniConfigToStr(ini);
+
+    for(u32 n = 0; n < 20000; n++)
+    {
+        CfgData cfg, expected;
+
+        if(n % 100 == 0)
+        {
+            randomConfig(&configData);
+            size = saveLumaIniConfigToStr(ini);
+        }
+
+        // Change a character, or a digit of a value, or cut the text short
+        char *newLine = strchr(ini + rnd() % size, '\n');
+        u32 pos = newLine != NULL && newLine > ini ? (u32)(newLine - ini) - 1 : rnd() % size;
+        switch(rnd() % 4)
+        {
+            case 0: ini[rnd() % size] = (char)(' ' + rnd() % 95); break;
+            case 1: ini[pos] = ini[pos] >= '0' && ini[pos] <= '9' ? '0' + rnd() % 10 : ini[pos]; break;
+            case 2: ini[pos] = '\n'; break;
+            case 3: size = rnd() % size + 1; ini[size] = 0; break;
+        }
+        size = strlen(ini);
+        fileWrite(ini, "config.ini", size);
+
+        bool expectedOk = parseIni(ini, &expected);
+        s32 i = findFile(CONFIG_SNAPSHOT_PATH, false);
+        u32 snapshotSize = i < 0 ? 0 : files[i].size;
+
+        bool ok = boot(&cfg);
+        CHECK(ok == expectedOk);
+        if(ok) CHECK(memcmp(&cfg, &expected, sizeof(CfgData)) == 0);
+        else CHECK(nbFileWrites == 0 && (i < 0 ? findFile(CONFIG_SNAPSHOT_PATH, false) < 0 : files[i].size == snapshotSize));
+
+        // Parsed or not, the next boot gives the same
+        CHECK(boot(&cfg) == expectedOk);
+        CHECK(nbFileWrites == 0);
+        if(expectedOk) CHECK(memcmp(&cfg, &expected, sizeof(CfgData)) == 0);
+    }
+}
+
+// What Rosalina's save leaves behind when cut short: the temporary file, and maybe config.ini
+static void testTemporaryFile(void)
+{
+    static char ini[0x2000], tmpIni[0x2000];
+
+    for(u32 n = 0; n < 100; n++)
+    {
+        CfgData cfg, expected, expectedTmp;
+
+        memset(files, 0, sizeof(files));
+        randomConfig(&configData);
+        size_t size = saveLumaIniConfigToStr(ini);
+        CHECK(parseIni(ini, &expected));
+        randomConfig(&configData);
+        size_t tmpSize = saveLumaIniConfigToStr(tmpIni);
+        CHECK(parseIni(tmpIni, &expectedTmp));
+
+        // Cut between the deletion of config.ini and the rename: the replacement is read, then
+        // put in its place
+        fileWrite(tmpIni, "config.ini.tmp", tmpSize);
+        CHECK(boot(&cfg));
+        CHECK(memcmp(&cfg, &expectedTmp, sizeof(CfgData)) == 0);
+        CHECK(findFile("config.ini.tmp", false) < 0);
+        CHECK(getFileSize("config.ini") == tmpSize && memcmp(files[findFile("config.ini", false)].data, tmpIni, tmpSize) == 0);
+
+        CHECK(boot(&cfg));
+        CHECK(nbFileWrites == 0);
+        CHECK(memcmp(&cfg, &expectedTmp, sizeof(CfgData)) == 0);
+
+        // With config.ini there, a leftover temporary file is never read, even if config.ini
+        // doesn't parse
+        memset(files, 0, sizeof(files));
+        fileWrite(ini, "config.ini", size);
+        fileWrite(tmpIni, "config.ini.tmp", tmpSize);
+        CHECK(boot(&cfg));
+        CHECK(memcmp(&cfg, &expected, sizeof(CfgData)) == 0);
+        CHECK(boot(&cfg));
+        CHECK(memcmp(&cfg, &expected, sizeof(CfgData)) == 0);
+
+        fileWrite("[boot]\nfoo = 1\n", "config.ini", 16);
+        CHECK(!boot(&cfg));
+        CHECK(getFileSize("config.ini.tmp") == tmpSize);
+
+        // Nor when it can't be read
+        memset(ini + size, '\n', sizeof(tmpIniBuffer) - size);
+        fileWrite(ini, "config.ini", sizeof(tmpIniBuffer));
+        CHECK(!boot(&cfg));
+        CHECK(getFileSize("config.ini.tmp") == tmpSize);
+
+        // A temporary file which doesn't parse doesn't replace anything either
+        fileDelete("config.ini");
+        fileWrite("[boot]\nfoo = 1\n", "config.ini.tmp", 16);
+        CHECK(!boot(&cfg));
+        CHECK(findFile("config.ini", false) < 0 && getFileSize("config.ini.tmp") == 16);
+    }
+}
+
+int main(void)
+{
+    testRoundTrip();
+    testSnapshot();
+    testEditedIni();
+    testTemporaryFile();
+
+    printf("config_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+// Host test of the pipelined CTRNAND reads (ctrNandRead in crypto.c), which decrypt each chunk
+// from the SDMMC idle callback while the next one is transferred. The AES engine is emulated
+// at the register level, with its 16-word FIFOs and a block processed every few register accesses, and
+// the SDMMC reads copy a sector at a time with idle callbacks in between. The output must be
+// the right keystream applied to the right sectors, whatever the read size, offset and source,
+// without ever overflowing or underflowing a FIFO, and a failed transfer must leave the engine
+// drained and the previous idle callback in place.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crypto.h"
+
+#include "test_common.h"
+
+static struct
+{
+    u32 cnt, blkcnt, ctr[4];
+    u8 keysel;
+    u32 wrFifo[16], rdFifo[16], wrCount, rdCount, readValue, discarded;
+    u8 counter[AES_BLOCK_SIZE]; //Big-endian counter of the next block
+    u32 blocksLeft, wordsLeft, accessesPerBlock, nbAccesses, nbStalledAccesses;
+    bool running;
+    u32 nbErrors, nbBlocks, nbBlocksDuringTransfers;
+} engine;
+
+static bool inTransfer;
+
+static void aesKeystream(u8 *out, const u8 *counter)
+{
+    u64 h = 0xCBF29CE484222325ull;
+
+    for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+        h = (h ^ counter[i]) * 0x100000001B3ull;
+    for(u32 i = 0; i < AES_BLOCK_SIZE; i++)
+    {
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        out[i] = (u8)(h >> 56);
+    }
+}
+
+static void incrementCounter(u8 *counter, u32 n)
+{
+    for(u32 i = AES_BLOCK_SIZE; i-- > 0 && n != 0; n >>= 8)
+    {
+        n += counter[i];
+        counter[i] = (u8)n;
+    }
+}
+
+static void aesStep(void)
+{
+    //A lost FIFO word would otherwise leave ctrNandRead polling forever, like the real engine
+    if(++engine.nbStalledAccesses == 1000000)
+    {
+        printf("crypto_test: the AES engine stalled, %u errors\n", engine.nbErrors);
+        exit(1);
+    }
+
+    if(engine.cnt & AES_CNT_FLUSH_WRITE) engine.wrCount = 0;
+    if(engine.cnt & AES_CNT_FLUSH_READ) engine.rdCount = 0;
+    engine.cnt &= ~(AES_CNT_FLUSH_WRITE | AES_CNT_FLUSH_READ);
+
+    if((engine.cnt & AES_CNT_START) && !engine.running)
+    {
+        //aes_setiv writes the words of a normal order counter last to first
+        for(u32 i = 0; i < 4; i++)
+            memcpy(engine.counter + 4 * i, &engine.ctr[3 - i], 4);
+        engine.blocksLeft = engine.blkcnt >> 16;
+        engine.wordsLeft = 4 * engine.blocksLeft;
+        engine.running = engine.blocksLeft != 0;
+        if((engine.cnt & AES_ALL_MODES) != AES_CTR_MODE || engine.keysel != 0x11 || !engine.running) engine.nbErrors++;
+    }
+
+    if(engine.running && engine.wrCount >= 4 && engine.rdCount <= 12 && ++engine.nbAccesses % engine.accessesPerBlock == 0)
+    {
+        u8 keystream[AES_BLOCK_SIZE];
+
+        aesKeystream(keystream, engine.counter);
+        incrementCounter(engine.counter, 1);
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 k;
+            memcpy(&k, keystream + 4 * i, 4);
+            engine.rdFifo[engine.rdCount++] = engine.wrFifo[i] ^ k;
+        }
+        memmove(engine.wrFifo, engine.wrFifo + 4, (engine.wrCount - 4) * 4);
+        engine.wrCount -= 4;
+        engine.nbBlocks++;
+        engine.nbStalledAccesses = 0;
+        if(inTransfer) engine.nbBlocksDuringTransfers++;
+        if(--engine.blocksLeft == 0)
+        {
+            engine.running = false;
+            engine.cnt &= ~AES_CNT_START;
+        }
+    }
+
+    engine.cnt = (engine.cnt & ~0x3FF) | engine.wrCount | engine.rdCount << 5;
+}
+
+static vu32 *aesRegister(u32 *reg)
+{
+    aesStep();
+    return (vu32 *)reg;
+}
+
+static vu32 *aesWriteFifo(void)
+{
+    aesStep();
+    if(engine.wrCount == 16 || engine.wordsLeft == 0)
+    {
+        engine.nbErrors++;
+        return &engine.discarded;
+    }
+    engine.wordsLeft--;
+    return &engine.wrFifo[engine.wrCount++];
+}
+
+static vu32 *aesReadFifo(void)
+{
+    aesStep();
+    if(engine.rdCount == 0)
+    {
+        engine.nbErrors++;
+        engine.readValue = 0;
+        return &engine.readValue;
+    }
+    engine.readValue = engine.rdFifo[0];
+    memmove(engine.rdFifo, engine.rdFifo + 1, --engine.rdCount * 4);
+    return &engine.readValue;
+}
+
+#undef REG_AESCNT
+#undef REG_AESBLKCNT
+#undef REG_AESWRFIFO
+#undef REG_AESRDFIFO
+#undef REG_AESKEYSEL
+#undef REG_AESCTR
+#define REG_AESCNT      (aesRegister(&engine.cnt))
+#define REG_AESBLKCNT   (aesRegister(&engine.blkcnt))
+#define REG_AESWRFIFO   (aesWriteFifo())
+#define REG_AESRDFIFO   (aesReadFifo())
+#define REG_AESKEYSEL   ((vu8 *)&engine.keysel)
+#define REG_AESCTR      (aesRegister(engine.ctr))
+
+#include "../source/crypto.c"
+
+#define NAND_SECTORS    0x1000
+#define EMU_OFFSET      0x123
+
+// Fake devices: each read copies a sector at a time, then polls the idle callback
+static u8 nand[NAND_SECTORS * 0x200], sd[(EMU_OFFSET + NAND_SECTORS) * 0x200];
+static sdmmc_idle_callback idleCallback;
+static u32 pollsPerSector, nbTransfers, maxTransferSectors, failingTransfer;
+
+u32 emuOffset, emuHeader;
+
+static int readSectors(const u8 *device, u32 deviceSectors, u32 sector_no, u32 numsectors, u8 *out)
+{
+    if(++nbTransfers == failingTransfer || numsectors == 0 || sector_no + numsectors > deviceSectors)
+        return 1;
+
+    if(numsectors > maxTransferSectors) maxTransferSectors = numsectors;
+    inTransfer = true;
+    for(u32 i = 0; i < numsectors; i++)
+    {
+        memcpy(out + i * 0x200, device + (sector_no + i) * 0x200, 0x200);
+        for(u32 j = 0; j < pollsPerSector && idleCallback != NULL; j++)
+            idleCallback();
+    }
+    inTransfer = false;
+
+    return 0;
+}
+
+int sdmmc_nand_readsectors(u32 sector_no, u32 numsectors, u8 *out)
+{
+    return readSectors(nand, NAND_SECTORS, sector_no, numsectors, out);
+}
+
+int sdmmc_sdcard_readsectors(u32 sector_no, u32 numsectors, u8 *out)
+{
+    return readSectors(sd, EMU_OFFSET + NAND_SECTORS, sector_no, numsectors, out);
+}
+
+sdmmc_idle_callback sdmmc_set_idle_callback(sdmmc_idle_callback callback)
+{
+    sdmmc_idle_callback previous = idleCallback;
+    idleCallback = callback;
+    return previous;
+}
+
+u64 chronoTicks(void)
+{
+    return 0;
+}
+
+void bootTraceCountCtrNandRead(u32 size, u64 ticks)
+{
+    (void)size;
+    (void)ticks;
+}
+
+static void someOtherCallback(void)
+{
+}
+
+static u8 out[NAND_SECTORS * 0x200 + 0x200], expected[NAND_SECTORS * 0x200];
+
+// Decrypts the sectors the way the original, unpipelined code saw them
+static void expectedRead(u32 sector, u32 sectorCount)
+{
+    u8 counter[AES_BLOCK_SIZE], keystream[AES_BLOCK_SIZE];
+
+    memcpy(counter, nandCtr, sizeof(counter));
+    incrementCounter(counter, (sector + fatStart) * 0x200 / AES_BLOCK_SIZE);
+    for(u32 i = 0; i < sectorCount * 0x200; i += AES_BLOCK_SIZE)
+    {
+        aesKeystream(keystream, counter);
+        incrementCounter(counter, 1);
+        for(u32 j = 0; j < AES_BLOCK_SIZE; j++)
+            expected[i + j] = nand[(sector + fatStart) * 0x200 + i + j] ^ keystream[j];
+    }
+}
+
+static bool readAndCompare(u32 sector, u32 sectorCount)
+{
+    memset(out, 0xAA, sizeof(out));
+    engine.nbErrors = engine.nbBlocks = engine.nbBlocksDuringTransfers = 0;
+    nbTransfers = maxTransferSectors = 0;
+    idleCallback = someOtherCallback;
+
+    int result = ctrNandRead(sector, sectorCount, out);
+    expectedRead(sector, sectorCount);
+
+    CHECK(engine.nbErrors == 0 && !engine.running && engine.wrCount == 0 && engine.rdCount == 0);
+    CHECK(engine.nbBlocks == sectorCount * 0x200 / AES_BLOCK_SIZE);
+    CHECK(idleCallback == someOtherCallback);
+    CHECK(maxTransferSectors <= CTRNAND_CHUNK_SECTORS);
+    CHECK(nbTransfers == (sectorCount + CTRNAND_CHUNK_SECTORS - 1) / CTRNAND_CHUNK_SECTORS);
+
+    return result == 0 && memcmp(out, expected, sectorCount * 0x200) == 0 && out[sectorCount * 0x200] == 0xAA;
+}
+
+static void testReads(void)
+{
+    static const u32 counts[] = { 1, 2, CTRNAND_CHUNK_SECTORS - 1, CTRNAND_CHUNK_SECTORS, CTRNAND_CHUNK_SECTORS + 1,
+                                  2 * CTRNAND_CHUNK_SECTORS, 5 * CTRNAND_CHUNK_SECTORS + 17, 0x800 };
+
+    for(u32 source = 0; source < 2; source++)
+    {
+        firmSource = source == 0 ? FIRMWARE_SYSNAND : FIRMWARE_EMUNAND;
+        emuOffset = source == 0 ? 0 : EMU_OFFSET;
+
+        for(u32 polls = 0; polls <= 64; polls = polls == 0 ? 1 : 8 * polls)
+        {
+            pollsPerSector = polls;
+            engine.accessesPerBlock = polls == 8 ? 16 : 1; //A slower engine fills its input FIFO
+            for(u32 i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+            {
+                u32 sector = rnd() % (NAND_SECTORS - fatStart - counts[i] + 1);
+                CHECK(readAndCompare(sector, counts[i]));
+
+                //Polled often enough, the engine decrypts each chunk during the transfer of the next one,
+                //unless that one is too short
+                if(polls >= 64)
+                {
+                    u32 nbChunks = (counts[i] + CTRNAND_CHUNK_SECTORS - 1) / CTRNAND_CHUNK_SECTORS,
+                        lastChunk = counts[i] - (nbChunks - 1) * CTRNAND_CHUNK_SECTORS,
+                        nbOverlapped = lastChunk == CTRNAND_CHUNK_SECTORS ? nbChunks - 1 : nbChunks < 2 ? 0 : nbChunks - 2;
+                    CHECK(engine.nbBlocksDuringTransfers >= nbOverlapped * CTRNAND_CHUNK_SECTORS * 0x200 / AES_BLOCK_SIZE);
+                    CHECK(engine.nbBlocksDuringTransfers <= (counts[i] - lastChunk) * 0x200 / AES_BLOCK_SIZE);
+                }
+            }
+        }
+    }
+}
+
+// Reads failing on each of their transfers
+static void testFailures(void)
+{
+    firmSource = FIRMWARE_SYSNAND;
+    pollsPerSector = 3;
+
+    for(u32 fail = 1; fail <= 4; fail++)
+    {
+        engine.nbErrors = 0;
+        nbTransfers = 0;
+        failingTransfer = fail;
+        idleCallback = someOtherCallback;
+
+        CHECK(ctrNandRead(10, 3 * CTRNAND_CHUNK_SECTORS + 1, out) != 0);
+        CHECK(nbTransfers == fail);
+        CHECK(engine.nbErrors == 0 && !engine.running && engine.wrCount == 0 && engine.rdCount == 0);
+        CHECK(idleCallback == someOtherCallback);
+    }
+
+    failingTransfer = 0;
+    CHECK(readAndCompare(10, 3 * CTRNAND_CHUNK_SECTORS + 1));
+}
+
+int main(void)
+{
+    for(u32 i = 0; i < sizeof(nand); i++)
+        nand[i] = (u8)rnd();
+    memcpy(sd + EMU_OFFSET * 0x200, nand, sizeof(nand));
+
+    //The counter carries across all of its words, past the CTRNAND offset
+    memset(nandCtr, 0xFF, sizeof(nandCtr));
+    nandCtr[0] = 0x12;
+    nandCtr[15] = 0x80;
+    nandSlot = 0x11;
+    engine.accessesPerBlock = 1;
+    fatStart = 0x97;
+
+    testReads();
+    testFailures();
+
+    printf("crypto_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// FatFs volume for the fs.c tests and benchmarks: FatFs itself (built with f_mkfs, see the
+// Makefile) over a sparse in-memory disk, which counts the disk_read calls fs.c and FatFs make,
+// and those touching the FAT.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../source/fs.c"
+#include "test_common.h"
+
+#define DISK_SIZE   (8ull << 30)
+
+static u8 *disk;
+static FATFS diskFs;
+static u32 nbDiskReads, nbDiskReadSectors, maxDiskReadSectors, nbFatReads;
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    if(pdrv != 0 || count == 0 || (u64)sector + count > DISK_SIZE / FF_MAX_SS)
+        return RES_PARERR;
+
+    nbDiskReads++;
+    nbDiskReadSectors += count;
+    if(count > maxDiskReadSectors) maxDiskReadSectors = count;
+    if(sector < diskFs.fatbase + diskFs.fsize && sector + count > diskFs.fatbase) nbFatReads++;
+    memcpy(buff, disk + (u64)sector * FF_MAX_SS, (size_t)count * FF_MAX_SS);
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    if(pdrv != 0 || count == 0 || (u64)sector + count > DISK_SIZE / FF_MAX_SS)
+        return RES_PARERR;
+
+    memcpy(disk + (u64)sector * FF_MAX_SS, buff, (size_t)count * FF_MAX_SS);
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    if(pdrv != 0) return RES_PARERR;
+
+    switch(cmd)
+    {
+        case GET_SECTOR_COUNT:
+            *(LBA_t *)buff = (LBA_t)(DISK_SIZE / FF_MAX_SS);
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+        default:
+            return RES_OK;
+    }
+}
+
+DWORD get_fattime(void)
+{
+    return 0;
+}
+
+static void resetDiskStats(void)
+{
+    nbDiskReads = nbDiskReadSectors = maxDiskReadSectors = nbFatReads = 0;
+}
+
+// Formats the disk as FAT32 or exFAT (FM_FAT32, FM_EXFAT) and mounts it as "sdmc:", the
+// current drive. Only the touched pages of the disk are ever allocated.
+static void formatDisk(BYTE format, DWORD clusterSize)
+{
+    static BYTE work[4096];
+    MKFS_PARM opt = { format, 0, 0, 0, clusterSize };
+
+    f_mount(NULL, "sdmc:", 0);
+    if(disk != NULL) munmap(disk, DISK_SIZE);
+    disk = mmap(NULL, DISK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(disk == MAP_FAILED || f_mkfs("sdmc:", &opt, work, sizeof(work)) != FR_OK || f_mount(&diskFs, "sdmc:", 1) != FR_OK ||
+       diskFs.fs_type != (format == FM_EXFAT ? FS_EXFAT : FS_FAT32))
+    {
+        printf("failed to set up a %s volume\n", format == FM_EXFAT ? "exFAT" : "FAT32");
+        exit(1);
+    }
+}
+
+// Writes the files with random contents, 1 to 4 chunks of one then of the next, so that they
+// end up fragmented. With a chunk size of 0 they are written one after the other, in one piece.
+static void writeFiles(u32 nbFiles, const char *const *paths, u8 *const *data, const u32 *sizes, u32 chunkSize, u32 seed)
+{
+    FIL files[nbFiles];
+    u32 offsets[nbFiles];
+    u32 state = seed | 1;
+    bool done = false;
+
+    for(u32 i = 0; i < nbFiles; i++)
+    {
+        for(u32 j = 0; j < sizes[i]; j++)
+            data[i][j] = (u8)rndFrom(&state);
+        offsets[i] = 0;
+        if(f_open(&files[i], paths[i], FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+        {
+            printf("failed to create %s\n", paths[i]);
+            exit(1);
+        }
+    }
+
+    while(!done)
+    {
+        done = true;
+        for(u32 i = 0; i < nbFiles; i++)
+        {
+            u32 n = chunkSize == 0 ? sizes[i] : (1 + rndFrom(&state) % 4) * chunkSize + rndFrom(&state) % 700;
+            UINT written;
+
+            if(offsets[i] == sizes[i]) continue;
+            if(n > sizes[i] - offsets[i]) n = sizes[i] - offsets[i];
+            f_write(&files[i], data[i] + offsets[i], n, &written);
+            offsets[i] += n;
+            done = false;
+        }
+    }
+
+    for(u32 i = 0; i < nbFiles; i++)
+        f_close(&files[i]);
+}
+
+// Number of fragments of a file, from its FastSeek map
+static u32 countFragments(const char *path)
+{
+    FIL file;
+    DWORD linkMap[0x400];
+    u32 nbFragments = 0;
+
+    if(f_open(&file, path, FA_READ) != FR_OK) return 0;
+    file.cltbl = linkMap;
+    linkMap[0] = sizeof(linkMap) / sizeof(DWORD);
+    if(f_size(&file) != 0 && f_lseek(&file, CREATE_LINKMAP) == FR_OK)
+        nbFragments = linkMap[0] / 2 - 1;
+    f_close(&file);
+
+    return nbFragments;
+}
@@ -0,0 +1,278 @@
+// Host test of the FIRM section hashing done while the FIRM is read (readFirmHashed and checkFirm
+// in firm.c). fileReadWithProgress fills the buffer in steps and runs the SDMMC idle callback in
+// between, and the SHA stream only ever sees what has been read so far. checkFirm must give the
+// same answer as hashing everything afterwards, and no hash may be used for any other FIRM than
+// the one it was computed from: not after a failed read, nor after a check that stopped early.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../source/firm.c"
+
+#include "test_common.h"
+
+#define FIRM_ADDRESS    0x20001000
+#define MAX_FIRM_SIZE   0x100000
+
+// Stand-in for SHA-256, block-wise like the hardware so that a stream gives the same result
+static u64 digestBlock(u64 h, const u8 *src, u32 size)
+{
+    for(u32 i = 0; i < size; i++)
+        h = (h ^ src[i]) * 0x100000001B3ull;
+    return h;
+}
+
+static void digestFinish(u8 *res, u64 h, u32 size)
+{
+    h ^= size;
+    for(u32 i = 0; i < SHA_256_HASH_SIZE; i++)
+    {
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        res[i] = (u8)(h >> 56);
+    }
+}
+
+static u32 nbShaCalls;
+
+void sha(void *res, const void *src, u32 size, u32 mode)
+{
+    (void)mode;
+    nbShaCalls++;
+    digestFinish(res, digestBlock(0xCBF29CE484222325ull, src, size), size);
+}
+
+static struct
+{
+    const u8 *src;
+    u32 size, totalSize;
+    u64 h;
+    bool isStarted;
+} shaStream;
+
+void shaStreamStart(const void *src, u32 size, u32 mode)
+{
+    (void)mode;
+    shaStream.src = src;
+    shaStream.size = shaStream.totalSize = size;
+    shaStream.h = 0xCBF29CE484222325ull;
+    shaStream.isStarted = true;
+}
+
+// The engine is busy at times, like after each block
+u32 shaStreamFeed(const void *end)
+{
+    while(shaStream.size >= 0x40 && shaStream.src + 0x40 <= (const u8 *)end && rnd() % 4 != 0)
+    {
+        shaStream.h = digestBlock(shaStream.h, shaStream.src, 0x40);
+        shaStream.src += 0x40;
+        shaStream.size -= 0x40;
+    }
+
+    return shaStream.size;
+}
+
+void shaStreamFinish(void *res)
+{
+    CHECK(shaStream.isStarted);
+    shaStream.h = digestBlock(shaStream.h, shaStream.src, shaStream.size);
+    digestFinish(res, shaStream.h, shaStream.totalSize);
+    shaStream.isStarted = false;
+}
+
+static sdmmc_idle_callback idleCallback;
+
+sdmmc_idle_callback sdmmc_set_idle_callback(sdmmc_idle_callback callback)
+{
+    sdmmc_idle_callback previous = idleCallback;
+    idleCallback = callback;
+    return previous;
+}
+
+// The file being read, in steps of about "step" bytes, failing after "failAfter" bytes if non-zero
+static u8 file[MAX_FIRM_SIZE];
+static u32 fileSize, step, failAfter;
+
+u32 fileReadWithProgress(void *dest, const char *path, u32 maxSize, u32 *progress)
+{
+    (void)path;
+    if(fileSize > maxSize) return 0;
+
+    memset(dest, 0xAA, fileSize);
+    *progress = 0;
+    while(*progress < fileSize)
+    {
+        u32 n = 1 + rnd() % (2 * step);
+        if(n > fileSize - *progress) n = fileSize - *progress;
+        if(failAfter != 0 && *progress + n > failAfter) return 0;
+
+        memcpy((u8 *)dest + *progress, file + *progress, n);
+        *progress += n;
+        for(u32 i = rnd() % 4; i > 0 && idleCallback != NULL; i--)
+            idleCallback();
+    }
+
+    return fileSize;
+}
+
+// A valid FIRM with 1 to 4 sections, stored in random order
+static void makeFirm(void)
+{
+    static const u32 addresses[4] = { 0x08006000, 0x1FF00000, 0x20400000, 0x18000000 };
+    Firm *f = (Firm *)file;
+    u32 order[4] = { 0, 1, 2, 3 }, offset = 0x200;
+
+    memset(file, 0, sizeof(file));
+    memcpy(f->magic, "FIRM", 4);
+    for(u32 i = 3; i > 0; i--)
+    {
+        u32 j = rnd() % (i + 1), tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    u32 nbSections = 1 + rnd() % 4;
+    for(u32 n = 0; n < nbSections; n++)
+    {
+        FirmSection *section = &f->section[order[n]];
+
+        section->offset = offset;
+        section->size = (1 + rnd() % 0x100) * 0x200;
+        section->address = (u8 *)(uintptr_t)addresses[order[n]];
+        for(u32 i = 0; i < section->size; i++)
+            file[offset + i] = (u8)rnd();
+        sha(section->hash, file + offset, section->size, SHA_256_MODE);
+        offset += section->size;
+    }
+
+    f->arm9Entry = f->section[order[0]].address + 0x10;
+    f->arm11Entry = nbSections > 1 && rnd() % 2 ? f->section[order[1]].address : NULL;
+    fileSize = offset;
+}
+
+// checkFirm on the FIRM in memory, without any hash from a read
+static bool referenceCheck(void)
+{
+    memset(&firmHashStream, 0, sizeof(firmHashStream));
+    return checkFirm(fileSize);
+}
+
+static void testValidFirms(void)
+{
+    for(u32 n = 0; n < 2000; n++)
+    {
+        makeFirm();
+        step = 1 + rnd() % 0x4000;
+        failAfter = 0;
+        idleCallback = NULL;
+
+        nbShaCalls = 0;
+        CHECK(readFirmHashed("firm", MAX_FIRM_SIZE) == fileSize);
+        CHECK(!shaStream.isStarted);
+        CHECK(idleCallback == NULL);
+        CHECK(nbShaCalls == 0);
+        CHECK(checkFirm(fileSize));
+        CHECK(nbShaCalls == 0); //Every section was hashed while reading
+
+        CHECK(referenceCheck());
+    }
+}
+
+// A byte of a section or of its hash in the header changed: the read and reference checks agree
+static void testCorruptedFirms(void)
+{
+    for(u32 n = 0; n < 2000; n++)
+    {
+        makeFirm();
+        step = 1 + rnd() % 0x4000;
+        failAfter = 0;
+
+        //The header is laid out with host pointers here
+        u32 pos = rnd() % 2 ? (u32)(((Firm *)file)->section[rnd() % 4].hash - file) + rnd() % 0x20 : 0x200 + rnd() % (fileSize - 0x200);
+        file[pos] ^= 1 << (rnd() % 8);
+
+        CHECK(readFirmHashed("firm", MAX_FIRM_SIZE) == fileSize);
+        bool result = checkFirm(fileSize);
+        CHECK(!shaStream.isStarted);
+        memcpy(firm, file, fileSize);
+        CHECK(result == referenceCheck());
+    }
+}
+
+// Loads the FIRM straight into memory with a section changed after the header hashes were
+// computed, like firmRead and decryptExeFs do for CTRNAND
+static void loadTamperedFirm(u32 sectionIndex)
+{
+    memcpy(firm, file, fileSize);
+    ((u8 *)firm)[firm->section[sectionIndex].offset] ^= 0xFF;
+}
+
+static u32 lastSection(void)
+{
+    u32 last = 0;
+    for(u32 i = 0; i < 4; i++)
+        if(((Firm *)file)->section[i].size != 0 && ((Firm *)file)->section[i].offset > ((Firm *)file)->section[last].offset) last = i;
+    return last;
+}
+
+// A check stopping at its first section leaves the hashes of the others behind
+static void testCheckStoppingEarly(void)
+{
+    for(u32 n = 0; n < 500; n++)
+    {
+        do makeFirm(); while(((Firm *)file)->section[0].size == 0 || lastSection() == 0);
+        step = 0x400;
+        failAfter = 0;
+
+        //Only the hash of section 0 in the header is wrong, those of the others are still right
+        u32 last = lastSection();
+        ((Firm *)file)->section[0].hash[0] ^= 0xFF;
+        CHECK(readFirmHashed("firm", MAX_FIRM_SIZE) == fileSize);
+        CHECK(!checkFirm(fileSize));
+        ((Firm *)file)->section[0].hash[0] ^= 0xFF;
+
+        loadTamperedFirm(last);
+        CHECK(!checkFirm(fileSize));
+    }
+}
+
+// A read failing after some sections were hashed
+static void testFailedRead(void)
+{
+    for(u32 n = 0; n < 500; n++)
+    {
+        do makeFirm(); while(lastSection() == 0);
+        step = 0x400;
+
+        u32 last = lastSection();
+        failAfter = ((Firm *)file)->section[last].offset + 1;
+        CHECK(readFirmHashed("firm", MAX_FIRM_SIZE) == 0);
+        failAfter = 0;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            if(((Firm *)file)->section[i].size == 0 || i == last) continue;
+            loadTamperedFirm(i);
+            CHECK(!checkFirm(fileSize));
+        }
+    }
+}
+
+int main(void)
+{
+    if(mmap((void *)FIRM_ADDRESS, MAX_FIRM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *)FIRM_ADDRESS)
+    {
+        printf("firm_test: unable to map the FIRM buffer\n");
+        return 1;
+    }
+
+    testValidFirms();
+    testCorruptedFirms();
+    testCheckStoppingEarly();
+    testFailedRead();
+
+    printf("firm_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+// Benchmark of fileRead (fs.c) against the single f_read call it replaced: disk_read calls per
+// file on FAT32 and exFAT, for FIRM and sysmodule sized files written in one piece and fragmented.
+// Each disk_read is an SD/MMC command with its own setup cost, so fewer calls means faster
+// boots; host timings would only measure memcpy.
+
+#include "fatfs_fixture.h"
+
+#define NB_FILES    4
+
+static const char *const paths[NB_FILES] = { "sdmc:/f0.bin", "sdmc:/f1.bin", "sdmc:/f2.bin", "sdmc:/f3.bin" };
+static const u32 sizes[NB_FILES] = { 1u << 20, (15u << 17) + 321, 3u << 20, 4u << 20 };
+
+// The way fileRead used to read files, one f_read call following the FAT chain
+static u32 referenceFileRead(void *dest, const char *path, u32 maxSize)
+{
+    FIL file;
+    FRESULT result = FR_OK;
+    u32 ret = 0;
+
+    if(f_open(&file, path, FA_READ) != FR_OK) return ret;
+
+    u32 size = f_size(&file);
+    if(size <= maxSize) result = f_read(&file, dest, size, (UINT *)&ret);
+    result |= f_close(&file);
+
+    return result == FR_OK ? ret : 0;
+}
+
+int main(void)
+{
+    static const BYTE formats[] = { FM_FAT32, FM_EXFAT };
+    static const DWORD clusterSizes[] = { 4096, 32768 };
+    u8 *data[NB_FILES], *out = malloc(4u << 20);
+
+    for(u32 i = 0; i < NB_FILES; i++)
+        data[i] = malloc(sizes[i]);
+
+    printf("%-6s %-8s %-10s %8s %6s %16s %16s\n", "fs", "cluster", "layout", "size", "frags", "f_read calls", "fileRead calls");
+    for(u32 n = 0; n < 2 * 2 * 2; n++)
+    {
+        BYTE format = formats[n / 4];
+        DWORD clusterSize = clusterSizes[n / 2 % 2];
+        bool fragmented = n % 2 != 0;
+
+        formatDisk(format, clusterSize);
+        writeFiles(NB_FILES, paths, data, sizes, fragmented ? clusterSize : 0, 1);
+
+        for(u32 i = 0; i < NB_FILES; i++)
+        {
+            resetDiskStats();
+            bool ok = referenceFileRead(out, paths[i], 4u << 20) == sizes[i];
+            u32 referenceReads = nbDiskReads;
+
+            resetDiskStats();
+            ok = ok && fileRead(out, paths[i], 4u << 20) == sizes[i] && memcmp(out, data[i], sizes[i]) == 0;
+
+            printf("%-6s %-8u %-10s %8u %6u %16u %16u%s\n", format == FM_EXFAT ? "exFAT" : "FAT32", (u32)clusterSize,
+                   fragmented ? "fragmented" : "one piece", sizes[i], countFragments(paths[i]), referenceReads, nbDiskReads,
+                   ok ? "" : " (read failed)");
+        }
+    }
+
+    return 0;
+}
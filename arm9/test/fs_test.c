@@ -0,0 +1,140 @@
+// Host test of fileRead and fileReadWithProgress (fs.c), which read files through their FastSeek
+// cluster map: on FAT32 and exFAT, the result must match the file contents byte for byte, whether
+// the files are in one piece, fragmented or too fragmented for the map, and no transfer may exceed
+// the limits. exFAT files too large for a 32-bit size must never be read nor copied.
+
+#include "fatfs_fixture.h"
+
+#include "test_common.h"
+
+#define NB_FILES    9
+#define MAX_SIZE    (17u << 20)
+
+static const char *const paths[NB_FILES] = {
+    "sdmc:/f0.bin", "sdmc:/f1.bin", "sdmc:/f2.bin", "sdmc:/f3.bin", "sdmc:/f4.bin",
+    "sdmc:/f5.bin", "sdmc:/f6.bin", "sdmc:/f7.bin", "sdmc:/f8.bin",
+};
+
+static u8 *data[NB_FILES], *out;
+
+static bool readAndCompare(const char *path, const u8 *expected, u32 size, u32 *progress)
+{
+    memset(out, 0xAA, size + 4096);
+    resetDiskStats();
+
+    u32 read = fileReadWithProgress(out, path, MAX_SIZE, progress);
+
+    bool ok = read == size && memcmp(out, expected, size) == 0;
+    for(u32 i = size; i < size + 4096; i++)
+        ok = ok && out[i] == 0xAA;
+
+    return ok;
+}
+
+static void testFiles(BYTE format, DWORD clusterSize, u32 chunkSize)
+{
+    // Empty, within a sector, a cluster, and across clusters with partial sectors at the end
+    const u32 sizes[NB_FILES] = {
+        0, 1, 511, 512, clusterSize, clusterSize + 1, 1234567, (4u << 20) + 123, 3u << 20,
+    };
+
+    formatDisk(format, clusterSize);
+    writeFiles(NB_FILES, paths, data, sizes, chunkSize, format + clusterSize + chunkSize);
+
+    for(u32 i = 0; i < NB_FILES; i++)
+    {
+        u32 progress = 0xDEADBEEF;
+
+        CHECK(readAndCompare(paths[i], data[i], sizes[i], NULL));
+        CHECK(maxDiskReadSectors <= MAX_READ_SECTORS);
+
+        //exFAT files in one piece don't have a FAT chain, nor FAT32 ones read within a cluster
+        if((format == FM_EXFAT && chunkSize == 0) || sizes[i] <= clusterSize)
+            CHECK(nbFatReads == 0);
+
+        CHECK(readAndCompare(paths[i], data[i], sizes[i], &progress));
+        CHECK(progress == sizes[i]);
+        CHECK(maxDiskReadSectors <= PROGRESS_READ_SECTORS);
+
+        // Size queries, and files too large for the buffer
+        CHECK(fileRead(NULL, paths[i], 0) == sizes[i]);
+        CHECK(getFileSize(paths[i]) == sizes[i]);
+        if(sizes[i] != 0)
+        {
+            memset(out, 0xAA, 16);
+            CHECK(fileRead(out, paths[i], sizes[i] - 1) == 0);
+            CHECK(out[0] == 0xAA);
+        }
+    }
+
+    CHECK(fileRead(out, "sdmc:/missing.bin", MAX_SIZE) == 0);
+}
+
+// Beyond the 127 fragments of the link map, fileRead falls back to f_read
+static void testTooFragmented(BYTE format)
+{
+    const u32 sizes[2] = { 3u << 20, 3u << 20 };
+
+    formatDisk(format, 4096);
+    writeFiles(2, paths, data, sizes, 4096, 7);
+    CHECK(countFragments(paths[0]) > 127);
+
+    CHECK(readAndCompare(paths[0], data[0], sizes[0], NULL));
+    CHECK(readAndCompare(paths[1], data[1], sizes[1], NULL));
+}
+
+// One piece larger than a single SD/MMC transfer
+static void testLargeTransfers(BYTE format)
+{
+    const u32 sizes[1] = { (16u << 20) + 5000 };
+
+    formatDisk(format, 32768);
+    writeFiles(1, paths, data, sizes, 0, 3);
+    CHECK(countFragments(paths[0]) == 1);
+
+    CHECK(readAndCompare(paths[0], data[0], sizes[0], NULL));
+    CHECK(maxDiskReadSectors == MAX_READ_SECTORS);
+    CHECK(nbDiskReads < 10);
+}
+
+// An exFAT file of 4 GiB and more, its size must not be cut down to 32 bits
+static void testHugeFile(void)
+{
+    static u8 buffer[0x1000];
+    const FSIZE_t size = (4ull << 30) + 1000;
+    FIL file;
+
+    formatDisk(FM_EXFAT, 32768);
+    CHECK(f_open(&file, "sdmc:/huge.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+    CHECK(f_lseek(&file, size) == FR_OK && f_size(&file) == size);
+    CHECK(f_close(&file) == FR_OK);
+
+    CHECK(getFileSize("sdmc:/huge.bin") == 0xFFFFFFFF);
+    CHECK(fileRead(out, "sdmc:/huge.bin", MAX_SIZE) == 0);
+    CHECK(fileRead(out, "sdmc:/huge.bin", 0xFFFFFFFF) == 0);
+    CHECK(!fileCopy("sdmc:/huge.bin", "sdmc:/copy.bin", true, buffer, sizeof(buffer)));
+    CHECK(f_stat("sdmc:/copy.bin", NULL) == FR_NO_FILE);
+}
+
+int main(void)
+{
+    for(u32 i = 0; i < NB_FILES; i++)
+        data[i] = malloc(MAX_SIZE);
+    out = malloc(MAX_SIZE + 4096);
+
+    for(u32 i = 0; i < 2; i++)
+    {
+        BYTE format = i == 0 ? FM_FAT32 : FM_EXFAT;
+
+        testFiles(format, 4096, 0);
+        testFiles(format, 4096, 4096);
+        testFiles(format, 32768, 0);
+        testFiles(format, 32768, 32768);
+        testTooFragmented(format);
+        testLargeTransfers(format);
+    }
+    testHugeFile();
+
+    printf("fs_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
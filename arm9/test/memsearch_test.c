@@ -0,0 +1,117 @@
+// Host test of memsearchMulti (memory.c) and of the patch site scan built on it (patches.c): every
+// pattern must be found at its first occurrence, like memsearch finds it, whatever the number and
+// lengths of the patterns and whatever the data, down to a handful of byte values making up both.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/memory.c"
+#include "../source/patches.c"
+
+#include "test_common.h"
+
+#define MAX_SIZE        0x80000
+#define MAX_PATTERNS    80
+
+static u8 *firstOccurrence(u8 *pos, u32 size, const void *pattern, u32 patternSize)
+{
+    if(patternSize == 0) return NULL;
+
+    for(u32 i = 0; i + patternSize <= size; i++)
+        if(memcmp(pos + i, pattern, patternSize) == 0) return pos + i;
+
+    return NULL;
+}
+
+// Data from a few byte values, with patterns planted in full and cut short
+static void fillBuffer(u8 *buf, u32 size, const MemSearchPattern *patterns, u32 nbPatterns)
+{
+    u32 nbValues = 1 + rnd() % (rnd() % 2 ? 4 : 256);
+
+    for(u32 i = 0; i < size; i++)
+        buf[i] = rnd() % 4 == 0 ? (u8)(rnd() % nbValues) : (rnd() % 2 ? 0x00 : 0xFF);
+
+    for(u32 n = rnd() % 20; n > 0 && nbPatterns != 0; n--)
+    {
+        const MemSearchPattern *pattern = &patterns[rnd() % nbPatterns];
+        u32 patternSize = pattern->size - (rnd() % 2 && pattern->size > 1 ? 1 + rnd() % (pattern->size - 1) : 0);
+
+        if(patternSize <= size) memcpy(buf + rnd() % (size - patternSize + 1), pattern->pattern, patternSize);
+    }
+}
+
+// Random patterns, up to longer than the 0xFF bytes of the skip table and more than fit a single pass
+static void testRandomPatterns(u8 *buf)
+{
+    static u8 patternData[MAX_PATTERNS][300];
+    MemSearchPattern patterns[MAX_PATTERNS];
+    u8 *results[MAX_PATTERNS + 1];
+
+    for(u32 n = 0; n < 20000; n++)
+    {
+        u32 nbPatterns = 1 + rnd() % (n % 10 == 0 ? MAX_PATTERNS : 8);
+        u32 size = 1 + rnd() % (n % 100 == 0 ? MAX_SIZE : 0x1000);
+
+        for(u32 i = 0; i < nbPatterns; i++)
+        {
+            u32 r = rnd() % 20;
+
+            patterns[i].pattern = patternData[i];
+            patterns[i].size = r == 0 ? 0 : (r == 1 ? 0x100 + rnd() % 44 : 1 + rnd() % 12);
+            for(u32 j = 0; j < patterns[i].size; j++)
+                patternData[i][j] = rnd() % 2 ? (u8)rnd() % 4 : (u8)rnd();
+        }
+
+        fillBuffer(buf, size, patterns, nbPatterns);
+        results[nbPatterns] = buf;
+        memsearchMulti(buf, size, patterns, nbPatterns, results);
+
+        for(u32 i = 0; i < nbPatterns; i++)
+            CHECK(results[i] == firstOccurrence(buf, size, patterns[i].pattern, patterns[i].size));
+        CHECK(results[nbPatterns] == buf);
+    }
+}
+
+// The patch signatures of each section, and the sites found by scanPatchSites
+static void testPatchSites(u8 *buf)
+{
+    for(u32 n = 0; n < 5000; n++)
+    {
+        PatchSiteSection section = (PatchSiteSection)(rnd() % PATCH_SECTION_COUNT);
+        MemSearchPattern patterns[PATCH_SITE_COUNT];
+        u32 nbPatterns = 0;
+        u32 size = 1 + rnd() % (n % 100 == 0 ? MAX_SIZE : 0x1000);
+
+        for(u32 i = 0; i < PATCH_SITE_COUNT; i++)
+        {
+            if(patchSignatures[i].section != section) continue;
+            patterns[nbPatterns].pattern = patchSignatures[i].pattern;
+            patterns[nbPatterns++].size = patchSignatures[i].size;
+        }
+
+        fillBuffer(buf, size, patterns, nbPatterns);
+        scanPatchSites(buf, size, section);
+
+        for(u32 i = 0; i < PATCH_SITE_COUNT; i++)
+        {
+            const PatchSignature *signature = &patchSignatures[i];
+            u8 *expected = firstOccurrence(buf, size, signature->pattern, signature->size);
+
+            //Other sections, and other regions, are searched the slow way
+            if(signature->section == section) CHECK(getPatchSite(buf, size, (PatchSite)i) == expected);
+            if(size > sizeof(signature->pattern)) CHECK(getPatchSite(buf + 1, size - 1, (PatchSite)i) == firstOccurrence(buf + 1, size - 1, signature->pattern, signature->size));
+        }
+    }
+}
+
+int main(void)
+{
+    u8 *buf = malloc(MAX_SIZE);
+
+    testRandomPatterns(buf);
+    testPatchSites(buf);
+
+    printf("memsearch_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
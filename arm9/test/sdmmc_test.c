@@ -0,0 +1,468 @@
+// Host test of SD card transfers (sdmmc.c, and disk_read in diskio.c) against a fake controller:
+// multi-block reads and writes are split into 0x200-byte FIFO blocks, whole words for aligned
+// buffers and bytes otherwise, and the controller takes its time before each block and on
+// every poll. The data must land on the right sectors, nothing may be read from an empty FIFO
+// or written to a full one, and a failed transfer must stop where it failed.
+// It is built with SDMMC_USE_NDMA, see the Makefile: large transfers to whole cache lines go
+// through a fake NDMA channel instead, which stores each block it reads some time after it took
+// it from the FIFO, and may only touch memory sdmmc.c flushed from the data cache.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "../source/fatfs/sdmmc/sdmmc.c"
+#include "../source/fatfs/diskio.c"
+
+#include "test_common.h"
+
+#define CARD_SECTORS    0x20000
+#define MAX_SECTORS     0xFFFF
+
+// The controller, with one block in its FIFO at most
+static struct
+{
+    u16 regs[0x200 / 2];
+    u16 status0, status1;
+    bool isBusy, isWrite, isBlockReady;
+    u32 sector, blocksLeft, word, delay, maxDelay, failAfter;
+    u32 block[0x200 / 4];
+    u32 nbCommands, nbBlocks, nbDmaBlocks, nbFifoErrors, nbStalledPolls;
+} sd;
+
+// The NDMA channel sdmmc.c uses
+static struct
+{
+    u32 gcnt, sad, dad, tcnt, wcnt, bcnt, cnt;
+    bool isPending; //A block taken from the FIFO, not stored yet
+    u32 storeDelay;
+    u32 pending[0x200 / 4];
+    const u8 *flushed;
+    u32 flushedSize;
+} dma;
+
+static u8 *card;
+
+static void nextBlock(void)
+{
+    if(sd.blocksLeft == 0)
+    {
+        sd.isBusy = false;
+        sd.status0 |= TMIO_STAT0_DATAEND;
+        return;
+    }
+
+    if(sd.failAfter != 0 && sd.nbBlocks == sd.failAfter)
+    {
+        sd.isBusy = false;
+        sd.status1 |= TMIO_STAT1_DATATIMEOUT;
+        return;
+    }
+
+    sd.delay = sd.maxDelay == 0 ? 0 : rnd() % sd.maxDelay;
+    sd.word = 0;
+    sd.isBlockReady = !sd.isWrite;
+    if(!sd.isWrite) memcpy(sd.block, card + (size_t)sd.sector * 0x200, 0x200);
+}
+
+static void startCommand(u16 cmd)
+{
+    u32 arg = sd.regs[REG_SDCMDARG0 / 2] | ((u32)sd.regs[REG_SDCMDARG1 / 2] << 16);
+    u32 count = sd.regs[REG_SDBLKCOUNT / 2];
+
+    sd.nbCommands++;
+    CHECK((cmd & 0x3F) == 18 || (cmd & 0x3F) == 25); //READ_MULTIPLE_BLOCK, WRITE_MULTIPLE_BLOCK
+    CHECK(sd.regs[REG_SDBLKCOUNT32 / 2] == count && sd.regs[REG_SDBLKLEN32 / 2] == 0x200);
+    CHECK(sd.regs[REG_SDSTOP / 2] == 0x100); //Stops on its own after the last block
+    if(!handleSD.isSDHC)
+    {
+        CHECK((arg & 0x1FF) == 0);
+        arg >>= 9;
+    }
+    CHECK(count != 0 && arg + count <= CARD_SECTORS);
+
+    sd.isWrite = (cmd & 0x3F) == 25;
+    if(dma.cnt & NDMA_ENABLE)
+    {
+        CHECK(dma.tcnt == count * 0x200 / 4);
+        CHECK((dma.cnt & NDMA_SRC_FIXED) == (sd.isWrite ? 0 : NDMA_SRC_FIXED));
+        CHECK((sd.regs[REG_DATACTL32 / 2] & 0x1800) == (sd.isWrite ? 0x1000 : 0x800));
+    }
+    sd.sector = arg;
+    sd.blocksLeft = count;
+    sd.nbBlocks = 0;
+    sd.isBusy = true;
+    sd.status0 |= TMIO_STAT0_CMDRESPEND;
+    nextBlock();
+}
+
+static void endBlock(void)
+{
+    if(sd.isWrite) memcpy(card + (size_t)sd.sector * 0x200, sd.block, 0x200);
+    sd.sector++;
+    sd.blocksLeft--;
+    sd.nbBlocks++;
+    sd.nbStalledPolls = 0;
+    nextBlock();
+}
+
+static void checkStalled(void)
+{
+    if(++sd.nbStalledPolls == 1000000)
+    {
+        printf("sdmmc_test: the transfer stalled after %u blocks\n", sd.nbBlocks);
+        exit(1);
+    }
+}
+
+static bool isFlushed(const u8 *p)
+{
+    return p >= dma.flushed && p + 0x200 <= dma.flushed + dma.flushedSize;
+}
+
+// The channel moves a block once the FIFO requests it (bit 11: a received block can be read,
+// bit 12: the FIFO can take a block), then stores a block it read a few steps later
+static void stepDma(void)
+{
+    u16 ctl = sd.regs[REG_DATACTL32 / 2];
+
+    if(!(dma.cnt & NDMA_ENABLE)) return;
+    if(dma.isPending && dma.storeDelay != 0)
+        dma.storeDelay--;
+    else if(dma.isPending)
+    {
+        u8 *dst = (u8 *)(uintptr_t)dma.dad;
+
+        CHECK(isFlushed(dst));
+        memcpy(dst, dma.pending, 0x200);
+        dma.dad += 0x200;
+        dma.isPending = false;
+        if((dma.tcnt -= 0x200 / 4) == 0) dma.cnt &= ~NDMA_ENABLE;
+    }
+    else if(sd.isBusy && sd.delay == 0 && sd.word == 0)
+    {
+        if(sd.isWrite && (ctl & 0x1000))
+        {
+            const u8 *src = (const u8 *)(uintptr_t)dma.sad;
+
+            CHECK(isFlushed(src));
+            memcpy(sd.block, src, 0x200);
+            dma.sad += 0x200;
+            if((dma.tcnt -= 0x200 / 4) == 0) dma.cnt &= ~NDMA_ENABLE;
+            sd.nbDmaBlocks++;
+            endBlock();
+        }
+        else if(!sd.isWrite && sd.isBlockReady && (ctl & 0x800))
+        {
+            memcpy(dma.pending, sd.block, 0x200);
+            dma.isPending = true;
+            dma.storeDelay = rnd() % 4;
+            sd.nbDmaBlocks++;
+            endBlock();
+        }
+    }
+}
+
+u16 sdmmc_read16(u16 reg)
+{
+    u16 ctl = sd.regs[REG_DATACTL32 / 2] & 0x1800;
+
+    switch(reg)
+    {
+        case REG_SDSTATUS0:
+            return sd.status0;
+        case REG_SDSTATUS1:
+            return sd.status1 | (sd.isBusy ? TMIO_STAT1_CMD_BUSY : 0);
+        case REG_DATACTL32:
+            //Bit 8: a received block can be read, bit 9: the FIFO can't take a block yet
+            checkStalled();
+            stepDma();
+            if(sd.delay != 0)
+            {
+                sd.delay--;
+                return ctl | 0x200;
+            }
+            if(!sd.isBusy) return ctl | 0x200;
+            return ctl | (sd.isWrite ? 0 : (sd.isBlockReady ? 0x100 : 0x200));
+        default:
+            return sd.regs[reg / 2];
+    }
+}
+
+void sdmmc_write16(u16 reg, u16 val)
+{
+    switch(reg)
+    {
+        case REG_SDSTATUS0:
+            sd.status0 &= val; //Acknowledged by writing 0
+            break;
+        case REG_SDSTATUS1:
+            sd.status1 &= val;
+            break;
+        case REG_SDCMD:
+            startCommand(val);
+            break;
+        default:
+            sd.regs[reg / 2] = val;
+            break;
+    }
+}
+
+u32 sdmmc_read32(u16 reg)
+{
+    CHECK(reg == REG_SDFIFO32);
+    if(!sd.isBusy || sd.isWrite || !sd.isBlockReady || sd.delay != 0 || (dma.cnt & NDMA_ENABLE))
+    {
+        sd.nbFifoErrors++;
+        return 0;
+    }
+
+    u32 data = sd.block[sd.word++];
+    if(sd.word == 0x200 / 4) endBlock();
+    return data;
+}
+
+void sdmmc_write32(u16 reg, u32 val)
+{
+    CHECK(reg == REG_SDFIFO32);
+    if(!sd.isBusy || !sd.isWrite || sd.delay != 0 || (dma.cnt & NDMA_ENABLE))
+    {
+        sd.nbFifoErrors++;
+        return;
+    }
+
+    sd.block[sd.word++] = val;
+    if(sd.word == 0x200 / 4) endBlock();
+}
+
+u32 ndma_read32(u32 reg)
+{
+    switch(reg)
+    {
+        case REG_NDMAGCNT:
+            return dma.gcnt;
+        case REG_NDMACNT(SDMMC_NDMA_CHANNEL):
+            checkStalled();
+            stepDma();
+            return dma.cnt;
+        default:
+            CHECK(false);
+            return 0;
+    }
+}
+
+void ndma_write32(u32 reg, u32 val)
+{
+    const u32 fifo = SDMMC_BASE + REG_SDFIFO32;
+
+    switch(reg)
+    {
+        case REG_NDMAGCNT:              dma.gcnt = val; break;
+        case REG_NDMASAD(SDMMC_NDMA_CHANNEL):   dma.sad = val; break;
+        case REG_NDMADAD(SDMMC_NDMA_CHANNEL):   dma.dad = val; break;
+        case REG_NDMATCNT(SDMMC_NDMA_CHANNEL):  dma.tcnt = val; break;
+        case REG_NDMAWCNT(SDMMC_NDMA_CHANNEL):  dma.wcnt = val; break;
+        case REG_NDMABCNT(SDMMC_NDMA_CHANNEL):  dma.bcnt = val; break;
+        case REG_NDMACNT(SDMMC_NDMA_CHANNEL):
+            dma.cnt = val;
+            dma.isPending = false;
+            if(val & NDMA_ENABLE)
+            {
+                bool isRead = (val & NDMA_SRC_FIXED) != 0;
+                const u8 *mem = (const u8 *)(uintptr_t)(isRead ? dma.dad : dma.sad);
+
+                CHECK(!sd.isBusy);
+                CHECK(dma.gcnt & NDMA_GCNT_ENABLE);
+                CHECK(val == (NDMA_ENABLE | NDMA_STARTUP_SDMMC | NDMA_BURST_16_WORDS | (isRead ? NDMA_SRC_FIXED : NDMA_DST_FIXED)));
+                CHECK((isRead ? dma.sad : dma.dad) == fifo);
+                CHECK(dma.wcnt == 0x200 / 4 && dma.bcnt == 0);
+                CHECK(mem == dma.flushed && dma.tcnt * 4 == dma.flushedSize);
+            }
+            break;
+        default:
+            CHECK(false);
+            break;
+    }
+}
+
+void flushDCacheRange(void *startAddress, u32 size)
+{
+    dma.flushed = startAddress;
+    dma.flushedSize = size;
+}
+
+// What diskio.c needs besides the SD card
+static u64 ticks;
+static u32 sdReadBytes;
+static u64 sdReadTicks;
+
+u64 chronoTicks(void)
+{
+    return ticks += 7;
+}
+
+void bootTraceCountSdRead(u32 size, u64 elapsed)
+{
+    sdReadBytes += size;
+    sdReadTicks += elapsed;
+}
+
+int ctrNandRead(u32 sector, u32 sectorCount, u8 *outbuf)
+{
+    (void)sector;
+    (void)sectorCount;
+    (void)outbuf;
+    CHECK(false);
+    return 1;
+}
+
+static u32 nbIdleCalls;
+
+static void onIdle(void)
+{
+    nbIdleCalls++;
+}
+
+static u8 *buffer;
+
+static void startTransfer(u32 maxDelay, u32 failAfter)
+{
+    memset(&sd, 0, sizeof(sd));
+    memset(&dma, 0, sizeof(dma));
+    sd.maxDelay = maxDelay;
+    sd.failAfter = failAfter;
+    handleSD.isSDHC = rnd() % 4 != 0;
+    nbIdleCalls = 0;
+}
+
+// Which transfers go through NDMA: large enough ones, to or from whole cache lines out of the TCMs
+static void testNdmaChoice(void)
+{
+    CHECK(sdmmc_use_ndma(0x20000000, SDMMC_NDMA_MIN_SECTORS));
+    CHECK(!sdmmc_use_ndma(0x20000000, SDMMC_NDMA_MIN_SECTORS - 1));
+    CHECK(!sdmmc_use_ndma(0x20000000, 0));
+    CHECK(sdmmc_use_ndma(0x08000020, MAX_SECTORS));
+    CHECK(!sdmmc_use_ndma(0x08000010, 0x100));
+    CHECK(!sdmmc_use_ndma(0x20000004, 0x100));
+    CHECK(!sdmmc_use_ndma(0x20000001, 0x100));
+    CHECK(!sdmmc_use_ndma(0x01FF8000, 0x100));
+    CHECK(!sdmmc_use_ndma(0x07FFFFE0, 0x100));
+    CHECK(!sdmmc_use_ndma(0xFFF00000, 0x100));
+    CHECK(sdmmc_use_ndma(0xFFF00000 - 0x1000, 8));
+    CHECK(!sdmmc_use_ndma(0xFFF00000 - 0x1000, 9));
+    CHECK(!sdmmc_use_ndma(0xFFFFFFE0, MAX_SECTORS));
+}
+
+// Reads and writes of random sizes, to and from buffers of any alignment
+static void testTransfers(void)
+{
+    for(u32 n = 0; n < 3000; n++)
+    {
+        u32 count = n % 100 == 0 ? MAX_SECTORS - rnd() % 16 : 1 + rnd() % (rnd() % 4 == 0 ? 0x400 : 0x40);
+        u32 sector = rnd() % (CARD_SECTORS - count + 1);
+        u32 offset = rnd() % 4 == 0 ? rnd() % 8 : rnd() % 2 * 32;
+        u8 *out = buffer + 32 + offset;
+        bool isWrite = rnd() % 3 == 0;
+        bool isDma = offset % 32 == 0 && count >= SDMMC_NDMA_MIN_SECTORS;
+        u32 size = count * 0x200;
+
+        startTransfer(rnd() % 8, 0);
+        memset(buffer, 0xAA, 32 + offset + size + 32);
+        if(isWrite)
+        {
+            for(u32 i = 0; i < size; i++)
+                out[i] = (u8)rnd();
+
+            CHECK(sdmmc_sdcard_writesectors(sector, count, out) == 0);
+            CHECK(memcmp(card + (size_t)sector * 0x200, out, size) == 0);
+        }
+        else
+        {
+            sdReadBytes = 0;
+            CHECK(disk_read(SDCARD, out, sector, count) == RES_OK);
+            CHECK(memcmp(out, card + (size_t)sector * 0x200, size) == 0);
+            CHECK(sdReadBytes == size);
+        }
+
+        CHECK(sd.nbCommands == 1 && sd.nbBlocks == count && sd.blocksLeft == 0);
+        CHECK(sd.nbDmaBlocks == (isDma ? count : 0));
+        CHECK(dma.cnt == 0 && (sd.regs[REG_DATACTL32 / 2] & 0x1800) == 0);
+        CHECK(sd.nbFifoErrors == 0);
+        CHECK(nbIdleCalls != 0);
+        for(u32 i = 0; i < 32 + offset; i++)
+            CHECK(buffer[i] == 0xAA);
+        for(u32 i = 32 + offset + size; i < 32 + offset + size + 32; i++)
+            CHECK(buffer[i] == 0xAA);
+    }
+}
+
+// The controller reports a timeout before some block: nothing more is transferred. A read through
+// NDMA may lose the last block the channel took, which it was still to store when stopped
+static void testFailures(void)
+{
+    for(u32 n = 0; n < 1000; n++)
+    {
+        u32 count = 2 + rnd() % 0x3F;
+        u32 failAfter = 1 + rnd() % (count - 1);
+        u32 sector = rnd() % (CARD_SECTORS - count + 1);
+        u32 offset = rnd() % 4 * (rnd() % 2 ? 1 : 32);
+        u8 *out = buffer + 32 + offset;
+        bool isDma = offset % 32 == 0 && count >= SDMMC_NDMA_MIN_SECTORS;
+        u32 size = count * 0x200;
+
+        startTransfer(rnd() % 8, failAfter);
+        memset(buffer, 0xAA, size + 160);
+        if(rnd() % 2)
+        {
+            static u8 before[0x40 * 0x200];
+
+            memcpy(before, card + (size_t)sector * 0x200, size);
+            for(u32 i = 0; i < size; i++)
+                out[i] = (u8)rnd();
+
+            CHECK(sdmmc_sdcard_writesectors(sector, count, out) != 0);
+            CHECK(memcmp(card + (size_t)sector * 0x200, out, failAfter * 0x200) == 0);
+            CHECK(memcmp(card + ((size_t)sector + failAfter) * 0x200, before + failAfter * 0x200, size - failAfter * 0x200) == 0);
+        }
+        else
+        {
+            CHECK(disk_read(SDCARD, out, sector, count) == RES_PARERR);
+            CHECK(memcmp(out, card + (size_t)sector * 0x200, (isDma ? failAfter - 1 : failAfter) * 0x200) == 0);
+            for(u32 i = failAfter * 0x200; i < size; i++)
+                CHECK(out[i] == 0xAA);
+        }
+
+        CHECK(sd.nbBlocks == failAfter);
+        CHECK(dma.cnt == 0 && (sd.regs[REG_DATACTL32 / 2] & 0x1800) == 0);
+        CHECK(sd.nbFifoErrors == 0);
+    }
+}
+
+int main(void)
+{
+    //Where FCRAM is, so that the channel's registers can hold the buffer's addresses
+    size_t bufferSize = (size_t)MAX_SECTORS * 0x200 + 0x1000;
+    buffer = mmap((void *)0x20000000, bufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(buffer != (u8 *)0x20000000)
+    {
+        printf("sdmmc_test: can't map the buffer at 0x20000000\n");
+        return 1;
+    }
+
+    card = malloc((size_t)CARD_SECTORS * 0x200);
+    for(size_t i = 0; i < (size_t)CARD_SECTORS * 0x200; i++)
+        card[i] = (u8)rnd();
+
+    handleSD.devicenumber = 0;
+    handleSD.clk = 0x80;
+    sdmmc_set_idle_callback(onIdle);
+
+    testNdmaChoice();
+    testTransfers();
+    testFailures();
+
+    printf("sdmmc_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
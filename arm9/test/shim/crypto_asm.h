@@ -0,0 +1,18 @@
+// Host stand-in for the inline assembly of include/crypto_asm.h: the same counter arithmetic,
+// in C.
+
+#pragma once
+
+#include "types.h"
+
+#define BSWAP32(x) {x = __builtin_bswap32(x);}
+
+#define ADD_u128_u32(u128_0, u128_1, u128_2, u128_3, u32_0) {\
+    u64 sum = (u64)(u128_0) + (u32_0);\
+    u128_0 = (u32)sum;\
+    sum = (u64)(u128_1) + (sum >> 32);\
+    u128_1 = (u32)sum;\
+    sum = (u64)(u128_2) + (sum >> 32);\
+    u128_2 = (u32)sum;\
+    u128_3 += (u32)(sum >> 32);\
+}
@@ -0,0 +1,13 @@
+// Host stand-in for the SD/MMC controller and NDMA registers, see include/sdmmc_regs.h. The
+// test which includes sdmmc.c defines these, on its fake controller.
+
+#pragma once
+
+#include "types.h"
+
+u16 sdmmc_read16(u16 reg);
+void sdmmc_write16(u16 reg, u16 val);
+u32 sdmmc_read32(u16 reg);
+void sdmmc_write32(u16 reg, u32 val);
+u32 ndma_read32(u32 reg);
+void ndma_write32(u32 reg, u32 val);
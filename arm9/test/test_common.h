@@ -0,0 +1,27 @@
+// What the host tests share: CHECK, which reports and counts failed conditions, and the random
+// numbers, an xorshift32 which gives the same sequence on every run and every host.
+
+#pragma once
+
+#include <stdio.h>
+#include "types.h"
+
+// The benchmarks only take the random numbers
+static u32 nbFailures __attribute__((unused)) = 0;
+
+#define CHECK(cond) do { if(!(cond)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); nbFailures++; } } while(0)
+
+static inline u32 rndFrom(u32 *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static u32 rngState = 1;
+
+static inline u32 rnd(void)
+{
+    return rndFrom(&rngState);
+}
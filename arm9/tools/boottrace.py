@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+# Prints the per-stage table of a /luma/boottrace.bin file written by arm9,
+# see arm9/include/boottrace_format.h for the format.
+
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHIIQIIQ")
+ENTRY = struct.Struct("<8sQ")
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.exit("usage: {0} boottrace.bin".format(argv[0]))
+
+    with open(argv[1], "rb") as f:
+        data = f.read()
+
+    magic, version, nbEntries, ticksPerSec, ctrNandReadSize, ctrNandReadTicks, sdReadSize, _, sdReadTicks = HEADER.unpack_from(data)
+    if magic != b"BTRC" or version != 3 or ticksPerSec == 0:
+        sys.exit("{0}: not a version 3 boot trace".format(argv[1]))
+    if len(data) < HEADER.size + nbEntries * ENTRY.size:
+        sys.exit("{0}: truncated boot trace".format(argv[1]))
+
+    entries = []
+    for i in range(nbEntries):
+        name, ticks = ENTRY.unpack_from(data, HEADER.size + i * ENTRY.size)
+        entries.append((name.split(b"\0", 1)[0].decode("ascii", "replace"), ticks))
+
+    ms = lambda ticks: 1000.0 * ticks / ticksPerSec
+
+    print("{0:<10} {1:>10} {2:>10}".format("Stage", "End (ms)", "Dur. (ms)"))
+    for i in range(1, nbEntries):
+        name, ticks = entries[i]
+        print("{0:<10} {1:>10.2f} {2:>10.2f}".format(name, ms(ticks - entries[0][1]), ms(ticks - entries[i - 1][1])))
+
+    print()
+    for name, size, ticks in (("SD card", sdReadSize, sdReadTicks), ("CTRNAND", ctrNandReadSize, ctrNandReadTicks)):
+        if ticks != 0:
+            print("{0}: {1} KiB in {2:.2f} ms ({3:.0f} KiB/s)".format(name, size // 1024, ms(ticks), size * ticksPerSec / ticks / 1024))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
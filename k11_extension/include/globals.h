@@ -67,6 +67,7 @@ extern Result (*CreateThread)(Handle *outThreadHandle, u32 ep, u32 arg, u32 stac
 extern void (*SleepThread)(s64 ns);
 extern Result (*CreateEvent)(Handle *out, ResetType resetType);
 extern Result (*CloseHandle)(Handle handle);
+extern u64 (*GetSystemTick)(void);
 extern Result (*GetHandleInfo)(s64 *out, Handle handle, u32 type);
 extern Result (*GetSystemInfo)(s64 *out, s32 type, s32 param);
 extern Result (*GetProcessInfo)(s64 *out, Handle processHandle, u32 type);
@@ -160,6 +161,7 @@ typedef struct CfwInfo
 
     u64 autobootTwlTitleId;
     u8 autobootCtrAppmemtype;
+    u8 screenshotFormat;
 
     u16 launchedPath[80+1];
 } CfwInfo;
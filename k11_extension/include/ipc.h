@@ -31,13 +31,29 @@
 #include "kernel.h"
 #include "utils.h"
 
-#define MAX_SESSION     345
+#define MAX_SESSION             345
+#define SESSION_TABLE_SIZE      512 // must be a power of two, > MAX_SESSION
 
 // the structure of sessions is apparently not the same on older versions...
 
+// Services the SendSyncRequest hook cares about, interned when the session is added
+typedef enum ServiceId
+{
+    SERVICE_ID_UNKNOWN = 0,
+    SERVICE_ID_SRV,
+    SERVICE_ID_SRV_PM,
+    SERVICE_ID_CFG_U,
+    SERVICE_ID_CFG_S,
+    SERVICE_ID_CFG_I,
+    SERVICE_ID_ERR_F,
+    SERVICE_ID_NDM_U,
+    SERVICE_ID_APT, // any "APT:" service
+} ServiceId;
+
 typedef struct SessionInfo
 {
     KSession *session;
+    u32 serviceId;
     char name[12];
 } SessionInfo;
 
@@ -50,6 +66,7 @@ typedef struct LangemuAttributes
 extern KRecursiveLock processLangemuLock;
 extern LangemuAttributes processLangemuAttributes[0x40];
 
+ServiceId SessionInfo_InternName(const char *name);
 SessionInfo *SessionInfo_Lookup(KSession *session);
 SessionInfo *SessionInfo_FindFirst(const char *name);
 void SessionInfo_ChangeVtable(KSession *session);
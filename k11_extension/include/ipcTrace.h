@@ -0,0 +1,68 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "kernel.h"
+
+#define IPC_TRACE_MAGIC                 0x54435049 // "IPCT"
+#define IPC_TRACE_VERSION               1
+#define IPC_TRACE_NB_EVENTS_PER_CORE    256 // must be a power of two
+
+// The trace buffer is shared with rosalina, which accesses it through PA | (1 << 31), like we do.
+// Please keep that in sync with the definitions in sysmodules/rosalina/include/ipc_trace.h
+
+typedef struct IpcTraceEvent
+{
+    u64 timestamp;          // system tick at which the request was sent
+    u32 latency;            // system ticks elapsed until the reply was received
+    u32 pid;
+    u32 cmdHeader;
+    char serviceName[12];   // empty if the session isn't known
+} IpcTraceEvent;
+
+typedef struct IpcTraceHeader
+{
+    u32 magic;
+    u32 version;
+    u32 nbCores;
+    u32 nbEventsPerCore;
+    vu32 writeIndices[4];   // free-running, only ever written by their own core
+    // followed by nbCores rings of nbEventsPerCore IpcTraceEvent each
+} IpcTraceHeader;
+
+extern bool ipcTraceEnabled;
+extern u32 ipcTraceOwnerPid, ipcTracePidFilter;
+
+static inline bool IpcTrace_ShouldTrace(u32 pid)
+{
+    return ipcTraceEnabled && pid != ipcTraceOwnerPid && (ipcTracePidFilter == 0xFFFFFFFF || pid == ipcTracePidFilter);
+}
+
+Result IpcTrace_SetEnabled(bool enable, u32 pidFilter);
+Result IpcTrace_GetInfo(s64 *out, s32 param);
+void IpcTrace_Record(u64 timestamp, u32 latency, u32 pid, u32 cmdHeader, const char *serviceName);
@@ -0,0 +1,66 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "kernel.h"
+
+#define SVC_PROFILER_NB_BUCKETS 8
+
+// Per-SVC statistics. Each core has its own array of these, so that no lock is needed
+// when recording; aggregation is done when reading them back (svcGetSystemInfo 0x10003).
+typedef struct SvcProfilerEntry
+{
+    u32 count;
+    u32 maxCycles;
+    u64 totalCycles;
+    u32 histogram[SVC_PROFILER_NB_BUCKETS];
+} SvcProfilerEntry;
+
+extern u32 svcProfilerPid;
+
+// CP15 cycle counter (CCNT), see enableCycleCounter
+static inline u32 svcProfilerGetCycleCount(void)
+{
+    u32 ccnt;
+    __asm__ __volatile__("mrc p15, 0, %[val], c15, c12, 1" : [val] "=r" (ccnt));
+    return ccnt;
+}
+
+// Bucket 0: < 256 cycles, bucket i: [256 << 2(i - 1), 256 << 2i), last bucket: >= 1M cycles
+static inline u32 svcProfilerBucketOf(u32 cycles)
+{
+    u32 nbBits = 32 - __builtin_clz(cycles | 1);
+    u32 bucket = nbBits <= 8 ? 0 : (nbBits - 7) / 2;
+    return bucket < SVC_PROFILER_NB_BUCKETS ? bucket : SVC_PROFILER_NB_BUCKETS - 1;
+}
+
+KSchedulableInterruptEvent *enableCycleCounter(KBaseInterruptEvent *this, u32 interruptID);
+
+Result SvcProfiler_SetEnabled(u32 pid, bool enable);
+void SvcProfiler_Record(u8 svcId, u32 cycles);
+Result SvcProfiler_GetInfo(s64 *out, s32 param);
@@ -66,6 +66,7 @@ Result (*CreateThread)(Handle *outThreadHandle, u32 ep, u32 arg, u32 stackTop, s
 void (*SleepThread)(s64 ns);
 Result (*CreateEvent)(Handle *out, ResetType resetType);
 Result (*CloseHandle)(Handle handle);
+u64 (*GetSystemTick)(void);
 Result (*GetHandleInfo)(s64 *out, Handle handle, u32 type);
 Result (*GetSystemInfo)(s64 *out, s32 type, s32 param);
 Result (*GetProcessInfo)(s64 *out, Handle processHandle, u32 type);
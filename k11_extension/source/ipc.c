@@ -26,9 +26,14 @@
 #include <string.h>
 
 #include "ipc.h"
+#include "synchronization.h"
 
 static SessionInfo sessionInfos[MAX_SESSION] = { {NULL} };
+static u16 sessionTable[SESSION_TABLE_SIZE]; // open addressing, indices into sessionInfos, 0 = empty
+static u16 freeSessionInfoSlots[MAX_SESSION];
+static u32 nbFreeSessionInfoSlots = 0, nbUsedSessionInfoSlots = 0;
 static u32 nbActiveSessions = 0;
+static vu32 sessionInfosSeqCounter = 0; // odd while sessionTable is being modified
 static KRecursiveLock sessionInfosLock = { NULL };
 
 KRecursiveLock processLangemuLock;
@@ -36,46 +41,84 @@ LangemuAttributes processLangemuAttributes[0x40];
 
 static void *customSessionVtable[0x10] = { NULL }; // should be enough
 
-static u32 SessionInfo_FindClosestSlot(KSession *session)
+static const struct
 {
-    if(nbActiveSessions == 0 || session <= sessionInfos[0].session)
-        return 0;
-    else if(session > sessionInfos[nbActiveSessions - 1].session)
-        return nbActiveSessions;
-
-    u32 a = 0, b = nbActiveSessions - 1, m;
-
-    do
+    const char *name;
+    u32 len; // compared length, to match e.g. "APT:U", "APT:A" and "APT:S" at once
+    ServiceId id;
+} internedServiceNames[] =
+{
+    { "srv:",   5, SERVICE_ID_SRV    },
+    { "srv:pm", 7, SERVICE_ID_SRV_PM },
+    { "cfg:u",  6, SERVICE_ID_CFG_U  },
+    { "cfg:s",  6, SERVICE_ID_CFG_S  },
+    { "cfg:i",  6, SERVICE_ID_CFG_I  },
+    { "err:f",  6, SERVICE_ID_ERR_F  },
+    { "ndm:u",  6, SERVICE_ID_NDM_U  },
+    { "APT:",   4, SERVICE_ID_APT    },
+};
+
+ServiceId SessionInfo_InternName(const char *name)
+{
+    for(u32 i = 0; i < sizeof(internedServiceNames) / sizeof(internedServiceNames[0]); i++)
     {
-        m = (a + b) / 2;
-        if(sessionInfos[m].session < session)
-            a = m;
-        else if(sessionInfos[m].session > session)
-            b = m;
-        else
-            return m;
+        if(strncmp(name, internedServiceNames[i].name, internedServiceNames[i].len) == 0)
+            return internedServiceNames[i].id;
     }
-    while(b - a > 1);
 
-    return b;
+    return SERVICE_ID_UNKNOWN;
 }
 
-SessionInfo *SessionInfo_Lookup(KSession *session)
+static inline u32 SessionInfo_Hash(KSession *session)
 {
-    KRecursiveLock__Lock(criticalSectionLock);
-    KRecursiveLock__Lock(&sessionInfosLock);
+    // Kernel objects are at least 8-byte aligned
+    return (((u32)session >> 3) * 0x9E3779B1u) >> (32 - __builtin_ctz(SESSION_TABLE_SIZE));
+}
 
+// Returns the position of the session in sessionTable, or that of the empty slot ending its probe sequence
+static u32 SessionInfo_FindSlot(KSession *session)
+{
+    u32 pos = SessionInfo_Hash(session);
+    while(sessionTable[pos] != 0 && sessionInfos[sessionTable[pos] - 1].session != session)
+        pos = (pos + 1) & (SESSION_TABLE_SIZE - 1);
+
+    return pos;
+}
+
+static inline void SessionInfo_BeginWrite(void)
+{
+    sessionInfosSeqCounter++;
+    __dmb();
+}
+
+static inline void SessionInfo_EndWrite(void)
+{
+    __dmb();
+    sessionInfosSeqCounter++;
+}
+
+// Called from the SendSyncRequest hook on every request, hence lock-free. Writers hold the
+// critical section lock and therefore can't be preempted, readers on other cores just retry
+// if they raced with one.
+SessionInfo *SessionInfo_Lookup(KSession *session)
+{
     SessionInfo *ret;
-    u32 id = SessionInfo_FindClosestSlot(session);
-    if(id == nbActiveSessions)
-        ret = NULL;
-    else
-        ret = (void **)(sessionInfos[id].session->autoObject.vtable) == customSessionVtable ? &sessionInfos[id] : NULL;
+    u32 seq;
 
-    KRecursiveLock__Unlock(&sessionInfosLock);
-    KRecursiveLock__Unlock(criticalSectionLock);
+    do
+    {
+        seq = sessionInfosSeqCounter;
+        __dmb();
+        if(seq & 1)
+            continue;
+
+        u32 id = sessionTable[SessionInfo_FindSlot(session)];
+        ret = id != 0 ? &sessionInfos[id - 1] : NULL;
+        __dmb();
+    }
+    while((seq & 1) || seq != sessionInfosSeqCounter);
 
-    return ret;
+    return ret != NULL && (void **)(session->autoObject.vtable) == customSessionVtable ? ret : NULL;
 }
 
 SessionInfo *SessionInfo_FindFirst(const char *name)
@@ -83,13 +126,16 @@ SessionInfo *SessionInfo_FindFirst(const char *name)
     KRecursiveLock__Lock(criticalSectionLock);
     KRecursiveLock__Lock(&sessionInfosLock);
 
-    SessionInfo *ret;
-    u32 id;
-    for(id = 0; id < nbActiveSessions && strncmp(sessionInfos[id].name, name, 12) != 0; id++);
-    if(id == nbActiveSessions)
-        ret = NULL;
-    else
-        ret = (void **)(sessionInfos[id].session->autoObject.vtable) == customSessionVtable ? &sessionInfos[id] : NULL;
+    SessionInfo *ret = NULL;
+    ServiceId serviceId = SessionInfo_InternName(name);
+    for(u32 id = 0; id < nbUsedSessionInfoSlots && ret == NULL; id++)
+    {
+        SessionInfo *info = &sessionInfos[id];
+        if(info->session == NULL || (void **)(info->session->autoObject.vtable) != customSessionVtable)
+            continue;
+        else if((serviceId == SERVICE_ID_UNKNOWN || info->serviceId == serviceId) && strncmp(info->name, name, 12) == 0)
+            ret = info;
+    }
 
     KRecursiveLock__Unlock(&sessionInfosLock);
     KRecursiveLock__Unlock(criticalSectionLock);
@@ -106,29 +152,25 @@ void SessionInfo_Add(KSession *session, const char *name)
     KRecursiveLock__Lock(criticalSectionLock);
     KRecursiveLock__Lock(&sessionInfosLock);
 
-    if(nbActiveSessions == MAX_SESSION)
+    u32 pos = SessionInfo_FindSlot(session);
+    if(nbActiveSessions == MAX_SESSION || sessionTable[pos] != 0)
     {
         KRecursiveLock__Unlock(&sessionInfosLock);
         KRecursiveLock__Unlock(criticalSectionLock);
         return;
     }
 
-    u32 id = SessionInfo_FindClosestSlot(session);
-
-    if(id != nbActiveSessions && sessionInfos[id].session == session)
-    {
-        KRecursiveLock__Unlock(&sessionInfosLock);
-        KRecursiveLock__Unlock(criticalSectionLock);
-        return;
-    }
+    u32 id = nbFreeSessionInfoSlots > 0 ? freeSessionInfoSlots[--nbFreeSessionInfoSlots] : nbUsedSessionInfoSlots++;
 
-    for(u32 i = nbActiveSessions; i > id && i != 0; i--)
-        sessionInfos[i] = sessionInfos[i - 1];
+    SessionInfo *info = &sessionInfos[id];
+    strncpy(info->name, name, 12);
+    info->serviceId = SessionInfo_InternName(info->name);
+    info->session = session;
 
+    SessionInfo_BeginWrite();
+    sessionTable[pos] = (u16)(id + 1);
     nbActiveSessions++;
-
-    sessionInfos[id].session = session;
-    strncpy(sessionInfos[id].name, name, 12);
+    SessionInfo_EndWrite();
 
     KRecursiveLock__Unlock(&sessionInfosLock);
     KRecursiveLock__Unlock(criticalSectionLock);
@@ -139,26 +181,35 @@ void SessionInfo_Remove(KSession *session)
     KRecursiveLock__Lock(criticalSectionLock);
     KRecursiveLock__Lock(&sessionInfosLock);
 
-    if(nbActiveSessions == MAX_SESSION)
+    u32 pos = SessionInfo_FindSlot(session);
+    if(sessionTable[pos] == 0)
     {
         KRecursiveLock__Unlock(&sessionInfosLock);
         KRecursiveLock__Unlock(criticalSectionLock);
         return;
     }
 
-    u32 id = SessionInfo_FindClosestSlot(session);
+    u32 id = sessionTable[pos] - 1;
+
+    SessionInfo_BeginWrite();
 
-    if(id == nbActiveSessions)
+    // Backward-shift deletion, so that no tombstones are needed
+    for(u32 next = (pos + 1) & (SESSION_TABLE_SIZE - 1); sessionTable[next] != 0; next = (next + 1) & (SESSION_TABLE_SIZE - 1))
     {
-        KRecursiveLock__Unlock(&sessionInfosLock);
-        KRecursiveLock__Unlock(criticalSectionLock);
-        return;
+        u32 home = SessionInfo_Hash(sessionInfos[sessionTable[next] - 1].session);
+        if(((next - home) & (SESSION_TABLE_SIZE - 1)) >= ((next - pos) & (SESSION_TABLE_SIZE - 1)))
+        {
+            sessionTable[pos] = sessionTable[next];
+            pos = next;
+        }
     }
+    sessionTable[pos] = 0;
 
-    for(u32 i = id; i < nbActiveSessions - 1; i++)
-        sessionInfos[i] = sessionInfos[i + 1];
+    memset(&sessionInfos[id], 0, sizeof(SessionInfo));
+    freeSessionInfoSlots[nbFreeSessionInfoSlots++] = (u16)id;
+    nbActiveSessions--;
 
-    memset(&sessionInfos[--nbActiveSessions], 0, sizeof(SessionInfo));
+    SessionInfo_EndWrite();
 
     KRecursiveLock__Unlock(&sessionInfosLock);
     KRecursiveLock__Unlock(criticalSectionLock);
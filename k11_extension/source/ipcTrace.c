@@ -0,0 +1,126 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "ipcTrace.h"
+#include "globals.h"
+#include "synchronization.h"
+#include "utils.h"
+
+bool ipcTraceEnabled = false;
+u32 ipcTraceOwnerPid = 0xFFFFFFFF, ipcTracePidFilter = 0xFFFFFFFF;
+
+// Accessed uncached, allocated when tracing is first enabled and never freed
+static IpcTraceHeader *ipcTraceBuffer = NULL;
+static u32 ipcTraceBufferPa = 0, ipcTraceBufferSize = 0;
+
+static inline IpcTraceEvent *IpcTrace_GetRing(u32 coreId)
+{
+    return (IpcTraceEvent *)(ipcTraceBuffer + 1) + coreId * IPC_TRACE_NB_EVENTS_PER_CORE;
+}
+
+Result IpcTrace_SetEnabled(bool enable, u32 pidFilter)
+{
+    if(!enable)
+    {
+        ipcTraceEnabled = false;
+        __dsb();
+        return 0;
+    }
+
+    if(ipcTraceBuffer == NULL)
+    {
+        u32 size = sizeof(IpcTraceHeader) + getNumberOfCores() * IPC_TRACE_NB_EVENTS_PER_CORE * sizeof(IpcTraceEvent);
+        size = (size + 0xFFF) >> 12 << 12;
+
+        void *kvAddr = kAlloc(fcramDescriptor, size >> 12, 0, MEMOP_REGION_BASE);
+        if(kvAddr == NULL)
+            return 0xD86007F3;
+
+        flushDataCacheRange(kvAddr, size); // we won't access it through that mapping anymore
+        ipcTraceBufferPa = convertVAToPA(kvAddr, false);
+        ipcTraceBufferSize = size;
+        ipcTraceBuffer = (IpcTraceHeader *)PA_PTR(ipcTraceBufferPa);
+    }
+
+    ipcTraceEnabled = false;
+    __dsb();
+
+    memset(ipcTraceBuffer, 0, ipcTraceBufferSize);
+    ipcTraceBuffer->magic = IPC_TRACE_MAGIC;
+    ipcTraceBuffer->version = IPC_TRACE_VERSION;
+    ipcTraceBuffer->nbCores = getNumberOfCores();
+    ipcTraceBuffer->nbEventsPerCore = IPC_TRACE_NB_EVENTS_PER_CORE;
+
+    // Don't trace the requests made by whoever is going to read (and possibly send) the trace
+    ipcTraceOwnerPid = idOfProcess(currentCoreContext->objectContext.currentProcess);
+    ipcTracePidFilter = pidFilter;
+    __dsb();
+    ipcTraceEnabled = true;
+
+    return 0;
+}
+
+Result IpcTrace_GetInfo(s64 *out, s32 param)
+{
+    switch(param)
+    {
+        case 0:
+            *out = ipcTraceBufferPa;
+            return 0;
+        case 1:
+            *out = ipcTraceBufferSize;
+            return 0;
+        case 2:
+            *out = ipcTraceEnabled;
+            return 0;
+        default:
+            *out = 0;
+            return 0xF8C007F4;
+    }
+}
+
+void IpcTrace_Record(u64 timestamp, u32 latency, u32 pid, u32 cmdHeader, const char *serviceName)
+{
+    // Single producer per ring: just make sure we aren't preempted by another request on this core
+    u32 cpsr = __get_cpsr();
+    __disable_irq();
+
+    u32 coreId = getCurrentCoreID();
+    u32 idx = ipcTraceBuffer->writeIndices[coreId];
+    IpcTraceEvent *event = &IpcTrace_GetRing(coreId)[idx & (IPC_TRACE_NB_EVENTS_PER_CORE - 1)];
+
+    event->timestamp = timestamp;
+    event->latency = latency;
+    event->pid = pid;
+    event->cmdHeader = cmdHeader;
+    memcpy(event->serviceName, serviceName, 12);
+
+    __dmb();
+    ipcTraceBuffer->writeIndices[coreId] = idx + 1;
+
+    __set_cpsr_cx(cpsr);
+}
@@ -49,6 +49,7 @@
 #include "svc/CopyHandle.h"
 #include "svc/TranslateHandle.h"
 #include "svc/ControlMemoryUnsafe.h"
+#include "svcProfiler.h"
 
 void *officialSVCs[0x7E] = {NULL};
 void *alteredSvcTable[0x100] = {NULL};
@@ -105,20 +106,30 @@ void buildAlteredSvcTable(void)
     alteredSvcTable[0xB3] = ControlProcess;
 }
 
-void signalSvcEntry(u32 svcId)
+// Returns the SVC profiler start timestamp (kept in r11 by svcHandler), or 0 if the SVC isn't profiled
+u32 signalSvcEntry(u32 svcId)
 {
     KProcess *currentProcess = currentCoreContext->objectContext.currentProcess;
 
     // Since DBGEVENT_SYSCALL_ENTRY is non blocking, we'll cheat using EXCEVENT_UNDEFINED_SYSCALL (debug->svcId is fortunately an u16!)
     if(debugOfProcess(currentProcess) != NULL && svcId != 0xFF && shouldSignalSyscallDebugEvent(currentProcess, svcId))
         SignalDebugEvent(DBGEVENT_OUTPUT_STRING, 0xFFFFFFFE, svcId);
+
+    if((svcSignalingEnabled & 4) && svcId != 0xFF && idOfProcess(currentProcess) == svcProfilerPid)
+        return svcProfilerGetCycleCount() | 1;
+    else
+        return 0;
 }
 
-void signalSvcReturn(u32 svcId)
+void signalSvcReturn(u32 svcId, u32 profilerStartCycles)
 {
+    u32 endCycles = svcProfilerGetCycleCount();
     KProcess *currentProcess = currentCoreContext->objectContext.currentProcess;
     u32      flags = KPROCESS_GET_RVALUE(currentProcess, customFlags);
 
+    if(profilerStartCycles != 0 && (svcSignalingEnabled & 4) && idOfProcess(currentProcess) == svcProfilerPid)
+        SvcProfiler_Record((u8)svcId, endCycles - profilerStartCycles);
+
     // Since DBGEVENT_SYSCALL_RETURN is non blocking, we'll cheat using EXCEVENT_UNDEFINED_SYSCALL (debug->svcId is fortunately an u16!)
     if(debugOfProcess(currentProcess) != NULL && svcId != 0xFF && shouldSignalSyscallDebugEvent(currentProcess, svcId))
         SignalDebugEvent(DBGEVENT_OUTPUT_STRING, 0xFFFFFFFF, svcId);
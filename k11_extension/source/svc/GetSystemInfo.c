@@ -28,6 +28,8 @@
 #include "utils.h"
 #include "ipc.h"
 #include "synchronization.h"
+#include "svcProfiler.h"
+#include "ipcTrace.h"
 
 Result GetSystemInfoHook(s64 *out, s32 type, s32 param)
 {
@@ -117,6 +119,9 @@ Result GetSystemInfoHook(s64 *out, s32 type, s32 param)
                 case 0x10C:
                     *out = (s64)cfwInfo.bottomScreenFilter.invert;
                     break;
+                case 0x10D:
+                    *out = cfwInfo.screenshotFormat;
+                    break;
                 case 0x180:
                     *out = cfwInfo.pluginLoaderFlags;
                     break;
@@ -206,6 +211,18 @@ Result GetSystemInfoHook(s64 *out, s32 type, s32 param)
             break;
         }
 
+        case 0x10003: // SVC profiler
+        {
+            res = SvcProfiler_GetInfo(out, param);
+            break;
+        }
+
+        case 0x10004: // IPC trace
+        {
+            res = IpcTrace_GetInfo(out, param);
+            break;
+        }
+
         case 0x20000:
         {
             *out = 0;
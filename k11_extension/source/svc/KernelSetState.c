@@ -29,6 +29,8 @@
 #include "synchronization.h"
 #include "ipc.h"
 #include "debug.h"
+#include "svcProfiler.h"
+#include "ipcTrace.h"
 
 #define MAX_DEBUG 3
 
@@ -210,6 +212,16 @@ Result KernelSetStateHook(u32 type, u32 varg1, u32 varg2, u32 varg3)
             }
             break;
         }
+        case 0x10008:
+        {
+            res = SvcProfiler_SetEnabled(varg1, (bool)varg2);
+            break;
+        }
+        case 0x10009:
+        {
+            res = IpcTrace_SetEnabled((bool)varg1, varg2);
+            break;
+        }
         case 0x10080:
         {
             disableThreadRedirection = varg1 != 0;
@@ -27,10 +27,22 @@
 
 #include "svc/SendSyncRequest.h"
 #include "ipc.h"
+#include "ipcTrace.h"
 
-static inline bool isNdmuWorkaround(const SessionInfo *info, u32 pid)
+static inline ServiceId lookupServiceId(KClientSession *clientSession)
 {
-    return info != NULL && strcmp(info->name, "ndm:u") == 0 && hasStartedRosalinaNetworkFuncsOnce && pid >= nbSection0Modules;
+    SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
+    return info != NULL ? (ServiceId)info->serviceId : SERVICE_ID_UNKNOWN;
+}
+
+static inline bool isNdmuWorkaround(ServiceId serviceId, u32 pid)
+{
+    return serviceId == SERVICE_ID_NDM_U && hasStartedRosalinaNetworkFuncsOnce && pid >= nbSection0Modules;
+}
+
+static inline bool isCfgService(ServiceId serviceId, bool allowCfgU, bool allowCfgS)
+{
+    return (allowCfgU && serviceId == SERVICE_ID_CFG_U) || (allowCfgS && serviceId == SERVICE_ID_CFG_S) || serviceId == SERVICE_ID_CFG_I;
 }
 
 Result SendSyncRequestHook(Handle handle)
@@ -47,14 +59,26 @@ Result SendSyncRequestHook(Handle handle)
      // not the exact same test but it should work
     bool isValidClientSession = clientSession != NULL && strcmp(classNameOfAutoObject(&clientSession->syncObject.autoObject), "KClientSession") == 0;
 
+    bool traced = isValidClientSession && IpcTrace_ShouldTrace(pid);
+    u32 traceCmdHeader = cmdbuf[0];
+    u64 traceStart = 0;
+    char traceServiceName[12] = { 0 };
+    if(traced)
+    {
+        SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
+        if(info != NULL)
+            memcpy(traceServiceName, info->name, 12);
+        traceStart = GetSystemTick();
+    }
+
     if(isValidClientSession)
     {
         switch (cmdbuf[0])
         {
             case 0x10042:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(isNdmuWorkaround(info, pid))
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isNdmuWorkaround(serviceId, pid))
                 {
                     cmdbuf[0] = 0x10040;
                     cmdbuf[1] = 0;
@@ -66,8 +90,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x10082:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && (strcmp(info->name, "cfg:u") == 0 || strcmp(info->name, "cfg:s") == 0 || strcmp(info->name, "cfg:i") == 0)) // GetConfigInfoBlk2
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isCfgService(serviceId, true, true)) // GetConfigInfoBlk2
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -75,8 +99,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x10800:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && strcmp(info->name, "err:f") == 0) // Throw
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(serviceId == SERVICE_ID_ERR_F) // Throw
                     skip = doErrfThrowHook(cmdbuf);
 
                 break;
@@ -84,8 +108,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x20000:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && (strcmp(info->name, "cfg:u") == 0 || strcmp(info->name, "cfg:s") == 0 || strcmp(info->name, "cfg:i") == 0)) // SecureInfoGetRegion
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isCfgService(serviceId, true, true)) // SecureInfoGetRegion
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -93,8 +117,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x20002:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(isNdmuWorkaround(info, pid))
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isNdmuWorkaround(serviceId, pid))
                 {
                     cmdbuf[0] = 0x20040;
                     cmdbuf[1] = 0;
@@ -106,8 +130,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x50100:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && (strcmp(info->name, "srv:") == 0 || (GET_VERSION_MINOR(kernelVersion) < 39 && strcmp(info->name, "srv:pm") == 0)))
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(serviceId == SERVICE_ID_SRV || (GET_VERSION_MINOR(kernelVersion) < 39 && serviceId == SERVICE_ID_SRV_PM))
                 {
                     char name[9] = { 0 };
                     memcpy(name, cmdbuf + 1, 8);
@@ -141,8 +165,8 @@ Result SendSyncRequestHook(Handle handle)
             {
                 if(!hasStartedRosalinaNetworkFuncsOnce)
                     break;
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                skip = isNdmuWorkaround(info, pid); // SuspendScheduler
+                ServiceId serviceId = lookupServiceId(clientSession);
+                skip = isNdmuWorkaround(serviceId, pid); // SuspendScheduler
                 if(skip)
                     cmdbuf[1] = 0;
                 break;
@@ -152,8 +176,8 @@ Result SendSyncRequestHook(Handle handle)
             {
                 if(!hasStartedRosalinaNetworkFuncsOnce)
                     break;
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(isNdmuWorkaround(info, pid)) // ResumeScheduler
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isNdmuWorkaround(serviceId, pid)) // ResumeScheduler
                 {
                     cmdbuf[0] = 0x90040;
                     cmdbuf[1] = 0;
@@ -164,9 +188,9 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x00C0080: // srv: publishToSubscriber
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
+                ServiceId serviceId = lookupServiceId(clientSession);
 
-                if (info != NULL && strcmp(info->name, "srv:") == 0 && cmdbuf[1] == 0x1002)
+                if (serviceId == SERVICE_ID_SRV && cmdbuf[1] == 0x1002)
                 {
                     // Wake up application thread
                     PLG__WakeAppThread();
@@ -179,9 +203,9 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x00D0080: // APT:ReceiveParameter
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
+                ServiceId serviceId = lookupServiceId(clientSession);
 
-                if (info != NULL && strncmp(info->name, "APT:", 4) == 0 && cmdbuf[1] == 0x300)
+                if (serviceId == SERVICE_ID_APT && cmdbuf[1] == 0x300)
                 {
                     res = SendSyncRequest(handle);
                     skip = true;
@@ -201,8 +225,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x4010082:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && (strcmp(info->name, "cfg:s") == 0 || strcmp(info->name, "cfg:i") == 0)) // GetConfigInfoBlk4
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isCfgService(serviceId, false, true)) // GetConfigInfoBlk4
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -210,8 +234,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x4020082:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && (strcmp(info->name, "cfg:s") == 0 || strcmp(info->name, "cfg:i") == 0)) // GetConfigInfoBlk8
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isCfgService(serviceId, false, true)) // GetConfigInfoBlk8
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -219,8 +243,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x8010082:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && (strcmp(info->name, "cfg:s") == 0 || strcmp(info->name, "cfg:i") == 0)) // GetConfigInfoBlk4
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isCfgService(serviceId, false, true)) // GetConfigInfoBlk4
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -228,8 +252,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x8020082:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession);
-                if(info != NULL && strcmp(info->name, "cfg:i") == 0) // GetConfigInfoBlk8
+                ServiceId serviceId = lookupServiceId(clientSession);
+                if(isCfgService(serviceId, false, false)) // GetConfigInfoBlk8
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -237,8 +261,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x4060000:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession); // SecureInfoGetRegion
-                if(info != NULL && (strcmp(info->name, "cfg:s") == 0 || strcmp(info->name, "cfg:i") == 0))
+                ServiceId serviceId = lookupServiceId(clientSession); // SecureInfoGetRegion
+                if(isCfgService(serviceId, false, true))
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -246,8 +270,8 @@ Result SendSyncRequestHook(Handle handle)
 
             case 0x8160000:
             {
-                SessionInfo *info = SessionInfo_Lookup(clientSession->parentSession); // SecureInfoGetRegion
-                if(info != NULL && strcmp(info->name, "cfg:i") == 0)
+                ServiceId serviceId = lookupServiceId(clientSession); // SecureInfoGetRegion
+                if(isCfgService(serviceId, false, false))
                     skip = doLangEmu(&res, cmdbuf);
 
                 break;
@@ -260,5 +284,8 @@ Result SendSyncRequestHook(Handle handle)
 
     res = skip ? res : SendSyncRequest(handle);
 
+    if(traced)
+        IpcTrace_Record(traceStart, (u32)(GetSystemTick() - traceStart), pid, traceCmdHeader, traceServiceName);
+
     return res;
 }
@@ -40,6 +40,7 @@ svcHandler:
     mov lr, #0              @ do stuff as if the "allow debug" flag is always set
     push {r0-r7, r12, lr}
     mov r10, #1
+    mov r11, #0             @ SVC profiler start timestamp, see signalSvcEntry
     strb r9, [sp, #0x58+3]  @ page end - 0xb8 + 3: svc being handled
     strb r10, [sp, #0x58+1] @ page end - 0xb8 + 1: "allow debug" flag
 
@@ -117,6 +118,7 @@ _call_svc_debugged:
     mov r0, r9
     cpsie i
     bl signalSvcEntry
+    mov r11, r0
     pop {r0-r3, r12, lr}
     blx r8
 
@@ -127,6 +129,7 @@ _call_svc_debugged:
 _signal_svc_end:
     push {r0-r3, r12, lr}
     mov r0, r9
+    mov r1, r11
     cpsie i
     bl signalSvcReturn
     cpsid i
@@ -0,0 +1,160 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <string.h>
+#include "svcProfiler.h"
+#include "globals.h"
+#include "synchronization.h"
+#include "utils.h"
+#include "svc/KernelSetState.h"
+
+u32 svcProfilerPid = 0xFFFFFFFF;
+
+// [coreId][svcId], allocated when the profiler is first enabled (only rosalina does that)
+static SvcProfilerEntry (*svcProfilerEntries)[0x100] = NULL;
+static KRecursiveLock svcProfilerLock = { NULL };
+
+KSchedulableInterruptEvent *enableCycleCounter(KBaseInterruptEvent *this UNUSED, u32 interruptID UNUSED)
+{
+    coreBarrier();
+
+    // Performance Monitor Control Register, see the ARM11 MPCore TRM (ddi0360f).
+    // Enable the counters and make CCNT count every cycle. Don't reset anything or touch the
+    // event selection, svcControlPerformanceCounter users may rely on them.
+    u32 PMNC;
+    __asm__ __volatile__("mrc p15, 0, %[val], c15, c12, 0" : [val] "=r" (PMNC));
+    PMNC = (PMNC & ~0x70E) | 1;
+    __asm__ __volatile__("mcr p15, 0, %[val], c15, c12, 0" :: [val] "r" (PMNC));
+
+    __dsb();
+    coreBarrier();
+
+    return NULL;
+}
+
+Result SvcProfiler_SetEnabled(u32 pid, bool enable)
+{
+    u32 size = getNumberOfCores() * sizeof(svcProfilerEntries[0]);
+
+    if(enable)
+    {
+        if(svcProfilerEntries == NULL)
+        {
+            svcProfilerEntries = kAlloc(fcramDescriptor, (size + 0xFFF) >> 12, 0, MEMOP_REGION_BASE);
+            if(svcProfilerEntries == NULL)
+                return 0xD86007F3;
+        }
+
+        executeFunctionOnCores(enableCycleCounter, 0xF, 0);
+    }
+
+    KRecursiveLock__Lock(criticalSectionLock);
+    KRecursiveLock__Lock(&svcProfilerLock);
+
+    if(enable)
+    {
+        svcSignalingEnabled &= ~4;
+        memset(svcProfilerEntries, 0, size);
+        svcProfilerPid = pid;
+        __dsb();
+        svcSignalingEnabled |= 4;
+    }
+    else
+    {
+        if(!(svcSignalingEnabled & 4) || svcProfilerPid != pid)
+        {
+            KRecursiveLock__Unlock(&svcProfilerLock);
+            KRecursiveLock__Unlock(criticalSectionLock);
+            return 0xE0E01BFD; // out of range (same as SetSyscallDebugEventMask)
+        }
+
+        svcSignalingEnabled &= ~4;
+        svcProfilerPid = 0xFFFFFFFF;
+    }
+
+    KRecursiveLock__Unlock(&svcProfilerLock);
+    KRecursiveLock__Unlock(criticalSectionLock);
+    return 0;
+}
+
+void SvcProfiler_Record(u8 svcId, u32 cycles)
+{
+    // Each core only ever touches its own entries, we just need to make sure we aren't preempted
+    u32 cpsr = __get_cpsr();
+    __disable_irq();
+
+    SvcProfilerEntry *entry = &svcProfilerEntries[getCurrentCoreID()][svcId];
+    entry->count++;
+    entry->totalCycles += cycles;
+    if(cycles > entry->maxCycles)
+        entry->maxCycles = cycles;
+    entry->histogram[svcProfilerBucketOf(cycles)]++;
+
+    __set_cpsr_cx(cpsr);
+}
+
+Result SvcProfiler_GetInfo(s64 *out, s32 param)
+{
+    // param: 0 = profiled PID (-1 if disabled), otherwise (field << 8) | svcId with
+    // field: 1 = call count, 2 = total cycles, 3 = max cycles, 4+i = histogram bucket i
+    u32 field = (u32)param >> 8;
+    u32 svcId = (u32)param & 0xFF;
+
+    if(param == 0)
+    {
+        *out = (svcSignalingEnabled & 4) ? (s64)svcProfilerPid : -1;
+        return 0;
+    }
+    else if(svcProfilerEntries == NULL || field == 0 || field >= 4 + SVC_PROFILER_NB_BUCKETS)
+    {
+        *out = 0;
+        return 0xF8C007F4;
+    }
+
+    u64 val = 0;
+    for(u32 coreId = 0; coreId < getNumberOfCores(); coreId++)
+    {
+        const SvcProfilerEntry *entry = &svcProfilerEntries[coreId][svcId];
+        switch(field)
+        {
+            case 1:
+                val += entry->count;
+                break;
+            case 2:
+                val += entry->totalCycles;
+                break;
+            case 3:
+                val = entry->maxCycles > val ? entry->maxCycles : val;
+                break;
+            default:
+                val += entry->histogram[field - 4];
+                break;
+        }
+    }
+
+    *out = (s64)val;
+    return 0;
+}
@@ -0,0 +1,23 @@
+// Rosalina's reader of the IPC trace rings, built against the rosalina test shims, see Makefile
+
+#define ipcTraceEnabled rosalinaIpcTraceEnabled
+#include "../../sysmodules/rosalina/source/ipc_trace.c"
+
+bool preTerminationRequested = false;
+
+void hostReaderAttach(const void *buffer)
+{
+    ipcTraceBuffer = (const IpcTraceHeader *)buffer;
+    memset(ipcTraceReadIndices, 0, sizeof(ipcTraceReadIndices));
+    ipcTraceNbEventsSent = ipcTraceNbEventsDropped = 0;
+}
+
+u32 hostReaderRead(void *out, u32 maxEvents)
+{
+    return IpcTrace_ReadEvents((IpcTraceEvent *)out, maxEvents);
+}
+
+u32 hostReaderNbDropped(void)
+{
+    return ipcTraceNbEventsDropped;
+}
@@ -0,0 +1,178 @@
+// Host test for the IPC trace rings: the kernel side (ipcTrace.c) records from one thread per
+// "core" while rosalina's reader (ipcTrace_reader.c) drains them concurrently, see Makefile.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "kernel.h"
+
+static KCoreContext hostCoreContext;
+#define currentCoreContext (&hostCoreContext)
+
+#include "../source/ipcTrace.c"
+
+#define NB_CORES            4
+
+__thread u32 hostCurrentCoreId;
+u32 hostNbCores = NB_CORES;
+u32 pidOffsetKProcess = 0;
+FcramDescriptor *fcramDescriptor = NULL;
+
+static u32 hostProcess[0x40];
+
+static void *hostAlloc(FcramDescriptor *fcramDesc, u32 nbPages, u32 alignment, u32 region)
+{
+    (void)fcramDesc; (void)alignment; (void)region;
+    void *p = mmap(NULL, nbPages << 12, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static void hostFlushDataCacheRange(void *addr, u32 len) { (void)addr; (void)len; }
+
+void* (*kAlloc)(FcramDescriptor *fcramDesc, u32 nbPages, u32 alignment, u32 region) = hostAlloc;
+void (*flushDataCacheRange)(void *addr, u32 len) = hostFlushDataCacheRange;
+
+u32 convertVAToPA(const void *addr, bool writeCheck)
+{
+    (void)writeCheck;
+    return (u32)(uintptr_t)addr;
+}
+
+void hostReaderAttach(const void *buffer);
+u32 hostReaderRead(void *out, u32 maxEvents);
+u32 hostReaderNbDropped(void);
+
+#include "test_common.h"
+
+// Every field is derived from (core, seq) so that torn events can be detected
+static void makeEvent(u32 coreId, u32 seq, u64 *timestamp, u32 *latency, u32 *cmdHeader, char *name)
+{
+    *timestamp = ((u64)coreId << 48) | seq;
+    *latency = seq * 2654435761u;
+    *cmdHeader = ~seq;
+    snprintf(name, 12, "s%u:%07x", coreId, seq & 0xFFFFFFF);
+}
+
+static volatile u32 nbWritersDone;
+static u32 nbEventsPerCore, writerDelay;
+
+static void *writerThread(void *arg)
+{
+    hostCurrentCoreId = (u32)(uintptr_t)arg;
+
+    for(u32 seq = 0; seq < nbEventsPerCore; seq++)
+    {
+        u64 timestamp;
+        u32 latency, cmdHeader;
+        char name[12];
+
+        makeEvent(hostCurrentCoreId, seq, &timestamp, &latency, &cmdHeader, name);
+        if(IpcTrace_ShouldTrace(hostCurrentCoreId + 0x100))
+            IpcTrace_Record(timestamp, latency, hostCurrentCoreId + 0x100, cmdHeader, name);
+
+        for(volatile u32 i = 0; i < writerDelay; i++);
+    }
+
+    __sync_fetch_and_add(&nbWritersDone, 1);
+    return NULL;
+}
+
+static void testSetup(void)
+{
+    s64 out;
+
+    hostProcess[0] = 0x28; // PID of the process enabling the trace
+    hostCoreContext.objectContext.currentProcess = (KProcess *)hostProcess;
+
+    CHECK(!IpcTrace_ShouldTrace(0x100));
+    CHECK(IpcTrace_SetEnabled(true, 0xFFFFFFFF) == 0);
+    CHECK(IpcTrace_GetInfo(&out, 2) == 0 && out == 1);
+    CHECK(IpcTrace_GetInfo(&out, 1) == 0 && out == 0x1000 * ((sizeof(IpcTraceHeader) + NB_CORES * IPC_TRACE_NB_EVENTS_PER_CORE * sizeof(IpcTraceEvent) + 0xFFF) >> 12));
+    CHECK(IpcTrace_GetInfo(&out, 3) != 0);
+
+    CHECK(ipcTraceBuffer->magic == IPC_TRACE_MAGIC && ipcTraceBuffer->nbCores == NB_CORES);
+    CHECK(IpcTrace_ShouldTrace(0x100) && !IpcTrace_ShouldTrace(0x28)); // owner is never traced
+
+    CHECK(IpcTrace_SetEnabled(true, 0x101) == 0);
+    CHECK(!IpcTrace_ShouldTrace(0x100) && IpcTrace_ShouldTrace(0x101));
+
+    CHECK(IpcTrace_SetEnabled(false, 0) == 0);
+    CHECK(!IpcTrace_ShouldTrace(0x101));
+}
+
+// Fast writers overrun the reader all the time (lots of dropped and overwritten-while-copied events),
+// slow ones mostly don't
+static void testConcurrentDrain(u32 nbEvents, u32 delay)
+{
+    static IpcTraceEvent batch[64];
+    u32 nextSeq[NB_CORES] = {0}, nbReceived[NB_CORES] = {0};
+    u64 total = 0;
+
+    nbEventsPerCore = nbEvents;
+    writerDelay = delay;
+    nbWritersDone = 0;
+
+    CHECK(IpcTrace_SetEnabled(true, 0xFFFFFFFF) == 0);
+    hostReaderAttach(ipcTraceBuffer);
+
+    pthread_t threads[NB_CORES];
+    for(u32 i = 0; i < NB_CORES; i++)
+        pthread_create(&threads[i], NULL, writerThread, (void *)(uintptr_t)i);
+
+    for(;;)
+    {
+        bool done = nbWritersDone == NB_CORES;
+        u32 n = hostReaderRead(batch, 64);
+
+        for(u32 i = 0; i < n; i++)
+        {
+            u32 coreId = (u32)(batch[i].timestamp >> 48), seq = (u32)batch[i].timestamp;
+            u64 timestamp;
+            u32 latency, cmdHeader;
+            char name[12];
+
+            if(coreId >= NB_CORES)
+            {
+                CHECK(coreId < NB_CORES);
+                continue;
+            }
+
+            makeEvent(coreId, seq, &timestamp, &latency, &cmdHeader, name);
+            if(batch[i].latency != latency || batch[i].cmdHeader != cmdHeader || batch[i].pid != coreId + 0x100 || memcmp(batch[i].serviceName, name, 12) != 0)
+            {
+                if(nbFailures++ < 10)
+                    printf("torn event: core %u seq %u\n", coreId, seq);
+            }
+
+            // Events of a core come out in order, gaps are only allowed for dropped events
+            CHECK(seq >= nextSeq[coreId]);
+            nextSeq[coreId] = seq + 1;
+            nbReceived[coreId]++;
+        }
+
+        total += n;
+        if(n == 0 && done)
+            break;
+    }
+
+    for(u32 i = 0; i < NB_CORES; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK(total + hostReaderNbDropped() == (u64)NB_CORES * nbEventsPerCore);
+    for(u32 i = 0; i < NB_CORES; i++)
+        CHECK(nbReceived[i] != 0 && nextSeq[i] == nbEventsPerCore);
+
+    printf("ipcTrace_test: writer delay %u: %llu events received, %u dropped\n", delay, (unsigned long long)total, hostReaderNbDropped());
+}
+
+int main(void)
+{
+    testSetup();
+    testConcurrentDrain(500000, 0);
+    testConcurrentDrain(50000, 10000);
+
+    printf("ipcTrace_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// Host microbenchmark of SessionInfo_Lookup against the sorted array + binary search it replaced.
+// Only the table walk is measured: the two KRecursiveLock round trips the old lookup also paid are
+// not modelled here, so the real gain on the console is larger than what this prints.
+
+#include <time.h>
+#include "ipc_fixture.h"
+
+#define NB_LOOKUPS 20000000
+
+static KSession *sortedSessions[MAX_SESSION];
+static u32 nbSortedSessions;
+
+static int compareSessions(const void *a, const void *b)
+{
+    KSession *x = *(KSession *const *)a, *y = *(KSession *const *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Previous SessionInfo_FindClosestSlot
+static u32 baselineFindClosestSlot(KSession *session)
+{
+    if(nbSortedSessions == 0 || session <= sortedSessions[0])
+        return 0;
+    else if(session > sortedSessions[nbSortedSessions - 1])
+        return nbSortedSessions;
+
+    u32 a = 0, b = nbSortedSessions - 1, m;
+
+    do
+    {
+        m = (a + b) / 2;
+        if(sortedSessions[m] < session)
+            a = m;
+        else if(sortedSessions[m] > session)
+            b = m;
+        else
+            return m;
+    }
+    while(b - a > 1);
+
+    return b;
+}
+
+static KSession *baselineLookup(KSession *session)
+{
+    u32 id = baselineFindClosestSlot(session);
+    return id != nbSortedSessions && sortedSessions[id] == session ? sortedSessions[id] : NULL;
+}
+
+static double nsPerLookup(struct timespec *t0, struct timespec *t1)
+{
+    return ((t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec)) / NB_LOOKUPS;
+}
+
+static void bench(u32 nbSessions, u32 hitPercent)
+{
+    static KSession *queries[1 << 16];
+    struct timespec t0, t1;
+    u32 nbHits = 0;
+
+    for(u32 i = 0; i < NB_FAKE_SESSIONS; i++)
+        if(SessionInfo_Lookup(&fakeSessions[i]) != NULL)
+            destroyFakeSession(&fakeSessions[i]);
+
+    // Random subset of the slab, like a system that has been running for a while
+    nbSortedSessions = 0;
+    while(nbSortedSessions < nbSessions)
+    {
+        KSession *session = &fakeSessions[rand() % NB_FAKE_SESSIONS];
+        if(SessionInfo_Lookup(session) == NULL)
+        {
+            SessionInfo_Add(session, "fs:USER");
+            sortedSessions[nbSortedSessions++] = session;
+        }
+    }
+    qsort(sortedSessions, nbSortedSessions, sizeof(KSession *), compareSessions);
+
+    for(u32 i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+        queries[i] = (u32)rand() % 100 < hitPercent ? sortedSessions[rand() % nbSortedSessions] : &fakeSessions[rand() % NB_FAKE_SESSIONS];
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(u32 i = 0; i < NB_LOOKUPS; i++)
+        nbHits += baselineLookup(queries[i & 0xFFFF]) != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double baselineNs = nsPerLookup(&t0, &t1);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(u32 i = 0; i < NB_LOOKUPS; i++)
+        nbHits -= SessionInfo_Lookup(queries[i & 0xFFFF]) != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double hashNs = nsPerLookup(&t0, &t1);
+
+    if(nbHits != 0)
+    {
+        printf("ipc_bench: lookup results differ\n");
+        exit(1);
+    }
+
+    printf("%3lu sessions, %3lu%% hits: binary search %6.2f ns, hash table %6.2f ns\n",
+           (unsigned long)nbSessions, (unsigned long)hitPercent, baselineNs, hashNs);
+}
+
+int main(void)
+{
+    static const u32 sizes[] = { 50, 150, MAX_SESSION };
+
+    createFakeSessions();
+    srand(1);
+
+    for(u32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        bench(sizes[i], 100);
+        bench(sizes[i], 10);
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Fake kernel sessions for the host builds of ipc.c, see Makefile
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "../source/ipc.c"
+
+#define NB_FAKE_SESSIONS 4096
+
+KRecursiveLock *criticalSectionLock = NULL;
+
+static void hostLock(KRecursiveLock *this) { (void)this; }
+static void hostAddReference(KAutoObject *this) { (void)this; }
+static KAutoObject *hostDecrementReferenceCount(KAutoObject *this) { return this; }
+static void hostSessionDtor(KAutoObject *this) { (void)this; }
+
+void (*KRecursiveLock__Lock)(KRecursiveLock *this) = hostLock;
+void (*KRecursiveLock__Unlock)(KRecursiveLock *this) = hostLock;
+void (*KAutoObject__AddReference)(KAutoObject *this) = hostAddReference;
+
+static Vtable__KAutoObject hostSessionVtable = {
+    .dtor = hostSessionDtor,
+    .DecrementReferenceCount = hostDecrementReferenceCount,
+};
+
+// Laid out like the kernel's slab heap
+static KSession *fakeSessions;
+
+static void createFakeSessions(void)
+{
+    fakeSessions = mmap(NULL, NB_FAKE_SESSIONS * sizeof(KSession), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if(fakeSessions == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(1);
+    }
+
+    for(u32 i = 0; i < NB_FAKE_SESSIONS; i++)
+        fakeSessions[i].autoObject.vtable = &hostSessionVtable;
+}
+
+// What SessionInfo_Remove is called from, once the vtable has been swapped by SessionInfo_Add
+static void destroyFakeSession(KSession *session)
+{
+    session->autoObject.vtable->dtor(&session->autoObject);
+    session->autoObject.vtable = &hostSessionVtable;
+}
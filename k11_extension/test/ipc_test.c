@@ -0,0 +1,105 @@
+// Host test of the session info table (ipc.c): random session churn checked against a reference
+
+#include "ipc_fixture.h"
+
+#include "test_common.h"
+
+static const char *const serviceNames[] = { "srv:", "srv:pm", "cfg:u", "cfg:s", "cfg:i", "err:f", "ndm:u", "APT:U", "APT:A", "fs:USER", "hid:USER", "gsp::Gpu" };
+#define NB_SERVICE_NAMES (sizeof(serviceNames) / sizeof(serviceNames[0]))
+
+static void testInternName(void)
+{
+    CHECK(SessionInfo_InternName("srv:") == SERVICE_ID_SRV);
+    CHECK(SessionInfo_InternName("srv:pm") == SERVICE_ID_SRV_PM);
+    CHECK(SessionInfo_InternName("srv:p") == SERVICE_ID_UNKNOWN);
+    CHECK(SessionInfo_InternName("cfg:u") == SERVICE_ID_CFG_U);
+    CHECK(SessionInfo_InternName("cfg:nor") == SERVICE_ID_UNKNOWN);
+    CHECK(SessionInfo_InternName("err:f") == SERVICE_ID_ERR_F);
+    CHECK(SessionInfo_InternName("ndm:u") == SERVICE_ID_NDM_U);
+    CHECK(SessionInfo_InternName("APT:S") == SERVICE_ID_APT);
+    CHECK(SessionInfo_InternName("fs:USER") == SERVICE_ID_UNKNOWN);
+}
+
+static void testChurn(void)
+{
+    static int nameOf[NB_FAKE_SESSIONS]; // -1: not registered
+    u32 nbRegistered = 0;
+
+    for(u32 i = 0; i < NB_FAKE_SESSIONS; i++)
+        nameOf[i] = -1;
+
+    srand(3);
+    for(u32 step = 0; step < 2000000; step++)
+    {
+        // Sessions are handed out close to each other, like the kernel's slab heap does
+        u32 i = rand() % (rand() % 4 == 0 ? NB_FAKE_SESSIONS : 512);
+        KSession *session = &fakeSessions[i];
+
+        switch(rand() % 4)
+        {
+            case 0:
+            {
+                int name = rand() % NB_SERVICE_NAMES;
+                SessionInfo_Add(session, serviceNames[name]);
+                if(nameOf[i] == -1 && nbRegistered < MAX_SESSION)
+                {
+                    nameOf[i] = name;
+                    nbRegistered++;
+                }
+                break;
+            }
+            case 1:
+                if(nameOf[i] != -1)
+                {
+                    destroyFakeSession(session);
+                    nameOf[i] = -1;
+                    nbRegistered--;
+                }
+                break;
+            default:
+            {
+                SessionInfo *info = SessionInfo_Lookup(session);
+                if(nameOf[i] == -1)
+                    CHECK(info == NULL);
+                else if(info == NULL)
+                    CHECK(info != NULL);
+                else
+                {
+                    CHECK(info->session == session);
+                    CHECK(strncmp(info->name, serviceNames[nameOf[i]], 12) == 0);
+                    CHECK(info->serviceId == SessionInfo_InternName(serviceNames[nameOf[i]]));
+                }
+                break;
+            }
+        }
+
+        if(nbFailures > 10)
+            return;
+    }
+
+    CHECK(nbActiveSessions == nbRegistered);
+
+    // FindFirst returns a live session with that exact name, or NULL
+    for(u32 n = 0; n < NB_SERVICE_NAMES; n++)
+    {
+        bool expected = false;
+        for(u32 i = 0; i < NB_FAKE_SESSIONS; i++)
+            expected = expected || nameOf[i] == (int)n;
+
+        SessionInfo *info = SessionInfo_FindFirst(serviceNames[n]);
+        CHECK((info != NULL) == expected);
+        if(info != NULL)
+            CHECK(strncmp(info->name, serviceNames[n], 12) == 0 && nameOf[info->session - fakeSessions] == (int)n);
+    }
+}
+
+int main(void)
+{
+    createFakeSessions();
+
+    testInternName();
+    testChurn();
+
+    printf("ipc_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+// Host stand-in for include/globals.h, see test/Makefile
+#pragma once
+
+#include "kernel.h"
+
+extern KRecursiveLock *criticalSectionLock;
+extern void (*KRecursiveLock__Lock)(KRecursiveLock *this);
+extern void (*KRecursiveLock__Unlock)(KRecursiveLock *this);
+extern FcramDescriptor *fcramDescriptor;
+extern void (*coreBarrier)(void);
+extern void* (*kAlloc)(FcramDescriptor *fcramDesc, u32 nbPages, u32 alignment, u32 region);
+extern void (*flushDataCacheRange)(void *addr, u32 len);
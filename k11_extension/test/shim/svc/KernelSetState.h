@@ -0,0 +1,6 @@
+// Host stand-in for include/svc/KernelSetState.h, see test/Makefile
+#pragma once
+
+#include "types.h"
+
+extern u8 svcSignalingEnabled;
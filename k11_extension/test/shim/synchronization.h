@@ -0,0 +1,15 @@
+// Host stand-in for include/synchronization.h, see test/Makefile
+#pragma once
+
+#include "kernel.h"
+
+typedef KSchedulableInterruptEvent* (*SGI0Handler_t)(KBaseInterruptEvent *this, u32 interruptID);
+
+void executeFunctionOnCores(SGI0Handler_t func, u8 targetList, u8 targetListFilter);
+
+static inline void __dsb(void) { __sync_synchronize(); }
+static inline void __dmb(void) { __sync_synchronize(); }
+static inline u32 __get_cpsr(void) { return 0; }
+static inline void __set_cpsr_cx(u32 cpsr) { (void)cpsr; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
@@ -0,0 +1,15 @@
+// Host stand-in for include/utils.h, see test/Makefile
+#pragma once
+
+#include "kernel.h"
+
+extern u32 hostNbCores;
+extern __thread u32 hostCurrentCoreId;
+
+static inline u32 getNumberOfCores(void) { return hostNbCores; }
+static inline u32 getCurrentCoreID(void) { return hostCurrentCoreId; }
+
+// Tests hand out buffers from the low 4 GiB (see hostAlloc), so that "physical addresses" fit in a u32
+#define PA_PTR(addr)            ((void *)(uintptr_t)(u32)(addr))
+
+u32 convertVAToPA(const void *addr, bool writeCheck);
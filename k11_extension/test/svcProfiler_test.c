@@ -0,0 +1,125 @@
+// Host test for the SVC profiler aggregation and histogram code, see Makefile.
+// svcProfiler.c is built as-is against the stand-ins in shim/.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Drop the CP15 accesses, they are only used by enableCycleCounter and svcProfilerGetCycleCount
+#define __asm__
+#define __volatile__(...)
+
+#include "../source/svcProfiler.c"
+
+u32 hostNbCores = 4;
+__thread u32 hostCurrentCoreId = 0;
+u8 svcSignalingEnabled = 0;
+KRecursiveLock *criticalSectionLock = NULL;
+FcramDescriptor *fcramDescriptor = NULL;
+
+static void hostLock(KRecursiveLock *this) { (void)this; }
+static void hostCoreBarrier(void) {}
+static void *hostAlloc(FcramDescriptor *fcramDesc, u32 nbPages, u32 alignment, u32 region)
+{
+    (void)fcramDesc; (void)alignment; (void)region;
+    return malloc(nbPages << 12);
+}
+
+void (*KRecursiveLock__Lock)(KRecursiveLock *this) = hostLock;
+void (*KRecursiveLock__Unlock)(KRecursiveLock *this) = hostLock;
+void (*coreBarrier)(void) = hostCoreBarrier;
+void* (*kAlloc)(FcramDescriptor *fcramDesc, u32 nbPages, u32 alignment, u32 region) = hostAlloc;
+
+void executeFunctionOnCores(SGI0Handler_t func, u8 targetList, u8 targetListFilter)
+{
+    (void)func; (void)targetList; (void)targetListFilter;
+}
+
+#include "test_common.h"
+
+static s64 getInfo(u32 field, u32 svcId)
+{
+    s64 out;
+    CHECK(SvcProfiler_GetInfo(&out, (s32)((field << 8) | svcId)) == 0);
+    return out;
+}
+
+// Reference for svcProfilerBucketOf: [0, 256) then one bucket per factor of 4, last one open-ended
+static u32 referenceBucketOf(u32 cycles)
+{
+    u32 bucket = 0;
+    for(u64 limit = 256; bucket < SVC_PROFILER_NB_BUCKETS - 1 && cycles >= limit; limit <<= 2)
+        bucket++;
+    return bucket;
+}
+
+static void testBuckets(void)
+{
+    static const u32 edges[] = { 0, 1, 255, 256, 1023, 1024, 4095, 4096, 0x3FFFF, 0x40000, 0xFFFFF, 0x100000, 0x3FFFFF, 0x400000, 0xFFFFFFFF };
+
+    for(u32 i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+        CHECK(svcProfilerBucketOf(edges[i]) == referenceBucketOf(edges[i]));
+
+    srand(1);
+    for(u32 i = 0; i < 1000000; i++)
+    {
+        u32 cycles = ((u32)rand() << 16 ^ (u32)rand()) >> (rand() % 32);
+        CHECK(svcProfilerBucketOf(cycles) == referenceBucketOf(cycles));
+    }
+}
+
+static void testAggregation(void)
+{
+    static u64 count[0x100], total[0x100], histogram[0x100][SVC_PROFILER_NB_BUCKETS];
+    static u32 maxCycles[0x100];
+
+    s64 out;
+    CHECK(SvcProfiler_GetInfo(&out, 0) == 0 && out == -1);
+    CHECK(SvcProfiler_GetInfo(&out, (1 << 8) | 0x32) != 0); // not allocated yet
+
+    CHECK(SvcProfiler_SetEnabled(0x30, true) == 0);
+    CHECK(SvcProfiler_GetInfo(&out, 0) == 0 && out == 0x30);
+    CHECK(SvcProfiler_SetEnabled(0x31, false) != 0); // not the profiled process
+
+    srand(2);
+    for(u32 i = 0; i < 200000; i++)
+    {
+        u8 svcId = rand() % 8 == 0 ? 0x32 : rand() & 0xFF;
+        u32 cycles = ((u32)rand() << 16 ^ (u32)rand()) >> (rand() % 32);
+
+        hostCurrentCoreId = rand() % hostNbCores;
+        SvcProfiler_Record(svcId, cycles);
+
+        count[svcId]++;
+        total[svcId] += cycles;
+        maxCycles[svcId] = cycles > maxCycles[svcId] ? cycles : maxCycles[svcId];
+        histogram[svcId][referenceBucketOf(cycles)]++;
+    }
+
+    for(u32 svcId = 0; svcId < 0x100; svcId++)
+    {
+        CHECK((u64)getInfo(1, svcId) == count[svcId]);
+        CHECK((u64)getInfo(2, svcId) == total[svcId]);
+        CHECK((u64)getInfo(3, svcId) == maxCycles[svcId]);
+        for(u32 i = 0; i < SVC_PROFILER_NB_BUCKETS; i++)
+            CHECK((u64)getInfo(4 + i, svcId) == histogram[svcId][i]);
+    }
+
+    CHECK(SvcProfiler_GetInfo(&out, 0x32) != 0); // field 0 only exists as param 0
+    CHECK(SvcProfiler_GetInfo(&out, ((4 + SVC_PROFILER_NB_BUCKETS) << 8) | 0x32) != 0);
+
+    // Re-enabling clears everything
+    CHECK(SvcProfiler_SetEnabled(0x30, false) == 0);
+    CHECK(SvcProfiler_GetInfo(&out, 0) == 0 && out == -1);
+    CHECK(SvcProfiler_SetEnabled(0x40, true) == 0);
+    CHECK(getInfo(1, 0x32) == 0 && getInfo(2, 0x32) == 0 && getInfo(3, 0x32) == 0);
+}
+
+int main(void)
+{
+    testBuckets();
+    testAggregation();
+
+    printf("svcProfiler_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+// What the host tests share: CHECK, which reports and counts failed conditions.
+
+#pragma once
+
+#include <stdio.h>
+#include "types.h"
+
+static u32 nbFailures = 0;
+
+#define CHECK(cond) do { if(!(cond)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); nbFailures++; } } while(0)
@@ -32,9 +32,10 @@
 
 #define Log_PrintP(...) ((void)0)
 
-#define MAXRELOCS 512
-static _3DSX_Reloc s_relocBuf[MAXRELOCS];
+#define MAXRELOCS 0x1000
+static _3DSX_Reloc s_relocBuf[MAXRELOCS]; // Also holds the first page of the file while parsing the headers
 u32 ldrArgvBuf[ARGVBUF_SIZE/4];
+Ldr_3dsxLoadStats ldr3dsxLoadStats;
 
 #define SEC_ASSERT(x) do { if (!(x)) { Log_PrintP("Assertion failed: %s", #x); return false; } } while (0)
 
@@ -45,6 +46,14 @@ typedef struct
     u32 segSizes[3];
 } _3DSX_LoadInfo;
 
+static u32 Read3dsx(IFile *file, void *buffer, u32 size, u32 offset)
+{
+    u32 total = IFile_Read2(file, buffer, size, offset);
+    ldr3dsxLoadStats.readCalls++;
+    ldr3dsxLoadStats.bytesRead += total;
+    return total;
+}
+
 static inline u32 TranslateAddr(u32 off, _3DSX_LoadInfo* d, u32* offsets)
 {
     if (off < offsets[0])
@@ -58,7 +67,7 @@ bool Ldr_Get3dsxSize(u32* pSize, IFile *file)
 {
     _3DSX_Header hdr;
 
-    if (IFile_Read2(file, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+    if (Read3dsx(file, &hdr, sizeof(hdr), 0) != sizeof(hdr))
     {
         Log_PrintP("Cannot read 3DSX header");
         return false;
@@ -89,110 +98,220 @@ static inline u32 min(u32 a, u32 b)
     return a < b ? a : b;
 }
 
-Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile *file, u64 tid)
+// Prelinked image cache: the relocated segments of a 3DSX are stored on the SD card,
+// so that relaunching it only costs a couple of reads and no relocation pass.
+#define CACHE_DIR       "/luma/3dsx_cache"
+#define CACHE_MAGIC     0x43584433 // '3DXC'
+#define CACHE_VERSION   2
+
+typedef struct
 {
-    u32 i,j,k,m;
-    Result res;
+    u32 magic;
+    u32 version;
+    u32 baseAddr;
+    u32 imageSize;      // Size of the image following this header, starting at the code segment
+    u32 reserved[2];
+    u64 fileSize;
+    u64 timestamp;
     _3DSX_Header hdr;
-    IFile_Read2(file, &hdr, sizeof(hdr), 0);
+    u16 path[PATH_MAX+1];
+} _3DSX_CacheHeader;
 
-    _3DSX_LoadInfo d;
-    d.segSizes[0] = (hdr.codeSegSize+0xFFF) &~ 0xFFF;
-    d.segSizes[1] = (hdr.rodataSegSize+0xFFF) &~ 0xFFF;
-    d.segSizes[2] = (hdr.dataSegSize+0xFFF) &~ 0xFFF;
-    d.segPtrs[0] = codePages;
-    d.segPtrs[1] = (char*)d.segPtrs[0] + d.segSizes[0];
-    d.segPtrs[2] = (char*)d.segPtrs[1] + d.segSizes[1];
-    d.segAddrs[0] = baseAddr;
-    d.segAddrs[1] = d.segAddrs[0] + d.segSizes[0];
-    d.segAddrs[2] = d.segAddrs[1] + d.segSizes[1];
+static _3DSX_CacheHeader s_cacheHdr;
 
-    u32 offsets[2] = { d.segSizes[0], d.segSizes[0] + d.segSizes[1] };
-    u32* segLimit = d.segPtrs[2] + d.segSizes[2];
+bool Ldr_Get3dsxCacheKey(Ldr_3dsxCacheKey* key, const u16* path, IFile *file)
+{
+    u32 len;
+    FS_Archive archive;
 
-    u32 readOffset = hdr.headerSize;
+    memset(key, 0, sizeof(*key));
+    for (len = 0; len < PATH_MAX && path[len] != 0; len ++)
+        key->path[len] = path[len];
 
-    u32 nRelocTables = hdr.relocHdrSize/4;
-    SEC_ASSERT((3*4*nRelocTables) <= 0x1000);
-    u32* extraPage = (u32*)((char*)d.segPtrs[2] + d.segSizes[2]);
-    u32 extraPageAddr = d.segAddrs[2] + d.segSizes[2];
+    if (len == 0 || R_FAILED(IFile_GetSize(file, &key->fileSize)))
+        return false;
 
-    // Read the relocation headers
-    for (i = 0; i < 3; i ++)
-    {
-        if (IFile_Read2(file, &extraPage[i*nRelocTables], hdr.relocHdrSize, readOffset) != hdr.relocHdrSize)
-        {
-            Log_PrintP("Cannot read relheader %d", i);
-            return 0;
-        }
-        readOffset += hdr.relocHdrSize;
-    }
+    if (R_FAILED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return false;
+
+    Result res = FSUSER_ControlArchive(archive, ARCHIVE_ACTION_GET_TIMESTAMP, key->path, 2*(len+1), &key->timestamp, sizeof(key->timestamp));
+    FSUSER_CloseArchive(archive);
+
+    return R_SUCCEEDED(res) && key->timestamp != 0;
+}
+
+static void Get3dsxCachePath(char* out, const Ldr_3dsxCacheKey* key)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    u32 i, hash = 2166136261u; // FNV-1a
+
+    for (i = 0; key->path[i] != 0; i ++)
+        hash = (hash ^ key->path[i]) * 16777619u;
 
-    // Read the code segment
-    if (IFile_Read2(file, d.segPtrs[0], hdr.codeSegSize, readOffset) != hdr.codeSegSize)
+    memcpy(out, CACHE_DIR "/", sizeof(CACHE_DIR));
+    out += sizeof(CACHE_DIR);
+    for (i = 0; i < 8; i ++)
+        *out++ = hexDigits[(hash >> (28 - 4*i)) & 0xF];
+    memcpy(out, ".bin", 5);
+}
+
+static bool Load3dsxCache(const Ldr_3dsxCacheKey* key, const _3DSX_Header* hdr, u32 baseAddr, u32* codePages, u32 maxImageSize)
+{
+    IFile file;
+    char path[sizeof(CACHE_DIR "/00000000.bin")];
+    _3DSX_CacheHeader* ch = &s_cacheHdr;
+    bool ok = false;
+
+    Get3dsxCachePath(path, key);
+    if (R_FAILED(IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ)))
+        return false;
+
+    if (Read3dsx(&file, ch, sizeof(*ch), 0) != sizeof(*ch) ||
+        ch->magic != CACHE_MAGIC || ch->version != CACHE_VERSION || ch->baseAddr != baseAddr ||
+        ch->fileSize != key->fileSize || ch->timestamp != key->timestamp || ch->imageSize > maxImageSize ||
+        memcmp(&ch->hdr, hdr, sizeof(*hdr)) != 0 || memcmp(ch->path, key->path, sizeof(key->path)) != 0)
     {
-        Log_PrintP("Cannot read code segment");
-        return 0;
+        IFile_Close(&file);
+        return false;
     }
-    readOffset += hdr.codeSegSize;
 
-    // Read the rodata segment
-    if (IFile_Read2(file, d.segPtrs[1], hdr.rodataSegSize, readOffset) != hdr.rodataSegSize)
+    ok = Read3dsx(&file, codePages, ch->imageSize, sizeof(*ch)) == ch->imageSize;
+    IFile_Close(&file);
+
+    // Relocations may have reached into the BSS, which the regular path doesn't clear
+    if (!ok)
+        memset(codePages, 0, ch->imageSize);
+
+    return ok;
+}
+
+static void Save3dsxCache(const Ldr_3dsxCacheKey* key, const _3DSX_Header* hdr, u32 baseAddr, const u32* codePages, u32 imageSize)
+{
+    IFile file;
+    u64 total;
+    FS_Archive archive;
+    char path[sizeof(CACHE_DIR "/00000000.bin")];
+    _3DSX_CacheHeader* ch = &s_cacheHdr;
+
+    if (R_FAILED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+        return;
+
+    // These fail if the directories already exist, which is fine
+    FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, "/luma"), 0);
+    FSUSER_CreateDirectory(archive, fsMakePath(PATH_ASCII, CACHE_DIR), 0);
+
+    Get3dsxCachePath(path, key);
+    Result res = IFile_OpenFromArchive(&file, archive, fsMakePath(PATH_ASCII, path), FS_OPEN_CREATE | FS_OPEN_WRITE);
+    FSUSER_CloseArchive(archive);
+    if (R_FAILED(res))
+        return;
+
+    memset(ch, 0, sizeof(*ch));
+    ch->magic = CACHE_MAGIC;
+    ch->version = CACHE_VERSION;
+    ch->baseAddr = baseAddr;
+    ch->imageSize = imageSize;
+    ch->fileSize = key->fileSize;
+    ch->timestamp = key->timestamp;
+    ch->hdr = *hdr;
+    memcpy(ch->path, key->path, sizeof(key->path));
+
+    // Drop any previous contents first, and write the header last, so that an interrupted
+    // write never leaves a header in place that describes a partial image
+    if (R_SUCCEEDED(IFile_SetSize(&file, 0)) &&
+        R_SUCCEEDED(IFile_SetSize(&file, sizeof(*ch) + imageSize)))
     {
-        Log_PrintP("Cannot read rodata segment");
-        return 0;
+        file.pos = sizeof(*ch);
+        if (R_SUCCEEDED(IFile_Write(&file, &total, codePages, imageSize, 0)) && total == imageSize)
+        {
+            file.pos = 0;
+            IFile_Write(&file, &total, ch, sizeof(*ch), FS_WRITE_FLUSH);
+        }
     }
-    readOffset += hdr.rodataSegSize;
 
-    // Read the data segment
-    u32 dataLoadSegSize = hdr.dataSegSize - hdr.bssSize;
-    if (IFile_Read2(file, d.segPtrs[2], dataLoadSegSize, readOffset) != dataLoadSegSize)
+    IFile_Close(&file);
+}
+
+// Reads and relocates the segments, the relocation headers having already been copied to the extra page.
+// On success, *pImageSize receives the size of the part of the image that was written
+// (code, rodata and the loaded/relocated part of data).
+static bool Load3dsxSegments(IFile *file, const _3DSX_Header* hdr, _3DSX_LoadInfo* d, u32* codePages, u32* extraPage, u32* pImageSize)
+{
+    u32 i,j,k,m;
+    u32* segLimit = (u32*)((char*)d->segPtrs[2] + d->segSizes[2]);
+    u32 offsets[2] = { d->segSizes[0], d->segSizes[0] + d->segSizes[1] };
+
+    u32 readOffset = hdr->headerSize + 3*hdr->relocHdrSize;
+
+    u32 nRelocTables = hdr->relocHdrSize/4;
+
+    // Read the code, rodata and data segments in one go: they are contiguous in the file,
+    // so stream them to the start of the image and move rodata and data to their pages
+    u32 dataLoadSegSize = hdr->dataSegSize - hdr->bssSize;
+    u32 streamSize = hdr->codeSegSize + hdr->rodataSegSize + dataLoadSegSize;
+    char* stream = (char*)codePages;
+    if (Read3dsx(file, stream, streamSize, readOffset) != streamSize)
     {
-        Log_PrintP("Cannot read data segment");
-        return 0;
+        Log_PrintP("Cannot read segments");
+        return false;
     }
-    readOffset += dataLoadSegSize;
+    readOffset += streamSize;
+
+    memmove(d->segPtrs[2], stream + hdr->codeSegSize + hdr->rodataSegSize, dataLoadSegSize);
+    memmove(d->segPtrs[1], stream + hdr->codeSegSize, hdr->rodataSegSize);
+    memset(stream + hdr->codeSegSize, 0, d->segSizes[0] - hdr->codeSegSize);
+    memset((char*)d->segPtrs[1] + hdr->rodataSegSize, 0, d->segSizes[1] - hdr->rodataSegSize);
+    u32* dataEnd = (u32*)((char*)d->segPtrs[2] + ((dataLoadSegSize+3) &~ 3));
+
+    // The relocation tables follow, also back to back: buffer them in as few reads as possible
+    u32 relocsLeft = 0, relocsBuffered = 0, relocPos = 0;
+    for (i = 0; i < 3*nRelocTables; i ++)
+        relocsLeft += extraPage[i];
 
     // Relocate the segments
     for (i = 0; i < 3; i ++)
     {
         for (j = 0; j < nRelocTables; j ++)
         {
-            int nRelocs = extraPage[i*nRelocTables + j];
-            if (j >= (sizeof(_3DSX_RelocHdr)/4))
-            {
-                // Not using this header
-                readOffset += nRelocs;
-                continue;
-            }
+            u32 nRelocs = extraPage[i*nRelocTables + j];
+            bool used = j < (sizeof(_3DSX_RelocHdr)/4); // Unused headers still have their tables in the file
 
-            u32* pos = (u32*)d.segPtrs[i];
-            u32* endPos = pos + (d.segSizes[i]/4);
+            u32* pos = (u32*)d->segPtrs[i];
+            u32* endPos = pos + (d->segSizes[i]/4);
             SEC_ASSERT(endPos <= segLimit);
 
             while (nRelocs)
             {
-                u32 toDo = nRelocs > MAXRELOCS ? MAXRELOCS : nRelocs;
-                nRelocs -= toDo;
-
-                u32 readSize = toDo*sizeof(_3DSX_Reloc);
-                if (IFile_Read2(file, s_relocBuf, readSize, readOffset) != readSize)
+                if (relocPos == relocsBuffered)
                 {
-                    Log_PrintP("Cannot read reloc table (%d,%d)", i, j);
-                    return 0;
+                    relocsBuffered = relocsLeft > MAXRELOCS ? MAXRELOCS : relocsLeft;
+                    relocsLeft -= relocsBuffered;
+                    relocPos = 0;
+
+                    u32 readSize = relocsBuffered*sizeof(_3DSX_Reloc);
+                    if (readSize == 0 || Read3dsx(file, s_relocBuf, readSize, readOffset) != readSize)
+                    {
+                        Log_PrintP("Cannot read reloc table (%d,%d)", i, j);
+                        return false;
+                    }
+                    readOffset += readSize;
                 }
-                readOffset += readSize;
 
-                for (k = 0; k < toDo && pos < endPos; k ++)
+                u32 toDo = min(nRelocs, relocsBuffered - relocPos);
+                _3DSX_Reloc* relocs = &s_relocBuf[relocPos];
+                nRelocs -= toDo;
+                relocPos += toDo;
+
+                for (k = 0; used && k < toDo && pos < endPos; k ++)
                 {
-                    pos += s_relocBuf[k].skip;
-                    u32 nPatches = s_relocBuf[k].patch;
+                    pos += relocs[k].skip;
+                    u32 nPatches = relocs[k].patch;
                     for (m = 0; m < nPatches && pos < endPos; m ++)
                     {
-                        u32 inAddr = baseAddr + 4*(pos - codePages);
+                        u32 inAddr = d->segAddrs[0] + 4*(pos - codePages);
                         u32 origData = *pos;
                         u32 subType = origData >> (32-4);
-                        u32 addr = TranslateAddr(origData &~ 0xF0000000, &d, offsets);
+                        u32 addr = TranslateAddr(origData &~ 0xF0000000, d, offsets);
                         //Log_PrintP("%08lX<-%08lX", inAddr, addr);
                         switch (j)
                         {
@@ -201,7 +320,7 @@ Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile
                                 if (subType != 0)
                                 {
                                     Log_PrintP("Unsupported absolute reloc subtype (%lu)", subType);
-                                    return 0;
+                                    return false;
                                 }
                                 *pos = addr;
                                 break;
@@ -215,7 +334,7 @@ Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile
                                     case 1: *pos = data &~ BIT(31); break; // 31-bit signed offset
                                     default:
                                         Log_PrintP("Unsupported relative reloc subtype (%lu)", subType);
-                                        return 0;
+                                        return false;
                                 }
                                 break;
                             }
@@ -224,9 +343,73 @@ Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile
                     }
                 }
             }
+
+            // Relocations may reach into the BSS, remember how much of the data segment was touched
+            if (i == 2)
+            {
+                if (pos > endPos)
+                    pos = endPos;
+                if (pos > dataEnd)
+                    dataEnd = pos;
+            }
         }
     }
 
+    *pImageSize = (u32)((char*)dataEnd - (char*)codePages);
+    return true;
+}
+
+Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile *file, u64 tid, const Ldr_3dsxCacheKey* cacheKey)
+{
+    Result res;
+    _3DSX_Header hdr;
+
+    // Read the header and the relocation headers following it in one go
+    u8* firstPage = (u8*)s_relocBuf;
+    u32 firstPageSize = Read3dsx(file, firstPage, 0x1000, 0);
+    SEC_ASSERT(firstPageSize >= sizeof(hdr));
+    memcpy(&hdr, firstPage, sizeof(hdr));
+
+    _3DSX_LoadInfo d;
+    d.segSizes[0] = (hdr.codeSegSize+0xFFF) &~ 0xFFF;
+    d.segSizes[1] = (hdr.rodataSegSize+0xFFF) &~ 0xFFF;
+    d.segSizes[2] = (hdr.dataSegSize+0xFFF) &~ 0xFFF;
+    d.segPtrs[0] = codePages;
+    d.segPtrs[1] = (char*)d.segPtrs[0] + d.segSizes[0];
+    d.segPtrs[2] = (char*)d.segPtrs[1] + d.segSizes[1];
+    d.segAddrs[0] = baseAddr;
+    d.segAddrs[1] = d.segAddrs[0] + d.segSizes[0];
+    d.segAddrs[2] = d.segAddrs[1] + d.segSizes[1];
+
+    u32 nRelocTables = hdr.relocHdrSize/4;
+    SEC_ASSERT((3*4*nRelocTables) <= 0x1000);
+    SEC_ASSERT((hdr.relocHdrSize & 3) == 0);
+    u32* extraPage = (u32*)((char*)d.segPtrs[2] + d.segSizes[2]);
+    u32 extraPageAddr = d.segAddrs[2] + d.segSizes[2];
+    u32 maxImageSize = d.segSizes[0] + d.segSizes[1] + d.segSizes[2];
+
+    // The relocation headers live in the extra page until _prm replaces its contents with argv
+    u32 relocHdrsSize = 3*hdr.relocHdrSize;
+    if (hdr.headerSize + relocHdrsSize <= firstPageSize)
+        memcpy(extraPage, firstPage + hdr.headerSize, relocHdrsSize);
+    else if (Read3dsx(file, extraPage, relocHdrsSize, hdr.headerSize) != relocHdrsSize)
+    {
+        Log_PrintP("Cannot read relheaders");
+        return 0;
+    }
+
+    // Use the prelinked image if there is one, otherwise relocate and store it for the next launch
+    u32 imageSize = 0;
+    ldr3dsxLoadStats.prelinked = cacheKey != NULL && Load3dsxCache(cacheKey, &hdr, baseAddr, codePages, maxImageSize);
+    if (!ldr3dsxLoadStats.prelinked)
+    {
+        if (!Load3dsxSegments(file, &hdr, &d, codePages, extraPage, &imageSize))
+            return 0;
+
+        if (cacheKey != NULL)
+            Save3dsxCache(cacheKey, &hdr, baseAddr, codePages, imageSize);
+    }
+
     // Detect and fill _prm structure
     PrmStruct* pst = (PrmStruct*) &codePages[1];
     if (pst->magic == _PRM_MAGIC)
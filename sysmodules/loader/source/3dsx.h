@@ -107,5 +107,25 @@ typedef struct
 #define ARGVBUF_SIZE 0x400
 extern u32 ldrArgvBuf[ARGVBUF_SIZE/4];
 
+// Identifies a 3DSX file for the prelinked image cache (/luma/3dsx_cache).
+// A cached image is only used if all of these (and the base address) match.
+typedef struct
+{
+    u16 path[PATH_MAX+1];
+    u64 fileSize;
+    u64 timestamp;
+} Ldr_3dsxCacheKey;
+
+// FS reads issued by the last 3DSX load (see hb:ldr GetLoadStats)
+typedef struct
+{
+    u32 readCalls;
+    u32 bytesRead;
+    u32 prelinked;  // Whether the prelinked image cache was used
+} Ldr_3dsxLoadStats;
+
+extern Ldr_3dsxLoadStats ldr3dsxLoadStats;
+
 bool Ldr_Get3dsxSize(u32* pSize, IFile *file);
-Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile *file, u64 tid);
+bool Ldr_Get3dsxCacheKey(Ldr_3dsxCacheKey* key, const u16* path, IFile *file);
+Handle Ldr_CodesetFrom3dsx(const char* name, u32* codePages, u32 baseAddr, IFile *file, u64 tid, const Ldr_3dsxCacheKey* cacheKey);
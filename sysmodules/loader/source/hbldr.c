@@ -196,6 +196,7 @@ static const u32 kernelCaps[] =
 };
 
 static u16 hbldrTarget[PATH_MAX+1];
+static Ldr_3dsxCacheKey hbldrCacheKey;
 
 static inline void error(u32* cmdbuf, Result rc)
 {
@@ -318,10 +319,16 @@ Result hbldrLoadProcess(Handle *outProcessHandle, const ExHeader_Info *exhi)
     }
 
     res = IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_UTF16, hbldrTarget), FS_OPEN_READ);
-    hbldrTarget[0] = 0;
     if (R_FAILED(res))
+    {
+        hbldrTarget[0] = 0;
         return res;
+    }
 
+    bool useCache = Ldr_Get3dsxCacheKey(&hbldrCacheKey, hbldrTarget, &file);
+    hbldrTarget[0] = 0;
+
+    memset(&ldr3dsxLoadStats, 0, sizeof(ldr3dsxLoadStats));
     u32 totalSize = 0;
     if (!Ldr_Get3dsxSize(&totalSize, &file))
     {
@@ -338,7 +345,7 @@ Result hbldrLoadProcess(Handle *outProcessHandle, const ExHeader_Info *exhi)
         return res;
     }
 
-    Handle hCodeset = Ldr_CodesetFrom3dsx(csi->name, (u32 *)addr, csi->text.address, &file, exhi->aci.local_caps.title_id);
+    Handle hCodeset = Ldr_CodesetFrom3dsx(csi->name, (u32 *)addr, csi->text.address, &file, exhi->aci.local_caps.title_id, useCache ? &hbldrCacheKey : NULL);
     IFile_Close(&file);
 
     if (hCodeset != 0)
@@ -396,6 +403,20 @@ void hbldrHandleCommands(void *ctx)
             cmdbuf[1] = 0;
             break;
         }
+        case 6: // GetLoadStats
+        {
+            if (cmdbuf[0] != IPC_MakeHeader(6, 0, 0))
+            {
+                error(cmdbuf, 0xD9001830);
+                break;
+            }
+            cmdbuf[0] = IPC_MakeHeader(6, 4, 0);
+            cmdbuf[1] = 0;
+            cmdbuf[2] = ldr3dsxLoadStats.readCalls;
+            cmdbuf[3] = ldr3dsxLoadStats.bytesRead;
+            cmdbuf[4] = ldr3dsxLoadStats.prelinked;
+            break;
+        }
         case 1: // LoadProcess (removed)
         case 4: // PatchExHeaderInfo (removed)
         case 5: // DebugNextApplicationByForce (removed)
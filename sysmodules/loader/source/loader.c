@@ -290,6 +290,44 @@ static Result PLGLDR_LoadPlugin(u32 processID)
     return svcSendSyncRequest(plgldrHandle);
 }
 
+// Let the plugin loader start reading the plugin while the title's code is being loaded
+static bool PLGLDR_PrefetchPlugin(const ExHeader_Info *exhi)
+{
+    u64 titleId = exhi->aci.local_caps.title_id;
+
+    if ((u32)((titleId >> 0x20) & 0xFFFFFFEDULL) != 0x00040000)
+        return false;
+
+    // Games rebooting the 3DS on old models are only handled when loading the plugin
+    if (!isN3DS && exhi->aci.local_caps.core_info.o3ds_system_mode > 0)
+        return false;
+
+    assertSuccess(plgldrInit());
+
+    u32* cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(15, 2, 0);
+    cmdbuf[1] = (u32)titleId;
+    cmdbuf[2] = (u32)(titleId >> 32);
+    assertSuccess(svcSendSyncRequest(plgldrHandle));
+
+    plgldrExit();
+    return true;
+}
+
+// The prefetched plugin won't be loaded after all (homebrew, or the process couldn't be created)
+static void PLGLDR_CancelPluginPrefetch(void)
+{
+    assertSuccess(plgldrInit());
+
+    u32* cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(16, 0, 0);
+    assertSuccess(svcSendSyncRequest(plgldrHandle));
+
+    plgldrExit();
+}
+
 static inline bool IsHioId(u64 id)
 {
     // FS loads HIO titles at boot when it can. For HIO titles, title/programId and "program handle"
@@ -421,6 +459,8 @@ static Result LoadProcessImpl(Handle *outProcessHandle, const ExHeader_Info *exh
 
     // load code
     u64 titleId = exhi->aci.local_caps.title_id;
+    bool pluginPrefetched = PLGLDR_PrefetchPlugin(exhi);
+    bool pluginLoadRequested = false;
     if (R_SUCCEEDED(res = loadCode(exhi, programHandle, &mapped)))
     {
         u32     *code = (u32 *)mapped.text_addr;
@@ -453,10 +493,14 @@ static Result LoadProcessImpl(Handle *outProcessHandle, const ExHeader_Info *exh
                 assertSuccess(plgldrInit());
                 assertSuccess(PLGLDR_LoadPlugin(processID));
                 plgldrExit();
+                pluginLoadRequested = true;
             }
         }
     }
 
+    if (pluginPrefetched && !pluginLoadRequested)
+        PLGLDR_CancelPluginPrefetch();
+
     svcControlMemory(&dummy, mapped.text_addr, 0, mapped.total_size << 12, MEMOP_FREE, 0);
     return res;
 }
@@ -0,0 +1,726 @@
+// Host test of the 3DSX loader (source/3dsx.c): random .3dsx files are loaded without the
+// prelinked image cache, through a cache miss and through a cache hit, and every image is
+// compared with the one built by a straightforward relocator written from the format
+// description in 3dsx.h. The cache is also checked to be ignored whenever it is stale
+// or damaged.
+
+#include "../source/3dsx.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test_common.h"
+
+static u32 rndRange(u32 n)
+{
+    return n == 0 ? 0 : rnd() % n;
+}
+
+// The SD card
+
+#define MAX_FILES   8
+
+typedef struct MockFile
+{
+    bool    exists;
+    char    path[64];
+    u8 *    data;
+    u32     size;
+    u64     timestamp;
+} MockFile;
+
+static MockFile files[MAX_FILES];
+static bool failImageWrites;
+
+static MockFile *findFile(const char *path)
+{
+    for(u32 i = 0; i < MAX_FILES; i++)
+    {
+        if(files[i].exists && strcmp(files[i].path, path) == 0)
+            return &files[i];
+    }
+
+    return NULL;
+}
+
+static MockFile *createFile(const char *path)
+{
+    for(u32 i = 0; i < MAX_FILES; i++)
+    {
+        if(!files[i].exists)
+        {
+            memset(&files[i], 0, sizeof(MockFile));
+            files[i].exists = true;
+            strcpy(files[i].path, path);
+            return &files[i];
+        }
+    }
+
+    abort();
+}
+
+static void deleteFile(MockFile *file)
+{
+    free(file->data);
+    file->exists = false;
+    file->data = NULL;
+}
+
+static void resetCard(void)
+{
+    for(u32 i = 0; i < MAX_FILES; i++)
+    {
+        if(files[i].exists)
+            deleteFile(&files[i]);
+    }
+}
+
+static void resizeFile(MockFile *file, u32 size)
+{
+    file->data = realloc(file->data, size + 1);
+    if(size > file->size)
+        memset(file->data + file->size, 0, size - file->size);
+    file->size = size;
+}
+
+static MockFile *fileFromHandle(Handle handle)
+{
+    return handle >= 1 && handle <= MAX_FILES && files[handle - 1].exists ? &files[handle - 1] : NULL;
+}
+
+static MockFile *cacheFileOf(const Ldr_3dsxCacheKey *key)
+{
+    char path[sizeof(CACHE_DIR "/00000000.bin")];
+    Get3dsxCachePath(path, key);
+    return findFile(path);
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes)
+{
+    (void)archive;
+    (void)path;
+    (void)attributes;
+    return 0;
+}
+
+Result FSUSER_ControlArchive(FS_Archive archive, u32 action, void *input, u32 inputSize, void *output, u32 outputSize)
+{
+    char path[64];
+    const u16 *path16 = (const u16 *)input;
+
+    (void)archive;
+    if(action != ARCHIVE_ACTION_GET_TIMESTAMP || outputSize != sizeof(u64))
+        return -1;
+
+    u32 i;
+    for(i = 0; i < inputSize / 2 && i < sizeof(path) - 1 && path16[i] != 0; i++)
+        path[i] = (char)path16[i];
+    path[i] = 0;
+
+    MockFile *file = findFile(path);
+    if(file == NULL)
+        return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+
+    *(u64 *)output = file->timestamp;
+    return 0;
+}
+
+Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+{
+    (void)archiveId;
+    (void)archivePath;
+    MockFile *f = findFile((const char *)filePath.data);
+
+    if(flags != FS_OPEN_READ || f == NULL)
+        return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+
+    file->handle = f - files + 1;
+    file->pos = 0;
+    file->size = f->size;
+    return 0;
+}
+
+Result IFile_OpenFromArchive(IFile *file, FS_Archive archive, FS_Path filePath, u32 flags)
+{
+    (void)archive;
+    MockFile *f = findFile((const char *)filePath.data);
+
+    if(f == NULL)
+    {
+        if(!(flags & FS_OPEN_CREATE))
+            return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+        f = createFile((const char *)filePath.data);
+    }
+
+    file->handle = f - files + 1;
+    file->pos = 0;
+    file->size = f->size;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_GetSize(IFile *file, u64 *size)
+{
+    MockFile *f = fileFromHandle(file->handle);
+    if(f == NULL)
+        return -1;
+
+    *size = f->size;
+    return 0;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+    MockFile *f = fileFromHandle(file->handle);
+    if(f == NULL)
+        return -1;
+
+    resizeFile(f, size);
+    return 0;
+}
+
+u32 IFile_Read2(IFile *file, void *buffer, u32 size, u32 offset)
+{
+    MockFile *f = fileFromHandle(file->handle);
+    if(f == NULL || offset >= f->size)
+        return 0;
+
+    u32 n = f->size - offset < size ? f->size - offset : size;
+    memcpy(buffer, f->data + offset, n);
+    return n;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    (void)flags;
+    MockFile *f = fileFromHandle(file->handle);
+    if(f == NULL || (failImageWrites && file->pos != 0))
+        return -1;
+
+    if(file->pos + len > f->size)
+        resizeFile(f, file->pos + len);
+    memcpy(f->data + file->pos, buffer, len);
+    file->pos += len;
+    *total = len;
+    return 0;
+}
+
+// Kernel side
+
+static bool isN3DS;
+static CodeSetHeader lastCodeSet;
+
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param)
+{
+    (void)param;
+    *out = 0;
+    return type == 0x10001 && isN3DS ? 0 : -1;
+}
+
+Result svcCreateCodeSet(Handle *out, const CodeSetHeader *info, u32 code_ptr, u32 ro_ptr, u32 data_ptr)
+{
+    (void)code_ptr;
+    (void)ro_ptr;
+    (void)data_ptr;
+    lastCodeSet = *info;
+    *out = 0x1234;
+    return 0;
+}
+
+// Sample files
+
+typedef struct Sample
+{
+    u8 *    data;
+    u32     size;
+} Sample;
+
+static void append(Sample *sample, const void *data, u32 size)
+{
+    sample->data = realloc(sample->data, sample->size + size);
+    memcpy(sample->data + sample->size, data, size);
+    sample->size += size;
+}
+
+static u32 pageAlign(u32 size)
+{
+    return (size + 0xFFF) & ~0xFFF;
+}
+
+// Builds a random 3DSX. Relocated words hold offsets into the image, with the relative
+// ones sometimes using the 31-bit subtype; everything else is random. With badSubtype,
+// one absolute relocation targets a word with a subtype the loader must reject.
+static void makeSample(Sample *sample, bool withPrm, bool manyRelocs, bool badSubtype)
+{
+    _3DSX_Header hdr;
+    u8 extHeader[12];
+
+    memset(sample, 0, sizeof(Sample));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = _3DSX_MAGIC;
+    hdr.headerSize = rndRange(2) ? sizeof(hdr) : sizeof(hdr) + sizeof(extHeader);
+    hdr.relocHdrSize = rndRange(2) ? 8 : 12;
+    hdr.codeSegSize = 8 + 4 * rndRange(0x2000);
+    hdr.rodataSegSize = rndRange(4) == 0 ? 0 : 4 * rndRange(0x1000);
+    u32 dataLoadSize = rndRange(0x2000);
+    hdr.bssSize = rndRange(4) == 0 ? 0 : rndRange(0x3000);
+    hdr.dataSegSize = dataLoadSize + hdr.bssSize;
+
+    u32 segFileSizes[3] = { hdr.codeSegSize, hdr.rodataSegSize, dataLoadSize };
+    u32 segSizes[3] = { pageAlign(hdr.codeSegSize), pageAlign(hdr.rodataSegSize), pageAlign(hdr.dataSegSize) };
+    u32 imageSize = segSizes[0] + segSizes[1] + segSizes[2];
+    u32 nRelocTables = hdr.relocHdrSize / 4;
+
+    // Relocation tables, and where they patch
+    u32 counts[3][3] = { { 0 } };
+    _3DSX_Reloc *relocs[3][3] = { { NULL } };
+    u8 *patched[3];
+    for(u32 i = 0; i < 3; i++)
+    {
+        patched[i] = calloc(1, segSizes[i] / 4);
+        for(u32 j = 0; j < nRelocTables; j++)
+        {
+            u32 count = rndRange(4) == 0 ? 0 : rndRange(200);
+            if(manyRelocs && i == 0 && j == 0)
+                count = 0x1000 + rndRange(0x1800);
+            counts[i][j] = count;
+            relocs[i][j] = malloc(count * sizeof(_3DSX_Reloc) + 1);
+
+            u32 pos = 0;
+            for(u32 k = 0; k < count; k++)
+            {
+                _3DSX_Reloc *r = &relocs[i][j][k];
+                r->skip = rndRange(16) == 0 ? rndRange(0x400) : rndRange(8);
+                if(i == 0 && k == 0)
+                    r->skip += 8; // Leave the entrypoint and _prm alone, like crt0 does
+                r->patch = rndRange(5);
+                pos += r->skip;
+                for(u32 m = 0; m < r->patch; m++, pos++)
+                {
+                    if(j < 2 && pos < segSizes[i] / 4)
+                        patched[i][pos] |= 1 << j;
+                }
+            }
+        }
+    }
+
+    append(sample, &hdr, sizeof(hdr));
+    if(hdr.headerSize > sizeof(hdr))
+    {
+        for(u32 i = 0; i < sizeof(extHeader); i++)
+            extHeader[i] = rnd();
+        append(sample, extHeader, sizeof(extHeader));
+    }
+    for(u32 i = 0; i < 3; i++)
+        append(sample, counts[i], hdr.relocHdrSize);
+
+    bool hasBadSubtype = false;
+    for(u32 i = 0; i < 3; i++)
+    {
+        u8 *seg = malloc(segFileSizes[i] + 4);
+        for(u32 k = 0; k < segFileSizes[i]; k++)
+            seg[k] = rnd();
+        for(u32 w = 0; w < segFileSizes[i] / 4; w++)
+        {
+            if(patched[i][w] == 0)
+                continue;
+
+            u32 value = rndRange(imageSize);
+            if(patched[i][w] == 2 && rndRange(2))
+                value |= 1u << 28;
+            if(badSubtype && !hasBadSubtype && patched[i][w] == 1)
+            {
+                value |= 1u << 28;
+                hasBadSubtype = true;
+            }
+            memcpy(seg + 4 * w, &value, 4);
+        }
+        if(i == 0)
+        {
+            u32 prm = withPrm ? _PRM_MAGIC : 0;
+            memcpy(seg + 4, &prm, 4);
+        }
+        append(sample, seg, segFileSizes[i]);
+        free(seg);
+    }
+
+    for(u32 i = 0; i < 3; i++)
+    {
+        for(u32 j = 0; j < nRelocTables; j++)
+        {
+            append(sample, relocs[i][j], counts[i][j] * sizeof(_3DSX_Reloc));
+            free(relocs[i][j]);
+        }
+        free(patched[i]);
+    }
+}
+
+// The reference loader: lay the segments out, then walk the relocation tables one entry at a time
+
+static u32 refTranslate(u32 off, const u32 *segAddrs, const u32 *segSizes)
+{
+    if(off < segSizes[0])
+        return segAddrs[0] + off;
+    if(off < segSizes[0] + segSizes[1])
+        return segAddrs[1] + off - segSizes[0];
+    return segAddrs[2] + off - segSizes[0] - segSizes[1];
+}
+
+static bool refLoad(u8 *image, const Sample *sample, u32 baseAddr)
+{
+    _3DSX_Header hdr;
+    memcpy(&hdr, sample->data, sizeof(hdr));
+
+    u32 segSizes[3] = { pageAlign(hdr.codeSegSize), pageAlign(hdr.rodataSegSize), pageAlign(hdr.dataSegSize) };
+    u32 segOffsets[3] = { 0, segSizes[0], segSizes[0] + segSizes[1] };
+    u32 segAddrs[3] = { baseAddr, baseAddr + segOffsets[1], baseAddr + segOffsets[2] };
+    u32 segFileSizes[3] = { hdr.codeSegSize, hdr.rodataSegSize, hdr.dataSegSize - hdr.bssSize };
+    u32 nRelocTables = hdr.relocHdrSize / 4;
+    u8 *extraPage = image + segOffsets[2] + segSizes[2];
+
+    const u8 *in = sample->data + hdr.headerSize;
+    u32 counts[3][3] = { { 0 } };
+    for(u32 i = 0; i < 3; i++, in += hdr.relocHdrSize)
+        memcpy(counts[i], in, hdr.relocHdrSize);
+    memcpy(extraPage, sample->data + hdr.headerSize, 3 * hdr.relocHdrSize);
+
+    for(u32 i = 0; i < 3; i++, in += segFileSizes[i - 1])
+        memcpy(image + segOffsets[i], in, segFileSizes[i]);
+
+    for(u32 i = 0; i < 3; i++)
+    {
+        for(u32 j = 0; j < nRelocTables; j++)
+        {
+            u32 pos = 0, end = segSizes[i] / 4;
+            for(u32 k = 0; k < counts[i][j]; k++, in += sizeof(_3DSX_Reloc))
+            {
+                _3DSX_Reloc r;
+                memcpy(&r, in, sizeof(r));
+                if(j >= 2)
+                    continue;
+
+                pos += r.skip;
+                for(u32 m = 0; m < r.patch && pos < end; m++, pos++)
+                {
+                    u32 word, out;
+                    u8 *p = image + segOffsets[i] + 4 * pos;
+                    memcpy(&word, p, 4);
+
+                    u32 addr = refTranslate(word & 0x0FFFFFFF, segAddrs, segSizes);
+                    u32 subType = word >> 28;
+                    if(j == 0)
+                    {
+                        if(subType != 0)
+                            return false;
+                        out = addr;
+                    }
+                    else
+                    {
+                        if(subType > 1)
+                            return false;
+                        out = addr - (segAddrs[i] + 4 * pos);
+                        if(subType == 1)
+                            out &= ~BIT(31);
+                    }
+                    memcpy(p, &out, 4);
+                }
+            }
+        }
+    }
+
+    PrmStruct prm;
+    memcpy(&prm, image + 4, sizeof(prm));
+    if(prm.magic == _PRM_MAGIC)
+    {
+        u32 extraPageAddr = segAddrs[2] + segSizes[2];
+        memset(extraPage, 0, 0x1000);
+        memcpy(extraPage, ldrArgvBuf, sizeof(ldrArgvBuf));
+        prm.pSrvOverride = extraPageAddr + 0xFFC;
+        prm.pArgList = extraPageAddr;
+        prm.runFlags |= RUNFLAG_APTCHAINLOAD;
+        prm.heapSize = isN3DS ? 48 << 20 : 24 << 20;
+        prm.linearHeapSize = isN3DS ? 64 << 20 : 32 << 20;
+        memcpy(image + 4, &prm, sizeof(prm));
+    }
+
+    return true;
+}
+
+// Loading through the actual loader
+
+static const char samplePath[] = "/3ds/sample.3dsx";
+static const char otherPath[] = "/3ds/other.3dsx";
+
+static void installSample(const char *path, const Sample *sample, u64 timestamp)
+{
+    MockFile *f = findFile(path);
+    if(f == NULL)
+        f = createFile(path);
+
+    resizeFile(f, sample->size);
+    memcpy(f->data, sample->data, sample->size);
+    f->timestamp = timestamp;
+}
+
+static void toPath16(u16 *out, const char *path)
+{
+    do
+        *out++ = (u8)*path;
+    while(*path++ != 0);
+}
+
+// Loads the file like hbldr does; NULL if the loader failed
+static u8 *load(const char *path, u32 baseAddr, bool useCache, u32 *pSize, Ldr_3dsxCacheKey *key)
+{
+    IFile file;
+    u16 path16[64];
+    u32 size;
+
+    CHECK(R_SUCCEEDED(IFile_Open(&file, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, path), FS_OPEN_READ)));
+    toPath16(path16, path);
+    useCache = useCache && Ldr_Get3dsxCacheKey(key, path16, &file);
+    memset(&ldr3dsxLoadStats, 0, sizeof(ldr3dsxLoadStats));
+    CHECK(Ldr_Get3dsxSize(&size, &file));
+    memset(&ldr3dsxLoadStats, 0, sizeof(ldr3dsxLoadStats));
+
+    u8 *image = calloc(1, size);
+    Handle codeset = Ldr_CodesetFrom3dsx("sample", (u32 *)image, baseAddr, &file, 0x000400000FF40002ULL, useCache ? key : NULL);
+    IFile_Close(&file);
+    if(codeset == 0)
+    {
+        free(image);
+        return NULL;
+    }
+
+    *pSize = size;
+    return image;
+}
+
+static u8 *reference(const Sample *sample, u32 baseAddr, u32 size)
+{
+    u8 *image = calloc(1, size);
+    CHECK(refLoad(image, sample, baseAddr));
+    return image;
+}
+
+// Loads and compares with the reference, returns whether the cache was used
+static bool loadAndCompare(const char *path, const Sample *sample, u32 baseAddr, bool useCache)
+{
+    Ldr_3dsxCacheKey key;
+    u32 size = 0;
+    u8 *image = load(path, baseAddr, useCache, &size, &key);
+
+    CHECK(image != NULL);
+    if(image == NULL)
+        return false;
+
+    u8 *expected = reference(sample, baseAddr, size);
+    CHECK(memcmp(image, expected, size) == 0);
+
+    _3DSX_Header hdr;
+    memcpy(&hdr, sample->data, sizeof(hdr));
+    u32 segSizes[3] = { pageAlign(hdr.codeSegSize), pageAlign(hdr.rodataSegSize), pageAlign(hdr.dataSegSize) };
+    CHECK(size == segSizes[0] + segSizes[1] + segSizes[2] + 0x1000);
+    CHECK(lastCodeSet.text_addr == baseAddr && lastCodeSet.text_size == segSizes[0] >> 12);
+    CHECK(lastCodeSet.ro_addr == baseAddr + segSizes[0] && lastCodeSet.ro_size == segSizes[1] >> 12);
+    CHECK(lastCodeSet.rw_addr == baseAddr + segSizes[0] + segSizes[1] && lastCodeSet.rw_size == (segSizes[2] >> 12) + 1);
+    CHECK(memcmp(lastCodeSet.name, "sample", 7) == 0);
+
+    // A hit reads the first page, the cache header and the image, and nothing else of the 3DSX
+    if(ldr3dsxLoadStats.prelinked)
+    {
+        CHECK(ldr3dsxLoadStats.readCalls == 3);
+        CHECK(ldr3dsxLoadStats.bytesRead <= 0x1000 + sizeof(_3DSX_CacheHeader) + size - 0x1000);
+    }
+
+    free(image);
+    free(expected);
+    return ldr3dsxLoadStats.prelinked;
+}
+
+static void testRandomFiles(void)
+{
+    for(u32 n = 0; n < 300; n++)
+    {
+        Sample sample;
+        u32 baseAddr = 0x00100000 + 0x1000 * rndRange(0x100);
+
+        resetCard();
+        isN3DS = rndRange(2);
+        for(u32 i = 0; i < ARGVBUF_SIZE / 4; i++)
+            ldrArgvBuf[i] = rnd();
+
+        makeSample(&sample, rndRange(2), n % 10 == 0, false);
+        installSample(samplePath, &sample, 1000 + n);
+
+        CHECK(!loadAndCompare(samplePath, &sample, baseAddr, false));
+        CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+        CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+        CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+        // Loaded somewhere else: relocated again, and cached for that address
+        CHECK(!loadAndCompare(samplePath, &sample, baseAddr + 0x10000, true));
+        CHECK(loadAndCompare(samplePath, &sample, baseAddr + 0x10000, true));
+
+        free(sample.data);
+    }
+}
+
+static void testStaleCache(void)
+{
+    Sample sample;
+    Ldr_3dsxCacheKey key;
+    u32 size, baseAddr = 0x00100000;
+
+    resetCard();
+    makeSample(&sample, true, true, false);
+    installSample(samplePath, &sample, 5);
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+    // Rewritten with the same size and header, only the timestamp tells
+    _3DSX_Header hdr;
+    memcpy(&hdr, sample.data, sizeof(hdr));
+    Sample other = { malloc(sample.size), sample.size };
+    memcpy(other.data, sample.data, sample.size);
+    other.data[hdr.headerSize + 3 * hdr.relocHdrSize] ^= 0x5A;
+    installSample(samplePath, &other, 6);
+    CHECK(!loadAndCompare(samplePath, &other, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &other, baseAddr, true));
+
+    // Same timestamp, different size
+    Sample longer = { malloc(other.size + 16), other.size + 16 };
+    memcpy(longer.data, other.data, other.size);
+    memset(longer.data + other.size, 0xEE, 16);
+    installSample(samplePath, &longer, 6);
+    CHECK(!loadAndCompare(samplePath, &longer, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &longer, baseAddr, true));
+
+    // No timestamp available: the cache isn't used at all
+    installSample(samplePath, &longer, 0);
+    CHECK(!loadAndCompare(samplePath, &longer, baseAddr, true));
+    CHECK(load(samplePath, baseAddr, true, &size, &key) != NULL);
+    CHECK(!ldr3dsxLoadStats.prelinked);
+
+    free(sample.data);
+    free(other.data);
+    free(longer.data);
+}
+
+static void testDamagedCache(void)
+{
+    Sample sample;
+    Ldr_3dsxCacheKey key;
+    u32 size, baseAddr = 0x00100000;
+
+    resetCard();
+    makeSample(&sample, false, true, false);
+    installSample(samplePath, &sample, 7);
+    free(load(samplePath, baseAddr, true, &size, &key));
+    MockFile *cache = cacheFileOf(&key);
+    CHECK(cache != NULL);
+
+    // Truncated image
+    resizeFile(cache, cache->size - 4);
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+    // Truncated header
+    resizeFile(cache, sizeof(_3DSX_CacheHeader) - 1);
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+    // Older format
+    ((_3DSX_CacheHeader *)cache->data)->version--;
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+    // The header describes another file
+    ((_3DSX_CacheHeader *)cache->data)->hdr.bssSize ^= 4;
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+    // Interrupted while writing the image: the header never makes it
+    deleteFile(cache);
+    failImageWrites = true;
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    failImageWrites = false;
+    cache = cacheFileOf(&key);
+    CHECK(cache != NULL && ((_3DSX_CacheHeader *)cache->data)->magic != CACHE_MAGIC);
+    CHECK(!loadAndCompare(samplePath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(samplePath, &sample, baseAddr, true));
+
+    // Another file whose path hashes to the same cache file
+    Ldr_3dsxCacheKey otherKey;
+    u16 path16[64];
+    installSample(otherPath, &sample, 7);
+    toPath16(path16, otherPath);
+    IFile file = { findFile(otherPath) - files + 1, 0, sample.size };
+    CHECK(Ldr_Get3dsxCacheKey(&otherKey, path16, &file));
+    CHECK(cacheFileOf(&otherKey) == NULL);
+    MockFile *otherCache = createFile("");
+    resizeFile(otherCache, cache->size);
+    memcpy(otherCache->data, cache->data, cache->size);
+    Get3dsxCachePath(otherCache->path, &otherKey);
+    CHECK(!loadAndCompare(otherPath, &sample, baseAddr, true));
+    CHECK(loadAndCompare(otherPath, &sample, baseAddr, true));
+
+    free(sample.data);
+}
+
+// A file the loader rejects is never cached
+static void testRejectedFile(void)
+{
+    Sample sample;
+    Ldr_3dsxCacheKey key;
+    u32 size;
+
+    // The bad subtype may land on a word that isn't in the file, try until it doesn't
+    for(;;)
+    {
+        makeSample(&sample, false, false, true);
+        u8 *image = calloc(1, 16 << 20);
+        bool accepted = refLoad(image, &sample, 0x00100000);
+        free(image);
+        if(!accepted)
+            break;
+        free(sample.data);
+    }
+
+    resetCard();
+    installSample(samplePath, &sample, 9);
+    CHECK(load(samplePath, 0x00100000, true, &size, &key) == NULL);
+    CHECK(cacheFileOf(&key) == NULL);
+
+    free(sample.data);
+}
+
+int main(void)
+{
+    testRandomFiles();
+    testStaleCache();
+    testDamagedCache();
+    testRejectedFile();
+    resetCard();
+
+    printf("3dsx_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -33,23 +33,38 @@ bool PXIIsSendFIFOFull(void)
     return (REG_PXI_CNT & CNT_SEND_FIFO_FULL_STATUS) != 0;
 }
 
+void PXIWaitForSendFIFONotFull(Handle sendFIFOEmptyInterrupt)
+{
+    // The IRQ fires when the FIFO becomes empty, which is bound to happen if it is full now.
+    // Stale signals from earlier transitions are harmless, we just check again.
+    while(REG_PXI_CNT & CNT_SEND_FIFO_FULL_STATUS)
+    {
+        if(sendFIFOEmptyInterrupt != 0 && R_FAILED(svcWaitSynchronization(sendFIFOEmptyInterrupt, -1LL)))
+            svcBreak(USERBREAK_PANIC);
+    }
+}
+
 void PXISendByte(u8 byte)
 {
     REG_PXI_BYTE_SENT_TO_REMOTE = byte;
 }
 
-void PXISendWord(u32 word)
+void PXISendWord(u32 word, Handle sendFIFOEmptyInterrupt)
 {
-    while(REG_PXI_CNT & CNT_SEND_FIFO_FULL_STATUS);
+    PXIWaitForSendFIFONotFull(sendFIFOEmptyInterrupt);
     REG_PXI_SEND = word;
 }
 
-void PXISendBuffer(const u32 *buffer, u32 nbWords)
+void PXISendBuffer(const u32 *buffer, u32 nbWords, Handle sendFIFOEmptyInterrupt)
 {
-    for(; nbWords > 0; nbWords--)
+    while(nbWords > 0)
     {
-        while(REG_PXI_CNT & CNT_SEND_FIFO_FULL_STATUS);
-        REG_PXI_SEND = *buffer++;
+        // Fill the FIFO as much as possible, then sleep until Process9 has drained it
+        for(; nbWords > 0 && !(REG_PXI_CNT & CNT_SEND_FIFO_FULL_STATUS); nbWords--)
+            REG_PXI_SEND = *buffer++;
+
+        if(nbWords > 0)
+            PXIWaitForSendFIFONotFull(sendFIFOEmptyInterrupt);
     }
 }
 
@@ -58,23 +73,35 @@ bool PXIIsReceiveFIFOEmpty(void)
     return (REG_PXI_CNT & CNT_RECEIVE_FIFO_EMPTY_STATUS) != 0;
 }
 
+void PXIWaitForReceiveFIFONotEmpty(Handle receiveFIFONotEmptyInterrupt)
+{
+    while(REG_PXI_CNT & CNT_RECEIVE_FIFO_EMPTY_STATUS)
+    {
+        if(receiveFIFONotEmptyInterrupt != 0 && R_FAILED(svcWaitSynchronization(receiveFIFONotEmptyInterrupt, -1LL)))
+            svcBreak(USERBREAK_PANIC);
+    }
+}
+
 u8 PXIReceiveByte(void)
 {
     return REG_PXI_BYTE_RECEIVED_FROM_REMOTE;
 }
 
-u32 PXIReceiveWord(void)
+u32 PXIReceiveWord(Handle receiveFIFONotEmptyInterrupt)
 {
-    while(REG_PXI_CNT & CNT_RECEIVE_FIFO_EMPTY_STATUS);
+    PXIWaitForReceiveFIFONotEmpty(receiveFIFONotEmptyInterrupt);
     return REG_PXI_RECV;
 }
 
-void PXIReceiveBuffer(u32 *buffer, u32 nbWords)
+void PXIReceiveBuffer(u32 *buffer, u32 nbWords, Handle receiveFIFONotEmptyInterrupt)
 {
-    for(; nbWords > 0; nbWords--)
+    while(nbWords > 0)
     {
-        while(REG_PXI_CNT & CNT_RECEIVE_FIFO_EMPTY_STATUS);
-        *buffer++ = REG_PXI_RECV;
+        for(; nbWords > 0 && !(REG_PXI_CNT & CNT_RECEIVE_FIFO_EMPTY_STATUS); nbWords--)
+            *buffer++ = REG_PXI_RECV;
+
+        if(nbWords > 0)
+            PXIWaitForReceiveFIFONotEmpty(receiveFIFONotEmptyInterrupt);
     }
 }
 
@@ -33,15 +33,19 @@ This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE fo
 void PXIReset(void);
 void PXITriggerSync9IRQ(void);
 
+// The interrupt handles below can be 0, in which case these functions busy-wait instead
+
 bool PXIIsSendFIFOFull(void);
+void PXIWaitForSendFIFONotFull(Handle sendFIFOEmptyInterrupt);
 void PXISendByte(u8 byte);
-void PXISendWord(u32 word);
-void PXISendBuffer(const u32 *buffer, u32 nbWords);
+void PXISendWord(u32 word, Handle sendFIFOEmptyInterrupt);
+void PXISendBuffer(const u32 *buffer, u32 nbWords, Handle sendFIFOEmptyInterrupt);
 
 bool PXIIsReceiveFIFOEmpty(void);
+void PXIWaitForReceiveFIFONotEmpty(Handle receiveFIFONotEmptyInterrupt);
 u8 PXIReceiveByte(void);
-u32 PXIReceiveWord(void);
-void PXIReceiveBuffer(u32 *buffer, u32 nbWords);
+u32 PXIReceiveWord(Handle receiveFIFONotEmptyInterrupt);
+void PXIReceiveBuffer(u32 *buffer, u32 nbWords, Handle receiveFIFONotEmptyInterrupt);
 
 Result bindPXIInterrupts(Handle *syncInterrupt, Handle *receiveFIFONotEmptyInterrupt, Handle *sendFIFOEmptyInterrupt);
 void unbindPXIInterrupts(Handle *syncInterrupt, Handle *receiveFIFONotEmptyInterrupt, Handle *sendFIFOEmptyInterrupt);
@@ -47,6 +47,7 @@ typedef struct SessionManager
 extern u32 ALIGN(0x1000) staticBuffers[NB_STATIC_BUFFERS][0x1000/4];
 
 extern Handle PXISyncInterrupt, PXITransferMutex;
+extern Handle PXIReceiveFIFONotEmptyInterrupt, PXISendFIFOEmptyInterrupt;
 extern Handle terminationRequestedEvent;
 extern bool shouldTerminate;
 extern SessionManager sessionManager;
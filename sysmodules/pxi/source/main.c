@@ -12,8 +12,10 @@ This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE fo
 #include "MyThread.h"
 #include "receiver.h"
 #include "sender.h"
+#include "statsServer.h"
 
 Handle PXISyncInterrupt = 0, PXITransferMutex = 0;
+Handle PXIReceiveFIFONotEmptyInterrupt = 0, PXISendFIFOEmptyInterrupt = 0;
 Handle terminationRequestedEvent = 0;
 bool shouldTerminate = false;
 SessionManager sessionManager = {0};
@@ -54,14 +56,16 @@ static inline void initPXI(void)
     if(PXITransferMutex != 0) svcBreak(USERBREAK_PANIC); //0xE0A0183B
     assertSuccess(svcCreateMutex(&PXITransferMutex, false));
 
-    assertSuccess(svcCreateEvent(&handles[0], RESET_ONESHOT)); //receive FIFO not empty
-    assertSuccess(svcCreateEvent(&handles[1], RESET_ONESHOT)); //send FIFO empty
+    assertSuccess(svcCreateEvent(&PXIReceiveFIFONotEmptyInterrupt, RESET_ONESHOT));
+    assertSuccess(svcCreateEvent(&PXISendFIFOEmptyInterrupt, RESET_ONESHOT));
+    handles[0] = PXIReceiveFIFONotEmptyInterrupt;
+    handles[1] = PXISendFIFOEmptyInterrupt;
     assertSuccess(bindPXIInterrupts(&PXISyncInterrupt, &handles[0], &handles[1]));
 
     s32 handleIndex;
     do
     {
-        while(!PXIIsSendFIFOFull()) PXISendWord(0);
+        while(!PXIIsSendFIFOFull()) PXISendWord(0, 0);
 
         res = assertSuccess(svcWaitSynchronization(handles[0], 0LL));
         if(R_DESCRIPTION(res) == RD_TIMEOUT)
@@ -70,26 +74,24 @@ static inline void initPXI(void)
             handleIndex = 0;
     } while(handleIndex != 0);
 
-
-
-    unbindPXIInterrupts(NULL, &handles[0], &handles[1]);
+    // The FIFO interrupts are kept bound: the sender and receiver threads sleep on them
+    // instead of busy-waiting on the FIFO status bits
 
     PXISendByte(1);
     while(PXIReceiveByte() < 1);
 
     while (!PXIIsReceiveFIFOEmpty())
-        PXIReceiveWord();
+        PXIReceiveWord(0);
 
     PXISendByte(2);
     while(PXIReceiveByte() < 2);
-
-    svcCloseHandle(handles[0]);
-    svcCloseHandle(handles[1]);
 }
 
 static inline void exitPXI(void)
 {
-    unbindPXIInterrupts(&PXISyncInterrupt, NULL, NULL);
+    unbindPXIInterrupts(&PXISyncInterrupt, &PXIReceiveFIFONotEmptyInterrupt, &PXISendFIFOEmptyInterrupt);
+    svcCloseHandle(PXIReceiveFIFONotEmptyInterrupt);
+    svcCloseHandle(PXISendFIFOEmptyInterrupt);
     svcCloseHandle(PXITransferMutex);
     svcCloseHandle(PXISyncInterrupt);
     PXIReset();
@@ -98,7 +100,8 @@ static inline void exitPXI(void)
 static u8 ALIGN(8) receiverStack[THREAD_STACK_SIZE];
 static u8 ALIGN(8) senderStack[THREAD_STACK_SIZE];
 static u8 ALIGN(8) PXISRV11HandlerStack[THREAD_STACK_SIZE];
-static MyThread receiverThread = {0}, senderThread = {0}, PXISRV11HandlerThread = {0};
+static u8 ALIGN(8) statsServerStack[THREAD_STACK_SIZE];
+static MyThread receiverThread = {0}, senderThread = {0}, PXISRV11HandlerThread = {0}, statsServerThread = {0};
 
 Result __sync_init(void);
 Result __sync_fini(void);
@@ -160,6 +163,7 @@ int main(void)
     assertSuccess(MyThread_Create(&receiverThread, receiver, receiverStack, THREAD_STACK_SIZE, 0x2D, -2));
     assertSuccess(MyThread_Create(&senderThread, sender, senderStack, THREAD_STACK_SIZE, 0x2D, -2));
     assertSuccess(MyThread_Create(&PXISRV11HandlerThread, PXISRV11Handler, PXISRV11HandlerStack, THREAD_STACK_SIZE, 0x2D, -2));
+    assertSuccess(MyThread_Create(&statsServerThread, statsServer, statsServerStack, THREAD_STACK_SIZE, 0x30, -2));
 
     assertSuccess(srvEnableNotification(&handles[0]));
 
@@ -200,6 +204,7 @@ int main(void)
     assertSuccess(MyThread_Join(&receiverThread, -1LL));
     assertSuccess(MyThread_Join(&senderThread, -1LL));
     assertSuccess(MyThread_Join(&PXISRV11HandlerThread, -1LL));
+    assertSuccess(MyThread_Join(&statsServerThread, -1LL));
 
     for(u32 i = 0; i < 10; i++)
         svcCloseHandle(handles[i]);
@@ -10,10 +10,11 @@ This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE fo
 
 #include "receiver.h"
 #include "PXI.h"
+#include "statsServer.h"
 
 static inline void receiveFromArm9(void)
 {
-    u32 serviceId = PXIReceiveWord();
+    u32 serviceId = PXIReceiveWord(PXIReceiveFIFONotEmptyInterrupt);
 
     //The offcical implementation can return 0xD90043FA
     if(((serviceId >= 10)) || (sessionManager.sessionData[serviceId].state != STATE_SENT_TO_ARM9))
@@ -21,7 +22,7 @@ static inline void receiveFromArm9(void)
 
     sessionManager.receivedServiceId = serviceId;
     RecursiveLock_Lock(&sessionManager.sessionData[serviceId].lock);
-    u32 replyHeader = PXIReceiveWord();
+    u32 replyHeader = PXIReceiveWord(PXIReceiveFIFONotEmptyInterrupt);
     u32 replySizeWords = (replyHeader & 0x3F) + ((replyHeader & 0xFC0) >> 6) + 1;
 
     if(replySizeWords > 0x40) svcBreak(USERBREAK_PANIC);
@@ -29,7 +30,8 @@ static inline void receiveFromArm9(void)
     u32 *buf = sessionManager.sessionData[serviceId].buffer;
 
     buf[0] = replyHeader;
-    PXIReceiveBuffer(buf + 1, replySizeWords - 1);
+    PXIReceiveBuffer(buf + 1, replySizeWords - 1, PXIReceiveFIFONotEmptyInterrupt);
+    recordPXIReplyReceived(serviceId);
     sessionManager.sessionData[serviceId].state = STATE_RECEIVED_FROM_ARM9;
     RecursiveLock_Unlock(&sessionManager.sessionData[serviceId].lock);
 
@@ -11,8 +11,9 @@ This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE fo
 
 #include "sender.h"
 #include "PXI.h"
+#include "statsServer.h"
 
-Result sendPXICmdbuf(Handle *additionalHandle, u32 serviceId, u32 *buffer)
+Result sendPXICmdbufs(Handle *additionalHandle, const u32 *serviceIds, u32 *const *buffers, u32 nb)
 {
 
     Result res = 0;
@@ -38,14 +39,25 @@ Result sendPXICmdbuf(Handle *additionalHandle, u32 serviceId, u32 *buffer)
     else
         assertSuccess(svcWaitSynchronization(PXITransferMutex, -1LL));
 
-    PXISendWord(serviceId & 0xFF);
-    PXITriggerSync9IRQ(); //notify arm9
-    PXISendBuffer(buffer, (buffer[0] & 0x3F) + ((buffer[0] & 0xFC0) >> 6) + 1);
+    // All the commands go out in one burst, Process9 gets a sync IRQ for each of them
+    for(u32 i = 0; i < nb; i++)
+    {
+        u32 *buffer = buffers[i];
+        recordPXICommandSent(serviceIds[i]);
+        PXISendWord(serviceIds[i] & 0xFF, PXISendFIFOEmptyInterrupt);
+        PXITriggerSync9IRQ(); //notify arm9
+        PXISendBuffer(buffer, (buffer[0] & 0x3F) + ((buffer[0] & 0xFC0) >> 6) + 1, PXISendFIFOEmptyInterrupt);
+    }
 
     svcReleaseMutex(PXITransferMutex);
     return 0;
 }
 
+Result sendPXICmdbuf(Handle *additionalHandle, u32 serviceId, u32 *buffer)
+{
+    return sendPXICmdbufs(additionalHandle, &serviceId, &buffer, 1);
+}
+
 static void updateTLSForStaticBuffers(void)
 {
     u32 *staticBufs = getThreadStaticBuffers();
@@ -103,6 +115,10 @@ void sender(void)
     {
         if(replyTarget == 0) //send to arm9
         {
+            u32 batchServiceIds[9];
+            u32 *batchBuffers[9];
+            u32 nbBatched = 0;
+
             for(u32 i = 0; i < 9; i++)
             {
                 SessionData *data = &sessionManager.sessionData[i];
@@ -116,17 +132,20 @@ void sender(void)
                 }
 
                 else
-                    sessionManager.pendingArm9Commands++;
+                    recordPendingArm9Commands(++sessionManager.pendingArm9Commands);
 
+                // Process9 can't reply (and the receiver can't touch the buffer) before the whole command is sent
                 RecursiveLock_Lock(&data->lock);
                 data->state = STATE_SENT_TO_ARM9;
-                res = sendPXICmdbuf(&terminationRequestedEvent, i, data->buffer);
                 RecursiveLock_Unlock(&data->lock);
 
-                if(R_FAILED(res))
-                    goto terminate;
-
+                batchServiceIds[nbBatched] = i;
+                batchBuffers[nbBatched++] = data->buffer;
             }
+
+            if(nbBatched != 0 && R_FAILED(sendPXICmdbufs(&terminationRequestedEvent, batchServiceIds, batchBuffers, nbBatched)))
+                goto terminate;
+
             cmdbuf[0] = 0xFFFF0000; //Kernel11
         }
 
@@ -188,7 +207,7 @@ void sender(void)
                     sessionManager.sendingDisabled = false;
                 }
                 else if(sessionManager.latest_PXI_MC5_val == 0)
-                    (sessionManager.pendingArm9Commands)--;
+                    recordPendingArm9Commands(--sessionManager.pendingArm9Commands);
 
                 u32 bufSize = 4 * ((data->buffer[0] & 0x3F) + ((data->buffer[0] & 0xFC0) >> 6) + 1);
                 if(bufSize > 0x100) svcBreak(USERBREAK_PANIC);
@@ -10,6 +10,7 @@ This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE fo
 
 #include "common.h"
 
+Result sendPXICmdbufs(Handle *additionalHandle, const u32 *serviceIds, u32 *const *buffers, u32 nb);
 Result sendPXICmdbuf(Handle *additionalHandle, u32 serviceId, u32 *buffer);
 void sender(void);
 void PXISRV11Handler(void);
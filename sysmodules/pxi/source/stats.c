@@ -0,0 +1,55 @@
+/*
+stats.c
+    Per-service PXI command statistics.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include <string.h>
+
+#include "stats.h"
+
+void PXIStats_Reset(PXIStats *stats)
+{
+    memset(stats, 0, sizeof(PXIStats));
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+        stats->services[i].minLatency = 0xFFFFFFFF;
+}
+
+void PXIStats_RecordCommandSent(PXIStats *stats, u32 serviceId, u64 tick)
+{
+    if(serviceId >= PXI_STATS_NB_SERVICES)
+        return;
+
+    PXIServiceStats *s = &stats->services[serviceId];
+    s->nbCommandsSent++;
+    s->lastSentTick = tick;
+}
+
+void PXIStats_RecordReplyReceived(PXIStats *stats, u32 serviceId, u64 tick)
+{
+    if(serviceId >= PXI_STATS_NB_SERVICES)
+        return;
+
+    PXIServiceStats *s = &stats->services[serviceId];
+
+    // Stats may have been reset while the command was in flight
+    if(s->nbRepliesReceived >= s->nbCommandsSent)
+        return;
+
+    u64 latency64 = tick - s->lastSentTick;
+    u32 latency = latency64 > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)latency64;
+
+    s->nbRepliesReceived++;
+    s->totalLatency += latency;
+    s->minLatency = latency < s->minLatency ? latency : s->minLatency;
+    s->maxLatency = latency > s->maxLatency ? latency : s->maxLatency;
+}
+
+void PXIStats_RecordPendingArm9Commands(PXIStats *stats, u32 nbPending)
+{
+    stats->nbPendingArm9Commands = nbPending;
+    if(nbPending > stats->peakPendingArm9Commands)
+        stats->peakPendingArm9Commands = nbPending;
+}
@@ -0,0 +1,34 @@
+/*
+stats.h
+    Per-service PXI command statistics. Doesn't depend on anything but the basic types,
+    time is passed by the caller.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// pxi:srv11 (9) is excluded: requests come from Process9 there
+#define PXI_STATS_NB_SERVICES   9
+
+typedef struct PXIServiceStats
+{
+    u32 nbCommandsSent, nbRepliesReceived;
+    u32 minLatency, maxLatency; // in system ticks
+    u64 totalLatency;
+    u64 lastSentTick;
+} PXIServiceStats;
+
+typedef struct PXIStats
+{
+    PXIServiceStats services[PXI_STATS_NB_SERVICES];
+    u32 nbPendingArm9Commands, peakPendingArm9Commands;
+} PXIStats;
+
+void PXIStats_Reset(PXIStats *stats);
+void PXIStats_RecordCommandSent(PXIStats *stats, u32 serviceId, u64 tick);
+void PXIStats_RecordReplyReceived(PXIStats *stats, u32 serviceId, u64 tick);
+void PXIStats_RecordPendingArm9Commands(PXIStats *stats, u32 nbPending);
@@ -0,0 +1,150 @@
+/*
+statsServer.c
+    Collects per-service statistics and exposes them through the "pxi:stat" service.
+
+    Commands:
+        0x0001 GetServiceStats(u32 serviceId) -> u32 nbCommandsSent, u32 nbRepliesReceived,
+               u32 minLatency, u32 maxLatency, u64 totalLatency (system ticks)
+        0x0002 GetPendingArm9CommandStats() -> u32 current, u32 peak
+        0x0003 ResetStats()
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include "statsServer.h"
+
+static PXIStats stats;
+static RecursiveLock statsLock;
+
+void recordPXICommandSent(u32 serviceId)
+{
+    RecursiveLock_Lock(&statsLock);
+    PXIStats_RecordCommandSent(&stats, serviceId, svcGetSystemTick());
+    RecursiveLock_Unlock(&statsLock);
+}
+
+void recordPXIReplyReceived(u32 serviceId)
+{
+    RecursiveLock_Lock(&statsLock);
+    PXIStats_RecordReplyReceived(&stats, serviceId, svcGetSystemTick());
+    RecursiveLock_Unlock(&statsLock);
+}
+
+void recordPendingArm9Commands(u32 nbPending)
+{
+    RecursiveLock_Lock(&statsLock);
+    PXIStats_RecordPendingArm9Commands(&stats, nbPending);
+    RecursiveLock_Unlock(&statsLock);
+}
+
+static void handleStatsCommand(u32 *cmdbuf)
+{
+    RecursiveLock_Lock(&statsLock);
+
+    switch(cmdbuf[0] >> 16)
+    {
+        case 1:
+        {
+            if(cmdbuf[0] != IPC_MakeHeader(1, 1, 0) || cmdbuf[1] >= PXI_STATS_NB_SERVICES)
+                goto invalid;
+
+            const PXIServiceStats *s = &stats.services[cmdbuf[1]];
+            cmdbuf[0] = IPC_MakeHeader(1, 7, 0);
+            cmdbuf[1] = 0;
+            cmdbuf[2] = s->nbCommandsSent;
+            cmdbuf[3] = s->nbRepliesReceived;
+            cmdbuf[4] = s->nbRepliesReceived != 0 ? s->minLatency : 0;
+            cmdbuf[5] = s->maxLatency;
+            cmdbuf[6] = (u32)s->totalLatency;
+            cmdbuf[7] = (u32)(s->totalLatency >> 32);
+            break;
+        }
+
+        case 2:
+        {
+            if(cmdbuf[0] != IPC_MakeHeader(2, 0, 0))
+                goto invalid;
+
+            cmdbuf[0] = IPC_MakeHeader(2, 3, 0);
+            cmdbuf[1] = 0;
+            cmdbuf[2] = stats.nbPendingArm9Commands;
+            cmdbuf[3] = stats.peakPendingArm9Commands;
+            break;
+        }
+
+        case 3:
+        {
+            if(cmdbuf[0] != IPC_MakeHeader(3, 0, 0))
+                goto invalid;
+
+            PXIStats_Reset(&stats);
+            cmdbuf[0] = IPC_MakeHeader(3, 1, 0);
+            cmdbuf[1] = 0;
+            break;
+        }
+
+        default:
+        invalid:
+            cmdbuf[0] = IPC_MakeHeader(0, 1, 0);
+            cmdbuf[1] = 0xD900182F; //unimplemented/invalid command
+            break;
+    }
+
+    RecursiveLock_Unlock(&statsLock);
+}
+
+void statsServer(void)
+{
+    Handle handles[3] = {terminationRequestedEvent, 0, 0};
+    Handle replyTarget = 0;
+    s32 index;
+
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    RecursiveLock_Lock(&statsLock);
+    PXIStats_Reset(&stats);
+    RecursiveLock_Unlock(&statsLock);
+
+    assertSuccess(srvRegisterService(&handles[1], "pxi:stat", 1));
+
+    do
+    {
+        if(replyTarget == 0)
+            cmdbuf[0] = 0xFFFF0000; //Kernel11
+
+        Result res = svcReplyAndReceive(&index, handles, handles[2] != 0 ? 3 : 2, replyTarget);
+
+        if((u32)res == 0xC920181A) //session closed by remote
+        {
+            svcCloseHandle(handles[2]);
+            handles[2] = replyTarget = 0;
+            continue;
+        }
+        else if(R_FAILED(res))
+            svcBreak(USERBREAK_PANIC);
+
+        switch(index)
+        {
+            case 0: //termination requested
+                break;
+
+            case 1:
+                if(handles[2] != 0) svcBreak(USERBREAK_PANIC);
+                assertSuccess(svcAcceptSession(&handles[2], handles[1]));
+                replyTarget = 0;
+                break;
+
+            default:
+                handleStatsCommand(cmdbuf);
+                replyTarget = handles[2];
+                break;
+        }
+    }
+    while(index != 0);
+
+    if(handles[2] != 0)
+        svcCloseHandle(handles[2]);
+    srvUnregisterService("pxi:stat");
+    svcCloseHandle(handles[1]);
+}
@@ -0,0 +1,18 @@
+/*
+statsServer.h
+    Collects per-service statistics and exposes them through the "pxi:stat" service.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#pragma once
+
+#include "common.h"
+#include "stats.h"
+
+void recordPXICommandSent(u32 serviceId);
+void recordPXIReplyReceived(u32 serviceId);
+void recordPendingArm9Commands(u32 nbPending);
+
+void statsServer(void);
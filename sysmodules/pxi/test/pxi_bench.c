@@ -0,0 +1,79 @@
+/*
+pxi_bench.c:
+    Throughput, round-trip latency (from the module's own statistics) and ARM11 CPU time per command
+    for each transfer mode, with Process9 taking more or less time to handle each command.
+
+    The host runs everything on whatever cores it has, so the CPU time column is the interesting one:
+    busy-waiting burns it while Process9 works, sleeping on the FIFO interrupts doesn't.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include "pxi_fixture.h"
+
+#define NB_ROUNDS 2000
+
+static double elapsedNs(const struct timespec *t0, const struct timespec *t1)
+{
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+static void bench(TransferMode mode, u64 processingNs, u32 nbSessions)
+{
+    static const u32 serviceIds[9] = {1, 2, 3, 4, 5, 6, 7, 8, 0};
+    struct timespec t0, t1;
+    u64 totalLatency = 0;
+    u32 nbReplies = 0;
+
+    fixtureStart(mode, processingNs);
+
+    u64 senderCpuNs = threadCpuNs();
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(u32 round = 0; round < NB_ROUNDS; round++)
+    {
+        if(exchangeCommands(serviceIds, nbSessions) != 0)
+        {
+            printf("pxi_bench: reply mismatch\n");
+            exit(1);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    senderCpuNs = threadCpuNs() - senderCpuNs;
+
+    fixtureStop();
+
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+    {
+        totalLatency += stats.services[i].totalLatency;
+        nbReplies += stats.services[i].nbRepliesReceived;
+    }
+
+    u32 nbCommands = NB_ROUNDS * nbSessions;
+    printf("%-32s %2lu sessions, %5lu us/cmd in Process9: %8.0f cmd/s, round trip %7.1f us, ARM11 CPU %6.2f us/cmd\n",
+           transferModeNames[mode], (unsigned long)nbSessions, (unsigned long)(processingNs / 1000),
+           nbCommands / (elapsedNs(&t0, &t1) / 1e9),
+           (double)totalLatency / nbReplies / CPU_TICKS_PER_USEC,
+           (senderCpuNs + receiverCpuNs) / 1e3 / nbCommands);
+}
+
+int main(void)
+{
+    static const u64 processingTimes[] = { 0, 50000 };
+    static const u32 sessionCounts[] = { 1, 9 };
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    srand(1);
+
+    for(u32 i = 0; i < sizeof(processingTimes) / sizeof(processingTimes[0]); i++)
+    {
+        for(u32 j = 0; j < sizeof(sessionCounts) / sizeof(sessionCounts[0]); j++)
+        {
+            bench(TRANSFER_SPIN_SINGLE, processingTimes[i], sessionCounts[j]);
+            bench(TRANSFER_IRQ_SINGLE, processingTimes[i], sessionCounts[j]);
+            bench(TRANSFER_IRQ_BATCHED, processingTimes[i], sessionCounts[j]);
+        }
+    }
+
+    return 0;
+}
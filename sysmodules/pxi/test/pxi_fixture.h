@@ -0,0 +1,163 @@
+/*
+pxi_fixture.h:
+    Runs the PXI module's transfer code (PXI.c, sender.c, receiver.c) against the simulator.
+    The test itself plays the part of sender(): it queues commands for several sessions,
+    sends them, and waits for receiver() to hand the replies back.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "pxisim.h"
+#include "../source/PXI.c"
+#include "../source/sender.c"
+#include "../source/receiver.c"
+#include "../source/stats.c"
+#include "../source/statsServer.c"
+
+Handle PXISyncInterrupt = 0, PXITransferMutex = 0;
+Handle PXIReceiveFIFONotEmptyInterrupt = 0, PXISendFIFOEmptyInterrupt = 0;
+Handle terminationRequestedEvent = 0;
+bool shouldTerminate = false;
+SessionManager sessionManager = {0};
+
+const u32 nbStaticBuffersByService[10] = {0, 2, 2, 2, 2, 1, 4, 4, 4, 0};
+u32 ALIGN(0x1000) staticBuffers[NB_STATIC_BUFFERS][0x400] = {{0}};
+
+typedef enum TransferMode
+{
+    // What the module did before: spin on the FIFO status bits, take PXITransferMutex for each command
+    TRANSFER_SPIN_SINGLE = 0,
+    TRANSFER_IRQ_SINGLE,
+    TRANSFER_IRQ_BATCHED,
+} TransferMode;
+
+static const char *const transferModeNames[] = { "spin, one command per transfer", "irq, one command per transfer", "irq, batched" };
+
+static TransferMode currentTransferMode;
+static Handle boundReceiveFIFONotEmptyInterrupt, boundSendFIFOEmptyInterrupt;
+static pthread_t receiverThread;
+static u64 receiverCpuNs;
+
+static u64 threadCpuNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *receiverThreadMain(void *arg)
+{
+    (void)arg;
+    receiver();
+    receiverCpuNs = threadCpuNs();
+    return NULL;
+}
+
+static void fixtureStart(TransferMode mode, u64 processingNs)
+{
+    currentTransferMode = mode;
+
+    PXIReset();
+    PXISim_Start(processingNs);
+
+    assertSuccess(svcCreateEvent(&PXISyncInterrupt, RESET_ONESHOT));
+    assertSuccess(svcCreateMutex(&PXITransferMutex, false));
+    assertSuccess(svcCreateEvent(&terminationRequestedEvent, RESET_STICKY));
+    assertSuccess(svcCreateSemaphore(&sessionManager.replySemaphore, 0, 9));
+    assertSuccess(svcCreateEvent(&sessionManager.PXISRV11ReplySentEvent, RESET_ONESHOT));
+    assertSuccess(svcCreateEvent(&boundReceiveFIFONotEmptyInterrupt, RESET_ONESHOT));
+    assertSuccess(svcCreateEvent(&boundSendFIFOEmptyInterrupt, RESET_ONESHOT));
+    assertSuccess(bindPXIInterrupts(&PXISyncInterrupt, &boundReceiveFIFONotEmptyInterrupt, &boundSendFIFOEmptyInterrupt));
+
+    // With null handles, PXI.c busy-waits
+    PXIReceiveFIFONotEmptyInterrupt = mode == TRANSFER_SPIN_SINGLE ? 0 : boundReceiveFIFONotEmptyInterrupt;
+    PXISendFIFOEmptyInterrupt = mode == TRANSFER_SPIN_SINGLE ? 0 : boundSendFIFOEmptyInterrupt;
+
+    for(u32 i = 0; i < 10; i++)
+        RecursiveLock_Init(&sessionManager.sessionData[i].lock);
+    PXIStats_Reset(&stats);
+
+    assertSuccess(svcSignalEvent(sessionManager.PXISRV11ReplySentEvent));
+    if(pthread_create(&receiverThread, NULL, receiverThreadMain, NULL) != 0)
+        abort();
+}
+
+static void fixtureStop(void)
+{
+    assertSuccess(svcSignalEvent(terminationRequestedEvent));
+    pthread_join(receiverThread, NULL);
+    PXISim_Stop();
+
+    unbindPXIInterrupts(&PXISyncInterrupt, &boundReceiveFIFONotEmptyInterrupt, &boundSendFIFOEmptyInterrupt);
+    svcCloseHandle(boundReceiveFIFONotEmptyInterrupt);
+    svcCloseHandle(boundSendFIFOEmptyInterrupt);
+    svcCloseHandle(sessionManager.PXISRV11ReplySentEvent);
+    svcCloseHandle(sessionManager.replySemaphore);
+    svcCloseHandle(terminationRequestedEvent);
+    svcCloseHandle(PXITransferMutex);
+    svcCloseHandle(PXISyncInterrupt);
+    memset(&sessionManager, 0, sizeof(SessionManager));
+    PXIReceiveFIFONotEmptyInterrupt = PXISendFIFOEmptyInterrupt = 0;
+}
+
+// Sends one command for each of the given sessions, then waits for all the replies.
+// Returns the number of reply words that don't match what the simulated Process9 sends back
+static u32 exchangeCommands(const u32 *serviceIds, u32 nb)
+{
+    u32 requests[9][0x40];
+    u32 *buffers[9];
+    u32 nbMismatches = 0;
+
+    if(nb == 0)
+        return 0;
+
+    for(u32 i = 0; i < nb; i++)
+    {
+        SessionData *data = &sessionManager.sessionData[serviceIds[i]];
+        u32 nbWords = 1 + rand() % 16;
+
+        requests[i][0] = IPC_MakeHeader(1 + rand() % 0x20, nbWords - 1, 0);
+        for(u32 j = 1; j < nbWords; j++)
+            requests[i][j] = ((u32)rand() << 16) ^ (u32)rand();
+
+        memcpy(data->buffer, requests[i], 4 * nbWords);
+        data->state = STATE_SENT_TO_ARM9;
+        buffers[i] = data->buffer;
+    }
+
+    if(currentTransferMode == TRANSFER_IRQ_BATCHED)
+        assertSuccess(sendPXICmdbufs(&terminationRequestedEvent, serviceIds, buffers, nb));
+    else
+    {
+        for(u32 i = 0; i < nb; i++)
+            assertSuccess(sendPXICmdbuf(&terminationRequestedEvent, serviceIds[i], buffers[i]));
+    }
+
+    for(u32 i = 0; i < nb; i++)
+        assertSuccess(svcWaitSynchronization(sessionManager.replySemaphore, -1LL));
+
+    for(u32 i = 0; i < nb; i++)
+    {
+        SessionData *data = &sessionManager.sessionData[serviceIds[i]];
+        u32 nbWords = (requests[i][0] & 0x3F) + 1;
+
+        if(data->state != STATE_RECEIVED_FROM_ARM9)
+            nbMismatches++;
+        nbMismatches += data->buffer[0] != requests[i][0];
+        for(u32 j = 1; j < nbWords; j++)
+            nbMismatches += data->buffer[j] != ~requests[i][j];
+
+        data->state = STATE_IDLE;
+    }
+
+    return nbMismatches;
+}
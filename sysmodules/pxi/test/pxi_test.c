@@ -0,0 +1,69 @@
+/*
+pxi_test.c:
+    Checks that commands and replies go through the PXI FIFOs intact in every transfer mode,
+    and that the per-service statistics account for all of them.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include "pxi_fixture.h"
+
+#define NB_ROUNDS 3000
+
+#include "test_common.h"
+
+static void testTransferMode(TransferMode mode)
+{
+    u32 nbSent[PXI_STATS_NB_SERVICES] = {0};
+    u32 nbMismatches = 0, nbCommands = 0;
+    PXISimStats simStats;
+
+    fixtureStart(mode, 0);
+
+    for(u32 round = 0; round < NB_ROUNDS; round++)
+    {
+        // A random subset of the sessions has a command pending, like in sender()
+        u32 serviceIds[9], nb = 0;
+        for(u32 i = 0; i < 9; i++)
+        {
+            if(rand() % 2 == 0)
+                serviceIds[nb++] = i;
+        }
+
+        nbMismatches += exchangeCommands(serviceIds, nb);
+        for(u32 i = 0; i < nb; i++)
+            nbSent[serviceIds[i]]++;
+        nbCommands += nb;
+    }
+
+    fixtureStop();
+    PXISim_GetStats(&simStats);
+
+    CHECK(nbMismatches == 0);
+    CHECK(simStats.nbCommands == nbCommands);
+    CHECK(simStats.nbSync9IRQs == nbCommands);
+    CHECK(simStats.nbSendFIFOOverflows == 0);
+    CHECK(simStats.nbReceiveFIFOUnderflows == 0);
+    CHECK(simStats.nbWordsToArm9 == simStats.nbWordsToArm11);
+
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+    {
+        CHECK(stats.services[i].nbCommandsSent == nbSent[i]);
+        CHECK(stats.services[i].nbRepliesReceived == nbSent[i]);
+    }
+
+    printf("pxi_test: %s: %lu commands\n", transferModeNames[mode], (unsigned long)nbCommands);
+}
+
+int main(void)
+{
+    srand(1);
+
+    testTransferMode(TRANSFER_SPIN_SINGLE);
+    testTransferMode(TRANSFER_IRQ_SINGLE);
+    testTransferMode(TRANSFER_IRQ_BATCHED);
+
+    printf("pxi_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
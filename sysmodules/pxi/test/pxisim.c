@@ -0,0 +1,551 @@
+/*
+pxisim.c:
+    Host-side simulation of the PXI registers and of the kernel objects, see pxisim.h.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "pxisim.h"
+
+// Kernel objects
+
+typedef enum KObjectType
+{
+    KOBJECT_NONE = 0,
+    KOBJECT_EVENT,
+    KOBJECT_MUTEX,
+    KOBJECT_SEMAPHORE,
+} KObjectType;
+
+typedef struct KObject
+{
+    KObjectType type;
+    ResetType resetType;
+    bool signaled;
+    s32 count, maxCount;
+    u32 owner, lockCount;
+} KObject;
+
+#define NB_KOBJECTS 32
+
+static KObject kObjects[NB_KOBJECTS];
+static pthread_mutex_t kernelLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kernelCond = PTHREAD_COND_INITIALIZER;
+
+static __thread u32 currentThreadTag;
+static u32 nbThreadTags;
+
+static u32 getThreadTag(void)
+{
+    if(currentThreadTag == 0)
+        currentThreadTag = __sync_add_and_fetch(&nbThreadTags, 1);
+    return currentThreadTag;
+}
+
+static void flushRegisterWrites(void);
+
+static Result createObject(Handle *out, KObject obj)
+{
+    pthread_mutex_lock(&kernelLock);
+    for(u32 i = 0; i < NB_KOBJECTS; i++)
+    {
+        if(kObjects[i].type == KOBJECT_NONE)
+        {
+            kObjects[i] = obj;
+            *out = i + 1;
+            pthread_mutex_unlock(&kernelLock);
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "pxisim: out of kernel objects\n");
+    abort();
+}
+
+static KObject *getObject(Handle handle, KObjectType type)
+{
+    if(handle == 0 || handle > NB_KOBJECTS || kObjects[handle - 1].type != type)
+    {
+        fprintf(stderr, "pxisim: invalid handle 0x%lx\n", (unsigned long)handle);
+        abort();
+    }
+
+    return &kObjects[handle - 1];
+}
+
+static bool tryAcquire(KObject *obj)
+{
+    switch(obj->type)
+    {
+        case KOBJECT_EVENT:
+            if(!obj->signaled)
+                return false;
+            if(obj->resetType == RESET_ONESHOT)
+                obj->signaled = false;
+            return true;
+        case KOBJECT_MUTEX:
+            if(obj->lockCount != 0 && obj->owner != getThreadTag())
+                return false;
+            obj->owner = getThreadTag();
+            obj->lockCount++;
+            return true;
+        case KOBJECT_SEMAPHORE:
+            if(obj->count == 0)
+                return false;
+            obj->count--;
+            return true;
+        default:
+            return false;
+    }
+}
+
+Result svcCreateEvent(Handle *event, ResetType reset_type)
+{
+    return createObject(event, (KObject){ .type = KOBJECT_EVENT, .resetType = reset_type });
+}
+
+Result svcSignalEvent(Handle handle)
+{
+    flushRegisterWrites();
+    pthread_mutex_lock(&kernelLock);
+    getObject(handle, KOBJECT_EVENT)->signaled = true;
+    pthread_cond_broadcast(&kernelCond);
+    pthread_mutex_unlock(&kernelLock);
+    return 0;
+}
+
+Result svcClearEvent(Handle handle)
+{
+    pthread_mutex_lock(&kernelLock);
+    getObject(handle, KOBJECT_EVENT)->signaled = false;
+    pthread_mutex_unlock(&kernelLock);
+    return 0;
+}
+
+Result svcCreateMutex(Handle *mutex, bool initially_locked)
+{
+    return createObject(mutex, (KObject){
+        .type = KOBJECT_MUTEX,
+        .owner = initially_locked ? getThreadTag() : 0,
+        .lockCount = initially_locked ? 1 : 0,
+    });
+}
+
+Result svcReleaseMutex(Handle handle)
+{
+    flushRegisterWrites();
+    pthread_mutex_lock(&kernelLock);
+    KObject *obj = getObject(handle, KOBJECT_MUTEX);
+    if(obj->lockCount == 0 || obj->owner != getThreadTag())
+        abort();
+
+    if(--obj->lockCount == 0)
+    {
+        obj->owner = 0;
+        pthread_cond_broadcast(&kernelCond);
+    }
+
+    pthread_mutex_unlock(&kernelLock);
+    return 0;
+}
+
+Result svcCreateSemaphore(Handle *semaphore, s32 initial_count, s32 max_count)
+{
+    return createObject(semaphore, (KObject){ .type = KOBJECT_SEMAPHORE, .count = initial_count, .maxCount = max_count });
+}
+
+Result svcReleaseSemaphore(s32 *count, Handle semaphore, s32 release_count)
+{
+    flushRegisterWrites();
+    pthread_mutex_lock(&kernelLock);
+    KObject *obj = getObject(semaphore, KOBJECT_SEMAPHORE);
+    if(obj->count + release_count > obj->maxCount)
+        abort();
+
+    *count = obj->count;
+    obj->count += release_count;
+    pthread_cond_broadcast(&kernelCond);
+    pthread_mutex_unlock(&kernelLock);
+    return 0;
+}
+
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds)
+{
+    struct timespec deadline;
+    Result res = 0;
+
+    if(wait_all)
+        abort(); // not used by the PXI module
+
+    flushRegisterWrites();
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += nanoseconds / 1000000000;
+    deadline.tv_nsec += nanoseconds % 1000000000;
+    if(deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&kernelLock);
+    for(;;)
+    {
+        s32 i;
+        for(i = 0; i < handles_num && !tryAcquire(&kObjects[handles[i] - 1]); i++);
+
+        if(i < handles_num)
+        {
+            *out = i;
+            break;
+        }
+        else if(nanoseconds == 0 || (nanoseconds > 0 && pthread_cond_timedwait(&kernelCond, &kernelLock, &deadline) != 0))
+        {
+            res = 0x09401BFE; // timeout
+            break;
+        }
+        else if(nanoseconds < 0)
+            pthread_cond_wait(&kernelCond, &kernelLock);
+    }
+
+    pthread_mutex_unlock(&kernelLock);
+    return res;
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+    s32 index;
+    return svcWaitSynchronizationN(&index, &handle, 1, false, nanoseconds);
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    pthread_mutex_lock(&kernelLock);
+    if(handle != 0 && handle <= NB_KOBJECTS)
+        kObjects[handle - 1].type = KOBJECT_NONE;
+    pthread_mutex_unlock(&kernelLock);
+    return 0;
+}
+
+void svcBreak(UserBreakType breakReason)
+{
+    fprintf(stderr, "pxisim: svcBreak(%d)\n", (int)breakReason);
+    abort();
+}
+
+u64 svcGetSystemTick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * SYSCLOCK_ARM11 + (u64)ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000;
+}
+
+void svcSleepThread(s64 ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+    nanosleep(&ts, NULL);
+}
+
+void RecursiveLock_Init(RecursiveLock *lock)
+{
+    lock->lock = 0;
+    lock->thread_tag = 0;
+    lock->counter = 0;
+}
+
+void RecursiveLock_Lock(RecursiveLock *lock)
+{
+    u32 tag = getThreadTag();
+    if(lock->thread_tag != tag)
+    {
+        while(!__sync_bool_compare_and_swap(&lock->lock, 0, 1))
+            sched_yield();
+        lock->thread_tag = tag;
+    }
+
+    lock->counter++;
+}
+
+void RecursiveLock_Unlock(RecursiveLock *lock)
+{
+    if(--lock->counter == 0)
+    {
+        lock->thread_tag = 0;
+        __sync_lock_release(&lock->lock);
+    }
+}
+
+// Registers, and Process9 on the other side of them
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    u32 toArm9[PXISIM_FIFO_SIZE], toArm9Start, toArm9Count;
+    bool sendPending;
+    u32 sendPendingThreadTag;
+    u32 toArm11[PXISIM_FIFO_SIZE], toArm11Start, toArm11Count;
+    u32 lastReceived;
+
+    u8 sync[4];
+    u16 cnt;
+
+    Handle syncInterrupt, sendFIFOEmptyInterrupt, receiveFIFONotEmptyInterrupt;
+
+    u64 processingNs;
+    bool stopRequested;
+    pthread_t arm9Thread;
+    PXISimStats stats;
+} sim = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+Result svcBindInterrupt(u32 interruptId, Handle eventOrSemaphore, s32 priority, bool isManualClear)
+{
+    (void)priority;
+    (void)isManualClear;
+
+    pthread_mutex_lock(&sim.lock);
+    switch(interruptId)
+    {
+        case 0x50: sim.syncInterrupt = eventOrSemaphore; break;
+        case 0x52: sim.sendFIFOEmptyInterrupt = eventOrSemaphore; break;
+        case 0x53: sim.receiveFIFONotEmptyInterrupt = eventOrSemaphore; break;
+        default: abort();
+    }
+    pthread_mutex_unlock(&sim.lock);
+
+    return 0;
+}
+
+Result svcUnbindInterrupt(u32 interruptId, Handle eventOrSemaphore)
+{
+    (void)eventOrSemaphore;
+
+    pthread_mutex_lock(&sim.lock);
+    switch(interruptId)
+    {
+        case 0x50: sim.syncInterrupt = 0; break;
+        case 0x52: sim.sendFIFOEmptyInterrupt = 0; break;
+        case 0x53: sim.receiveFIFONotEmptyInterrupt = 0; break;
+        default: abort();
+    }
+    pthread_mutex_unlock(&sim.lock);
+
+    return 0;
+}
+
+// Called with sim.lock held, the kernel lock is always taken after it
+static void raiseInterrupt(Handle handle)
+{
+    if(handle == 0)
+        return;
+
+    pthread_mutex_lock(&kernelLock);
+    getObject(handle, KOBJECT_EVENT)->signaled = true;
+    pthread_cond_broadcast(&kernelCond);
+    pthread_mutex_unlock(&kernelLock);
+}
+
+// The word written to REG_PXI_SEND is only known to be there once the thread that wrote it touches the registers again
+static void commitRegisterWrites(void)
+{
+    if(sim.sendPending && sim.sendPendingThreadTag == getThreadTag())
+    {
+        sim.sendPending = false;
+        sim.toArm9Count++;
+        sim.stats.nbWordsToArm9++;
+        pthread_cond_broadcast(&sim.cond);
+    }
+
+    if(sim.sync[3] & SYNC_TRIGGER_SYNC9_IRQ)
+    {
+        sim.sync[3] &= ~SYNC_TRIGGER_SYNC9_IRQ;
+        sim.stats.nbSync9IRQs++;
+    }
+}
+
+static void flushRegisterWrites(void)
+{
+    pthread_mutex_lock(&sim.lock);
+    commitRegisterWrites();
+    pthread_mutex_unlock(&sim.lock);
+}
+
+vu8 *PXISim_Sync(void)
+{
+    pthread_mutex_lock(&sim.lock);
+    commitRegisterWrites();
+    pthread_mutex_unlock(&sim.lock);
+    return sim.sync;
+}
+
+vu16 *PXISim_Cnt(void)
+{
+    pthread_mutex_lock(&sim.lock);
+    commitRegisterWrites();
+
+    sim.cnt &= ~(CNT_SEND_FIFO_FULL_STATUS | CNT_RECEIVE_FIFO_EMPTY_STATUS | CNT_CLEAR_SEND_FIFO | CNT_ACKNOWLEDGE_FIFO_ERROR);
+    if(sim.toArm9Count + sim.sendPending == PXISIM_FIFO_SIZE)
+        sim.cnt |= CNT_SEND_FIFO_FULL_STATUS;
+    if(sim.toArm11Count == 0)
+        sim.cnt |= CNT_RECEIVE_FIFO_EMPTY_STATUS;
+
+    pthread_mutex_unlock(&sim.lock);
+    return &sim.cnt;
+}
+
+vu32 *PXISim_Send(void)
+{
+    static u32 overflowSink;
+
+    pthread_mutex_lock(&sim.lock);
+    commitRegisterWrites();
+
+    vu32 *ret;
+    if(sim.toArm9Count + sim.sendPending == PXISIM_FIFO_SIZE)
+    {
+        sim.stats.nbSendFIFOOverflows++;
+        ret = &overflowSink;
+    }
+    else
+    {
+        sim.sendPending = true;
+        sim.sendPendingThreadTag = getThreadTag();
+        ret = &sim.toArm9[(sim.toArm9Start + sim.toArm9Count) % PXISIM_FIFO_SIZE];
+    }
+
+    pthread_mutex_unlock(&sim.lock);
+    return ret;
+}
+
+vu32 *PXISim_Recv(void)
+{
+    pthread_mutex_lock(&sim.lock);
+    commitRegisterWrites();
+
+    if(sim.toArm11Count == 0)
+        sim.stats.nbReceiveFIFOUnderflows++;
+    else
+    {
+        sim.lastReceived = sim.toArm11[sim.toArm11Start];
+        sim.toArm11Start = (sim.toArm11Start + 1) % PXISIM_FIFO_SIZE;
+        sim.toArm11Count--;
+        pthread_cond_broadcast(&sim.cond);
+    }
+
+    pthread_mutex_unlock(&sim.lock);
+    return &sim.lastReceived;
+}
+
+// Process9 side, called with sim.lock held. Returns false when stopping
+static bool arm9Receive(u32 *word)
+{
+    while(sim.toArm9Count == 0 && !sim.stopRequested)
+        pthread_cond_wait(&sim.cond, &sim.lock);
+    if(sim.stopRequested)
+        return false;
+
+    *word = sim.toArm9[sim.toArm9Start];
+    sim.toArm9Start = (sim.toArm9Start + 1) % PXISIM_FIFO_SIZE;
+    if(--sim.toArm9Count == 0 && (sim.cnt & CNT_ENABLE_SEND_FIFO_EMPTY_IRQ))
+        raiseInterrupt(sim.sendFIFOEmptyInterrupt);
+
+    return true;
+}
+
+static bool arm9Send(u32 word)
+{
+    while(sim.toArm11Count == PXISIM_FIFO_SIZE && !sim.stopRequested)
+        pthread_cond_wait(&sim.cond, &sim.lock);
+    if(sim.stopRequested)
+        return false;
+
+    sim.toArm11[(sim.toArm11Start + sim.toArm11Count) % PXISIM_FIFO_SIZE] = word;
+    sim.stats.nbWordsToArm11++;
+    if(sim.toArm11Count++ == 0 && (sim.cnt & CNT_ENABLE_RECEIVE_FIFO_NOT_EMPTY_IRQ))
+        raiseInterrupt(sim.receiveFIFONotEmptyInterrupt);
+
+    return true;
+}
+
+static void *arm9ThreadMain(void *arg)
+{
+    u32 buffer[0x40];
+    (void)arg;
+
+    pthread_mutex_lock(&sim.lock);
+    for(;;)
+    {
+        u32 serviceId;
+        if(!arm9Receive(&serviceId) || !arm9Receive(&buffer[0]))
+            break;
+
+        u32 nbWords = (buffer[0] & 0x3F) + ((buffer[0] & 0xFC0) >> 6) + 1;
+        if(nbWords > 0x40)
+            abort();
+
+        u32 i;
+        for(i = 1; i < nbWords && arm9Receive(&buffer[i]); i++);
+        if(i < nbWords)
+            break;
+
+        if(sim.processingNs != 0)
+        {
+            pthread_mutex_unlock(&sim.lock);
+            svcSleepThread(sim.processingNs);
+            pthread_mutex_lock(&sim.lock);
+        }
+
+        // Same order as on the ARM11 side: the sync IRQ comes before the reply itself, which may not fit in the FIFO
+        sim.stats.nbCommands++;
+        if(!arm9Send(serviceId))
+            break;
+        if(sim.sync[3] & SYNC_ENABLE_SYNC11_IRQ)
+            raiseInterrupt(sim.syncInterrupt);
+
+        if(!arm9Send(buffer[0]))
+            break;
+        for(i = 1; i < nbWords && arm9Send(~buffer[i]); i++);
+        if(i < nbWords)
+            break;
+    }
+
+    pthread_mutex_unlock(&sim.lock);
+    return NULL;
+}
+
+void PXISim_Start(u64 processingNs)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.toArm9Start = sim.toArm9Count = sim.toArm11Start = sim.toArm11Count = 0;
+    sim.sendPending = sim.stopRequested = false;
+    sim.processingNs = processingNs;
+    sim.stats = (PXISimStats){0};
+    pthread_mutex_unlock(&sim.lock);
+
+    if(pthread_create(&sim.arm9Thread, NULL, arm9ThreadMain, NULL) != 0)
+        abort();
+}
+
+void PXISim_Stop(void)
+{
+    pthread_mutex_lock(&sim.lock);
+    sim.stopRequested = true;
+    pthread_cond_broadcast(&sim.cond);
+    pthread_mutex_unlock(&sim.lock);
+
+    pthread_join(sim.arm9Thread, NULL);
+}
+
+void PXISim_GetStats(PXISimStats *out)
+{
+    pthread_mutex_lock(&sim.lock);
+    *out = sim.stats;
+    pthread_mutex_unlock(&sim.lock);
+}
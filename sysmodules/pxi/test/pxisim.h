@@ -0,0 +1,50 @@
+/*
+pxisim.h:
+    Host-side simulation of the PXI registers, with a Process9 thread on the other end,
+    and of the few kernel objects the PXI module uses.
+
+    The register macros of PXI.h are redirected to the simulator. A word written to
+    REG_PXI_SEND only becomes visible to Process9 on the writing thread's next register
+    access or svc call, which is always before the module can expect anything from it.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#pragma once
+
+#include "../source/PXI.h"
+
+#define PXISIM_FIFO_SIZE    16
+
+vu8 *PXISim_Sync(void);
+vu16 *PXISim_Cnt(void);
+vu32 *PXISim_Send(void);
+vu32 *PXISim_Recv(void);
+
+#undef REG_PXI_SYNC
+#undef REG_PXI_BYTE_RECEIVED_FROM_REMOTE
+#undef REG_PXI_BYTE_SENT_TO_REMOTE
+#undef REG_PXI_INTERRUPT_CNT
+#undef REG_PXI_CNT
+#undef REG_PXI_SEND
+#undef REG_PXI_RECV
+
+#define REG_PXI_SYNC                        (*(vu32 *)PXISim_Sync())
+#define REG_PXI_BYTE_RECEIVED_FROM_REMOTE   (PXISim_Sync()[0])
+#define REG_PXI_BYTE_SENT_TO_REMOTE         (PXISim_Sync()[1])
+#define REG_PXI_INTERRUPT_CNT               (PXISim_Sync()[3])
+#define REG_PXI_CNT                         (*PXISim_Cnt())
+#define REG_PXI_SEND                        (*PXISim_Send())
+#define REG_PXI_RECV                        (*PXISim_Recv())
+
+typedef struct PXISimStats
+{
+    u32 nbCommands, nbWordsToArm9, nbWordsToArm11;
+    u32 nbSync9IRQs, nbSendFIFOOverflows, nbReceiveFIFOUnderflows;
+} PXISimStats;
+
+// Process9 echoes every command back, each word inverted, after spending processingNs on it
+void PXISim_Start(u64 processingNs);
+void PXISim_Stop(void);
+void PXISim_GetStats(PXISimStats *out);
@@ -0,0 +1,199 @@
+/*
+stats_test.c:
+    Unit test of the per-service PXI statistics and of the pxi:stat command handler.
+
+(c) TuxSH, 2016-2020
+This is part of 3ds_pxi, which is licensed under the MIT license (see LICENSE for details).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/stats.c"
+#include "../source/statsServer.c"
+
+Handle terminationRequestedEvent = 0;
+
+#include "test_common.h"
+
+static void testLatencies(void)
+{
+    PXIStats s;
+    PXIStats_Reset(&s);
+
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+    {
+        CHECK(s.services[i].nbCommandsSent == 0 && s.services[i].nbRepliesReceived == 0);
+        CHECK(s.services[i].minLatency == 0xFFFFFFFF && s.services[i].maxLatency == 0);
+    }
+
+    PXIStats_RecordCommandSent(&s, 1, 1000);
+    PXIStats_RecordReplyReceived(&s, 1, 1300);
+    PXIStats_RecordCommandSent(&s, 1, 2000);
+    PXIStats_RecordReplyReceived(&s, 1, 2100);
+    PXIStats_RecordCommandSent(&s, 1, 3000);
+    PXIStats_RecordReplyReceived(&s, 1, 3500);
+
+    CHECK(s.services[1].nbCommandsSent == 3);
+    CHECK(s.services[1].nbRepliesReceived == 3);
+    CHECK(s.services[1].minLatency == 100);
+    CHECK(s.services[1].maxLatency == 500);
+    CHECK(s.services[1].totalLatency == 900);
+
+    // Other services are left alone
+    CHECK(s.services[0].nbCommandsSent == 0 && s.services[2].nbCommandsSent == 0);
+
+    // Latencies that don't fit in 32 bits saturate
+    PXIStats_RecordCommandSent(&s, 2, 0);
+    PXIStats_RecordReplyReceived(&s, 2, 0x100000000ULL + 5);
+    CHECK(s.services[2].maxLatency == 0xFFFFFFFF);
+    CHECK(s.services[2].totalLatency == 0xFFFFFFFF);
+}
+
+static void testUnmatchedReplies(void)
+{
+    PXIStats s;
+    PXIStats_Reset(&s);
+
+    // Reset while a command was in flight: its reply is ignored
+    PXIStats_RecordReplyReceived(&s, 3, 500);
+    CHECK(s.services[3].nbRepliesReceived == 0);
+    CHECK(s.services[3].totalLatency == 0);
+
+    PXIStats_RecordCommandSent(&s, 3, 600);
+    PXIStats_RecordReplyReceived(&s, 3, 650);
+    PXIStats_RecordReplyReceived(&s, 3, 700);
+    CHECK(s.services[3].nbRepliesReceived == 1);
+    CHECK(s.services[3].totalLatency == 50);
+
+    // pxi:srv11 and out-of-range ids are ignored
+    PXIStats_RecordCommandSent(&s, 9, 0);
+    PXIStats_RecordReplyReceived(&s, 9, 10);
+    PXIStats_RecordCommandSent(&s, 0xFFFFFFFF, 0);
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+        CHECK(i == 3 || s.services[i].nbCommandsSent == 0);
+}
+
+static void testPendingDepth(void)
+{
+    PXIStats s;
+    PXIStats_Reset(&s);
+
+    static const u32 depths[] = { 1, 2, 3, 2, 1, 0, 1, 5, 4, 0 };
+    for(u32 i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+        PXIStats_RecordPendingArm9Commands(&s, depths[i]);
+
+    CHECK(s.nbPendingArm9Commands == 0);
+    CHECK(s.peakPendingArm9Commands == 5);
+}
+
+static void testRandomAgainstReference(void)
+{
+    PXIStats s;
+    u64 sentTick[PXI_STATS_NB_SERVICES];
+    u32 nbSent[PXI_STATS_NB_SERVICES] = {0}, minLat[PXI_STATS_NB_SERVICES], maxLat[PXI_STATS_NB_SERVICES] = {0};
+    u64 totalLat[PXI_STATS_NB_SERVICES] = {0};
+    bool inFlight[PXI_STATS_NB_SERVICES] = {false};
+    u64 tick = 0;
+
+    PXIStats_Reset(&s);
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+        minLat[i] = 0xFFFFFFFF;
+
+    srand(1);
+    for(u32 step = 0; step < 1000000; step++)
+    {
+        u32 id = rand() % PXI_STATS_NB_SERVICES;
+        tick += rand() % 100000;
+
+        // Like the sender, at most one command in flight per session
+        if(!inFlight[id])
+        {
+            PXIStats_RecordCommandSent(&s, id, tick);
+            sentTick[id] = tick;
+            nbSent[id]++;
+            inFlight[id] = true;
+        }
+        else
+        {
+            PXIStats_RecordReplyReceived(&s, id, tick);
+            u32 lat = (u32)(tick - sentTick[id]);
+            totalLat[id] += lat;
+            minLat[id] = lat < minLat[id] ? lat : minLat[id];
+            maxLat[id] = lat > maxLat[id] ? lat : maxLat[id];
+            inFlight[id] = false;
+        }
+    }
+
+    for(u32 i = 0; i < PXI_STATS_NB_SERVICES; i++)
+    {
+        CHECK(s.services[i].nbCommandsSent == nbSent[i]);
+        CHECK(s.services[i].nbRepliesReceived == nbSent[i] - inFlight[i]);
+        CHECK(s.services[i].minLatency == minLat[i]);
+        CHECK(s.services[i].maxLatency == maxLat[i]);
+        CHECK(s.services[i].totalLatency == totalLat[i]);
+    }
+}
+
+static void testStatsCommands(void)
+{
+    u32 cmdbuf[0x40];
+
+    PXIStats_Reset(&stats);
+    PXIStats_RecordCommandSent(&stats, 4, 10);
+    PXIStats_RecordReplyReceived(&stats, 4, 0x100000010ULL);
+    PXIStats_RecordCommandSent(&stats, 4, 0x100000020ULL);
+    PXIStats_RecordReplyReceived(&stats, 4, 0x100000030ULL);
+    PXIStats_RecordPendingArm9Commands(&stats, 3);
+    PXIStats_RecordPendingArm9Commands(&stats, 1);
+
+    cmdbuf[0] = IPC_MakeHeader(1, 1, 0);
+    cmdbuf[1] = 4;
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[0] == IPC_MakeHeader(1, 7, 0) && cmdbuf[1] == 0);
+    CHECK(cmdbuf[2] == 2 && cmdbuf[3] == 2);
+    CHECK(cmdbuf[4] == 0x10 && cmdbuf[5] == 0xFFFFFFFF);
+    CHECK(cmdbuf[6] == 0x0000000F && cmdbuf[7] == 1); // 0xFFFFFFFF + 0x10
+
+    // No reply yet: the min is reported as 0, not as its initial value
+    cmdbuf[0] = IPC_MakeHeader(1, 1, 0);
+    cmdbuf[1] = 5;
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[0] == IPC_MakeHeader(1, 7, 0) && cmdbuf[4] == 0);
+
+    cmdbuf[0] = IPC_MakeHeader(1, 1, 0);
+    cmdbuf[1] = PXI_STATS_NB_SERVICES;
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[0] == IPC_MakeHeader(0, 1, 0) && cmdbuf[1] == 0xD900182F);
+
+    cmdbuf[0] = IPC_MakeHeader(2, 0, 0);
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[0] == IPC_MakeHeader(2, 3, 0) && cmdbuf[1] == 0);
+    CHECK(cmdbuf[2] == 1 && cmdbuf[3] == 3);
+
+    cmdbuf[0] = IPC_MakeHeader(2, 1, 0);
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[1] == 0xD900182F);
+
+    cmdbuf[0] = IPC_MakeHeader(3, 0, 0);
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[0] == IPC_MakeHeader(3, 1, 0) && cmdbuf[1] == 0);
+    CHECK(stats.services[4].nbCommandsSent == 0 && stats.peakPendingArm9Commands == 0);
+
+    cmdbuf[0] = IPC_MakeHeader(4, 0, 0);
+    handleStatsCommand(cmdbuf);
+    CHECK(cmdbuf[1] == 0xD900182F);
+}
+
+int main(void)
+{
+    testLatencies();
+    testUnmatchedReplies();
+    testPendingDepth();
+    testRandomAgainstReference();
+    testStatsCommands();
+
+    printf("stats_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
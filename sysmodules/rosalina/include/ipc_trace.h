@@ -0,0 +1,74 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include "MyThread.h"
+
+#define IPC_TRACE_MAGIC     0x54435049 // "IPCT"
+#define IPC_TRACE_VERSION   1
+#define IPC_TRACE_PORT      4960
+
+// Please keep these in sync with the definitions in k11_extension/include/ipcTrace.h
+
+typedef struct IpcTraceEvent
+{
+    u64 timestamp;          // system tick at which the request was sent
+    u32 latency;            // system ticks elapsed until the reply was received
+    u32 pid;
+    u32 cmdHeader;
+    char serviceName[12];   // empty if the session isn't known
+} IpcTraceEvent;
+
+typedef struct IpcTraceHeader
+{
+    u32 magic;
+    u32 version;
+    u32 nbCores;
+    u32 nbEventsPerCore;
+    vu32 writeIndices[4];   // free-running, only ever written by their own core
+    // followed by nbCores rings of nbEventsPerCore IpcTraceEvent each
+} IpcTraceHeader;
+
+// What is sent to the client once connected, followed by IpcTraceEvent records (little-endian)
+typedef struct IpcTraceFileHeader
+{
+    u32 magic;
+    u32 version;
+    u64 tickRate;
+} IpcTraceFileHeader;
+
+extern bool ipcTraceEnabled;
+extern bool ipcTraceClientConnected;
+extern u32 ipcTraceNbEventsSent, ipcTraceNbEventsDropped;
+
+MyThread *ipcTraceCreateThread(void);
+void ipcTraceThreadMain(void);
+
+const IpcTraceHeader *IpcTrace_GetBuffer(void);
+Result IpcTrace_Enable(void);
+Result IpcTrace_Disable(s64 timeout);
@@ -42,6 +42,8 @@ enum singleOptions
     PATCHUNITINFO,
     DISABLEARM11EXCHANDLERS,
     ENABLESAFEFIRMROSALINA,
+    CACHENATIVEFIRM,
+    SAVEBOOTTRACE,
 };
 
 enum multiOptions
@@ -55,6 +57,13 @@ enum multiOptions
     FORCEAUDIOOUTPUT,
 };
 
+#define SCREENSHOT_FORMAT_BMP   0
+#define SCREENSHOT_FORMAT_QOI   1
+
 void LumaConfig_ConvertComboToString(char *out, u32 combo);
+/// Saves the settings now, on the task runner, and waits for the result
 Result LumaConfig_SaveSettings(void);
+/// Has the settings saved in the background, together with any other change made until then
 void LumaConfig_RequestSaveSettings(void);
+/// Hands the requested save over to the task runner, if any, and if it isn't busy
+void LumaConfig_SaveRequestedSettings(void);
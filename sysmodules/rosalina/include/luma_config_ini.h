@@ -0,0 +1,62 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2023 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/services/fs.h>
+#include "menus/screen_filters.h"
+
+typedef struct CfgData {
+    u16 formatVersionMajor, formatVersionMinor;
+
+    u32 config, multiConfig, bootConfig;
+    u32 splashDurationMsec;
+
+    u64 hbldr3dsxTitleId;
+    u32 rosalinaMenuCombo;
+    u32 pluginLoaderFlags;
+    s16 ntpTzOffetMinutes;
+
+    ScreenFilter topScreenFilter;
+    ScreenFilter bottomScreenFilter;
+
+    u64 autobootTwlTitleId;
+    u8 autobootCtrAppmemtype;
+    u8 screenshotFormat;
+} CfgData;
+
+/// Size of the buffers config.ini is written to
+#define LUMA_INI_BUFFER_SIZE    0x2000
+
+/// Writes the contents of config.ini for cfg, as generated by the given Luma3DS version. Returns their size, 0 on failure
+size_t LumaConfig_SaveLumaIniConfigToStr(char *out, const CfgData *cfg, u32 version, u32 commitHash, bool isRelease);
+/// Whether the file holds exactly the given data. False if it can't be read
+bool LumaConfig_FileContentEquals(FS_Archive archive, const char *path, const char *data, size_t size);
+/// Writes tmpPath, then renames it over path. tmpPath is deleted on failure, unless path is gone and it is complete
+Result LumaConfig_WriteFileAtomically(FS_Archive archive, const char *path, const char *tmpPath, const void *data, size_t size);
+/// Writes data to path as above, unless the file already holds it
+Result LumaConfig_WriteFileIfChanged(FS_Archive archive, const char *path, const char *tmpPath, const char *data, size_t size);
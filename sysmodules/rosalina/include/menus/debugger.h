@@ -37,3 +37,5 @@ Result debuggerDisable(s64 timeout);
 void DebuggerMenu_EnableDebugger(void);
 void DebuggerMenu_DisableDebugger(void);
 void DebuggerMenu_DebugNextApplicationByForce(void);
+void DebuggerMenu_SvcProfiler(void);
+void DebuggerMenu_IpcTrace(void);
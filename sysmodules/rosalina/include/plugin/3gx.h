@@ -66,11 +66,19 @@ typedef struct PACKED
     _3gx_Symtable   symtable;
 } _3gx_Header;
 
+typedef struct
+{
+    u32             exeLoadFunc[32]; // NOP terminated
+    u32             swapSaveFunc[32]; // NOP terminated
+    u32             swapLoadFunc[32]; // NOP terminated
+}   _3gx_EmbeddedPayloads;
+
 
 Result  Check_3gx_Magic(IFile *file);
 Result  Read_3gx_Header(IFile *file, _3gx_Header *header);
 Result  Read_3gx_ParseHeader(IFile *file, _3gx_Header *header);
 Result  Read_3gx_LoadSegments(IFile *file, _3gx_Header *header, void *dst);
-Result  Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header);
+Result  Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header, _3gx_EmbeddedPayloads *payloads);
+Result  Apply_3gx_EmbeddedPayloads(_3gx_Header *header, _3gx_EmbeddedPayloads *payloads);
 Result  Set_3gx_LoadParams(u32* loadFunc, u32* params);
 void	Reset_3gx_LoadParams(void);
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <3ds/types.h>
+#include "plugin/3gx.h"
+#include "plugin/plgldr.h"
+
+// Keeps the most recently loaded plugin images (parsed header, embedded payloads
+// and checksum-verified segments) in memory, so that relaunching a title with an
+// unchanged plugin doesn't need to read and decode it again.
+// Entries are keyed by path, file size and file timestamp.
+// The memory comes from the SYSTEM region, so the cache isn't used when the plugin
+// memory block does too (O3DS without mode 3), and it is dropped if swapping needs room.
+
+#define  PLUGIN_CACHE_MAX_ENTRIES   (4)
+#define  PLUGIN_CACHE_ADDR          (0x0E000000)
+
+typedef struct
+{
+    char                    path[256];
+    u64                     fileSize;
+    u64                     timestamp;
+    u32                     offset; ///< In the cache memory
+    u32                     headerSize; ///< Header, author, title and targets
+    u32                     segmentsSize; ///< .text + .rodata + .data
+    u32                     lastUse;
+    _3gx_EmbeddedPayloads   payloads;
+}   PluginCacheEntry;
+
+void                PluginCache__Init(u32 budget);
+bool                PluginCache__IsEnabled(void);
+/// Drops every entry and gives the memory back, the cache is allocated again on the next insert
+void                PluginCache__Free(void);
+/// Counts a hit or a miss. A timestamp of 0 (unknown) never matches
+PluginCacheEntry *  PluginCache__Find(const char *path, u64 fileSize, u64 timestamp);
+/// Only the fields which aren't pointers are meaningful in the returned header
+const _3gx_Header * PluginCache__GetHeader(const PluginCacheEntry *entry);
+void                PluginCache__RestoreHeader(const PluginCacheEntry *entry, _3gx_Header *dst);
+void                PluginCache__RestoreSegments(const PluginCacheEntry *entry, void *dst);
+/// header must have been parsed by Read_3gx_ParseHeader
+void                PluginCache__Insert(const char *path, u64 fileSize, u64 timestamp, const _3gx_Header *header,
+                                        const _3gx_EmbeddedPayloads *payloads, const void *segments);
+void                PluginCache__GetStats(PluginCacheStats *stats);
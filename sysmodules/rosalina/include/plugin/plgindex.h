@@ -0,0 +1,45 @@
+#pragma once
+
+#include <3ds/types.h>
+
+// Persistent title ID -> plugin file name index, so that launching a game doesn't
+// need to search its plugin directory. An entry is trusted as long as the
+// timestamp and the entry count of /luma/plugins/<tid> didn't change since it was
+// recorded: FAT doesn't always update the timestamp when files are added or removed.
+// Only found plugins are recorded, a file replacing another keeps both unchanged
+// and removing the indexed plugin is only caught when opening it.
+
+#define  PLUGIN_INDEX_PATH          "/luma/plugins/index.bin"
+#define  PLUGIN_INDEX_MAX_ENTRIES   (64)
+#define  PLUGIN_INDEX_NAME_SIZE     (104)
+
+#define  PluginIndexMagic       (0x58444950) /* "PIDX" */
+#define  PluginIndexVersion     (3)
+
+typedef struct
+{
+    u64     titleId;
+    u64     dirTimestamp;
+    u32     nbDirEntries;
+    char    fileName[PLUGIN_INDEX_NAME_SIZE];
+}   PluginIndexEntry;
+
+typedef struct
+{
+    u32                 magic;
+    u32                 version;
+    u32                 nbEntries;
+    u32                 nextVictim; ///< Entry replaced when the index is full
+    PluginIndexEntry    entries[PLUGIN_INDEX_MAX_ENTRIES];
+}   PluginIndex;
+
+void                PluginIndex__Reset(PluginIndex *index);
+bool                PluginIndex__IsValid(const PluginIndex *index);
+/// Returns the entry of the title, whether it's still valid or not
+PluginIndexEntry *  PluginIndex__Find(PluginIndex *index, u64 titleId);
+/// Returns the entry if it exists and was recorded with the same directory timestamp and entry count
+PluginIndexEntry *  PluginIndex__Lookup(PluginIndex *index, u64 titleId, u64 dirTimestamp, u32 nbDirEntries);
+void                PluginIndex__Insert(PluginIndex *index, u64 titleId, u64 dirTimestamp, u32 nbDirEntries, const char *fileName);
+bool                PluginIndex__Remove(PluginIndex *index, u64 titleId);
+/// Size of the used part of the index, which is all that needs to be saved
+u32                 PluginIndex__GetUsedSize(const PluginIndex *index);
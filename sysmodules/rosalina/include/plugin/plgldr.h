@@ -60,6 +60,28 @@ typedef struct
     u32             config[32];
 }   PluginHeader;
 
+typedef struct
+{
+    u32     hits;
+    u32     misses;
+    u32     nbEntries;
+    u32     usedSize;
+    u32     budget;
+}   PluginCacheStats;
+
+/// System ticks, 0 if the step didn't happen
+typedef struct
+{
+    u64     prefetchRequested; ///< Loader announced the title, before loading its code
+    u64     prefetchStarted;
+    u64     prefetchDone;
+    u64     loadRequested; ///< Loader asked to load the plugin, the process is created
+    u64     loadPrepared; ///< Plugin read and verified (prefetched or not)
+    u64     loadDone; ///< Plugin mounted and game hooked
+    u32     usedPrefetch;
+    u32     padding;
+}   PluginLaunchTimeline;
+
 typedef void (*OnPlgLdrEventCb_t)(s32 eventType);
 
 Result  plgLdrInit(void);
@@ -74,5 +96,7 @@ Result  PLGLDR__SetRosalinaMenuBlock(bool shouldBlock);
 Result  PLGLDR__SetSwapSettings(char* swapPath, void* saveFunc, void* loadFunc, void* args);
 Result  PLGLDR__SetExeLoadSettings(void* loadFunc, void* args);
 Result  PLGLDR__GetVersion(u32 *version);
+Result  PLGLDR__GetPluginCacheStats(PluginCacheStats *stats);
+Result  PLGLDR__GetLaunchTimeline(PluginLaunchTimeline *timeline);
 void    PLGLDR__SetEventCallback(OnPlgLdrEventCb_t cb);
 void    PLGLDR__Status(void);
@@ -7,6 +7,7 @@
 
 void        PluginLoader__Init(void);
 bool        PluginLoader__IsEnabled(void);
+u32         PluginLoader__GetConfigFlags(void);
 void        PluginLoader__MenuCallback(void);
 void        PluginLoader__UpdateMenu(void);
 void        PluginLoader__HandleKernelEvent(u32 notifId);
@@ -16,6 +17,12 @@ void    PluginLoader__Error(const char *message, Result res);
 
 Result     MemoryBlock__SetSize(u32 size);
 Result     MemoryBlock__IsReady(void);
+/// Same as MemoryBlock__IsReady, but a failure is left to the caller
+Result     MemoryBlock__Allocate(void);
+/// Reports that the memory block couldn't be allocated and reboots
+void       MemoryBlock__AllocationFailed(Result res);
+/// False when the memory block is taken from the SYSTEM region (O3DS without mode 3)
+bool       MemoryBlock__UsesAppRegion(void);
 Result     MemoryBlock__Free(void);
 Result     MemoryBlock__ToSwapFile(void);
 Result     MemoryBlock__FromSwapFile(void);
@@ -35,6 +42,9 @@ u32         loadSwapFunc(void* startAddr, void* endAddr, void* args);
 u32		    loadExeFunc(void* startAddr, void* endAddr, void* args);
 
 bool     TryToLoadPlugin(Handle process);
+void     PrefetchPlugin(u64 tid);
+void     CancelPluginPrefetch(void);
+void     GetPluginLaunchTimeline(PluginLaunchTimeline *timeline);
 void    PLG__NotifyEvent(PLG_Event event, bool signal);
 void     PLG__SetConfigMemoryStatus(u32 status);
 u32      PLG__GetConfigMemoryStatus(void);
@@ -67,6 +77,7 @@ typedef struct
 
 typedef struct 
 {
+    RecursiveLock   lock; ///< Plugins can be prepared on the task runner, see PreparePlugin
     bool            isEnabled;
     bool            pluginIsSwapped;
     bool            pluginIsHome;
@@ -89,6 +100,8 @@ typedef struct
     bool            isExeLoadFunctionset;
     bool            isSwapFunctionset;
     u8              pluginMemoryStrategy;
+    bool            useSwapCompression;
+    u8              imageCacheSizeMb;
     u32             exeLoadChecksum;
     u32             swapLoadChecksum;    
 }   PluginLoaderContext;
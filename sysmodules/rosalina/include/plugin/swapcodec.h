@@ -0,0 +1,20 @@
+#pragma once
+
+#include <3ds/types.h>
+
+// Small LZ77 codec for the plugin swap file, using the LZ4 block layout
+// (token, literals, 16-bit offset, extra length bytes). Plugin memory is
+// mostly zero-filled or sparse, which the overlapping matches turn into runs.
+// Doesn't depend on anything but the basic types.
+
+#define  SWAP_CODEC_HASH_BITS   (12)
+
+typedef struct
+{
+    u16     table[1 << SWAP_CODEC_HASH_BITS];
+}   SwapCodecState;
+
+/// Returns the compressed size, or 0 if the data doesn't fit in dstCapacity. srcSize must be <= 64 KiB
+u32     SwapCodec__Compress(SwapCodecState *state, u8 *dst, u32 dstCapacity, const u8 *src, u32 srcSize);
+/// Returns true if src decoded to exactly dstSize bytes
+bool    SwapCodec__Decompress(u8 *dst, u32 dstSize, const u8 *src, u32 srcSize);
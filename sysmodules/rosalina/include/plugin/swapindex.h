@@ -0,0 +1,58 @@
+#pragma once
+
+#include <3ds/types.h>
+
+// Page-granular bookkeeping for the plugin swap file, so that only the pages
+// (or, when compressing, the chunks) which changed since the last swap need
+// to be written back to the SD card.
+// Doesn't depend on anything but the basic types.
+
+#define  SWAP_PAGE_SIZE         (0x1000)
+#define  SWAP_CHUNK_SIZE        (0x4000) ///< Unit of compression
+#define  SWAP_PAGES_PER_CHUNK   (SWAP_CHUNK_SIZE / SWAP_PAGE_SIZE)
+#define  SWAP_MAX_PAGES         ((10 * 1024 * 1024) / SWAP_PAGE_SIZE) ///< Largest plugin memory region
+#define  SWAP_MAX_CHUNKS        (SWAP_MAX_PAGES / SWAP_PAGES_PER_CHUNK)
+#define  SWAP_HASHES_OFFSET     (0x800) ///< Page hashes of the swapped image, so that they don't need to stay in memory
+#define  SWAP_DATA_OFFSET       (0x6000) ///< Chunk i is at SWAP_DATA_OFFSET + i * SWAP_CHUNK_SIZE in the file
+
+#define  SwapFileMagic      (0x50415753) /* "SWAP" */
+#define  SwapFileVersion    (3)
+
+typedef struct
+{
+    u32     magic;
+    u32     version;
+    u32     memBlockSize;
+    u32     nbPages;
+    u32     nonZeroPages[SWAP_MAX_PAGES / 32]; ///< Zero pages are never read back
+    /// 0: all pages are zero, SWAP_CHUNK_SIZE: raw pages, otherwise: compressed size
+    u16     chunkSizes[SWAP_MAX_CHUNKS];
+}   SwapFileHeader;
+
+_Static_assert(sizeof(SwapFileHeader) <= SWAP_HASHES_OFFSET, "SwapFileHeader is too big");
+_Static_assert(SWAP_HASHES_OFFSET + SWAP_MAX_PAGES * sizeof(u64) <= SWAP_DATA_OFFSET, "Page hashes overlap with the data");
+
+/// Only needed while swapping, the page hashes are read back from the swap file
+typedef struct
+{
+    bool            isValid; ///< Whether pageHashes describes what is in the swap file
+    u32             nbPages;
+    u64             pageHashes[SWAP_MAX_PAGES];
+    u32             dirtyPages[SWAP_MAX_PAGES / 32];
+    SwapFileHeader  header;
+}   SwapIndex;
+
+/// Returns 0 if and only if the page is all zeroes
+u64     SwapIndex__HashPage(const u32 *page);
+/// Resets the index, the next update will mark every non-zero page as dirty
+void    SwapIndex__Reset(SwapIndex *index, u32 memBlockSize);
+/// Compares the pages against the last swapped image, returns the number of pages which changed
+u32     SwapIndex__Update(SwapIndex *index, const u8 *mem);
+/// Whether any page of the chunk changed in the last update
+bool    SwapIndex__IsChunkDirty(const SwapIndex *index, u32 chunk);
+/// Whether all pages of the chunk are zero, according to header
+bool    SwapIndex__IsChunkZero(const SwapFileHeader *header, u32 chunk);
+/// Checks a header read back from the swap file
+bool    SwapIndex__IsHeaderValid(const SwapFileHeader *header, u32 memBlockSize);
+/// Finds the next run of pages set in bitmap, starting at *pos. Returns false when there are none left
+bool    SwapIndex__NextRun(const u32 *bitmap, u32 nbPages, u32 *pos, u32 *outStart, u32 *outCount);
@@ -0,0 +1,24 @@
+// License for this file: ctrulib's license
+// Copyright AuroraWright, TuxSH 2019-2020
+
+#pragma once
+
+#include <3ds/types.h>
+
+/// Statistics for one PXI service, latencies are in system ticks.
+typedef struct PxiStatServiceStats
+{
+    u32 nbCommandsSent, nbRepliesReceived;
+    u32 minLatency, maxLatency;
+    u64 totalLatency;
+} PxiStatServiceStats;
+
+/// Number of services tracked by "pxi:stat" (everything but pxi:srv11).
+#define PXISTAT_NB_SERVICES 9
+
+Result pxiStatInit(void);
+void pxiStatExit(void);
+
+Result PXISTAT_GetServiceStats(PxiStatServiceStats *out, u32 serviceId);
+Result PXISTAT_GetPendingArm9CommandStats(u32 *outCurrent, u32 *outPeak);
+Result PXISTAT_ResetStats(void);
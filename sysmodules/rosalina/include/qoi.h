@@ -0,0 +1,50 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#pragma once
+
+#include <3ds/types.h>
+
+// Streaming QOI (https://qoiformat.org) encoder, for 24-bit screenshots.
+// Pixels are fed in any number of batches, in image order (top to bottom, left to right).
+
+#define QOI_HEADER_SIZE     14
+#define QOI_FOOTER_SIZE     8
+
+// Worst case size of the data produced by QoiEncoder_EncodeBGR8 and QoiEncoder_Finish
+#define QOI_MAX_ENCODED_SIZE(numPixels)     (4 * (numPixels) + 1)
+#define QOI_MAX_FINISH_SIZE                 (1 + QOI_FOOTER_SIZE)
+
+typedef struct QoiEncoder
+{
+    u32 index[64];
+    u32 previous;
+    u32 run;
+} QoiEncoder;
+
+u32 QoiEncoder_Init(QoiEncoder *enc, u8 *dst, u32 width, u32 height);
+u32 QoiEncoder_EncodeBGR8(QoiEncoder *enc, u8 *dst, const u8 *src, u32 numPixels);
+u32 QoiEncoder_Finish(QoiEncoder *enc, u8 *dst);
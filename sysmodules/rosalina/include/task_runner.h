@@ -18,6 +18,8 @@ MyThread *taskRunnerCreateThread(void);
 
 void TaskRunner_Init(void);
 void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsize);
+/// Same as TaskRunner_RunTask, but returns false instead of waiting if the runner is busy
+bool TaskRunner_TryRunTask(void (*task)(void *argdata), void *argdata, size_t argsize);
 void TaskRunner_Terminate(void);
 
 /// Thread function
@@ -281,68 +281,121 @@ void Draw_CreateBitmapHeader(u8 *dst, u32 width, u32 heigth)
     Draw_WriteUnaligned(dst + 0x22, 3 * width * heigth, 4);
 }
 
-static inline void Draw_ConvertPixelToBGR8(u8 *dst, const u8 *src, GSPGPU_FramebufferFormat srcFormat)
+static inline void Draw_StoreBGR8(u8 *dst, u32 blue, u32 green, u32 red)
 {
-    u8 red, green, blue;
-    switch(srcFormat)
+    dst[0] = (u8)blue;
+    dst[1] = (u8)green;
+    dst[2] = (u8)red;
+}
+
+static inline void Draw_StorePixelFromRGB565(u8 *dst, u32 px)
+{
+    // thanks neobrain
+    u32 blue = px & 0x1F;
+    u32 green = (px >> 5) & 0x3F;
+    u32 red = (px >> 11) & 0x1F;
+
+    Draw_StoreBGR8(dst, (blue << 3) | (blue >> 2), (green << 2) | (green >> 4), (red << 3) | (red >> 2));
+}
+
+static inline void Draw_StorePixelFromRGB5A1(u8 *dst, u32 px)
+{
+    u32 blue = (px >> 1) & 0x1F;
+    u32 green = (px >> 6) & 0x1F;
+    u32 red = (px >> 11) & 0x1F;
+
+    Draw_StoreBGR8(dst, (blue << 3) | (blue >> 2), (green << 3) | (green >> 2), (red << 3) | (red >> 2));
+}
+
+static inline void Draw_StorePixelFromRGBA4(u8 *dst, u32 px)
+{
+    u32 blue = (px >> 4) & 0xF;
+    u32 green = (px >> 8) & 0xF;
+    u32 red = (px >> 12) & 0xF;
+
+    Draw_StoreBGR8(dst, (blue << 4) | blue, (green << 4) | green, (red << 4) | red);
+}
+
+// Run converters: convert "count" consecutive framebuffer pixels (a run along a framebuffer line,
+// i.e. a screen column) to BGR8, writing successive pixels "dstStride" bytes apart.
+typedef void (*Draw_PixelRunConverter)(u8 *dst, u32 dstStride, const u8 *src, u32 count);
+
+static void Draw_ConvertRunFromRGBA8(u8 *dst, u32 dstStride, const u8 *src, u32 count)
+{
+    const u32 *src32 = (const u32 *)src;
+
+    for (; count >= 4; count -= 4, src32 += 4)
     {
-        case GSP_RGBA8_OES:
-        {
-            u32 px = *(u32 *)src;
-            dst[0] = (px >>  8) & 0xFF;
-            dst[1] = (px >> 16) & 0xFF;
-            dst[2] = (px >> 24) & 0xFF;
-            break;
-        }
-        case GSP_BGR8_OES:
-        {
-            dst[2] = src[2];
-            dst[1] = src[1];
-            dst[0] = src[0];
-            break;
-        }
-        case GSP_RGB565_OES:
-        {
-            // thanks neobrain
-            u16 px = *(u16 *)src;
-            blue = px & 0x1F;
-            green = (px >> 5) & 0x3F;
-            red = (px >> 11) & 0x1F;
+        u32 px0 = src32[0], px1 = src32[1], px2 = src32[2], px3 = src32[3];
+        Draw_StoreBGR8(dst, px0 >> 8, px0 >> 16, px0 >> 24); dst += dstStride;
+        Draw_StoreBGR8(dst, px1 >> 8, px1 >> 16, px1 >> 24); dst += dstStride;
+        Draw_StoreBGR8(dst, px2 >> 8, px2 >> 16, px2 >> 24); dst += dstStride;
+        Draw_StoreBGR8(dst, px3 >> 8, px3 >> 16, px3 >> 24); dst += dstStride;
+    }
 
-            dst[0] = (blue  << 3) | (blue  >> 2);
-            dst[1] = (green << 2) | (green >> 4);
-            dst[2] = (red   << 3) | (red   >> 2);
+    for (; count != 0; count--, src32++, dst += dstStride)
+        Draw_StoreBGR8(dst, *src32 >> 8, *src32 >> 16, *src32 >> 24);
+}
 
-            break;
-        }
-        case GSP_RGB5_A1_OES:
-        {
-            u16 px = *(u16 *)src;
-            blue = (px >> 1) & 0x1F;
-            green = (px >> 6) & 0x1F;
-            red = (px >> 11) & 0x1F;
+static void Draw_ConvertRunFromBGR8(u8 *dst, u32 dstStride, const u8 *src, u32 count)
+{
+    // Bytewise until word-aligned, then 4 pixels (3 words) at a time
+    for (; count != 0 && ((u32)src & 3) != 0; count--, src += 3, dst += dstStride)
+        Draw_StoreBGR8(dst, src[0], src[1], src[2]);
 
-            dst[0] = (blue  << 3) | (blue  >> 2);
-            dst[1] = (green << 3) | (green >> 2);
-            dst[2] = (red   << 3) | (red   >> 2);
+    for (; count >= 4; count -= 4, src += 12)
+    {
+        const u32 *src32 = (const u32 *)src;
+        u32 w0 = src32[0], w1 = src32[1], w2 = src32[2];
+        Draw_StoreBGR8(dst, w0, w0 >> 8, w0 >> 16); dst += dstStride;
+        Draw_StoreBGR8(dst, w0 >> 24, w1, w1 >> 8); dst += dstStride;
+        Draw_StoreBGR8(dst, w1 >> 16, w1 >> 24, w2); dst += dstStride;
+        Draw_StoreBGR8(dst, w2 >> 8, w2 >> 16, w2 >> 24); dst += dstStride;
+    }
 
-            break;
-        }
-        case GSP_RGBA4_OES:
-        {
-            u16 px = *(u32 *)src;
-            blue = (px >> 4) & 0xF;
-            green = (px >> 8) & 0xF;
-            red = (px >> 12) & 0xF;
+    for (; count != 0; count--, src += 3, dst += dstStride)
+        Draw_StoreBGR8(dst, src[0], src[1], src[2]);
+}
 
-            dst[0] = (blue  << 4) | (blue  >> 0);
-            dst[1] = (green << 4) | (green >> 0);
-            dst[2] = (red   << 4) | (red   >> 0);
+static inline __attribute__((always_inline)) void Draw_ConvertRunFrom16bpp(u8 *dst, u32 dstStride, const u8 *src, u32 count, void (*storePixel)(u8 *, u32))
+{
+    const u16 *src16 = (const u16 *)src;
 
-            break;
-        }
-        default: break;
+    // One halfword until word-aligned, then 4 pixels (2 words) at a time
+    if (count != 0 && ((u32)src16 & 2) != 0)
+    {
+        storePixel(dst, *src16++);
+        dst += dstStride;
+        count--;
     }
+
+    for (; count >= 4; count -= 4, src16 += 4)
+    {
+        const u32 *src32 = (const u32 *)src16;
+        u32 w0 = src32[0], w1 = src32[1];
+        storePixel(dst, w0 & 0xFFFF); dst += dstStride;
+        storePixel(dst, w0 >> 16);    dst += dstStride;
+        storePixel(dst, w1 & 0xFFFF); dst += dstStride;
+        storePixel(dst, w1 >> 16);    dst += dstStride;
+    }
+
+    for (; count != 0; count--, src16++, dst += dstStride)
+        storePixel(dst, *src16);
+}
+
+static void Draw_ConvertRunFromRGB565(u8 *dst, u32 dstStride, const u8 *src, u32 count)
+{
+    Draw_ConvertRunFrom16bpp(dst, dstStride, src, count, Draw_StorePixelFromRGB565);
+}
+
+static void Draw_ConvertRunFromRGB5A1(u8 *dst, u32 dstStride, const u8 *src, u32 count)
+{
+    Draw_ConvertRunFrom16bpp(dst, dstStride, src, count, Draw_StorePixelFromRGB5A1);
+}
+
+static void Draw_ConvertRunFromRGBA4(u8 *dst, u32 dstStride, const u8 *src, u32 count)
+{
+    Draw_ConvertRunFrom16bpp(dst, dstStride, src, count, Draw_StorePixelFromRGBA4);
 }
 
 typedef struct FrameBufferConvertArgs {
@@ -357,22 +410,30 @@ typedef struct FrameBufferConvertArgs {
 static void Draw_ConvertFrameBufferLinesKernel(const FrameBufferConvertArgs *args)
 {
     static const u8 formatSizes[] = { 4, 3, 2, 2, 2 };
+    static const Draw_PixelRunConverter converters[] = {
+        Draw_ConvertRunFromRGBA8,
+        Draw_ConvertRunFromBGR8,
+        Draw_ConvertRunFromRGB565,
+        Draw_ConvertRunFromRGB5A1,
+        Draw_ConvertRunFromRGBA4,
+    };
 
     GSPGPU_FramebufferFormat fmt = args->top ? (GSPGPU_FramebufferFormat)(GPU_FB_TOP_FMT & 7) : (GSPGPU_FramebufferFormat)(GPU_FB_BOTTOM_FMT & 7);
     u32 width = args->width;
     u32 stride = args->top ? GPU_FB_TOP_STRIDE : GPU_FB_BOTTOM_STRIDE;
 
-    u32 pa = Draw_GetCurrentFramebufferAddress(args->top, args->left);
-    u8 *addr = (u8 *)KERNPA2VA(pa);
+    if (fmt > GSP_RGBA4_OES)
+        return;
 
-    for (u32 y = args->startingLine; y < args->startingLine + args->numLines; y++)
-    {
-        for(u32 x = 0; x < width; x++)
-        {
-            __builtin_prefetch(addr + x * stride + y * formatSizes[fmt], 0, 3);
-            Draw_ConvertPixelToBGR8(args->buf + (x + width * y) * 3 , addr + x * stride + y * formatSizes[fmt], fmt);
-        }
-    }
+    u32 pa = Draw_GetCurrentFramebufferAddress(args->top, args->left);
+    const u8 *src = (const u8 *)KERNPA2VA(pa) + args->startingLine * formatSizes[fmt];
+    u32 lineSize = 3 * width;
+    u8 *dst = args->buf;
+
+    // Framebuffer lines are screen columns: read each of them sequentially, and let the
+    // (at most 240) destination lines being written to stay in the data cache
+    for (u32 x = 0; x < width; x++, src += stride, dst += 3)
+        converters[fmt](dst, lineSize, src, args->numLines);
 }
 
 void Draw_ConvertFrameBufferLines(u8 *buf, u32 width, u32 startingLine, u32 numLines, bool top, bool left)
@@ -0,0 +1,289 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "ipc_trace.h"
+#include "minisoc.h"
+#include "menu.h"
+#include "utils.h"
+
+bool ipcTraceEnabled = false;
+bool ipcTraceClientConnected = false;
+u32 ipcTraceNbEventsSent = 0, ipcTraceNbEventsDropped = 0;
+
+static Handle ipcTraceThreadStartedEvent;
+static int ipcTraceStartResult;
+
+static const IpcTraceHeader *ipcTraceBuffer = NULL; // uncached, see k11_extension/source/ipcTrace.c
+static u32 ipcTraceReadIndices[4];
+static IpcTraceEvent ipcTraceBatch[64];
+
+static MyThread ipcTraceThread;
+static u8 ALIGN(8) ipcTraceThreadStack[0x3000];
+
+MyThread *ipcTraceCreateThread(void)
+{
+    if(R_FAILED(MyThread_Create(&ipcTraceThread, ipcTraceThreadMain, ipcTraceThreadStack, 0x3000, 0x20, CORE_SYSTEM)))
+        svcBreak(USERBREAK_PANIC);
+    return &ipcTraceThread;
+}
+
+const IpcTraceHeader *IpcTrace_GetBuffer(void)
+{
+    return ipcTraceBuffer;
+}
+
+static inline const IpcTraceEvent *IpcTrace_GetRing(u32 coreId)
+{
+    return (const IpcTraceEvent *)(ipcTraceBuffer + 1) + coreId * ipcTraceBuffer->nbEventsPerCore;
+}
+
+// The kernel never waits for us: if we're too slow, the oldest events are lost (and counted as such)
+static u32 IpcTrace_ReadEvents(IpcTraceEvent *out, u32 maxEvents)
+{
+    u32 nbEventsPerCore = ipcTraceBuffer->nbEventsPerCore;
+    u32 n = 0;
+
+    for(u32 coreId = 0; coreId < ipcTraceBuffer->nbCores && n < maxEvents; coreId++)
+    {
+        const IpcTraceEvent *ring = IpcTrace_GetRing(coreId);
+        u32 start = ipcTraceReadIndices[coreId];
+        u32 end = ipcTraceBuffer->writeIndices[coreId];
+        __dmb();
+
+        if(end - start > nbEventsPerCore)
+        {
+            ipcTraceNbEventsDropped += end - start - nbEventsPerCore;
+            start = end - nbEventsPerCore;
+        }
+
+        u32 count = end - start < maxEvents - n ? end - start : maxEvents - n;
+        for(u32 i = 0; i < count; i++)
+            out[n + i] = ring[(start + i) & (nbEventsPerCore - 1)];
+
+        // Discard what might have been overwritten while we were copying, including the slot
+        // the kernel may be writing right now (event #newEnd, not published yet)
+        __dmb();
+        u32 newEnd = ipcTraceBuffer->writeIndices[coreId];
+        u32 nbOverwritten = newEnd - start >= nbEventsPerCore ? newEnd - start - nbEventsPerCore + 1 : 0;
+        nbOverwritten = nbOverwritten < count ? nbOverwritten : count;
+        if(nbOverwritten != 0)
+        {
+            memmove(out + n, out + n + nbOverwritten, (count - nbOverwritten) * sizeof(IpcTraceEvent));
+            ipcTraceNbEventsDropped += nbOverwritten;
+        }
+
+        n += count - nbOverwritten;
+        ipcTraceReadIndices[coreId] = start + count;
+    }
+
+    return n;
+}
+
+static bool IpcTrace_SendAll(int sock, const void *buf, u32 size)
+{
+    const u8 *p = (const u8 *)buf;
+    while(size != 0)
+    {
+        int n = socSend(sock, p, size, 0);
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static void IpcTrace_CloseSocket(int sock)
+{
+    struct linger linger;
+    linger.l_onoff = 1;
+    linger.l_linger = 0;
+
+    socSetsockopt(sock, SOL_SOCKET, SO_LINGER, &linger, sizeof(struct linger));
+    socClose(sock);
+}
+
+void ipcTraceThreadMain(void)
+{
+    Result res = miniSocInit();
+    if(R_FAILED(res))
+    {
+        ipcTraceStartResult = res;
+        miniSocExit();
+        svcSignalEvent(ipcTraceThreadStartedEvent);
+        return;
+    }
+
+    int listenSock = socSocket(AF_INET, SOCK_STREAM, 0);
+    u32 tries = 15;
+    while(listenSock == -1 && --tries > 0)
+    {
+        svcSleepThread(100 * 1000 * 1000LL);
+        listenSock = socSocket(AF_INET, SOCK_STREAM, 0);
+    }
+
+    if(listenSock < -10000 || tries == 0)
+    {
+        ipcTraceStartResult = -1;
+        miniSocExit();
+        svcSignalEvent(ipcTraceThreadStartedEvent);
+        return;
+    }
+
+    struct sockaddr_in saddr;
+    saddr.sin_family = AF_INET;
+    saddr.sin_port = htons(IPC_TRACE_PORT);
+    saddr.sin_addr.s_addr = socGethostid();
+    res = socBind(listenSock, (struct sockaddr *)&saddr, sizeof(struct sockaddr_in));
+    if(res == 0)
+        res = socListen(listenSock, 1);
+    if(res != 0)
+    {
+        socClose(listenSock);
+        miniSocExit();
+        ipcTraceStartResult = res;
+        svcSignalEvent(ipcTraceThreadStartedEvent);
+        return;
+    }
+
+    svcSignalEvent(ipcTraceThreadStartedEvent);
+
+    int clientSock = -1;
+    while(ipcTraceEnabled && !preTerminationRequested)
+    {
+        if(clientSock == -1)
+        {
+            struct pollfd pfd;
+            pfd.fd = listenSock;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            int pollres = socPoll(&pfd, 1, 100);
+            if(pollres < -10000)
+                break;
+            else if(pollres <= 0 || !(pfd.revents & POLLIN))
+                continue;
+
+            socklen_t len = sizeof(struct sockaddr_in);
+            clientSock = socAccept(listenSock, (struct sockaddr *)&saddr, &len);
+            if(clientSock < 0)
+            {
+                clientSock = -1;
+                continue;
+            }
+
+            // Start with whatever is still in the rings
+            for(u32 coreId = 0; coreId < ipcTraceBuffer->nbCores; coreId++)
+            {
+                u32 end = ipcTraceBuffer->writeIndices[coreId];
+                ipcTraceReadIndices[coreId] = end > ipcTraceBuffer->nbEventsPerCore ? end - ipcTraceBuffer->nbEventsPerCore : 0;
+            }
+
+            IpcTraceFileHeader hdr = { IPC_TRACE_MAGIC, IPC_TRACE_VERSION, SYSCLOCK_ARM11 };
+            ipcTraceNbEventsSent = ipcTraceNbEventsDropped = 0;
+            ipcTraceClientConnected = IpcTrace_SendAll(clientSock, &hdr, sizeof(hdr));
+            if(!ipcTraceClientConnected)
+            {
+                IpcTrace_CloseSocket(clientSock);
+                clientSock = -1;
+            }
+
+            continue;
+        }
+
+        u32 n = IpcTrace_ReadEvents(ipcTraceBatch, sizeof(ipcTraceBatch) / sizeof(ipcTraceBatch[0]));
+        if(n == 0)
+            svcSleepThread(10 * 1000 * 1000LL);
+        else if(IpcTrace_SendAll(clientSock, ipcTraceBatch, n * sizeof(IpcTraceEvent)))
+            ipcTraceNbEventsSent += n;
+        else
+        {
+            ipcTraceClientConnected = false;
+            IpcTrace_CloseSocket(clientSock);
+            clientSock = -1;
+        }
+    }
+
+    ipcTraceClientConnected = false;
+    if(clientSock != -1)
+        IpcTrace_CloseSocket(clientSock);
+    IpcTrace_CloseSocket(listenSock);
+
+    miniSocExit();
+}
+
+Result IpcTrace_Enable(void)
+{
+    if(ipcTraceEnabled)
+        return 0;
+
+    Result res = svcKernelSetState(0x10009, true, 0xFFFFFFFF); // trace all processes but us
+    if(R_FAILED(res))
+        return res;
+
+    s64 out;
+    svcGetSystemInfo(&out, 0x10004, 0);
+    ipcTraceBuffer = (const IpcTraceHeader *)PA_PTR((u32)out);
+
+    res = svcCreateEvent(&ipcTraceThreadStartedEvent, RESET_STICKY);
+    if(R_SUCCEEDED(res))
+    {
+        ipcTraceStartResult = 0;
+        ipcTraceEnabled = true;
+        ipcTraceCreateThread();
+
+        res = svcWaitSynchronization(ipcTraceThreadStartedEvent, 10 * 1000 * 1000 * 1000LL);
+        if(res == 0)
+            res = (Result)ipcTraceStartResult;
+        svcCloseHandle(ipcTraceThreadStartedEvent);
+
+        if(res != 0)
+        {
+            ipcTraceEnabled = false;
+            MyThread_Join(&ipcTraceThread, 5 * 1000 * 1000 * 1000LL);
+        }
+    }
+
+    if(res != 0)
+        svcKernelSetState(0x10009, false, 0);
+
+    return res;
+}
+
+Result IpcTrace_Disable(s64 timeout)
+{
+    if(!ipcTraceEnabled)
+        return 0;
+
+    svcKernelSetState(0x10009, false, 0);
+    ipcTraceEnabled = false;
+
+    return MyThread_Join(&ipcTraceThread, timeout);
+}
@@ -0,0 +1,249 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2023 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds/types.h>
+#include <3ds/os.h>
+#include <string.h>
+#include "fmt.h"
+#include "utils.h"
+#include "ifile.h"
+#include "luma_config.h"
+#include "luma_config_ini.h"
+#include "config_template_ini.h"
+
+void LumaConfig_ConvertComboToString(char *out, u32 combo)
+{
+    static const char *keys[] = {
+        "A", "B", "Select", "Start", "Right", "Left", "Up", "Down", "R", "L", "X", "Y",
+        "?", "?",
+        "ZL", "ZR",
+        "?", "?", "?", "?",
+        "Touch",
+        "?", "?", "?",
+        "CStick Right", "CStick Left", "CStick Up", "CStick Down",
+        "CPad Right", "CPad Left", "CPad Up", "CPad Down",
+    };
+
+    char *outOrig = out;
+    out[0] = 0;
+    for(s32 i = 31; i >= 0; i--)
+    {
+        if(combo & (1 << i))
+        {
+            strcpy(out, keys[i]);
+            out += strlen(keys[i]);
+            *out++ = '+';
+        }
+    }
+
+    if (out != outOrig)
+        out[-1] = 0;
+}
+
+size_t LumaConfig_SaveLumaIniConfigToStr(char *out, const CfgData *cfg, u32 version, u32 commitHash, bool isRelease)
+{
+    char lumaVerStr[64];
+    char lumaRevSuffixStr[16];
+    char rosalinaMenuComboStr[128];
+
+    const char *splashPosStr;
+    const char *n3dsCpuStr;
+    const char *autobootModeStr;
+    const char *forceAudioOutputStr;
+    const char *screenshotFormatStr;
+
+    switch (MULTICONFIG(SPLASH)) {
+        default: case 0: splashPosStr = "off"; break;
+        case 1: splashPosStr = "before payloads"; break;
+        case 2: splashPosStr = "after payloads"; break;
+    }
+
+    switch (MULTICONFIG(NEWCPU)) {
+        default: case 0: n3dsCpuStr = "off"; break;
+        case 1: n3dsCpuStr = "clock"; break;
+        case 2: n3dsCpuStr = "l2"; break;
+        case 3: n3dsCpuStr = "clock+l2"; break;
+    }
+
+    switch (cfg->screenshotFormat) {
+        default: case SCREENSHOT_FORMAT_BMP: screenshotFormatStr = "bmp"; break;
+        case SCREENSHOT_FORMAT_QOI: screenshotFormatStr = "qoi"; break;
+    }
+
+    switch (MULTICONFIG(AUTOBOOTMODE)) {
+        default: case 0: autobootModeStr = "off"; break;
+        case 1: autobootModeStr = "3ds"; break;
+        case 2: autobootModeStr = "dsi"; break;
+    }
+
+    switch (MULTICONFIG(FORCEAUDIOOUTPUT)) {
+        default: case 0: forceAudioOutputStr = "off"; break;
+        case 1: forceAudioOutputStr = "headphones"; break;
+        case 2: forceAudioOutputStr = "speakers"; break;
+    }
+
+    if (GET_VERSION_REVISION(version) != 0) {
+        sprintf(lumaVerStr, "Luma3DS v%d.%d.%d", (int)GET_VERSION_MAJOR(version), (int)GET_VERSION_MINOR(version), (int)GET_VERSION_REVISION(version));
+    } else {
+        sprintf(lumaVerStr, "Luma3DS v%d.%d",  (int)GET_VERSION_MAJOR(version), (int)GET_VERSION_MINOR(version));
+    }
+
+    if (isRelease) {
+        strcpy(lumaRevSuffixStr, "");
+    } else {
+        sprintf(lumaRevSuffixStr, "-%08lx", (unsigned long)commitHash);
+    }
+
+    LumaConfig_ConvertComboToString(rosalinaMenuComboStr, cfg->rosalinaMenuCombo);
+
+    static const int pinOptionToDigits[] = { 0, 4, 6, 8 };
+    int pinNumDigits = pinOptionToDigits[MULTICONFIG(PIN)];
+
+    char topScreenFilterGammaStr[32];
+    char topScreenFilterContrastStr[32];
+    char topScreenFilterBrightnessStr[32];
+    floatToString(topScreenFilterGammaStr, cfg->topScreenFilter.gamma, 6, false);
+    floatToString(topScreenFilterContrastStr, cfg->topScreenFilter.contrast, 6, false);
+    floatToString(topScreenFilterBrightnessStr, cfg->topScreenFilter.brightness, 6, false);
+
+    char bottomScreenFilterGammaStr[32];
+    char bottomScreenFilterContrastStr[32];
+    char bottomScreenFilterBrightnessStr[32];
+    floatToString(bottomScreenFilterGammaStr, cfg->bottomScreenFilter.gamma, 6, false);
+    floatToString(bottomScreenFilterContrastStr, cfg->bottomScreenFilter.contrast, 6, false);
+    floatToString(bottomScreenFilterBrightnessStr, cfg->bottomScreenFilter.brightness, 6, false);
+
+    int n = sprintf(
+        out, (const char *)config_template_ini,
+        lumaVerStr, lumaRevSuffixStr,
+
+        (int)cfg->formatVersionMajor, (int)cfg->formatVersionMinor,
+        (int)CONFIG(AUTOBOOTEMU), (int)CONFIG(USEEMUFIRM),
+        (int)CONFIG(LOADEXTFIRMSANDMODULES), (int)CONFIG(PATCHGAMES),
+        (int)CONFIG(REDIRECTAPPTHREADS), (int)CONFIG(PATCHVERSTRING),
+        (int)CONFIG(SHOWGBABOOT),
+
+        1 + (int)MULTICONFIG(DEFAULTEMU), 4 - (int)MULTICONFIG(BRIGHTNESS),
+        splashPosStr, (unsigned int)cfg->splashDurationMsec,
+        pinNumDigits, n3dsCpuStr,
+        autobootModeStr,
+
+        cfg->hbldr3dsxTitleId, rosalinaMenuComboStr, (int)(cfg->pluginLoaderFlags & 1),
+        (int)((cfg->pluginLoaderFlags >> 1) & 1), (int)((cfg->pluginLoaderFlags >> 8) & 0xFF),
+        (int)cfg->ntpTzOffetMinutes, screenshotFormatStr,
+
+        (int)cfg->topScreenFilter.cct, (int)cfg->bottomScreenFilter.cct,
+        topScreenFilterGammaStr, bottomScreenFilterGammaStr,
+        topScreenFilterContrastStr, bottomScreenFilterContrastStr,
+        topScreenFilterBrightnessStr, bottomScreenFilterBrightnessStr,
+        (int)cfg->topScreenFilter.invert, (int)cfg->bottomScreenFilter.invert,
+
+        cfg->autobootTwlTitleId, (int)cfg->autobootCtrAppmemtype,
+
+        forceAudioOutputStr,
+
+        (int)CONFIG(PATCHUNITINFO), (int)CONFIG(DISABLEARM11EXCHANDLERS),
+        (int)CONFIG(ENABLESAFEFIRMROSALINA), (int)CONFIG(CACHENATIVEFIRM),
+        (int)CONFIG(SAVEBOOTTRACE)
+    );
+
+    return n < 0 ? 0 : (size_t)n;
+}
+
+bool LumaConfig_FileContentEquals(FS_Archive archive, const char *path, const char *data, size_t size)
+{
+    IFile file;
+    u64 fileSize, total;
+    char buf[0x200];
+
+    if (R_FAILED(IFile_OpenFromArchive(&file, archive, fsMakePath(PATH_ASCII, path), FS_OPEN_READ)))
+        return false;
+
+    bool equal = R_SUCCEEDED(IFile_GetSize(&file, &fileSize)) && fileSize == size;
+    for (size_t pos = 0; equal && pos < size; pos += sizeof(buf))
+    {
+        u32 len = size - pos < sizeof(buf) ? size - pos : sizeof(buf);
+        equal = R_SUCCEEDED(IFile_Read(&file, &total, buf, len)) && total == len && memcmp(buf, data + pos, len) == 0;
+    }
+
+    IFile_Close(&file);
+    return equal;
+}
+
+static bool LumaConfig_FileExists(FS_Archive archive, FS_Path path)
+{
+    IFile file;
+
+    if (R_FAILED(IFile_OpenFromArchive(&file, archive, path, FS_OPEN_READ)))
+        return false;
+
+    IFile_Close(&file);
+    return true;
+}
+
+// FAT can't rename over an existing file, so the old one is deleted first. arm9 falls back
+// to the temporary file when it is all that is left, see readLumaIniConfig
+Result LumaConfig_WriteFileAtomically(FS_Archive archive, const char *path, const char *tmpPath, const void *data, size_t size)
+{
+    IFile file;
+    u64 total;
+    FS_Path filePath = fsMakePath(PATH_ASCII, path), tmpFilePath = fsMakePath(PATH_ASCII, tmpPath);
+
+    Result res = IFile_OpenFromArchive(&file, archive, tmpFilePath, FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if (R_SUCCEEDED(res))
+    {
+        res = IFile_SetSize(&file, size);
+        if (R_SUCCEEDED(res))
+            res = IFile_Write(&file, &total, data, size, FS_WRITE_FLUSH);
+        IFile_Close(&file);
+
+        if (R_SUCCEEDED(res) && total != size)
+            res = -1;
+    }
+
+    bool isComplete = R_SUCCEEDED(res);
+    if (isComplete)
+    {
+        FSUSER_DeleteFile(archive, filePath);
+        res = FSUSER_RenameFile(archive, tmpFilePath, archive, filePath);
+    }
+
+    // Never leave an incomplete file for arm9 to find. A complete one is kept when the file it
+    // replaces is already gone
+    if (R_FAILED(res) && (!isComplete || LumaConfig_FileExists(archive, filePath)))
+        FSUSER_DeleteFile(archive, tmpFilePath);
+
+    return res;
+}
+
+Result LumaConfig_WriteFileIfChanged(FS_Archive archive, const char *path, const char *tmpPath, const char *data, size_t size)
+{
+    // Several requests may have been coalesced into this one, and often nothing changed at all
+    if (LumaConfig_FileContentEquals(archive, path, data, size))
+        return 0;
+
+    return LumaConfig_WriteFileAtomically(archive, path, tmpPath, data, size);
+}
@@ -38,6 +38,7 @@
 #include "menus/cheats.h"
 #include "menus/sysconfig.h"
 #include "input_redirection.h"
+#include "ipc_trace.h"
 #include "minisoc.h"
 #include "draw.h"
 #include "bootdiag.h"
@@ -191,6 +192,9 @@ static void handlePreTermNotification(u32 notificationId)
     // Disable input redirection
     InputRedirection_Disable(100 * 1000 * 1000LL);
 
+    // Stop the IPC trace server
+    IpcTrace_Disable(100 * 1000 * 1000LL);
+
     // Ask the debugger to terminate in approx 2 * 100ms
     debuggerDisable(100 * 1000 * 1000LL);
 
@@ -293,10 +293,8 @@ void menuThreadMain(void)
             menuLeave();
         }
 
-        if (saveSettingsRequest) {
-            LumaConfig_SaveSettings();
-            saveSettingsRequest = false;
-        }
+        // Requests made while the menu was open are coalesced into a single background write
+        LumaConfig_SaveRequestedSettings();
     }
 }
 
@@ -42,6 +42,9 @@
 #include "process_patches.h"
 #include "luminance.h"
 #include "luma_config.h"
+#include "pxistat.h"
+#include "qoi.h"
+#include "boottrace_format.h"
 
 Menu rosalinaMenu = {
     "Rosalina menu",
@@ -96,6 +99,133 @@ void RosalinaMenu_SaveSettings(void)
     while(!(waitInput() & KEY_B) && !menuShouldExit);
 }
 
+static void RosalinaMenu_DrawPxiStats(u32 posY, Result pxiStatRes)
+{
+    static const char *serviceNames[PXISTAT_NB_SERVICES] =
+    {
+        "pxi:mc", "PxiFS0", "PxiFS1", "PxiFSB", "PxiFSR", "PxiPM", "pxi:dev", "pxi:am9", "pxi:ps9",
+    };
+
+    if(R_FAILED(pxiStatRes))
+    {
+        Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Failed to connect to pxi:stat (0x%08lx).\n", (u32)pxiStatRes);
+        return;
+    }
+
+    u32 ticksPerUs = SYSCLOCK_ARM11 / 1000000;
+    posY = Draw_DrawString(10, posY, COLOR_WHITE, "Round-trip latencies in us.\n\n");
+    posY = Draw_DrawString(10, posY, COLOR_WHITE, "Service     Cmds Replies    Min    Avg     Max\n");
+    for(u32 i = 0; i < PXISTAT_NB_SERVICES; i++)
+    {
+        PxiStatServiceStats stats;
+        if(R_FAILED(PXISTAT_GetServiceStats(&stats, i)) || stats.nbCommandsSent == 0)
+            continue;
+
+        u32 avg = stats.nbRepliesReceived != 0 ? (u32)(stats.totalLatency / stats.nbRepliesReceived) : 0;
+        posY = Draw_DrawFormattedString(
+            10, posY, COLOR_WHITE, "%-8s %7lu %7lu %6lu %6lu %7lu\n",
+            serviceNames[i], stats.nbCommandsSent, stats.nbRepliesReceived,
+            stats.minLatency / ticksPerUs, avg / ticksPerUs, stats.maxLatency / ticksPerUs
+        );
+    }
+
+    u32 current, peak;
+    if(R_SUCCEEDED(PXISTAT_GetPendingArm9CommandStats(&current, &peak)))
+        posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "Pending ARM9 commands: %lu (peak %lu)\n", current, peak);
+
+    Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "X: back to debug info, Y: reset statistics");
+}
+
+static BootTrace bootTrace;
+
+static Result RosalinaMenu_LoadBootTrace(void)
+{
+    IFile file;
+    Result res;
+    u64 total = 0;
+    s64 out;
+
+    svcGetSystemInfo(&out, 0x10000, 0x203);
+    FS_ArchiveID archiveId = (bool)out ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
+
+    memset(&bootTrace, 0, sizeof(bootTrace));
+    res = IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, "/luma/boottrace.bin"), FS_OPEN_READ);
+    if(R_FAILED(res))
+        return res;
+
+    res = IFile_Read(&file, &total, &bootTrace, sizeof(bootTrace));
+    IFile_Close(&file);
+
+    if(R_SUCCEEDED(res) && (memcmp(bootTrace.magic, BOOTTRACE_MAGIC, 4) != 0 || bootTrace.version != BOOTTRACE_VERSION || bootTrace.ticksPerSec == 0 ||
+       bootTrace.nbEntries > BOOTTRACE_MAX_ENTRIES ||
+       total < offsetof(BootTrace, entries) + bootTrace.nbEntries * sizeof(BootTraceEntry)))
+        res = MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_UTIL, RD_INVALID_RESULT_VALUE);
+
+    return res;
+}
+
+static u32 RosalinaMenu_DrawBootTraceThroughput(u32 posY, const char *name, u32 size, u64 ticks)
+{
+    if(ticks == 0)
+        return posY;
+
+    return Draw_DrawFormattedString(
+        10, posY, COLOR_WHITE, "%s: %lu KiB in %lu ms (%lu KiB/s).\n",
+        name, size / 1024, (u32)(1000 * ticks / bootTrace.ticksPerSec),
+        (u32)((u64)size * bootTrace.ticksPerSec / ticks / 1024)
+    );
+}
+
+static void RosalinaMenu_DrawBootTrace(u32 posY, Result bootTraceRes)
+{
+    if(R_FAILED(bootTraceRes))
+    {
+        posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Failed to read /luma/boottrace.bin (0x%08lx).\n\n", (u32)bootTraceRes);
+        posY = Draw_DrawString(10, posY, COLOR_WHITE, "Set save_boot_trace in config.ini to write it on boot.\n");
+    }
+    else
+    {
+        // Tenths of milliseconds
+        u64 ticksPerTenthMs = bootTrace.ticksPerSec / 10000;
+
+        posY = Draw_DrawString(10, posY, COLOR_WHITE, "Arm9 boot stages, times in ms.\n\n");
+        posY = Draw_DrawString(10, posY, COLOR_WHITE, "Stage          End   Duration\n");
+        for(u32 i = 1; i < bootTrace.nbEntries; i++)
+        {
+            const BootTraceEntry *entry = &bootTrace.entries[i];
+            u32 end = (u32)((entry->ticks - bootTrace.entries[0].ticks) / ticksPerTenthMs);
+            u32 duration = (u32)((entry->ticks - bootTrace.entries[i - 1].ticks) / ticksPerTenthMs);
+
+            posY = Draw_DrawFormattedString(
+                10, posY, COLOR_WHITE, "%-8.8s %7lu.%lu %8lu.%lu\n",
+                entry->name, end / 10, end % 10, duration / 10, duration % 10
+            );
+        }
+
+        posY += SPACING_Y;
+        posY = RosalinaMenu_DrawBootTraceThroughput(posY, "SD card", bootTrace.sdReadSize, bootTrace.sdReadTicks);
+        posY = RosalinaMenu_DrawBootTraceThroughput(posY, "CTRNAND", bootTrace.ctrNandReadSize, bootTrace.ctrNandReadTicks);
+    }
+
+    // Process creation time, in system ticks
+    u32 pid;
+    Handle processHandle;
+    s64 creationTicks;
+    if(R_SUCCEEDED(svcGetProcessId(&pid, CUR_PROCESS_HANDLE)) && R_SUCCEEDED(svcOpenProcess(&processHandle, pid)))
+    {
+        if(R_SUCCEEDED(svcGetHandleInfo(&creationTicks, processHandle, 0)))
+        {
+            posY = Draw_DrawFormattedString(
+                10, posY + SPACING_Y, COLOR_WHITE, "Rosalina started %lu ms after the Arm11 kernel.\n",
+                (u32)(1000 * creationTicks / SYSCLOCK_ARM11)
+            );
+        }
+        svcCloseHandle(processHandle);
+    }
+
+    Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "Y: back to debug info");
+}
+
 void RosalinaMenu_ShowDebugInfo(void)
 {
     Draw_Lock();
@@ -114,51 +244,103 @@ void RosalinaMenu_ShowDebugInfo(void)
     u32 kernelVer = osGetKernelVersion();
     FS_SdMmcSpeedInfo speedInfo;
 
+    bool showPxiStats = false, showBootTrace = false;
+    Result pxiStatRes = pxiStatInit();
+    Result bootTraceRes = RosalinaMenu_LoadBootTrace();
+    u32 pressed = 0;
+
     do
     {
         Draw_Lock();
-        Draw_DrawString(10, 10, COLOR_TITLE, "Rosalina -- Debug info");
+        if(showBootTrace)
+        {
+            Draw_ClearFramebuffer();
+            Draw_DrawString(10, 10, COLOR_TITLE, "Rosalina -- Debug info (boot)");
+            RosalinaMenu_DrawBootTrace(30, bootTraceRes);
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
 
-        u32 posY = Draw_DrawString(10, 30, COLOR_WHITE, memoryMap);
-        posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Kernel ext PA: %08lx - %08lx\n\n", kextPa, kextPa + kextSize);
-        posY = Draw_DrawFormattedString(
-            10, posY, COLOR_WHITE, "Kernel version: %lu.%lu-%lu\n",
-            GET_VERSION_MAJOR(kernelVer), GET_VERSION_MINOR(kernelVer), GET_VERSION_REVISION(kernelVer)
-        );
-        if (mcuFwVersion != 0)
+            pressed = waitInput();
+        }
+        else if(showPxiStats)
         {
-            posY = Draw_DrawFormattedString(
-                10, posY, COLOR_WHITE, "MCU FW version: %lu.%lu\n",
-                GET_VERSION_MAJOR(mcuFwVersion), GET_VERSION_MINOR(mcuFwVersion)
-            );
+            Draw_ClearFramebuffer();
+            Draw_DrawString(10, 10, COLOR_TITLE, "Rosalina -- Debug info (PXI)");
+            RosalinaMenu_DrawPxiStats(30, pxiStatRes);
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
+
+            pressed = waitInputWithTimeout(1000);
+            if((pressed & KEY_Y) && R_SUCCEEDED(pxiStatRes))
+                PXISTAT_ResetStats();
         }
-
-        if (R_SUCCEEDED(FSUSER_GetSdmcSpeedInfo(&speedInfo)))
+        else
         {
-            u32 clkDiv = 1 << (1 + (speedInfo.sdClkCtrl & 0xFF));
+            Draw_DrawString(10, 10, COLOR_TITLE, "Rosalina -- Debug info");
+            u32 posY = Draw_DrawString(10, 30, COLOR_WHITE, memoryMap);
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Kernel ext PA: %08lx - %08lx\n\n", kextPa, kextPa + kextSize);
             posY = Draw_DrawFormattedString(
-                10, posY, COLOR_WHITE, "SDMC speed: HS=%d %lukHz\n",
-                (int)speedInfo.highSpeedModeEnabled, SYSCLOCK_SDMMC / (1000 * clkDiv)
+                10, posY, COLOR_WHITE, "Kernel version: %lu.%lu-%lu\n",
+                GET_VERSION_MAJOR(kernelVer), GET_VERSION_MINOR(kernelVer), GET_VERSION_REVISION(kernelVer)
             );
+            if (mcuFwVersion != 0)
+            {
+                posY = Draw_DrawFormattedString(
+                    10, posY, COLOR_WHITE, "MCU FW version: %lu.%lu\n",
+                    GET_VERSION_MAJOR(mcuFwVersion), GET_VERSION_MINOR(mcuFwVersion)
+                );
+            }
+
+            if (R_SUCCEEDED(FSUSER_GetSdmcSpeedInfo(&speedInfo)))
+            {
+                u32 clkDiv = 1 << (1 + (speedInfo.sdClkCtrl & 0xFF));
+                posY = Draw_DrawFormattedString(
+                    10, posY, COLOR_WHITE, "SDMC speed: HS=%d %lukHz\n",
+                    (int)speedInfo.highSpeedModeEnabled, SYSCLOCK_SDMMC / (1000 * clkDiv)
+                );
+            }
+            if (R_SUCCEEDED(FSUSER_GetNandSpeedInfo(&speedInfo)))
+            {
+                u32 clkDiv = 1 << (1 + (speedInfo.sdClkCtrl & 0xFF));
+                posY = Draw_DrawFormattedString(
+                    10, posY, COLOR_WHITE, "NAND speed: HS=%d %lukHz\n",
+                    (int)speedInfo.highSpeedModeEnabled, SYSCLOCK_SDMMC / (1000 * clkDiv)
+                );
+            }
+            {
+                posY = Draw_DrawFormattedString(
+                    10, posY, COLOR_WHITE, "APPMEMTYPE: %lu\n",
+                    OS_KernelConfig->app_memtype
+                );
+            }
+            Draw_DrawString(10, SCREEN_BOT_HEIGHT - 20, COLOR_TITLE, "X: PXI statistics, Y: boot timeline");
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
+
+            pressed = waitInput();
         }
-        if (R_SUCCEEDED(FSUSER_GetNandSpeedInfo(&speedInfo)))
+
+        if((pressed & KEY_X) && !showBootTrace)
         {
-            u32 clkDiv = 1 << (1 + (speedInfo.sdClkCtrl & 0xFF));
-            posY = Draw_DrawFormattedString(
-                10, posY, COLOR_WHITE, "NAND speed: HS=%d %lukHz\n",
-                (int)speedInfo.highSpeedModeEnabled, SYSCLOCK_SDMMC / (1000 * clkDiv)
-            );
+            showPxiStats = !showPxiStats;
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
         }
+        else if((pressed & KEY_Y) && !showPxiStats)
         {
-            posY = Draw_DrawFormattedString(
-                10, posY, COLOR_WHITE, "APPMEMTYPE: %lu\n",
-                OS_KernelConfig->app_memtype
-            );
+            showBootTrace = !showBootTrace;
+            Draw_Lock();
+            Draw_ClearFramebuffer();
+            Draw_FlushFramebuffer();
+            Draw_Unlock();
         }
-        Draw_FlushFramebuffer();
-        Draw_Unlock();
     }
-    while(!(waitInput() & KEY_B) && !menuShouldExit);
+    while(!(pressed & KEY_B) && !menuShouldExit);
+
+    if(R_SUCCEEDED(pxiStatRes))
+        pxiStatExit();
 }
 
 void RosalinaMenu_ShowCredits(void)
@@ -356,44 +538,180 @@ void RosalinaMenu_PowerOff(void) // Soft shutdown.
 
 static s64 timeSpentConvertingScreenshot = 0;
 static s64 timeSpentWritingScreenshot = 0;
+static s64 timeSpentTakingScreenshot = 0;
+
+// Screenshot buffers are written by a separate thread, so that the next batch of lines
+// can be converted while the SD card is busy with the previous one
+static struct
+{
+    LightEvent bufferReadyEvent;
+    LightEvent bufferWrittenEvent;
+    IFile *file;
+    const u8 *buf;
+    u32 size;
+    Result res;
+} screenshotWriter;
+
+static MyThread screenshotWriterThread;
+static u8 ALIGN(8) screenshotWriterThreadStack[0x1000];
+
+static void RosalinaMenu_ScreenshotWriterThreadMain(void)
+{
+    for(;;)
+    {
+        LightEvent_Wait(&screenshotWriter.bufferReadyEvent);
+        if(screenshotWriter.buf == NULL)
+            break;
+
+        u64 total;
+        s64 t0 = svcGetSystemTick();
+        if(R_SUCCEEDED(screenshotWriter.res))
+            screenshotWriter.res = IFile_Write(screenshotWriter.file, &total, screenshotWriter.buf, screenshotWriter.size, 0);
+        timeSpentWritingScreenshot += svcGetSystemTick() - t0;
+
+        LightEvent_Signal(&screenshotWriter.bufferWrittenEvent);
+    }
+}
+
+static Result RosalinaMenu_StartScreenshotWriter(void)
+{
+    LightEvent_Init(&screenshotWriter.bufferReadyEvent, RESET_ONESHOT);
+    LightEvent_Init(&screenshotWriter.bufferWrittenEvent, RESET_ONESHOT);
+    LightEvent_Signal(&screenshotWriter.bufferWrittenEvent); // nothing pending
+    screenshotWriter.res = 0;
+
+    return MyThread_Create(&screenshotWriterThread, RosalinaMenu_ScreenshotWriterThreadMain, screenshotWriterThreadStack,
+                           sizeof(screenshotWriterThreadStack), 0x20, CORE_SYSTEM);
+}
+
+static void RosalinaMenu_StopScreenshotWriter(void)
+{
+    LightEvent_Wait(&screenshotWriter.bufferWrittenEvent);
+    screenshotWriter.buf = NULL;
+    LightEvent_Signal(&screenshotWriter.bufferReadyEvent);
+    MyThread_Join(&screenshotWriterThread, -1LL);
+}
+
+// Waits for the previous write (so, the one before it too) to complete, then hands buf over
+static Result RosalinaMenu_QueueScreenshotWrite(IFile *file, const u8 *buf, u32 size)
+{
+    LightEvent_Wait(&screenshotWriter.bufferWrittenEvent);
+    if(R_FAILED(screenshotWriter.res))
+    {
+        LightEvent_Signal(&screenshotWriter.bufferWrittenEvent);
+        return screenshotWriter.res;
+    }
+
+    screenshotWriter.file = file;
+    screenshotWriter.buf = buf;
+    screenshotWriter.size = size;
+    LightEvent_Signal(&screenshotWriter.bufferReadyEvent);
+    return 0;
+}
+
+// Waits for all queued writes, must be done before the buffers are freed
+static Result RosalinaMenu_FlushScreenshotWrites(void)
+{
+    LightEvent_Wait(&screenshotWriter.bufferWrittenEvent);
+    LightEvent_Signal(&screenshotWriter.bufferWrittenEvent);
+    return screenshotWriter.res;
+}
 
 static Result RosalinaMenu_WriteScreenshot(IFile *file, u32 width, bool top, bool left)
 {
-    u64 total;
-    Result res = 0;
+    Result res = 0, writeRes;
     u32 lineSize = 3 * width;
     u32 remaining = lineSize * 240;
 
-    TRY(Draw_AllocateFramebufferCacheForScreenshot(remaining));
+    TRY(Draw_AllocateFramebufferCacheForScreenshot(54 + remaining));
 
+    // Two buffers: one is being converted to while the other is being written
     u8 *framebufferCache = (u8 *)Draw_GetFramebufferCache();
-    u8 *framebufferCacheEnd = framebufferCache + Draw_GetFramebufferCacheSize();
+    u32 bufferSize = Draw_GetFramebufferCacheSize() / 2;
+    u8 *buffers[2] = { framebufferCache, framebufferCache + bufferSize };
+    if (bufferSize < 54 + lineSize)
+    {
+        res = MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY);
+        goto end;
+    }
 
-    u8 *buf = framebufferCache;
-    Draw_CreateBitmapHeader(framebufferCache, width, 240);
-    buf += 54;
+    Draw_CreateBitmapHeader(buffers[0], width, 240);
 
     u32 y = 0;
-    // Our buffer might be smaller than the size of the screenshot...
-    while (remaining != 0)
+    for (u32 i = 0; remaining != 0; i ^= 1)
     {
         s64 t0 = svcGetSystemTick();
-        u32 available = (u32)(framebufferCacheEnd - buf);
-        u32 size = available < remaining ? available : remaining;
-        u32 nlines = size / lineSize;
-        Draw_ConvertFrameBufferLines(buf, width, y, nlines, top, left);
+        u32 headerSize = y == 0 ? 54 : 0; // don't forget to write the header
+        u32 nlines = (bufferSize - headerSize) / lineSize;
+        nlines = nlines * lineSize > remaining ? remaining / lineSize : nlines;
+        Draw_ConvertFrameBufferLines(buffers[i] + headerSize, width, y, nlines, top, left);
+        timeSpentConvertingScreenshot += svcGetSystemTick() - t0;
 
-        s64 t1 = svcGetSystemTick();
-        timeSpentConvertingScreenshot += t1 - t0;
-        TRY(IFile_Write(file, &total, framebufferCache, (y == 0 ? 54 : 0) + lineSize * nlines, 0)); // don't forget to write the header
-        timeSpentWritingScreenshot += svcGetSystemTick() - t1;
+        TRY(RosalinaMenu_QueueScreenshotWrite(file, buffers[i], headerSize + lineSize * nlines));
 
         y += nlines;
         remaining -= lineSize * nlines;
-        buf = framebufferCache;
     }
+
+    end:
+
+    writeRes = RosalinaMenu_FlushScreenshotWrites();
+    if (R_SUCCEEDED(res))
+        res = writeRes;
+    Draw_FreeFramebufferCache();
+    return res;
+}
+
+static Result RosalinaMenu_WriteScreenshotQoi(IFile *file, u32 width, bool top, bool left)
+{
+    static QoiEncoder encoder;
+
+    Result res = 0, writeRes;
+    u32 lineSize = 3 * width;
+
+    TRY(Draw_AllocateFramebufferCacheForScreenshot(lineSize * 240));
+
+    // Converted lines go at the start of the buffer, followed by two output buffers for their encoding:
+    // one is being encoded to while the other is being written
+    u8 *framebufferCache = (u8 *)Draw_GetFramebufferCache();
+    u32 outOverhead = QOI_HEADER_SIZE + QOI_MAX_FINISH_SIZE;
+    u32 maxLines = (Draw_GetFramebufferCacheSize() - 2 * outOverhead) / (lineSize + 2 * QOI_MAX_ENCODED_SIZE(width));
+    maxLines = maxLines > 240 ? 240 : maxLines;
+    if (maxLines == 0)
+    {
+        res = MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY);
+        goto end;
+    }
+
+    u8 *outBuffers[2];
+    outBuffers[0] = framebufferCache + lineSize * maxLines;
+    outBuffers[1] = outBuffers[0] + outOverhead + QOI_MAX_ENCODED_SIZE(width) * maxLines;
+    u32 outSize = QoiEncoder_Init(&encoder, outBuffers[0], width, 240);
+
+    // Framebuffer line 0 is the bottom of the image, QOI wants it top to bottom
+    u32 y = 240;
+    for (u32 i = 0; y != 0; i ^= 1)
+    {
+        s64 t0 = svcGetSystemTick();
+        u8 *out = outBuffers[i];
+        u32 nlines = y < maxLines ? y : maxLines;
+        y -= nlines;
+        Draw_ConvertFrameBufferLines(framebufferCache, width, y, nlines, top, left);
+        for (u32 j = nlines; j > 0; j--)
+            outSize += QoiEncoder_EncodeBGR8(&encoder, out + outSize, framebufferCache + lineSize * (j - 1), width);
+        if (y == 0)
+            outSize += QoiEncoder_Finish(&encoder, out + outSize);
+        timeSpentConvertingScreenshot += svcGetSystemTick() - t0;
+
+        TRY(RosalinaMenu_QueueScreenshotWrite(file, out, outSize));
+        outSize = 0;
+    }
+
     end:
 
+    writeRes = RosalinaMenu_FlushScreenshotWrites();
+    if (R_SUCCEEDED(res))
+        res = writeRes;
     Draw_FreeFramebufferCache();
     return res;
 }
@@ -411,12 +729,28 @@ void RosalinaMenu_TakeScreenshot(void)
     s64 out;
     bool isSdMode;
 
+    Result (*writeScreenshot)(IFile *file, u32 width, bool top, bool left);
+    const char *ext;
+
+    s64 startTick = svcGetSystemTick();
     timeSpentConvertingScreenshot = 0;
     timeSpentWritingScreenshot = 0;
 
     if(R_FAILED(svcGetSystemInfo(&out, 0x10000, 0x203))) svcBreak(USERBREAK_ASSERT);
     isSdMode = (bool)out;
 
+    svcGetSystemInfo(&out, 0x10000, 0x10D);
+    if(out == SCREENSHOT_FORMAT_QOI)
+    {
+        writeScreenshot = RosalinaMenu_WriteScreenshotQoi;
+        ext = "qoi";
+    }
+    else
+    {
+        writeScreenshot = RosalinaMenu_WriteScreenshot;
+        ext = "bmp";
+    }
+
     archiveId = isSdMode ? ARCHIVE_SDMC : ARCHIVE_NAND_RW;
     Draw_Lock();
     Draw_RestoreFramebuffer();
@@ -441,26 +775,31 @@ void RosalinaMenu_TakeScreenshot(void)
 
     dateTimeToString(dateTimeStr, osGetTime(), true);
 
-    sprintf(filename, "/luma/screenshots/%s_top.bmp", dateTimeStr);
+    TRY(RosalinaMenu_StartScreenshotWriter());
+
+    sprintf(filename, "/luma/screenshots/%s_top.%s", dateTimeStr, ext);
     TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
-    TRY(RosalinaMenu_WriteScreenshot(&file, topWidth, true, true));
+    TRY(writeScreenshot(&file, topWidth, true, true));
     TRY(IFile_Close(&file));
 
-    sprintf(filename, "/luma/screenshots/%s_bot.bmp", dateTimeStr);
+    sprintf(filename, "/luma/screenshots/%s_bot.%s", dateTimeStr, ext);
     TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
-    TRY(RosalinaMenu_WriteScreenshot(&file, bottomWidth, false, true));
+    TRY(writeScreenshot(&file, bottomWidth, false, true));
     TRY(IFile_Close(&file));
 
     if(is3d && (Draw_GetCurrentFramebufferAddress(true, true) != Draw_GetCurrentFramebufferAddress(true, false)))
     {
-        sprintf(filename, "/luma/screenshots/%s_top_right.bmp", dateTimeStr);
+        sprintf(filename, "/luma/screenshots/%s_top_right.%s", dateTimeStr, ext);
         TRY(IFile_Open(&file, archiveId, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, filename), FS_OPEN_CREATE | FS_OPEN_WRITE));
-        TRY(RosalinaMenu_WriteScreenshot(&file, topWidth, true, false));
+        TRY(writeScreenshot(&file, topWidth, true, false));
         TRY(IFile_Close(&file));
     }
 
 end:
     IFile_Close(&file);
+    if(screenshotWriterThread.handle != 0)
+        RosalinaMenu_StopScreenshotWriter();
+    timeSpentTakingScreenshot = svcGetSystemTick() - startTick;
 
     if (R_FAILED(Draw_AllocateFramebufferCache(FB_BOTTOM_SIZE)))
         __builtin_trap(); // We're f***ed if this happens
@@ -479,10 +818,12 @@ end:
         {
             u32 t1 = (u32)(1000 * timeSpentConvertingScreenshot / SYSCLOCK_ARM11);
             u32 t2 = (u32)(1000 * timeSpentWritingScreenshot / SYSCLOCK_ARM11);
+            u32 t3 = (u32)(1000 * timeSpentTakingScreenshot / SYSCLOCK_ARM11);
             u32 posY = 30;
             posY = Draw_DrawString(10, posY, COLOR_WHITE, "Operation succeeded.\n\n");
             posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Time spent converting:    %5lums\n", t1);
             posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Time spent writing files: %5lums\n", t2);
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Total time (wall clock):  %5lums\n", t3);
         }
 
         Draw_FlushFramebuffer();
@@ -35,6 +35,7 @@
 #include "gdb/monitor.h"
 #include "gdb/net.h"
 #include "pmdbgext.h"
+#include "ipc_trace.h"
 
 Menu debuggerMenu = {
     "Debugger options menu",
@@ -42,6 +43,8 @@ Menu debuggerMenu = {
         { "Enable debugger",                        METHOD, .method = &DebuggerMenu_EnableDebugger  },
         { "Disable debugger",                       METHOD, .method = &DebuggerMenu_DisableDebugger },
         { "Force-debug next application at launch", METHOD, .method = &DebuggerMenu_DebugNextApplicationByForce },
+        { "SVC profiler",                           METHOD, .method = &DebuggerMenu_SvcProfiler },
+        { "IPC trace",                              METHOD, .method = &DebuggerMenu_IpcTrace },
         {},
     }
 };
@@ -236,6 +239,210 @@ void DebuggerMenu_DebugNextApplicationByForce(void)
     while(!(waitInput() & KEY_B) && !menuShouldExit);
 }
 
+#define SVC_PROFILER_NB_ROWS    8
+#define SVC_PROFILER_NB_BUCKETS 8
+
+typedef struct SvcProfilerRow
+{
+    u32 svcId;
+    u32 count;
+    u64 totalCycles;
+    u32 maxCycles;
+} SvcProfilerRow;
+
+// Fetches the SVCs the profiled process spent the most time in, sorted
+static u32 DebuggerMenu_GetSvcProfilerRows(SvcProfilerRow *rows)
+{
+    u32 nbRows = 0;
+
+    for(u32 svcId = 0; svcId < 0x100; svcId++)
+    {
+        s64 count, totalCycles, maxCycles;
+        if(R_FAILED(svcGetSystemInfo(&count, 0x10003, 0x100 | svcId)) || count == 0)
+            continue;
+        svcGetSystemInfo(&totalCycles, 0x10003, 0x200 | svcId);
+        svcGetSystemInfo(&maxCycles, 0x10003, 0x300 | svcId);
+
+        u32 pos;
+        for(pos = nbRows; pos > 0 && rows[pos - 1].totalCycles < (u64)totalCycles; pos--)
+        {
+            if(pos < SVC_PROFILER_NB_ROWS)
+                rows[pos] = rows[pos - 1];
+        }
+
+        if(pos < SVC_PROFILER_NB_ROWS)
+        {
+            rows[pos].svcId = svcId;
+            rows[pos].count = (u32)count;
+            rows[pos].totalCycles = (u64)totalCycles;
+            rows[pos].maxCycles = (u32)maxCycles;
+            if(nbRows < SVC_PROFILER_NB_ROWS)
+                nbRows++;
+        }
+    }
+
+    return nbRows;
+}
+
+void DebuggerMenu_SvcProfiler(void)
+{
+    static const char *bucketNames[SVC_PROFILER_NB_BUCKETS] = { "<256", "<1K", "<4K", "<16K", "<64K", "<256K", "<1M", ">=1M" };
+
+    SvcProfilerRow rows[SVC_PROFILER_NB_ROWS];
+    u32 selected = 0;
+    Result res = 0;
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        s64 out, clkRate;
+        svcGetSystemInfo(&out, 0x10003, 0);
+        u32 profiledPid = (u32)out;
+
+        // The cycle counter runs at the CPU clock rate
+        if(R_FAILED(svcGetSystemInfo(&clkRate, 0x10001, 0)))
+            clkRate = 268;
+
+        u32 nbRows = profiledPid != 0xFFFFFFFF ? DebuggerMenu_GetSvcProfilerRows(rows) : 0;
+        if(selected >= nbRows)
+            selected = nbRows == 0 ? 0 : nbRows - 1;
+
+        Draw_Lock();
+        Draw_ClearFramebuffer();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Debugger options menu -- SVC profiler");
+
+        u32 posY = 30;
+        if(R_FAILED(res))
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Operation failed (0x%08lx).\n", (u32)res);
+        else if(profiledPid == 0xFFFFFFFF)
+            posY = Draw_DrawString(10, posY, COLOR_WHITE, "Profiler disabled.\n");
+        else
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Profiling process %lu (%lluMHz).\n", profiledPid, clkRate);
+        posY = Draw_DrawString(10, posY, COLOR_WHITE, "A: (re)start on the current app, X: stop.\n\n");
+
+        posY = Draw_DrawString(10, posY, COLOR_WHITE, "    ID      Calls   Avg (us)   Max (us)\n");
+        for(u32 i = 0; i < nbRows; i++)
+        {
+            Draw_DrawCharacter(10, posY, COLOR_TITLE, i == selected ? '>' : ' ');
+            posY = Draw_DrawFormattedString(
+                34, posY, COLOR_WHITE, "%02lx %10lu %10lu %10lu\n",
+                rows[i].svcId, rows[i].count,
+                (u32)(rows[i].totalCycles / rows[i].count / (u64)clkRate), rows[i].maxCycles / (u32)clkRate
+            );
+        }
+
+        if(nbRows > 0)
+        {
+            posY = Draw_DrawFormattedString(10, posY + SPACING_Y, COLOR_WHITE, "SVC 0x%02lx, calls by cycle count:\n", rows[selected].svcId);
+            for(u32 i = 0; i < SVC_PROFILER_NB_BUCKETS; i += 2)
+            {
+                s64 a, b;
+                svcGetSystemInfo(&a, 0x10003, ((4 + i) << 8) | rows[selected].svcId);
+                svcGetSystemInfo(&b, 0x10003, ((5 + i) << 8) | rows[selected].svcId);
+                posY = Draw_DrawFormattedString(
+                    10, posY, COLOR_WHITE, "  %-6s %10lu    %-6s %10lu\n",
+                    bucketNames[i], (u32)a, bucketNames[i + 1], (u32)b
+                );
+            }
+        }
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+
+        if(pressed & KEY_A)
+        {
+            FS_ProgramInfo progInfo;
+            u32 pid, launchFlags;
+            res = PMDBG_GetCurrentAppInfo(&progInfo, &pid, &launchFlags);
+            if(R_SUCCEEDED(res))
+            {
+                if(profiledPid != 0xFFFFFFFF && profiledPid != pid)
+                    svcKernelSetState(0x10008, profiledPid, false);
+                res = svcKernelSetState(0x10008, pid, true);
+            }
+            selected = 0;
+        }
+        else if(pressed & KEY_X)
+            res = profiledPid != 0xFFFFFFFF ? svcKernelSetState(0x10008, profiledPid, false) : 0;
+        else if(pressed & KEY_DOWN)
+            selected = nbRows == 0 ? 0 : (selected + 1) % nbRows;
+        else if(pressed & KEY_UP)
+            selected = nbRows == 0 ? 0 : (selected + nbRows - 1) % nbRows;
+        else if(pressed & KEY_B)
+            break;
+    }
+    while(!menuShouldExit);
+}
+
+void DebuggerMenu_IpcTrace(void)
+{
+    Result res = 0;
+    bool isSocURegistered;
+
+    res = srvIsServiceRegistered(&isSocURegistered, "soc:U");
+    isSocURegistered = R_SUCCEEDED(res) && isSocURegistered;
+    res = 0;
+
+    Draw_Lock();
+    Draw_ClearFramebuffer();
+    Draw_FlushFramebuffer();
+    Draw_Unlock();
+
+    do
+    {
+        Draw_Lock();
+        Draw_ClearFramebuffer();
+        Draw_DrawString(10, 10, COLOR_TITLE, "Debugger options menu -- IPC trace");
+
+        u32 posY = 30;
+        if(!isSocURegistered)
+            posY = Draw_DrawString(10, posY, COLOR_WHITE, "Can't start the IPC trace before the system has\nfinished loading.\n");
+        else if(R_FAILED(res))
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Operation failed (0x%08lx).\n", (u32)res);
+        else if(!ipcTraceEnabled)
+            posY = Draw_DrawString(10, posY, COLOR_WHITE, "IPC trace disabled.\n");
+        else
+        {
+            u32 ip = socGethostid();
+            u8 *addr = (u8 *)&ip;
+            posY = Draw_DrawFormattedString(
+                10, posY, COLOR_WHITE, "Listening on %hhu.%hhu.%hhu.%hhu:%u (%s).\n",
+                addr[0], addr[1], addr[2], addr[3], IPC_TRACE_PORT,
+                ipcTraceClientConnected ? "client connected" : "no client"
+            );
+        }
+        posY = Draw_DrawString(10, posY, COLOR_WHITE, "A: start, X: stop.\n\n");
+
+        const IpcTraceHeader *buf = IpcTrace_GetBuffer();
+        if(ipcTraceEnabled && buf != NULL)
+        {
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Events sent:    %10lu\n", ipcTraceNbEventsSent);
+            posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Events dropped: %10lu\n\n", ipcTraceNbEventsDropped);
+            for(u32 i = 0; i < buf->nbCores; i++)
+                posY = Draw_DrawFormattedString(10, posY, COLOR_WHITE, "Events recorded on core %lu: %10lu\n", i, buf->writeIndices[i]);
+        }
+
+        Draw_FlushFramebuffer();
+        Draw_Unlock();
+
+        u32 pressed = waitInputWithTimeout(1000);
+
+        if((pressed & KEY_A) && isSocURegistered)
+            res = IpcTrace_Enable();
+        else if(pressed & KEY_X)
+            res = IpcTrace_Disable(2 * 1000 * 1000 * 1000LL);
+        else if(pressed & KEY_B)
+            break;
+    }
+    while(!menuShouldExit);
+}
+
 void debuggerSocketThreadMain(void)
 {
     GDB_IncrementServerReferenceCount(&gdbServer);
@@ -115,6 +115,7 @@ void MiscellaneousMenu_SwitchBoot3dsxTargetTitle(void)
     }
 
     Luma_SharedConfig->selected_hbldr_3dsx_tid = newTid;
+    LumaConfig_RequestSaveSettings();
 
     // Move "selected" field to "current" if no app is currently running.
     // Otherwise, PM will do it on app exit.
@@ -171,6 +172,7 @@ void MiscellaneousMenu_ChangeMenuCombo(void)
 
     menuCombo = waitCombo();
     LumaConfig_ConvertComboToString(comboStr, menuCombo);
+    LumaConfig_RequestSaveSettings();
 
     do
     {
@@ -347,6 +349,7 @@ void MiscellaneousMenu_UpdateTimeDateNtp(void)
 
     utcOffset -= 12;
     lastNtpTzOffset = 60 * utcOffset + utcOffsetMinute;
+    LumaConfig_RequestSaveSettings();
 
     res = srvIsServiceRegistered(&isSocURegistered, "soc:U");
     cantStart = R_FAILED(res) || !isSocURegistered;
@@ -29,6 +29,7 @@
 #include "memory.h"
 #include "menu.h"
 #include "menus/screen_filters.h"
+#include "luma_config.h"
 #include "draw.h"
 #include "redshift/colorramp.h"
 
@@ -127,6 +128,7 @@ static void ScreenFiltersMenu_SetCct(u16 cct)
     bottomScreenFilter.cct = cct;
     ScreenFiltersMenu_ApplyColorSettings(true);
     ScreenFiltersMenu_ApplyColorSettings(false);
+    LumaConfig_RequestSaveSettings();
 }
 
 Menu screenFiltersMenu = {
@@ -324,6 +326,7 @@ void ScreenFiltersMenu_AdvancedConfiguration(void)
     int mult = 1;
 
     bool sync = true;
+    bool changed = false;
 
     do
     {
@@ -350,6 +353,7 @@ void ScreenFiltersMenu_AdvancedConfiguration(void)
             ScreenFiltersMenu_AdvancedConfigurationChangeValue(pos, -mult, sync);
         if (input & KEY_RIGHT)
             ScreenFiltersMenu_AdvancedConfigurationChangeValue(pos, mult, sync);
+        changed = changed || (input & (KEY_LEFT | KEY_RIGHT));
         if (input & KEY_UP)
             pos = (10 + pos - 1) % 10;
         if (input & KEY_DOWN)
@@ -359,4 +363,7 @@ void ScreenFiltersMenu_AdvancedConfiguration(void)
         Draw_Unlock();
     }
     while(!(input & (KEY_A | KEY_B)) && !menuShouldExit);
+
+    if (changed)
+        LumaConfig_RequestSaveSettings();
 }
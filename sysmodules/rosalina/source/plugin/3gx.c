@@ -110,29 +110,40 @@ Result  Read_3gx_LoadSegments(IFile *file, _3gx_Header *header, void *dst)
     return res;
 }
 
-Result Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header)
+Result Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header, _3gx_EmbeddedPayloads *payloads)
 {
-    u32                 tempBuff[32];
-    u32                 tempBuff2[4];
     u64                 total;
     Result              res = 0;
-    PluginLoaderContext *ctx = &PluginLoaderCtx;
-    
+
     if (header->infos.embeddedExeLoadFunc) {
         file->pos = header->executable.exeLoadFuncOffset;
-        res = IFile_Read(file, &total, tempBuff, sizeof(tempBuff));
+        res = IFile_Read(file, &total, payloads->exeLoadFunc, sizeof(payloads->exeLoadFunc));
+    }
+    if (!res && header->infos.embeddedSwapSaveLoadFunc) {
+        file->pos = header->executable.swapSaveFuncOffset;
+        res = IFile_Read(file, &total, payloads->swapSaveFunc, sizeof(payloads->swapSaveFunc));
+        file->pos = header->executable.swapLoadFuncOffset;
+        if (!res) res = IFile_Read(file, &total, payloads->swapLoadFunc, sizeof(payloads->swapLoadFunc));
+    }
+    if (!res) res = Apply_3gx_EmbeddedPayloads(header, payloads);
+    return res;
+}
+
+Result Apply_3gx_EmbeddedPayloads(_3gx_Header *header, _3gx_EmbeddedPayloads *payloads)
+{
+    u32                 tempBuff2[4];
+    Result              res = 0;
+    PluginLoaderContext *ctx = &PluginLoaderCtx;
+
+    if (header->infos.embeddedExeLoadFunc) {
         memcpy(tempBuff2, header->infos.builtInLoadExeArgs, sizeof(tempBuff2));
-        if (!res) res = Set_3gx_LoadParams(tempBuff, tempBuff2);
+        res = Set_3gx_LoadParams(payloads->exeLoadFunc, tempBuff2);
         if (!res) ctx->isExeLoadFunctionset = true;
     }
     if (!res && header->infos.embeddedSwapSaveLoadFunc) {
-        file->pos = header->executable.swapSaveFuncOffset;
-        res = IFile_Read(file, &total, tempBuff, sizeof(tempBuff));
         memcpy(tempBuff2, header->infos.builtInSwapSaveLoadArgs, sizeof(tempBuff2));
-        if (!res) res = MemoryBlock__SetSwapSettings(tempBuff, false, tempBuff2);
-        file->pos = header->executable.swapLoadFuncOffset;
-        if (!res) res = IFile_Read(file, &total, tempBuff, sizeof(tempBuff));
-        if (!res) res = MemoryBlock__SetSwapSettings(tempBuff, true, tempBuff2);
+        res = MemoryBlock__SetSwapSettings(payloads->swapSaveFunc, false, tempBuff2);
+        if (!res) res = MemoryBlock__SetSwapSettings(payloads->swapLoadFunc, true, tempBuff2);
         if (!res) ctx->isSwapFunctionset = true;
     }
     return res;
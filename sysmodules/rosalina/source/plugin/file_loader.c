@@ -5,10 +5,43 @@
 #include "plugin.h"
 #include "ifile.h"
 #include "ifile.h"
+#include "plugin/plgindex.h"
+#include "plugin/plgcache.h"
 #include "utils.h"
+#include "task_runner.h"
 
 // Use a global to avoid stack overflow, those structs are quite heavy
 static FS_DirectoryEntry   g_entries[10];
+static PluginIndex         g_pluginIndex;
+static _3gx_EmbeddedPayloads g_payloads;
+
+// Everything PreparePlugin needs is copied in when the job is created, so that a prefetch running
+// on the task runner doesn't depend on plg:ldr commands received meanwhile
+typedef struct
+{
+    u64             titleId;
+    bool            useUserLoadParameters;
+    PluginLoadParameters    userLoadParameters;
+    u8              pluginMemoryStrategy;
+
+    Result          result;
+    Error           error; ///< Only reported by TryToLoadPlugin, on plg:ldr's thread
+    bool            memblockFailed; ///< TryToLoadPlugin reboots
+    IFile           plugin;
+    _3gx_Header *   header;
+}   PluginLoadJob;
+
+typedef struct
+{
+    bool            isActive; ///< Started and its result not consumed yet
+    LightEvent      doneEvent;
+    PluginLoadJob   job;
+}   PluginPrefetch;
+
+static PluginPrefetch       g_prefetch;
+static PluginLoadJob        g_loadJob;
+static PluginLaunchTimeline g_launchTimeline;
+static bool                g_pluginIndexLoaded;
 
 static char        g_path[256];
 static const char *g_dirPath = "/luma/plugins/%016llX";
@@ -28,34 +61,116 @@ static u32     strlen16(const u16 *str)
     return strEnd - str;
 }
 
-static Result   FindPluginFile(u64 tid)
+static void     LoadPluginIndex(FS_Archive sdmcArchive)
+{
+    IFile   file;
+    u64     total = 0;
+
+    g_pluginIndexLoaded = true;
+
+    if (R_FAILED(IFile_OpenFromArchive(&file, sdmcArchive, fsMakePath(PATH_ASCII, PLUGIN_INDEX_PATH), FS_OPEN_READ)))
+    {
+        PluginIndex__Reset(&g_pluginIndex);
+        return;
+    }
+
+    if (R_FAILED(IFile_Read(&file, &total, &g_pluginIndex, sizeof(PluginIndex)))
+        || total < PluginIndex__GetUsedSize(&g_pluginIndex) || !PluginIndex__IsValid(&g_pluginIndex))
+        PluginIndex__Reset(&g_pluginIndex);
+
+    IFile_Close(&file);
+}
+
+static void     SavePluginIndex(FS_Archive sdmcArchive)
+{
+    IFile   file;
+    u64     total = 0;
+    u32     size = PluginIndex__GetUsedSize(&g_pluginIndex);
+
+    if (R_FAILED(IFile_OpenFromArchive(&file, sdmcArchive, fsMakePath(PATH_ASCII, PLUGIN_INDEX_PATH), FS_OPEN_WRITE | FS_OPEN_CREATE)))
+        return;
+
+    // Not critical: if this fails, the index is rebuilt on the next launch
+    if (R_SUCCEEDED(IFile_Write(&file, &total, &g_pluginIndex, size, FS_WRITE_FLUSH)))
+        IFile_SetSize(&file, size);
+
+    IFile_Close(&file);
+}
+
+// Returns 0 if the timestamp couldn't be retrieved (e.g. the file or directory doesn't exist)
+static u64      GetPathTimestamp(FS_Archive sdmcArchive, const char *path)
+{
+    u16     path16[256];
+    u64     timestamp = 0;
+    ssize_t units = utf8_to_utf16(path16, (const u8 *)path, 255);
+
+    if (units < 0)
+        return 0;
+    path16[units] = 0;
+
+    if (R_FAILED(FSUSER_ControlArchive(sdmcArchive, ARCHIVE_ACTION_GET_TIMESTAMP, path16, (units + 1) * sizeof(u16), &timestamp, sizeof(timestamp))))
+        return 0;
+
+    return timestamp;
+}
+
+static u64      GetPluginFileTimestamp(const char *path)
+{
+    FS_Archive  sdmcArchive = 0;
+    u64         timestamp = 0;
+
+    if (R_SUCCEEDED(FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""))))
+    {
+        timestamp = GetPathTimestamp(sdmcArchive, path);
+        FSUSER_CloseArchive(sdmcArchive);
+    }
+
+    return timestamp;
+}
+
+// Number of entries in the directory, 0 if it can't be opened
+static u32      CountDirectoryEntries(FS_Archive sdmcArchive, const char *path)
+{
+    u32     entriesNb = 0;
+    u32     total = 0;
+    Handle  dir = 0;
+
+    if (R_FAILED(FSUSER_OpenDirectory(&dir, sdmcArchive, fsMakePath(PATH_ASCII, path))))
+        return 0;
+
+    while (R_SUCCEEDED(FSDIR_Read(dir, &entriesNb, 10, g_entries)) && entriesNb != 0)
+        total += entriesNb;
+
+    FSDIR_Close(dir);
+
+    return total;
+}
+
+// Finds the first plugin of the directory, and counts its entries for the index
+static Result   ScanPluginDirectory(FS_Archive sdmcArchive, const char *path, char *filename, u32 *nbEntries)
 {
-    char                filename[256];
     u32                 entriesNb = 0;
     bool                found = false;
     Handle              dir = 0;
     Result              res;
-    FS_Archive          sdmcArchive = 0;
     FS_DirectoryEntry * entries = g_entries;
-    
-    memset(entries, 0, sizeof(g_entries));
-    sprintf(g_path, g_dirPath, tid);
 
-    if (R_FAILED((res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))))
-        goto exit;
+    *nbEntries = 0;
+    memset(entries, 0, sizeof(g_entries));
 
-    if (R_FAILED((res = FSUSER_OpenDirectory(&dir, sdmcArchive, fsMakePath(PATH_ASCII, g_path)))))
-        goto exit;
+    if (R_FAILED((res = FSUSER_OpenDirectory(&dir, sdmcArchive, fsMakePath(PATH_ASCII, path)))))
+        return res;
 
-    strcat(g_path, "/");
-    while (!found && R_SUCCEEDED(FSDIR_Read(dir, &entriesNb, 10, entries)))
+    while (R_SUCCEEDED(FSDIR_Read(dir, &entriesNb, 10, entries)))
     {
         if (entriesNb == 0)
             break;
 
+        *nbEntries += entriesNb;
+
         static const u16 *   validExtension = u"3gx";
 
-        for (u32 i = 0; i < entriesNb; ++i)
+        for (u32 i = 0; !found && i < entriesNb; ++i)
         {
             FS_DirectoryEntry *entry = &entries[i];
 
@@ -79,14 +194,67 @@ static Result   FindPluginFile(u64 tid)
                 continue;
             filename[units] = 0;
             found = true;
-            break;
         }
     }
 
-    if (!found)
-        res = MAKERESULT(28, 4, 0, 1018);
+    FSDIR_Close(dir);
+
+    return found ? 0 : MAKERESULT(28, 4, 0, 1018);
+}
+
+static Result   FindPluginFile(u64 tid, bool useIndex, bool *fromIndex)
+{
+    char                filename[256];
+    Result              res;
+    FS_Archive          sdmcArchive = 0;
+    PluginIndexEntry *  indexEntry = NULL;
+
+    *fromIndex = false;
+    sprintf(g_path, g_dirPath, tid);
+
+    if (R_FAILED((res = FSUSER_OpenArchive(&sdmcArchive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))))
+        goto exit;
+
+    if (!g_pluginIndexLoaded)
+        LoadPluginIndex(sdmcArchive);
+
+    // The directory timestamp changes when plugins are renamed, its entry count when they are
+    // added or removed. Only count the entries when that can save the scan
+    u64 timestamp = GetPathTimestamp(sdmcArchive, g_path);
+    u32 nbEntries = 0;
+
+    if (useIndex)
+        indexEntry = PluginIndex__Find(&g_pluginIndex, tid);
+
+    if (indexEntry != NULL && timestamp != 0 && indexEntry->dirTimestamp == timestamp)
+        indexEntry = PluginIndex__Lookup(&g_pluginIndex, tid, timestamp, CountDirectoryEntries(sdmcArchive, g_path));
     else
+        indexEntry = NULL;
+
+    if (indexEntry != NULL)
     {
+        strcpy(filename, indexEntry->fileName);
+        res = 0;
+        *fromIndex = true;
+    }
+    else
+    {
+        res = ScanPluginDirectory(sdmcArchive, g_path, filename, &nbEntries);
+
+        // Only remember found plugins: a file replacing another keeps both the directory timestamp
+        // and entry count, so a directory without plugin must be scanned again on every launch
+        if (timestamp != 0 && R_SUCCEEDED(res))
+        {
+            PluginIndex__Insert(&g_pluginIndex, tid, timestamp, nbEntries, filename);
+            SavePluginIndex(sdmcArchive);
+        }
+        else if (PluginIndex__Remove(&g_pluginIndex, tid))
+            SavePluginIndex(sdmcArchive);
+    }
+
+    if (R_SUCCEEDED(res))
+    {
+        strcat(g_path, "/");
         u32 len = strlen(g_path);
         filename[256 - len] = 0;
         strcat(g_path, filename);
@@ -94,7 +262,6 @@ static Result   FindPluginFile(u64 tid)
     }
 
 exit:
-    FSDIR_Close(dir);
     FSUSER_CloseArchive(sdmcArchive);
 
     return res;
@@ -107,7 +274,18 @@ static Result   OpenFile(IFile *file, const char *path)
 
 static Result   OpenPluginFile(u64 tid, IFile *plugin)
 {
-    if (R_FAILED(FindPluginFile(tid)) || OpenFile(plugin, g_path))
+    bool    fromIndex;
+    Result  res = FindPluginFile(tid, true, &fromIndex);
+    bool    indexedPlugin = R_SUCCEEDED(res) && fromIndex;
+
+    if (R_SUCCEEDED(res))
+        res = OpenFile(plugin, g_path);
+
+    // The indexed plugin was replaced without changing the directory timestamp nor entry count, rescan it
+    if (R_FAILED(res) && indexedPlugin && R_SUCCEEDED(FindPluginFile(tid, false, &fromIndex)))
+        res = OpenFile(plugin, g_path);
+
+    if (R_FAILED(res))
     {
         // Try to open default plugin
         if (OpenFile(plugin, g_defaultPath))
@@ -121,7 +299,7 @@ static Result   OpenPluginFile(u64 tid, IFile *plugin)
     return 0;
 }
 
-static Result   CheckPluginCompatibility(_3gx_Header *header, u32 processTitle)
+static Result   CheckPluginCompatibility(_3gx_Header *header, u32 processTitle, Error *error)
 {
     static char   errorBuf[0x100];
 
@@ -137,20 +315,42 @@ static Result   CheckPluginCompatibility(_3gx_Header *header, u32 processTitle)
     sprintf(errorBuf, "The plugin - %s -\nis not compatible with this game.\n" \
                       "Contact \"%s\" for more infos.", header->infos.titleMsg, header->infos.authorMsg);
     
-    PluginLoaderCtx.error.message = errorBuf;
+    error->message = errorBuf;
 
     return -1;
 }
 
-bool     TryToLoadPlugin(Handle process)
+// Must be called on plg:ldr's thread, as it consumes the user load parameters
+static void     InitLoadJob(PluginLoadJob *job, u64 tid)
 {
-    u64             tid;
+    PluginLoaderContext *ctx = &PluginLoaderCtx;
+
+    memset(job, 0, sizeof(PluginLoadJob));
+    job->titleId = tid;
+    job->pluginMemoryStrategy = ctx->pluginMemoryStrategy;
+
+    if (ctx->useUserLoadParameters && (u32)tid == ctx->userLoadParameters.lowTitleId)
+    {
+        ctx->useUserLoadParameters = false;
+        job->useUserLoadParameters = true;
+        job->userLoadParameters = ctx->userLoadParameters;
+        job->pluginMemoryStrategy = job->userLoadParameters.pluginMemoryStrategy;
+    }
+}
+
+// Reads, decodes and verifies the plugin into the memory block, without touching the process.
+// Doesn't report errors, as it may run on the task runner
+static Result   PreparePlugin(PluginLoadJob *job)
+{
+    u64             tid = job->titleId;
     u64             fileSize;
+    u64             timestamp = 0;
     IFile           plugin;
     Result          res;
     _3gx_Header     fileHeader;
     _3gx_Header     *header = NULL;
-    _3gx_Executable *exeHdr = NULL;
+    PluginCacheEntry    *cached = NULL;
+    Error               *error = &job->error;
     PluginLoaderContext *ctx = &PluginLoaderCtx;
     PluginHeader        *pluginHeader = &ctx->header;
     const u32           memRegionSizes[] = 
@@ -161,34 +361,39 @@ bool     TryToLoadPlugin(Handle process)
         5 * 1024 * 1024, // 5 MiB (Reserved)
     };
 
-    // Get title id
-    svcGetProcessInfo((s64 *)&tid, process, 0x10001);
-
     memset(pluginHeader, 0, sizeof(PluginHeader));
     pluginHeader->magic = HeaderMagic;
+    ctx->pluginMemoryStrategy = job->pluginMemoryStrategy;
 
     // Try to open plugin file
-    if (ctx->useUserLoadParameters && (u32)tid == ctx->userLoadParameters.lowTitleId)
+    if (job->useUserLoadParameters)
     {
-        ctx->useUserLoadParameters = false;
-        ctx->pluginMemoryStrategy = ctx->userLoadParameters.pluginMemoryStrategy;
-        if (OpenFile(&plugin, ctx->userLoadParameters.path))
-            return false;
+        if (OpenFile(&plugin, job->userLoadParameters.path))
+            return -1;
 
-        ctx->pluginPath = ctx->userLoadParameters.path;
+        ctx->pluginPath = job->userLoadParameters.path;
 
-        memcpy(pluginHeader->config, ctx->userLoadParameters.config, 32 * sizeof(u32));
+        memcpy(pluginHeader->config, job->userLoadParameters.config, 32 * sizeof(u32));
     }
     else
     {
         if (R_FAILED(OpenPluginFile(tid, &plugin)))
-            return false;
+            return -1;
     }
 
     if (R_FAILED((res = IFile_GetSize(&plugin, &fileSize))))
-        ctx->error.message = "Couldn't get file size";
+        error->message = "Couldn't get file size";
+
+    // A cached plugin image doesn't need to be read nor decoded again
+    bool useCache = PluginCache__IsEnabled() && MemoryBlock__UsesAppRegion();
+
+    if (!res && useCache)
+    {
+        timestamp = GetPluginFileTimestamp(ctx->pluginPath);
+        cached = PluginCache__Find(ctx->pluginPath, fileSize, timestamp);
+    }
 
-    if (!res && R_FAILED(res = Check_3gx_Magic(&plugin)))
+    if (!res && !cached && R_FAILED(res = Check_3gx_Magic(&plugin)))
     {
         const char * errors[] = 
         {
@@ -198,54 +403,191 @@ bool     TryToLoadPlugin(Handle process)
             "Outdated plugin loader\nCheck for Luma3DS updates."   
         };
 
-        ctx->error.message = errors[R_MODULE(res) == RM_LDR ? R_DESCRIPTION(res) : 0];
+        error->message = errors[R_MODULE(res) == RM_LDR ? R_DESCRIPTION(res) : 0];
     }
 
     // Read header
-    if (!res && R_FAILED((res = Read_3gx_Header(&plugin, &fileHeader))))
-        ctx->error.message = "Couldn't read file";
+    if (!res && cached)
+        memcpy(&fileHeader, PluginCache__GetHeader(cached), sizeof(_3gx_Header));
+    else if (!res && R_FAILED((res = Read_3gx_Header(&plugin, &fileHeader))))
+        error->message = "Couldn't read file";
 
     // Set memory region size according to header
     if (!res && R_FAILED((res = MemoryBlock__SetSize(memRegionSizes[fileHeader.infos.memoryRegionSize])))) {
-        ctx->error.message = "Couldn't set memblock size.";
+        error->message = "Couldn't set memblock size.";
     }
     
     // Ensure memory block is mounted
-    if (!res && R_FAILED((res = MemoryBlock__IsReady())))
-        ctx->error.message = "Failed to allocate memory.";
+    if (!res && R_FAILED((res = MemoryBlock__Allocate())))
+        job->memblockFailed = true;
 
     // Plugins will not exceed 5MB so this is fine
     if (!res) {
         header = (_3gx_Header *)(ctx->memblock.memblock + g_memBlockSize - (u32)fileSize);
-        memcpy(header, &fileHeader, sizeof(_3gx_Header));
+        if (cached)
+            PluginCache__RestoreHeader(cached, header);
+        else
+            memcpy(header, &fileHeader, sizeof(_3gx_Header));
     }
 
     // Parse rest of header
-    if (!res && R_FAILED((res = Read_3gx_ParseHeader(&plugin, header))))
-        ctx->error.message = "Couldn't read file";
+    if (!res && !cached && R_FAILED((res = Read_3gx_ParseHeader(&plugin, header))))
+        error->message = "Couldn't read file";
 
     // Read embedded save/load functions
-    if (!res && R_FAILED((res = Read_3gx_EmbeddedPayloads(&plugin, header))))
-        ctx->error.message = "Invalid save/load payloads.";
+    if (!res && cached && R_FAILED((res = Apply_3gx_EmbeddedPayloads(header, &cached->payloads))))
+        error->message = "Invalid save/load payloads.";
+    else if (!res && !cached && R_FAILED((res = Read_3gx_EmbeddedPayloads(&plugin, header, &g_payloads))))
+        error->message = "Invalid save/load payloads.";
     
     // Save exe checksum
     if (!res)
         ctx->exeLoadChecksum = header->infos.exeLoadChecksum;
     
     // Check titles compatibility
-    if (!res) res = CheckPluginCompatibility(header, (u32)tid);
+    if (!res) res = CheckPluginCompatibility(header, (u32)tid, error);
 
     // Read code
-    if (!res && R_FAILED(res = Read_3gx_LoadSegments(&plugin, header, ctx->memblock.memblock + sizeof(PluginHeader)))) {
-        if (res == MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_NO_DATA)) ctx->error.message = "This plugin requires a loading function.";
-        else if (res == MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_INVALID_ADDRESS)) ctx->error.message = "This plugin file is corrupted.";
-        else ctx->error.message = "Couldn't read plugin's code";
+    if (!res && cached) {
+        PluginCache__RestoreSegments(cached, ctx->memblock.memblock + sizeof(PluginHeader));
+        Reset_3gx_LoadParams();
+    }
+    else if (!res && R_FAILED(res = Read_3gx_LoadSegments(&plugin, header, ctx->memblock.memblock + sizeof(PluginHeader)))) {
+        if (res == MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_NO_DATA)) error->message = "This plugin requires a loading function.";
+        else if (res == MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, RD_INVALID_ADDRESS)) error->message = "This plugin file is corrupted.";
+        else error->message = "Couldn't read plugin's code";
     }
 
     if (R_FAILED(res))
     {
-        ctx->error.code = res;
-        goto exitFail;
+        error->code = res;
+        IFile_Close(&plugin);
+        MemoryBlock__Free();
+        return res;
+    }
+
+    // Only cache the plugins which decode themselves, as the segments are stored decoded
+    if (!cached && timestamp != 0 && header->infos.embeddedExeLoadFunc)
+        PluginCache__Insert(ctx->pluginPath, fileSize, timestamp, header, &g_payloads, ctx->memblock.memblock + sizeof(PluginHeader));
+
+    job->plugin = plugin;
+    job->header = header;
+    return 0;
+}
+
+static void     PrefetchPluginTask(void *argdata)
+{
+    (void)argdata;
+    PluginLoaderContext *ctx = &PluginLoaderCtx;
+
+    g_launchTimeline.prefetchStarted = svcGetSystemTick();
+    RecursiveLock_Lock(&ctx->lock);
+    g_prefetch.job.result = PreparePlugin(&g_prefetch.job);
+    RecursiveLock_Unlock(&ctx->lock);
+    g_launchTimeline.prefetchDone = svcGetSystemTick();
+
+    LightEvent_Signal(&g_prefetch.doneEvent);
+}
+
+void    PrefetchPlugin(u64 tid)
+{
+    PluginLoaderContext *ctx = &PluginLoaderCtx;
+
+    CancelPluginPrefetch();
+
+    // Leave the memory block alone while the previous plugin is still around. Launches
+    // with user load parameters may need a memory mode change first, keep them synchronous
+    RecursiveLock_Lock(&ctx->lock);
+    bool canPrefetch = ctx->isEnabled && !ctx->useUserLoadParameters && ctx->target == 0 && !ctx->memblock.isReady;
+    RecursiveLock_Unlock(&ctx->lock);
+
+    if (!canPrefetch)
+        return;
+
+    memset(&g_launchTimeline, 0, sizeof(PluginLaunchTimeline));
+    g_launchTimeline.prefetchRequested = svcGetSystemTick();
+
+    memset(&g_prefetch, 0, sizeof(PluginPrefetch));
+    InitLoadJob(&g_prefetch.job, tid);
+    LightEvent_Init(&g_prefetch.doneEvent, RESET_STICKY);
+
+    // The task runner may be busy waiting for the very title being loaded (debugger), never block
+    g_prefetch.isActive = TaskRunner_TryRunTask(PrefetchPluginTask, NULL, 0);
+}
+
+void    CancelPluginPrefetch(void)
+{
+    if (!g_prefetch.isActive)
+        return;
+
+    LightEvent_Wait(&g_prefetch.doneEvent);
+    g_prefetch.isActive = false;
+
+    if (R_SUCCEEDED(g_prefetch.job.result))
+    {
+        RecursiveLock_Lock(&PluginLoaderCtx.lock);
+        IFile_Close(&g_prefetch.job.plugin);
+        MemoryBlock__Free();
+        MemoryBlock__ResetSwapSettings();
+        RecursiveLock_Unlock(&PluginLoaderCtx.lock);
+    }
+}
+
+void    GetPluginLaunchTimeline(PluginLaunchTimeline *timeline)
+{
+    *timeline = g_launchTimeline;
+}
+
+bool     TryToLoadPlugin(Handle process)
+{
+    u64             tid;
+    u64             loadRequested = svcGetSystemTick();
+    IFile           plugin;
+    Result          res;
+    _3gx_Header     *header = NULL;
+    _3gx_Executable *exeHdr = NULL;
+    PluginLoadJob   *job;
+    PluginLoaderContext *ctx = &PluginLoaderCtx;
+    PluginHeader        *pluginHeader = &ctx->header;
+
+    // Get title id
+    svcGetProcessInfo((s64 *)&tid, process, 0x10001);
+
+    // Most of the work may already have been done while the game's code was being loaded
+    if (g_prefetch.isActive && g_prefetch.job.titleId == tid)
+    {
+        LightEvent_Wait(&g_prefetch.doneEvent);
+        g_prefetch.isActive = false;
+        g_launchTimeline.usedPrefetch = true;
+        job = &g_prefetch.job;
+        RecursiveLock_Lock(&ctx->lock);
+    }
+    else
+    {
+        CancelPluginPrefetch();
+        memset(&g_launchTimeline, 0, sizeof(PluginLaunchTimeline));
+        job = &g_loadJob;
+        InitLoadJob(job, tid);
+        RecursiveLock_Lock(&ctx->lock);
+        job->result = PreparePlugin(job);
+    }
+
+    g_launchTimeline.loadRequested = loadRequested;
+    g_launchTimeline.loadPrepared = svcGetSystemTick();
+
+    res = job->result;
+    plugin = job->plugin;
+    header = job->header;
+
+    if (R_FAILED(res))
+    {
+        RecursiveLock_Unlock(&ctx->lock);
+
+        if (job->memblockFailed)
+            MemoryBlock__AllocationFailed(res);
+        else if (job->error.message)
+            ctx->error = job->error;
+        return false;
     }
 
     pluginHeader->version = header->version;
@@ -299,11 +641,14 @@ bool     TryToLoadPlugin(Handle process)
 
 
     IFile_Close(&plugin);
+    RecursiveLock_Unlock(&ctx->lock);
+    g_launchTimeline.loadDone = svcGetSystemTick();
     return true;
 
 exitFail:
     IFile_Close(&plugin);
     MemoryBlock__Free();
+    RecursiveLock_Unlock(&ctx->lock);
 
     return false;
 }
@@ -2,6 +2,9 @@
 #include <string.h>
 #include <stdio.h>
 #include "plugin.h"
+#include "plugin/swapindex.h"
+#include "plugin/swapcodec.h"
+#include "plugin/plgcache.h"
 #include "ifile.h"
 #include "utils.h"
 
@@ -11,6 +14,20 @@ u32  g_loadSaveSwapArgs[4];
 char g_swapFileName[256];
 u32  g_memBlockSize = 5 * 1024 * 1024;
 
+static bool g_swapIndexValid = false; ///< Whether the swap file's header and page hashes can be trusted
+
+// Scratch memory for swapping, only allocated while swapping: rosalina's own memory is tight
+#define SWAP_WORK_ADDR  (0x0F000000)
+
+typedef struct
+{
+    SwapIndex       index;
+    SwapCodecState  codecState;
+    u8              chunkBuffer[SWAP_CHUNK_SIZE];
+}   SwapWorkArea;
+
+#define SWAP_WORK_SIZE  ((sizeof(SwapWorkArea) + 0xFFF) & ~0xFFF)
+
 Result     MemoryBlock__SetSize(u32 size) {
     PluginLoaderContext *ctx = &PluginLoaderCtx;
     MemoryBlock *memblock = &ctx->memblock;
@@ -19,20 +36,44 @@ Result     MemoryBlock__SetSize(u32 size) {
         return MAKERESULT(RL_PERMANENT, RS_INVALIDSTATE, RM_LDR, RD_ALREADY_INITIALIZED);
     
     g_memBlockSize = size;
+    g_swapIndexValid = false;
     return 0;
 }
 
+bool        MemoryBlock__UsesAppRegion(void)
+{
+    return isN3DS || PluginLoaderCtx.pluginMemoryStrategy == PLG_STRATEGY_MODE3;
+}
+
 Result      MemoryBlock__IsReady(void)
 {
-    PluginLoaderContext *ctx = &PluginLoaderCtx;
-    MemoryBlock *memblock = &ctx->memblock;
+    Result  res = MemoryBlock__Allocate();
+
+    if (R_FAILED(res))
+        MemoryBlock__AllocationFailed(res);
+
+    return res;
+}
+
+void        MemoryBlock__AllocationFailed(Result res)
+{
+    if (PluginLoaderCtx.memblock.isAppRegion)
+        PluginLoader__Error("Cannot map plugin memory.", res);
+    else
+        PluginLoader__Error("A console reboot is needed to\nclose extended memory games.\n\nPress [B] to reboot.", res);
+    svcKernelSetState(7);
+}
+
+Result      MemoryBlock__Allocate(void)
+{
+    MemoryBlock *memblock = &PluginLoaderCtx.memblock;
 
     if (memblock->isReady)
         return 0;
 
     Result  res;
 
-    if (isN3DS || (ctx->pluginMemoryStrategy == PLG_STRATEGY_MODE3))
+    if (MemoryBlock__UsesAppRegion())
     {
         s64     appRegionSize = 0;
         s64     appRegionUsed = 0;
@@ -71,18 +112,14 @@ Result      MemoryBlock__IsReady(void)
     else
     {
         memblock->isAppRegion = false;
+
+        // The plugin image cache would compete with the memory block, and failing here means a reboot
+        PluginCache__Free();
         res = svcControlMemoryUnsafe((u32 *)&memblock->memblock, 0x07000000,
                                     g_memBlockSize, MEMOP_REGION_SYSTEM | MEMOP_ALLOC | MEMOP_LINEAR_FLAG, MEMPERM_RW);
     }
 
-    if (R_FAILED(res)) {
-        if (isN3DS || (ctx->pluginMemoryStrategy == PLG_STRATEGY_MODE3))
-            PluginLoader__Error("Cannot map plugin memory.", res);
-        else
-            PluginLoader__Error("A console reboot is needed to\nclose extended memory games.\n\nPress [B] to reboot.", res);
-        svcKernelSetState(7);
-    }
-    else
+    if (R_SUCCEEDED(res))
     {
         // Clear the memblock
         memset(memblock->memblock, 0, g_memBlockSize);
@@ -125,13 +162,154 @@ Result      MemoryBlock__Free(void)
 
 #define FS_OPEN_RWC (FS_OPEN_READ | FS_OPEN_WRITE | FS_OPEN_CREATE)
 
+static SwapWorkArea    *AllocateSwapWorkArea(void)
+{
+    u32     tmp;
+    Result  res = svcControlMemoryEx(&tmp, SWAP_WORK_ADDR, 0, SWAP_WORK_SIZE, MEMOP_ALLOC, MEMREGION_SYSTEM | MEMPERM_READWRITE, true);
+
+    // Failing to swap means a reboot, drop the plugin image cache to make room instead
+    if (R_FAILED(res))
+    {
+        PluginCache__Free();
+        res = svcControlMemoryEx(&tmp, SWAP_WORK_ADDR, 0, SWAP_WORK_SIZE, MEMOP_ALLOC, MEMREGION_SYSTEM | MEMPERM_READWRITE, true);
+    }
+
+    return R_SUCCEEDED(res) ? (SwapWorkArea *)SWAP_WORK_ADDR : NULL;
+}
+
+static void     FreeSwapWorkArea(void)
+{
+    u32     tmp;
+
+    svcControlMemory(&tmp, SWAP_WORK_ADDR, 0, SWAP_WORK_SIZE, MEMOP_FREE, 0);
+}
+
+static Result   WriteSwapAt(IFile *file, u32 offset, const void *buffer, u32 size, u32 flags)
+{
+    u64     written = 0;
+    Result  res;
+
+    file->pos = offset;
+    res = IFile_Write(file, &written, buffer, size, flags);
+    return R_SUCCEEDED(res) && written != size ? -1 : res;
+}
+
+static Result   ReadSwapAt(IFile *file, u32 offset, void *buffer, u32 size)
+{
+    u64     read = 0;
+    Result  res;
+
+    file->pos = offset;
+    res = IFile_Read(file, &read, buffer, size);
+    return R_SUCCEEDED(res) && read != size ? -1 : res;
+}
+
+// Reads back what the swap file contains, or resets the index if it can't be trusted
+static void     LoadSwapIndex(IFile *file, SwapIndex *index)
+{
+    index->isValid = g_swapIndexValid &&
+        R_SUCCEEDED(ReadSwapAt(file, 0, &index->header, sizeof(SwapFileHeader))) &&
+        SwapIndex__IsHeaderValid(&index->header, g_memBlockSize) &&
+        R_SUCCEEDED(ReadSwapAt(file, SWAP_HASHES_OFFSET, index->pageHashes, index->header.nbPages * sizeof(u64)));
+
+    if (index->isValid)
+        index->nbPages = index->header.nbPages;
+    else
+        SwapIndex__Reset(index, g_memBlockSize);
+}
+
+// Writes the pages which changed since the last swap in place, the others are already in the file
+static Result   WriteRawSwapPages(IFile *file, SwapIndex *index, const u8 *mem)
+{
+    Result  res = 0;
+    u32     pos = 0, start, count;
+
+    for (u32 i = 0; i < index->nbPages / SWAP_PAGES_PER_CHUNK; i++)
+        index->header.chunkSizes[i] = SwapIndex__IsChunkZero(&index->header, i) ? 0 : SWAP_CHUNK_SIZE;
+
+    while (R_SUCCEEDED(res) && SwapIndex__NextRun(index->dirtyPages, index->nbPages, &pos, &start, &count))
+        res = WriteSwapAt(file, SWAP_DATA_OFFSET + start * SWAP_PAGE_SIZE, mem + start * SWAP_PAGE_SIZE, count * SWAP_PAGE_SIZE, 0);
+
+    return res;
+}
+
+// Compresses the chunks which changed since the last swap, one at a time
+static Result   WriteCompressedSwapChunks(IFile *file, SwapWorkArea *work, const u8 *mem)
+{
+    SwapIndex *index = &work->index;
+    Result  res = 0;
+
+    for (u32 i = 0; R_SUCCEEDED(res) && i < index->nbPages / SWAP_PAGES_PER_CHUNK; i++)
+    {
+        const u8 *chunk = mem + i * SWAP_CHUNK_SIZE;
+        u32     offset = SWAP_DATA_OFFSET + i * SWAP_CHUNK_SIZE;
+
+        if (SwapIndex__IsChunkZero(&index->header, i))
+        {
+            index->header.chunkSizes[i] = 0;
+            continue;
+        }
+
+        if (!SwapIndex__IsChunkDirty(index, i) && index->header.chunkSizes[i] != 0)
+            continue;
+
+        u32 size = SwapCodec__Compress(&work->codecState, work->chunkBuffer, SWAP_CHUNK_SIZE - 1, chunk, SWAP_CHUNK_SIZE);
+        if (size != 0)
+            res = WriteSwapAt(file, offset, work->chunkBuffer, size, 0);
+        else
+        {
+            size = SWAP_CHUNK_SIZE; // incompressible, store it raw
+            res = WriteSwapAt(file, offset, chunk, size, 0);
+        }
+
+        index->header.chunkSizes[i] = (u16)size;
+    }
+
+    return res;
+}
+
+static Result   ReadSwapChunks(IFile *file, SwapWorkArea *work, u8 *mem)
+{
+    const SwapFileHeader *header = &work->index.header;
+    u32     nbChunks = header->nbPages / SWAP_PAGES_PER_CHUNK;
+    Result  res = 0;
+
+    for (u32 i = 0; R_SUCCEEDED(res) && i < nbChunks; i++)
+    {
+        u32 size = header->chunkSizes[i];
+
+        if (size == 0)
+            continue;
+
+        if (size == SWAP_CHUNK_SIZE)
+        {
+            // Batch the reads over consecutive raw chunks. The memblock was cleared when
+            // allocated, so zero pages don't need to be read
+            u32 end = i + 1;
+            while (end < nbChunks && (header->chunkSizes[end] == 0 || header->chunkSizes[end] == SWAP_CHUNK_SIZE))
+                end++;
+
+            u32 pos = i * SWAP_PAGES_PER_CHUNK, start, count;
+            while (R_SUCCEEDED(res) && SwapIndex__NextRun(header->nonZeroPages, end * SWAP_PAGES_PER_CHUNK, &pos, &start, &count))
+                res = ReadSwapAt(file, SWAP_DATA_OFFSET + start * SWAP_PAGE_SIZE, mem + start * SWAP_PAGE_SIZE, count * SWAP_PAGE_SIZE);
+
+            i = end - 1;
+            continue;
+        }
+
+        res = ReadSwapAt(file, SWAP_DATA_OFFSET + i * SWAP_CHUNK_SIZE, work->chunkBuffer, size);
+        if (R_SUCCEEDED(res) && !SwapCodec__Decompress(mem + i * SWAP_CHUNK_SIZE, SWAP_CHUNK_SIZE, work->chunkBuffer, size))
+            res = -1;
+    }
+
+    return res;
+}
+
 Result      MemoryBlock__ToSwapFile(void)
 {
     MemoryBlock *memblock = &PluginLoaderCtx.memblock;
     PluginLoaderContext *ctx = &PluginLoaderCtx;
 
-    u64     written = 0;
-    u64     toWrite = g_memBlockSize;
     IFile   file;
     Result  res = 0;
 
@@ -149,14 +327,36 @@ Result      MemoryBlock__ToSwapFile(void)
         svcKernelSetState(7);
     }
     ctx->swapLoadChecksum = saveSwapFunc(memblock->memblock, memblock->memblock + g_memBlockSize, g_loadSaveSwapArgs);
-    
-    res = IFile_Write(&file, &written, memblock->memblock, toWrite, FS_WRITE_FLUSH);
 
-    if (R_FAILED(res) || written != toWrite) {
+    SwapWorkArea *work = AllocateSwapWorkArea();
+    if (work == NULL) {
+        res = MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_LDR, RD_OUT_OF_MEMORY);
+        PluginLoader__Error("CRITICAL: Not enough memory to swap.\n\nConsole will now reboot.", res);
+        svcKernelSetState(7);
+    }
+
+    LoadSwapIndex(&file, &work->index);
+    SwapIndex__Update(&work->index, memblock->memblock);
+
+    // The file is only consistent again once the header is written
+    g_swapIndexValid = false;
+    if (ctx->useSwapCompression)
+        res = WriteCompressedSwapChunks(&file, work, memblock->memblock);
+    else
+        res = WriteRawSwapPages(&file, &work->index, memblock->memblock);
+
+    if (R_SUCCEEDED(res))
+        res = WriteSwapAt(&file, SWAP_HASHES_OFFSET, work->index.pageHashes, work->index.nbPages * sizeof(u64), 0);
+    if (R_SUCCEEDED(res))
+        res = WriteSwapAt(&file, 0, &work->index.header, sizeof(SwapFileHeader), FS_WRITE_FLUSH);
+
+    if (R_FAILED(res)) {
         PluginLoader__Error("CRITICAL: Couldn't write swap to SD.\n\nConsole will now reboot.", res);
         svcKernelSetState(7);
     }
 
+    g_swapIndexValid = true;
+    FreeSwapWorkArea();
     IFile_Close(&file);
     return res;
 }
@@ -165,8 +365,6 @@ Result      MemoryBlock__FromSwapFile(void)
 {
     MemoryBlock *memblock = &PluginLoaderCtx.memblock;
 
-    u64     read = 0;
-    u64     toRead = g_memBlockSize;
     IFile   file;
     Result  res = 0;
 
@@ -178,9 +376,20 @@ Result      MemoryBlock__FromSwapFile(void)
         svcKernelSetState(7);
     }
 
-    res = IFile_Read(&file, &read, memblock->memblock, toRead);
+    SwapWorkArea *work = AllocateSwapWorkArea();
+    if (work == NULL)
+        res = MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_LDR, RD_OUT_OF_MEMORY);
+    else
+    {
+        res = ReadSwapAt(&file, 0, &work->index.header, sizeof(SwapFileHeader));
+        if (R_SUCCEEDED(res) && !SwapIndex__IsHeaderValid(&work->index.header, g_memBlockSize))
+            res = -1;
+        if (R_SUCCEEDED(res))
+            res = ReadSwapChunks(&file, work, memblock->memblock);
+        FreeSwapWorkArea();
+    }
 
-    if (R_FAILED(res) || read != toRead) {
+    if (R_FAILED(res)) {
         PluginLoader__Error("CRITICAL: Couldn't read swap from SD.\n\nConsole will now reboot.", res);
         svcKernelSetState(7);
     }
@@ -244,6 +453,7 @@ Result    MemoryBlock__SetSwapSettings(u32* func, bool isLoad, u32* params)
     u32* physAddr = PA_FROM_VA_PTR(isLoad ? (u32)loadSwapFunc : (u32)saveSwapFunc); //Bypass mem permissions
 
 	memcpy(g_loadSaveSwapArgs, params, sizeof(g_loadSaveSwapArgs));
+    g_swapIndexValid = false; ///< The swap file name or format may have changed
     
     int i = 0;
     for (; i < 32 && func[i] != 0xE320F000; i++)
@@ -271,6 +481,7 @@ void       MemoryBlock__ResetSwapSettings(void)
 
 	strcpy(g_swapFileName, "/luma/plugins/.swap");
     ctx->isSwapFunctionset = false;
+    g_swapIndexValid = false;
 
 	svcInvalidateEntireInstructionCache();
 }
@@ -0,0 +1,185 @@
+#include <3ds.h>
+#include <string.h>
+#include "csvc.h"
+#include "plugin/plgcache.h"
+
+static PluginCacheEntry g_cacheEntries[PLUGIN_CACHE_MAX_ENTRIES];
+static u32              g_nbCacheEntries;
+static u8 *             g_cacheMemory;
+static u32              g_cacheBudget;
+static u32              g_cacheUsedSize;
+static u32              g_cacheClock;
+static u32              g_cacheHits;
+static u32              g_cacheMisses;
+
+static inline u32   EntrySize(const PluginCacheEntry *entry)
+{
+    return entry->headerSize + entry->segmentsSize;
+}
+
+// Entries are kept contiguous and sorted by offset, so that the free space is always at the end
+static void     RemoveEntry(u32 index)
+{
+    PluginCacheEntry *entry = &g_cacheEntries[index];
+    u32     offset = entry->offset;
+    u32     size = EntrySize(entry);
+
+    memmove(g_cacheMemory + offset, g_cacheMemory + offset + size, g_cacheUsedSize - offset - size);
+    g_cacheUsedSize -= size;
+
+    for (u32 i = index + 1; i < g_nbCacheEntries; ++i)
+    {
+        g_cacheEntries[i].offset -= size;
+        g_cacheEntries[i - 1] = g_cacheEntries[i];
+    }
+
+    --g_nbCacheEntries;
+}
+
+static void     RemoveLeastRecentlyUsedEntry(void)
+{
+    u32 victim = 0;
+
+    for (u32 i = 1; i < g_nbCacheEntries; ++i)
+    {
+        if (g_cacheEntries[i].lastUse < g_cacheEntries[victim].lastUse)
+            victim = i;
+    }
+
+    RemoveEntry(victim);
+}
+
+static bool     AllocateCacheMemory(void)
+{
+    u32     tmp;
+
+    if (g_cacheMemory != NULL)
+        return true;
+
+    if (R_FAILED(svcControlMemoryEx(&tmp, PLUGIN_CACHE_ADDR, 0, g_cacheBudget, MEMOP_ALLOC, MEMREGION_SYSTEM | MEMPERM_READWRITE, true)))
+    {
+        // Not enough memory, don't try again
+        g_cacheBudget = 0;
+        return false;
+    }
+
+    g_cacheMemory = (u8 *)PLUGIN_CACHE_ADDR;
+    return true;
+}
+
+void    PluginCache__Free(void)
+{
+    u32     tmp;
+
+    if (g_cacheMemory == NULL)
+        return;
+
+    svcControlMemory(&tmp, PLUGIN_CACHE_ADDR, 0, g_cacheBudget, MEMOP_FREE, 0);
+    g_cacheMemory = NULL;
+    g_cacheUsedSize = 0;
+    g_nbCacheEntries = 0;
+}
+
+void    PluginCache__Init(u32 budget)
+{
+    g_cacheBudget = (budget + 0xFFF) & ~0xFFF;
+}
+
+bool    PluginCache__IsEnabled(void)
+{
+    return g_cacheBudget != 0;
+}
+
+PluginCacheEntry *  PluginCache__Find(const char *path, u64 fileSize, u64 timestamp)
+{
+    for (u32 i = 0; timestamp != 0 && i < g_nbCacheEntries; ++i)
+    {
+        PluginCacheEntry *entry = &g_cacheEntries[i];
+
+        if (entry->fileSize == fileSize && entry->timestamp == timestamp && !strcmp(entry->path, path))
+        {
+            entry->lastUse = ++g_cacheClock;
+            ++g_cacheHits;
+            return entry;
+        }
+    }
+
+    ++g_cacheMisses;
+    return NULL;
+}
+
+const _3gx_Header * PluginCache__GetHeader(const PluginCacheEntry *entry)
+{
+    return (const _3gx_Header *)(g_cacheMemory + entry->offset);
+}
+
+void    PluginCache__RestoreHeader(const PluginCacheEntry *entry, _3gx_Header *dst)
+{
+    memcpy(dst, g_cacheMemory + entry->offset, entry->headerSize);
+
+    // Pointers are stored relative to the header
+    dst->infos.authorMsg = (const char *)dst + (u32)dst->infos.authorMsg;
+    dst->infos.titleMsg = (const char *)dst + (u32)dst->infos.titleMsg;
+    dst->targets.titles = (u32 *)((u8 *)dst + (u32)dst->targets.titles);
+}
+
+void    PluginCache__RestoreSegments(const PluginCacheEntry *entry, void *dst)
+{
+    memcpy(dst, g_cacheMemory + entry->offset + entry->headerSize, entry->segmentsSize);
+}
+
+void    PluginCache__Insert(const char *path, u64 fileSize, u64 timestamp, const _3gx_Header *header,
+                            const _3gx_EmbeddedPayloads *payloads, const void *segments)
+{
+    const _3gx_Executable *exeHdr = &header->executable;
+    u32     headerSize = (const u8 *)(header->targets.titles + header->targets.count) - (const u8 *)header;
+    u32     segmentsSize = exeHdr->codeSize + exeHdr->rodataSize + exeHdr->dataSize;
+
+    if (timestamp == 0 || strlen(path) >= sizeof(g_cacheEntries[0].path) || headerSize + segmentsSize > g_cacheBudget)
+        return;
+
+    // Replace any older version of the plugin
+    for (u32 i = 0; i < g_nbCacheEntries; ++i)
+    {
+        if (!strcmp(g_cacheEntries[i].path, path))
+        {
+            RemoveEntry(i);
+            break;
+        }
+    }
+
+    while (g_nbCacheEntries == PLUGIN_CACHE_MAX_ENTRIES || g_cacheUsedSize + headerSize + segmentsSize > g_cacheBudget)
+        RemoveLeastRecentlyUsedEntry();
+
+    if (!AllocateCacheMemory())
+        return;
+
+    PluginCacheEntry *entry = &g_cacheEntries[g_nbCacheEntries++];
+    _3gx_Header *cachedHeader = (_3gx_Header *)(g_cacheMemory + g_cacheUsedSize);
+
+    strcpy(entry->path, path);
+    entry->fileSize = fileSize;
+    entry->timestamp = timestamp;
+    entry->offset = g_cacheUsedSize;
+    entry->headerSize = headerSize;
+    entry->segmentsSize = segmentsSize;
+    entry->lastUse = ++g_cacheClock;
+    entry->payloads = *payloads;
+
+    memcpy(cachedHeader, header, headerSize);
+    cachedHeader->infos.authorMsg = (const char *)(header->infos.authorMsg - (const char *)header);
+    cachedHeader->infos.titleMsg = (const char *)(header->infos.titleMsg - (const char *)header);
+    cachedHeader->targets.titles = (u32 *)((const u8 *)header->targets.titles - (const u8 *)header);
+
+    memcpy((u8 *)cachedHeader + headerSize, segments, segmentsSize);
+    g_cacheUsedSize += headerSize + segmentsSize;
+}
+
+void    PluginCache__GetStats(PluginCacheStats *stats)
+{
+    stats->hits = g_cacheHits;
+    stats->misses = g_cacheMisses;
+    stats->nbEntries = g_nbCacheEntries;
+    stats->usedSize = g_cacheUsedSize;
+    stats->budget = g_cacheBudget;
+}
@@ -0,0 +1,93 @@
+#include <stddef.h>
+#include <string.h>
+#include "plugin/plgindex.h"
+
+PluginIndexEntry *  PluginIndex__Find(PluginIndex *index, u64 titleId)
+{
+    for (u32 i = 0; i < index->nbEntries; ++i)
+    {
+        if (index->entries[i].titleId == titleId)
+            return &index->entries[i];
+    }
+
+    return NULL;
+}
+
+void    PluginIndex__Reset(PluginIndex *index)
+{
+    index->magic = PluginIndexMagic;
+    index->version = PluginIndexVersion;
+    index->nbEntries = 0;
+    index->nextVictim = 0;
+}
+
+bool    PluginIndex__IsValid(const PluginIndex *index)
+{
+    if (index->magic != PluginIndexMagic || index->version != PluginIndexVersion)
+        return false;
+
+    if (index->nbEntries > PLUGIN_INDEX_MAX_ENTRIES || index->nextVictim >= PLUGIN_INDEX_MAX_ENTRIES)
+        return false;
+
+    for (u32 i = 0; i < index->nbEntries; ++i)
+    {
+        const char *fileName = index->entries[i].fileName;
+
+        // Only directories holding a plugin are recorded
+        if (index->entries[i].nbDirEntries == 0 || fileName[0] == 0 || memchr(fileName, 0, PLUGIN_INDEX_NAME_SIZE) == NULL)
+            return false;
+    }
+
+    return true;
+}
+
+PluginIndexEntry *  PluginIndex__Lookup(PluginIndex *index, u64 titleId, u64 dirTimestamp, u32 nbDirEntries)
+{
+    PluginIndexEntry *entry = PluginIndex__Find(index, titleId);
+
+    // A timestamp of 0 means we couldn't get one, never trust that
+    if (entry == NULL || dirTimestamp == 0 || entry->dirTimestamp != dirTimestamp || entry->nbDirEntries != nbDirEntries)
+        return NULL;
+
+    return entry;
+}
+
+void    PluginIndex__Insert(PluginIndex *index, u64 titleId, u64 dirTimestamp, u32 nbDirEntries, const char *fileName)
+{
+    PluginIndexEntry *entry = PluginIndex__Find(index, titleId);
+
+    if (entry == NULL)
+    {
+        if (index->nbEntries < PLUGIN_INDEX_MAX_ENTRIES)
+            entry = &index->entries[index->nbEntries++];
+        else
+        {
+            entry = &index->entries[index->nextVictim];
+            index->nextVictim = (index->nextVictim + 1) % PLUGIN_INDEX_MAX_ENTRIES;
+        }
+    }
+
+    memset(entry, 0, sizeof(PluginIndexEntry));
+    entry->titleId = titleId;
+    entry->dirTimestamp = dirTimestamp;
+    entry->nbDirEntries = nbDirEntries;
+    strncpy(entry->fileName, fileName, PLUGIN_INDEX_NAME_SIZE - 1);
+}
+
+bool    PluginIndex__Remove(PluginIndex *index, u64 titleId)
+{
+    PluginIndexEntry *entry = PluginIndex__Find(index, titleId);
+
+    if (entry == NULL)
+        return false;
+
+    *entry = index->entries[--index->nbEntries];
+    if (index->nextVictim >= index->nbEntries)
+        index->nextVictim = 0;
+    return true;
+}
+
+u32     PluginIndex__GetUsedSize(const PluginIndex *index)
+{
+    return offsetof(PluginIndex, entries) + index->nbEntries * sizeof(PluginIndexEntry);
+}
@@ -200,6 +200,50 @@ Result  PLGLDR__GetVersion(u32 *version)
     return res;
 }
 
+Result  PLGLDR__GetPluginCacheStats(PluginCacheStats *stats)
+{
+    if (stats == NULL)
+        return MAKERESULT(28, 7, 254, 1014); ///< Usage, App, Invalid argument
+
+    Result res = 0;
+
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(14, 0, 0);
+
+    if (R_SUCCEEDED((res = svcSendSyncRequest(plgLdrHandle))))
+    {
+        if (cmdbuf[0] != IPC_MakeHeader(14, 6, 0))
+            return 0xD900182F;
+
+        res = cmdbuf[1];
+        memcpy(stats, &cmdbuf[2], sizeof(PluginCacheStats));
+    }
+    return res;
+}
+
+Result  PLGLDR__GetLaunchTimeline(PluginLaunchTimeline *timeline)
+{
+    if (timeline == NULL)
+        return MAKERESULT(28, 7, 254, 1014); ///< Usage, App, Invalid argument
+
+    Result res = 0;
+
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[0] = IPC_MakeHeader(17, 0, 0);
+
+    if (R_SUCCEEDED((res = svcSendSyncRequest(plgLdrHandle))))
+    {
+        if (cmdbuf[0] != IPC_MakeHeader(17, 15, 0))
+            return 0xD900182F;
+
+        res = cmdbuf[1];
+        memcpy(timeline, &cmdbuf[2], sizeof(PluginLaunchTimeline));
+    }
+    return res;
+}
+
 Result  PLGLDR__GetPluginPath(char *path)
 {
     if (path == NULL)
@@ -3,6 +3,7 @@
 #include "utils.h" // for makeARMBranch
 #include "luma_config.h"
 #include "plugin.h"
+#include "plugin/plgcache.h"
 #include "fmt.h"
 #include "menu.h"
 #include "menus.h"
@@ -10,7 +11,7 @@
 #include "sleep.h"
 #include "task_runner.h"
 
-#define PLGLDR_VERSION (SYSTEM_VERSION(1, 0, 1))
+#define PLGLDR_VERSION (SYSTEM_VERSION(1, 0, 2))
 
 #define THREADVARS_MAGIC  0x21545624 // !TV$
 
@@ -26,11 +27,15 @@ void        PluginLoader__Init(void)
     PluginLoaderContext *ctx = &PluginLoaderCtx;
 
     memset(ctx, 0, sizeof(PluginLoaderContext));
+    RecursiveLock_Init(&ctx->lock);
 
     s64 pluginLoaderFlags = 0;
 
     svcGetSystemInfo(&pluginLoaderFlags, 0x10000, 0x180);
     ctx->isEnabled = pluginLoaderFlags & 1;
+    ctx->useSwapCompression = (pluginLoaderFlags & 2) != 0;
+    ctx->imageCacheSizeMb = (pluginLoaderFlags >> 8) & 0xFF;
+    PluginCache__Init((u32)ctx->imageCacheSizeMb << 20);
 
     ctx->plgEventPA = (s32 *)PA_FROM_VA_PTR(&ctx->plgEvent);
     ctx->plgReplyPA = (s32 *)PA_FROM_VA_PTR(&ctx->plgReply);
@@ -55,6 +60,12 @@ bool        PluginLoader__IsEnabled(void)
     return PluginLoaderCtx.isEnabled;
 }
 
+u32         PluginLoader__GetConfigFlags(void)
+{
+    return (u32)PluginLoaderCtx.isEnabled | ((u32)PluginLoaderCtx.useSwapCompression << 1)
+        | ((u32)PluginLoaderCtx.imageCacheSizeMb << 8);
+}
+
 void        PluginLoader__MenuCallback(void)
 {
     PluginLoaderCtx.isEnabled = !PluginLoaderCtx.isEnabled;
@@ -144,6 +155,8 @@ void     PluginLoader__HandleCommands(void *_ctx)
                 TaskRunner_RunTask(j_PluginLoader__SetMode3AppMode, NULL, 0);
 
             bool flash = !(ctx->useUserLoadParameters && ctx->userLoadParameters.noFlash);
+            if (!ctx->isEnabled)
+                CancelPluginPrefetch();
             if (ctx->isEnabled && TryToLoadPlugin(ctx->target))
             {
                 if (flash)
@@ -325,7 +338,9 @@ void     PluginLoader__HandleCommands(void *_ctx)
             }
 
             char *path = (char *)cmdbuf[2];
+            RecursiveLock_Lock(&ctx->lock);
             strncpy(path, ctx->pluginPath, 255);
+            RecursiveLock_Unlock(&ctx->lock);
 
             cmdbuf[0] = IPC_MakeHeader(10, 1, 2);
             cmdbuf[1] = 0;
@@ -417,6 +432,70 @@ void     PluginLoader__HandleCommands(void *_ctx)
             break;
         }
 
+        case 14: // Get plugin image cache stats
+        {
+            if (cmdbuf[0] != IPC_MakeHeader(14, 0, 0))
+            {
+                error(cmdbuf, 0xD9001830);
+                break;
+            }
+
+            PluginCacheStats stats;
+            PluginCache__GetStats(&stats);
+
+            cmdbuf[0] = IPC_MakeHeader(14, 6, 0);
+            cmdbuf[1] = 0;
+            memcpy(&cmdbuf[2], &stats, sizeof(PluginCacheStats));
+            break;
+        }
+
+        case 15: // Prefetch plugin (sent by loader before loading the title's code)
+        {
+            if (cmdbuf[0] != IPC_MakeHeader(15, 2, 0))
+            {
+                error(cmdbuf, 0xD9001830);
+                break;
+            }
+
+            PrefetchPlugin((u64)cmdbuf[1] | ((u64)cmdbuf[2] << 32));
+
+            cmdbuf[0] = IPC_MakeHeader(15, 1, 0);
+            cmdbuf[1] = 0;
+            break;
+        }
+
+        case 16: // Cancel plugin prefetch (the title won't get a plugin)
+        {
+            if (cmdbuf[0] != IPC_MakeHeader(16, 0, 0))
+            {
+                error(cmdbuf, 0xD9001830);
+                break;
+            }
+
+            CancelPluginPrefetch();
+
+            cmdbuf[0] = IPC_MakeHeader(16, 1, 0);
+            cmdbuf[1] = 0;
+            break;
+        }
+
+        case 17: // Get last launch timeline
+        {
+            if (cmdbuf[0] != IPC_MakeHeader(17, 0, 0))
+            {
+                error(cmdbuf, 0xD9001830);
+                break;
+            }
+
+            PluginLaunchTimeline timeline;
+            GetPluginLaunchTimeline(&timeline);
+
+            cmdbuf[0] = IPC_MakeHeader(17, 15, 0);
+            cmdbuf[1] = 0;
+            memcpy(&cmdbuf[2], &timeline, sizeof(PluginLaunchTimeline));
+            break;
+        }
+
         default: // Unknown command
         {
             error(cmdbuf, 0xD900182F);
@@ -485,6 +564,8 @@ static void WaitForProcessTerminated(void *arg)
     // Wait until all threads of the process have finished (svcWaitSynchronization == 0) or 5 seconds have passed.
     for (u32 i = 0; svcWaitSynchronization(ctx->target, 0) != 0 && i < 100; i++) svcSleepThread(50000000); // 50ms
     
+    RecursiveLock_Lock(&ctx->lock);
+
     // Unmap plugin's memory before closing the process
     if (!ctx->pluginIsSwapped) {
         MemoryBlock__UnmountFromProcess();
@@ -502,6 +583,7 @@ static void WaitForProcessTerminated(void *arg)
     ctx->pluginMemoryStrategy = PLG_STRATEGY_SWAP;
     g_blockMenuOpen = 0;
     MemoryBlock__ResetSwapSettings();
+    RecursiveLock_Unlock(&ctx->lock);
     //if (!ctx->userLoadParameters.noIRPatch)
     //    IR__Unpatch();
 }
@@ -533,6 +615,7 @@ void    PluginLoader__HandleKernelEvent(u32 notifId)
     }
     else if (event == PLG_CFG_HOME_EVENT)
     {
+        RecursiveLock_Lock(&ctx->lock);
         if ((ctx->pluginMemoryStrategy == PLG_STRATEGY_SWAP) && !isN3DS) {
             if (ctx->pluginIsSwapped)
             {
@@ -587,7 +670,7 @@ void    PluginLoader__HandleKernelEvent(u32 notifId)
             }
             ctx->pluginIsHome = !ctx->pluginIsHome;
         }
-        
+        RecursiveLock_Unlock(&ctx->lock);
     }
     srvPublishToSubscriber(0x1002, 0);
 }
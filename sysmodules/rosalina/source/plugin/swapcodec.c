@@ -0,0 +1,165 @@
+#include <string.h>
+#include "plugin/swapcodec.h"
+
+#define MIN_MATCH       (4)
+#define LAST_LITERALS   (5) ///< The encoder always ends with a few literals, like LZ4 does
+
+static inline u32   Read32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline u32   Hash(u32 v)
+{
+    return (v * 2654435761u) >> (32 - SWAP_CODEC_HASH_BITS);
+}
+
+static inline u8 *  WriteLength(u8 *op, const u8 *oend, u32 len)
+{
+    for (; len >= 255; len -= 255)
+    {
+        if (op >= oend)
+            return NULL;
+        *op++ = 255;
+    }
+
+    if (op >= oend)
+        return NULL;
+    *op++ = (u8)len;
+    return op;
+}
+
+static u8 *         WriteSequence(u8 *op, const u8 *oend, const u8 *literals, u32 nbLiterals, u32 offset, u32 matchLen)
+{
+    u8 *token = op++;
+    if (token >= oend)
+        return NULL;
+
+    *token = (u8)((nbLiterals >= 15 ? 15 : nbLiterals) << 4);
+    if (nbLiterals >= 15 && (op = WriteLength(op, oend, nbLiterals - 15)) == NULL)
+        return NULL;
+
+    if (op + nbLiterals > oend)
+        return NULL;
+    memcpy(op, literals, nbLiterals);
+    op += nbLiterals;
+
+    if (matchLen == 0)
+        return op; // last sequence
+
+    if (op + 2 > oend)
+        return NULL;
+    *op++ = (u8)offset;
+    *op++ = (u8)(offset >> 8);
+
+    matchLen -= MIN_MATCH;
+    *token |= matchLen >= 15 ? 15 : matchLen;
+    if (matchLen >= 15)
+        op = WriteLength(op, oend, matchLen - 15);
+
+    return op;
+}
+
+u32     SwapCodec__Compress(SwapCodecState *state, u8 *dst, u32 dstCapacity, const u8 *src, u32 srcSize)
+{
+    const u8    *ip = src, *anchor = src;
+    const u8    *iend = src + srcSize;
+    const u8    *matchLimit = srcSize > LAST_LITERALS ? iend - LAST_LITERALS : src;
+    u8          *op = dst;
+    const u8    *oend = dst + dstCapacity;
+
+    memset(state->table, 0xFF, sizeof(state->table));
+
+    while (ip + MIN_MATCH <= matchLimit)
+    {
+        u32     seq = Read32(ip);
+        u32     h = Hash(seq);
+        u32     refPos = state->table[h];
+
+        state->table[h] = (u16)(ip - src);
+
+        if (refPos == 0xFFFF || Read32(src + refPos) != seq)
+        {
+            ip++;
+            continue;
+        }
+
+        const u8    *ref = src + refPos;
+        const u8    *mp = ip + MIN_MATCH;
+
+        // Overlapping matches are fine, the decoder copies byte by byte
+        while (mp < matchLimit && *mp == ref[mp - ip])
+            mp++;
+
+        op = WriteSequence(op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+        if (op == NULL)
+            return 0;
+
+        ip = anchor = mp;
+    }
+
+    op = WriteSequence(op, oend, anchor, iend - anchor, 0, 0);
+    return op != NULL ? (u32)(op - dst) : 0;
+}
+
+static inline bool  ReadLength(const u8 **ip, const u8 *iend, u32 *len)
+{
+    u8 b;
+    do
+    {
+        if (*ip >= iend)
+            return false;
+        b = *(*ip)++;
+        *len += b;
+    }
+    while (b == 255);
+
+    return true;
+}
+
+bool    SwapCodec__Decompress(u8 *dst, u32 dstSize, const u8 *src, u32 srcSize)
+{
+    const u8    *ip = src, *iend = src + srcSize;
+    u8          *op = dst, *oend = dst + dstSize;
+
+    while (ip < iend)
+    {
+        u8  token = *ip++;
+        u32 nbLiterals = token >> 4;
+
+        if (nbLiterals == 15 && !ReadLength(&ip, iend, &nbLiterals))
+            return false;
+        if (nbLiterals > (u32)(iend - ip) || nbLiterals > (u32)(oend - op))
+            return false;
+
+        memcpy(op, ip, nbLiterals);
+        ip += nbLiterals;
+        op += nbLiterals;
+
+        if (ip == iend)
+            break; // last sequence
+
+        if (iend - ip < 2)
+            return false;
+
+        u32 offset = ip[0] | (ip[1] << 8);
+        u32 matchLen = token & 15;
+        ip += 2;
+
+        if (matchLen == 15 && !ReadLength(&ip, iend, &matchLen))
+            return false;
+        matchLen += MIN_MATCH;
+
+        if (offset == 0 || offset > (u32)(op - dst) || matchLen > (u32)(oend - op))
+            return false;
+
+        const u8 *ref = op - offset;
+        for (u32 i = 0; i < matchLen; i++)
+            op[i] = ref[i];
+        op += matchLen;
+    }
+
+    return op == oend;
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+#include "plugin/swapindex.h"
+
+static inline bool  IsBitSet(const u32 *bitmap, u32 i)
+{
+    return (bitmap[i / 32] >> (i % 32)) & 1;
+}
+
+static inline void  SetBit(u32 *bitmap, u32 i, bool value)
+{
+    if (value)
+        bitmap[i / 32] |= 1u << (i % 32);
+    else
+        bitmap[i / 32] &= ~(1u << (i % 32));
+}
+
+u64     SwapIndex__HashPage(const u32 *page)
+{
+    // Two independent 32-bit lanes, a stale page going unnoticed would corrupt the plugin
+    u32     h1 = 0x811C9DC5, h2 = 0x9E3779B9;
+    u32     acc = 0;
+
+    for (u32 i = 0; i < SWAP_PAGE_SIZE / 4; i++)
+    {
+        u32 w = page[i];
+
+        acc |= w;
+        h1 = (h1 ^ w) * 0x01000193;
+        h2 = ((h2 << 5) | (h2 >> 27)) ^ (w * 0x85EBCA6B);
+    }
+
+    if (acc == 0)
+        return 0;
+
+    u64 h = ((u64)h1 << 32) | h2;
+    return h != 0 ? h : 1;
+}
+
+void    SwapIndex__Reset(SwapIndex *index, u32 memBlockSize)
+{
+    index->isValid = false;
+    index->nbPages = memBlockSize / SWAP_PAGE_SIZE;
+
+    memset(index->dirtyPages, 0, sizeof(index->dirtyPages));
+    memset(&index->header, 0, sizeof(index->header));
+    index->header.magic = SwapFileMagic;
+    index->header.version = SwapFileVersion;
+    index->header.memBlockSize = memBlockSize;
+    index->header.nbPages = index->nbPages;
+}
+
+u32     SwapIndex__Update(SwapIndex *index, const u8 *mem)
+{
+    u32     nbDirty = 0;
+
+    for (u32 i = 0; i < index->nbPages; i++)
+    {
+        u64     hash = SwapIndex__HashPage((const u32 *)(mem + i * SWAP_PAGE_SIZE));
+        bool    dirty = !index->isValid || hash != index->pageHashes[i];
+
+        SetBit(index->dirtyPages, i, dirty);
+        SetBit(index->header.nonZeroPages, i, hash != 0);
+        index->pageHashes[i] = hash;
+        nbDirty += dirty;
+    }
+
+    return nbDirty;
+}
+
+static inline bool  AreAnyBitsSet(const u32 *bitmap, u32 first, u32 count)
+{
+    for (u32 i = first; i < first + count; i++)
+    {
+        if (IsBitSet(bitmap, i))
+            return true;
+    }
+
+    return false;
+}
+
+bool    SwapIndex__IsChunkDirty(const SwapIndex *index, u32 chunk)
+{
+    return AreAnyBitsSet(index->dirtyPages, chunk * SWAP_PAGES_PER_CHUNK, SWAP_PAGES_PER_CHUNK);
+}
+
+bool    SwapIndex__IsChunkZero(const SwapFileHeader *header, u32 chunk)
+{
+    return !AreAnyBitsSet(header->nonZeroPages, chunk * SWAP_PAGES_PER_CHUNK, SWAP_PAGES_PER_CHUNK);
+}
+
+bool    SwapIndex__IsHeaderValid(const SwapFileHeader *header, u32 memBlockSize)
+{
+    if (header->magic != SwapFileMagic || header->version != SwapFileVersion ||
+        header->memBlockSize != memBlockSize || header->nbPages != memBlockSize / SWAP_PAGE_SIZE ||
+        header->nbPages > SWAP_MAX_PAGES || header->nbPages % SWAP_PAGES_PER_CHUNK != 0)
+        return false;
+
+    for (u32 i = 0; i < header->nbPages / SWAP_PAGES_PER_CHUNK; i++)
+    {
+        if (header->chunkSizes[i] > SWAP_CHUNK_SIZE)
+            return false;
+    }
+
+    return true;
+}
+
+bool    SwapIndex__NextRun(const u32 *bitmap, u32 nbPages, u32 *pos, u32 *outStart, u32 *outCount)
+{
+    u32     i = *pos;
+
+    while (i < nbPages && !IsBitSet(bitmap, i))
+        i++;
+
+    if (i >= nbPages)
+    {
+        *pos = nbPages;
+        return false;
+    }
+
+    *outStart = i;
+    while (i < nbPages && IsBitSet(bitmap, i))
+        i++;
+
+    *outCount = i - *outStart;
+    *pos = i;
+    return true;
+}
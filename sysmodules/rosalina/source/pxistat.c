@@ -0,0 +1,62 @@
+// License for this file: ctrulib's license
+// Copyright AuroraWright, TuxSH 2019-2020
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/srv.h>
+#include <3ds/ipc.h>
+#include "pxistat.h"
+
+static Handle pxiStatHandle;
+
+Result pxiStatInit(void)
+{
+    return srvGetServiceHandle(&pxiStatHandle, "pxi:stat");
+}
+
+void pxiStatExit(void)
+{
+    svcCloseHandle(pxiStatHandle);
+    pxiStatHandle = 0;
+}
+
+Result PXISTAT_GetServiceStats(PxiStatServiceStats *out, u32 serviceId)
+{
+    Result ret = 0;
+    u32 *cmdbuf = getThreadCommandBuffer();
+    cmdbuf[0] = IPC_MakeHeader(1, 1, 0);
+    cmdbuf[1] = serviceId;
+
+    if(R_FAILED(ret = svcSendSyncRequest(pxiStatHandle))) return ret;
+
+    out->nbCommandsSent = cmdbuf[2];
+    out->nbRepliesReceived = cmdbuf[3];
+    out->minLatency = cmdbuf[4];
+    out->maxLatency = cmdbuf[5];
+    out->totalLatency = (u64)cmdbuf[6] | ((u64)cmdbuf[7] << 32);
+    return (Result)cmdbuf[1];
+}
+
+Result PXISTAT_GetPendingArm9CommandStats(u32 *outCurrent, u32 *outPeak)
+{
+    Result ret = 0;
+    u32 *cmdbuf = getThreadCommandBuffer();
+    cmdbuf[0] = IPC_MakeHeader(2, 0, 0);
+
+    if(R_FAILED(ret = svcSendSyncRequest(pxiStatHandle))) return ret;
+
+    *outCurrent = cmdbuf[2];
+    *outPeak = cmdbuf[3];
+    return (Result)cmdbuf[1];
+}
+
+Result PXISTAT_ResetStats(void)
+{
+    Result ret = 0;
+    u32 *cmdbuf = getThreadCommandBuffer();
+    cmdbuf[0] = IPC_MakeHeader(3, 0, 0);
+
+    if(R_FAILED(ret = svcSendSyncRequest(pxiStatHandle))) return ret;
+    return (Result)cmdbuf[1];
+}
@@ -0,0 +1,141 @@
+/*
+*   This file is part of Luma3DS
+*   Copyright (C) 2016-2020 Aurora Wright, TuxSH
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Additional Terms 7.b and 7.c of GPLv3 apply to this file:
+*       * Requiring preservation of specified reasonable legal notices or
+*         author attributions in that material or in the Appropriate Legal
+*         Notices displayed by works containing it.
+*       * Prohibiting misrepresentation of the origin of that material,
+*         or requiring that modified versions of such material be marked in
+*         reasonable ways as different from the original version.
+*/
+
+#include <3ds.h>
+#include <string.h>
+#include "qoi.h"
+
+#define QOI_OP_INDEX    0x00
+#define QOI_OP_DIFF     0x40
+#define QOI_OP_LUMA     0x80
+#define QOI_OP_RUN      0xC0
+#define QOI_OP_RGB      0xFE
+
+// Pixels are packed as R | G << 8 | B << 16 | A << 24, alpha is always 255
+#define QOI_PACK(r, g, b)   ((u32)(r) | ((u32)(g) << 8) | ((u32)(b) << 16) | 0xFF000000u)
+#define QOI_HASH(r, g, b)   (((r) * 3 + (g) * 5 + (b) * 7 + 255 * 11) & 63)
+
+static inline void QoiEncoder_WriteBE32(u8 *dst, u32 val)
+{
+    dst[0] = (u8)(val >> 24);
+    dst[1] = (u8)(val >> 16);
+    dst[2] = (u8)(val >> 8);
+    dst[3] = (u8)val;
+}
+
+u32 QoiEncoder_Init(QoiEncoder *enc, u8 *dst, u32 width, u32 height)
+{
+    memset(enc->index, 0, sizeof(enc->index));
+    enc->previous = QOI_PACK(0, 0, 0);
+    enc->run = 0;
+
+    memcpy(dst, "qoif", 4);
+    QoiEncoder_WriteBE32(dst + 4, width);
+    QoiEncoder_WriteBE32(dst + 8, height);
+    dst[12] = 3; // RGB
+    dst[13] = 0; // sRGB with linear alpha
+
+    return QOI_HEADER_SIZE;
+}
+
+u32 QoiEncoder_EncodeBGR8(QoiEncoder *enc, u8 *dst, const u8 *src, u32 numPixels)
+{
+    u8 *out = dst;
+    u32 previous = enc->previous;
+    u32 run = enc->run;
+
+    for (u32 i = 0; i < numPixels; i++, src += 3)
+    {
+        u32 b = src[0], g = src[1], r = src[2];
+        u32 px = QOI_PACK(r, g, b);
+
+        if (px == previous)
+        {
+            if (++run == 62)
+            {
+                *out++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run != 0)
+        {
+            *out++ = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        u32 hash = QOI_HASH(r, g, b);
+        if (enc->index[hash] == px)
+            *out++ = QOI_OP_INDEX | hash;
+        else
+        {
+            enc->index[hash] = px;
+
+            s32 vr = (s8)(r - (previous & 0xFF));
+            s32 vg = (s8)(g - ((previous >> 8) & 0xFF));
+            s32 vb = (s8)(b - ((previous >> 16) & 0xFF));
+            s32 vgr = vr - vg;
+            s32 vgb = vb - vg;
+
+            if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1)
+                *out++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+            else if (vgr >= -8 && vgr <= 7 && vg >= -32 && vg <= 31 && vgb >= -8 && vgb <= 7)
+            {
+                *out++ = QOI_OP_LUMA | (vg + 32);
+                *out++ = (vgr + 8) << 4 | (vgb + 8);
+            }
+            else
+            {
+                *out++ = QOI_OP_RGB;
+                *out++ = (u8)r;
+                *out++ = (u8)g;
+                *out++ = (u8)b;
+            }
+        }
+
+        previous = px;
+    }
+
+    enc->previous = previous;
+    enc->run = run;
+    return (u32)(out - dst);
+}
+
+u32 QoiEncoder_Finish(QoiEncoder *enc, u8 *dst)
+{
+    static const u8 footer[QOI_FOOTER_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    u32 n = 0;
+
+    if (enc->run != 0)
+    {
+        dst[n++] = QOI_OP_RUN | (enc->run - 1);
+        enc->run = 0;
+    }
+
+    memcpy(dst + n, footer, sizeof(footer));
+    return n + sizeof(footer);
+}
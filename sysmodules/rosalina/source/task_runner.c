@@ -35,6 +35,17 @@ void TaskRunner_RunTask(void (*task)(void *argdata), void *argdata, size_t argsi
     LightEvent_Signal(&g_taskRunner.parametersSetEvent);
 }
 
+bool TaskRunner_TryRunTask(void (*task)(void *argdata), void *argdata, size_t argsize)
+{
+    argsize = argsize > sizeof(g_taskRunner.argStorage) ? sizeof(g_taskRunner.argStorage) : argsize;
+    if (!LightEvent_TryWait(&g_taskRunner.readyEvent))
+        return false;
+    g_taskRunner.task = task;
+    memcpy(g_taskRunner.argStorage, argdata, argsize);
+    LightEvent_Signal(&g_taskRunner.parametersSetEvent);
+    return true;
+}
+
 void TaskRunner_Terminate(void)
 {
     g_taskRunner.shouldTerminate = true;
@@ -0,0 +1,58 @@
+// Benchmark of the screenshot framebuffer conversion: whole top screen frames converted by
+// Draw_ConvertFrameBufferLines and by the per-pixel conversion it replaced, for each format, of
+// noise and of screen-like contents (see synthetic_fixture.h).
+// Host numbers only show the relative cost; the ARM11 caches are much smaller.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "draw_fixture.h"
+#include "synthetic_fixture.h"
+
+#define NB_FRAMES   200
+
+static const char *const formatNames[] = { "RGBA8", "BGR8", "RGB565", "RGB5A1", "RGBA4" };
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Converts the frame in batches of 16 lines, like the BMP writer does with a small cache
+static double timeFrames(void (*convert)(u8 *, u32, u32, u32, bool, bool), u8 *buf)
+{
+    double t0 = now();
+    for(u32 i = 0; i < NB_FRAMES; i++)
+    {
+        for(u32 y = 0; y < 240; y += 16)
+            convert(buf, 400, y, 16, true, true);
+    }
+    return now() - t0;
+}
+
+int main(void)
+{
+    static const SyntheticKind kinds[] = { SYNTH_RANDOM, SYNTH_MENU, SYNTH_DITHERED };
+    static u8 buf[400 * 16 * 3];
+    u8 *fb = mapFramebuffer();
+
+    printf("%-8s %-10s %14s %14s %8s\n", "format", "image", "per-pixel MP/s", "run MP/s", "speedup");
+    for(u32 fmt = GSP_RGBA8_OES; fmt <= GSP_RGBA4_OES; fmt++)
+    {
+        for(u32 i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+        {
+            fillSynthetic(fb, FB_MAX_SIZE, fmt, 240, kinds[i], 1);
+            setFramebuffer(true, true, false, fmt, 240 * syntheticFormatSizes[fmt], 0);
+            double reference = timeFrames(Reference_ConvertFrameBufferLines, buf);
+            double runs = timeFrames(Draw_ConvertFrameBufferLines, buf);
+            double mpix = NB_FRAMES * 400 * 240 / 1e6;
+
+            printf("%-8s %-10s %14.1f %14.1f %7.2fx\n", formatNames[fmt], syntheticKindNames[kinds[i]], mpix / reference,
+                   mpix / runs, reference / runs);
+        }
+    }
+
+    return 0;
+}
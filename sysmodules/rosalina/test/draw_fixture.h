@@ -0,0 +1,161 @@
+// Framebuffer screenshot conversion fixture for the draw test and benchmark: the GPU registers
+// and VRAM are mapped where rosalina reaches them, and the conversion that predates the run
+// converters is kept here as the reference.
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../source/draw.c"
+
+#define FB_PA           0x18000000 // VRAM
+#define FB_MAX_SIZE     (400 * 240 * 4 + 0x1000)
+#define GPU_REGS_PA     0x10400000
+
+u32 osGetKernelVersion(void)
+{
+    return SYSTEM_VERSION(2, 46, 0);
+}
+
+Result svcCustomBackdoor(void *func, ...)
+{
+    va_list args;
+    va_start(args, func);
+    void *arg = va_arg(args, void *);
+    va_end(args);
+
+    ((void (*)(void *))func)(arg);
+    return 0;
+}
+
+static u8 *mapAt(uintptr_t addr, size_t size)
+{
+    void *p = mmap((void *)addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(p == MAP_FAILED)
+        abort();
+    return (u8 *)p;
+}
+
+// Maps the GPU registers and a framebuffer in VRAM, returns the latter
+static u8 *mapFramebuffer(void)
+{
+    mapAt((uintptr_t)PA_PTR(GPU_REGS_PA), 0x1000);
+    return mapAt(KERNPA2VA(FB_PA), FB_MAX_SIZE);
+}
+
+// Points the current framebuffer of the given screen (and eye) at FB_PA + offset
+static void setFramebuffer(bool top, bool left, bool secondBuffer, GSPGPU_FramebufferFormat fmt, u32 stride, u32 offset)
+{
+    u32 pa = FB_PA + offset;
+
+    GPU_FB_TOP_SEL = 0;
+    GPU_FB_BOTTOM_SEL = secondBuffer ? 1 : 0;
+    GPU_FB_TOP_LEFT_ADDR_1 = GPU_FB_TOP_LEFT_ADDR_2 = GPU_FB_TOP_RIGHT_ADDR_1 = GPU_FB_TOP_RIGHT_ADDR_2 = 0;
+    GPU_FB_BOTTOM_ADDR_1 = GPU_FB_BOTTOM_ADDR_2 = 0;
+    if(top)
+    {
+        if(left)
+            *(secondBuffer ? &GPU_FB_TOP_LEFT_ADDR_2 : &GPU_FB_TOP_LEFT_ADDR_1) = pa;
+        else
+            *(secondBuffer ? &GPU_FB_TOP_RIGHT_ADDR_2 : &GPU_FB_TOP_RIGHT_ADDR_1) = pa;
+        GPU_FB_TOP_FMT = 0x80000 | fmt;
+        GPU_FB_TOP_STRIDE = stride;
+    }
+    else
+    {
+        *(secondBuffer ? &GPU_FB_BOTTOM_ADDR_2 : &GPU_FB_BOTTOM_ADDR_1) = pa;
+        GPU_FB_BOTTOM_FMT = 0x80000 | fmt;
+        GPU_FB_BOTTOM_STRIDE = stride;
+    }
+}
+
+// The conversion as it was before the run converters, a switch per pixel
+static inline void Reference_ConvertPixelToBGR8(u8 *dst, const u8 *src, GSPGPU_FramebufferFormat srcFormat)
+{
+    u8 red, green, blue;
+    switch(srcFormat)
+    {
+        case GSP_RGBA8_OES:
+        {
+            u32 px = *(u32 *)src;
+            dst[0] = (px >>  8) & 0xFF;
+            dst[1] = (px >> 16) & 0xFF;
+            dst[2] = (px >> 24) & 0xFF;
+            break;
+        }
+        case GSP_BGR8_OES:
+        {
+            dst[2] = src[2];
+            dst[1] = src[1];
+            dst[0] = src[0];
+            break;
+        }
+        case GSP_RGB565_OES:
+        {
+            // thanks neobrain
+            u16 px = *(u16 *)src;
+            blue = px & 0x1F;
+            green = (px >> 5) & 0x3F;
+            red = (px >> 11) & 0x1F;
+
+            dst[0] = (blue  << 3) | (blue  >> 2);
+            dst[1] = (green << 2) | (green >> 4);
+            dst[2] = (red   << 3) | (red   >> 2);
+
+            break;
+        }
+        case GSP_RGB5_A1_OES:
+        {
+            u16 px = *(u16 *)src;
+            blue = (px >> 1) & 0x1F;
+            green = (px >> 6) & 0x1F;
+            red = (px >> 11) & 0x1F;
+
+            dst[0] = (blue  << 3) | (blue  >> 2);
+            dst[1] = (green << 3) | (green >> 2);
+            dst[2] = (red   << 3) | (red   >> 2);
+
+            break;
+        }
+        case GSP_RGBA4_OES:
+        {
+            u16 px = *(u32 *)src;
+            blue = (px >> 4) & 0xF;
+            green = (px >> 8) & 0xF;
+            red = (px >> 12) & 0xF;
+
+            dst[0] = (blue  << 4) | (blue  >> 0);
+            dst[1] = (green << 4) | (green >> 0);
+            dst[2] = (red   << 4) | (red   >> 0);
+
+            break;
+        }
+        default: break;
+    }
+}
+
+static void Reference_ConvertFrameBufferLines(u8 *buf, u32 width, u32 startingLine, u32 numLines, bool top, bool left)
+{
+    static const u8 formatSizes[] = { 4, 3, 2, 2, 2 };
+
+    GSPGPU_FramebufferFormat fmt = top ? (GSPGPU_FramebufferFormat)(GPU_FB_TOP_FMT & 7) : (GSPGPU_FramebufferFormat)(GPU_FB_BOTTOM_FMT & 7);
+    u32 stride = top ? GPU_FB_TOP_STRIDE : GPU_FB_BOTTOM_STRIDE;
+
+    u32 pa = Draw_GetCurrentFramebufferAddress(top, left);
+    u8 *addr = (u8 *)KERNPA2VA(pa);
+
+    if(fmt > GSP_RGBA4_OES)
+        return;
+
+    for(u32 y = startingLine; y < startingLine + numLines; y++)
+    {
+        for(u32 x = 0; x < width; x++)
+        {
+            __builtin_prefetch(addr + x * stride + y * formatSizes[fmt], 0, 3);
+            Reference_ConvertPixelToBGR8(buf + (x + width * (y - startingLine)) * 3, addr + x * stride + y * formatSizes[fmt], fmt);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+// Host test of the screenshot framebuffer conversion (Draw_ConvertFrameBufferLines in draw.c):
+// the output must be bit-exact with the per-pixel conversion it replaced, for all five
+// framebuffer formats, both screens and any batch of lines, on noise and screen-like contents.
+
+#include <stdio.h>
+
+#include "draw_fixture.h"
+#include "synthetic_fixture.h"
+
+#include "test_common.h"
+
+static u8 *fb;
+static u8 expected[400 * 240 * 3 + 64], actual[400 * 240 * 3 + 64];
+
+// Converts the lines both ways, with the bytes past them checked to be left alone
+static bool convertAndCompare(u32 width, u32 startingLine, u32 numLines, bool top, bool left)
+{
+    memset(expected, 0xAA, sizeof(expected));
+    memset(actual, 0xAA, sizeof(actual));
+    Reference_ConvertFrameBufferLines(expected, width, startingLine, numLines, top, left);
+    Draw_ConvertFrameBufferLines(actual, width, startingLine, numLines, top, left);
+    return memcmp(expected, actual, sizeof(actual)) == 0;
+}
+
+static void testAllFormats(void)
+{
+    static const SyntheticKind kinds[] = { SYNTH_RANDOM, SYNTH_MENU, SYNTH_GRADIENT, SYNTH_DITHERED };
+
+    for(u32 fmt = GSP_RGBA8_OES; fmt <= GSP_RGBA4_OES; fmt++)
+    {
+        for(u32 screen = 0; screen < 4; screen++)
+        {
+            bool top = screen != 3, left = screen != 1, secondBuffer = screen == 2;
+            u32 width = top ? 400 : 320;
+
+            // Framebuffer lines are padded at times, and may start anywhere in VRAM
+            for(u32 padding = 0; padding <= 8; padding += 4)
+            {
+                for(u32 offset = 0; offset < 4; offset++)
+                {
+                    u32 stride = 240 * syntheticFormatSizes[fmt] + padding;
+
+                    fillSynthetic(fb, FB_MAX_SIZE, fmt, 240, kinds[offset], rnd());
+                    setFramebuffer(top, left, secondBuffer, fmt, stride, offset);
+                    CHECK(convertAndCompare(width, 0, 240, top, left));
+
+                    // Every starting line with short batches, then the batch sizes the screenshot writers use
+                    for(u32 y = 0; y < 240; y += 1 + y / 16)
+                        CHECK(convertAndCompare(width, y, 1 + rnd() % (y < 232 ? 8 : 240 - y), top, left));
+                    for(u32 nlines = 1; nlines <= 240; nlines = 2 * nlines + 1)
+                    {
+                        for(u32 y = 0; y < 240; y += nlines)
+                            CHECK(convertAndCompare(width, y, y + nlines > 240 ? 240 - y : nlines, top, left));
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void testUnknownFormats(void)
+{
+    for(u32 fmt = GSP_RGBA4_OES + 1; fmt < 8; fmt++)
+    {
+        setFramebuffer(true, true, false, fmt, 240 * 4, 0);
+        memset(actual, 0x55, sizeof(actual));
+        Draw_ConvertFrameBufferLines(actual, 400, 0, 240, true, true);
+        bool untouched = true;
+        for(u32 i = 0; i < sizeof(actual); i++)
+            untouched = untouched && actual[i] == 0x55;
+        CHECK(untouched);
+    }
+}
+
+int main(void)
+{
+    fb = mapFramebuffer();
+
+    testAllFormats();
+    testUnknownFormats();
+
+    printf("draw_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
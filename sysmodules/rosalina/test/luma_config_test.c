@@ -0,0 +1,418 @@
+// Host test of how rosalina saves config.ini (luma_config_ini.c): the serialized settings, and
+// the write itself, skipped when the file already holds them, against a mock SD card.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/luma_config_ini.c"
+#include "../source/utils.c"
+
+#include "test_common.h"
+
+#define INI_PATH    "/luma/config.ini"
+#define TMP_PATH    "/luma/config.ini.tmp"
+
+// The SD card
+
+typedef struct MockFile
+{
+    const char *path;
+    bool exists;
+    char data[LUMA_INI_BUFFER_SIZE];
+    u32 size;
+} MockFile;
+
+static MockFile files[] = { { .path = INI_PATH }, { .path = TMP_PATH } };
+
+static u32 nbFileWrites, nbRenames;
+
+// What fails next
+static bool failSetSize, failWrite, shortWrite, failIniDelete, failRename;
+
+static MockFile *fileFromPath(FS_Path path)
+{
+    for(u32 i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        if(strcmp((const char *)path.data, files[i].path) == 0)
+            return &files[i];
+    }
+
+    return NULL;
+}
+
+Result IFile_OpenFromArchive(IFile *file, FS_Archive archive, FS_Path filePath, u32 flags)
+{
+    MockFile *f = fileFromPath(filePath);
+
+    (void)archive;
+    if(f == NULL)
+        return -1;
+    if(!f->exists)
+    {
+        if(!(flags & FS_OPEN_CREATE))
+            return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+        f->exists = true;
+        f->size = 0;
+    }
+
+    file->handle = (Handle)(f - files) + 1;
+    file->pos = 0;
+    file->size = f->size;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_GetSize(IFile *file, u64 *size)
+{
+    *size = files[file->handle - 1].size;
+    return 0;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+    if(failSetSize || size > LUMA_INI_BUFFER_SIZE)
+        return -1;
+
+    files[file->handle - 1].size = size;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    MockFile *f = &files[file->handle - 1];
+    u32 n = file->pos >= f->size ? 0 : (f->size - file->pos < len ? f->size - file->pos : len);
+
+    memcpy(buffer, f->data + file->pos, n);
+    file->pos += n;
+    *total = n;
+    return 0;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    MockFile *f = &files[file->handle - 1];
+
+    (void)flags;
+    if(failWrite || file->pos + len > LUMA_INI_BUFFER_SIZE)
+        return -1;
+    if(shortWrite)
+        len /= 2;
+
+    memcpy(f->data + file->pos, buffer, len);
+    file->pos += len;
+    if(file->pos > f->size)
+        f->size = file->pos;
+    *total = len;
+    nbFileWrites++;
+    return 0;
+}
+
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path)
+{
+    MockFile *f = fileFromPath(path);
+
+    (void)archive;
+    if(f == NULL || !f->exists)
+        return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+    if(failIniDelete && f == &files[0])
+        return -1;
+
+    f->exists = false;
+    return 0;
+}
+
+// Like on FAT, the destination must not exist
+Result FSUSER_RenameFile(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath)
+{
+    MockFile *src = fileFromPath(srcPath), *dst = fileFromPath(dstPath);
+
+    (void)srcArchive;
+    (void)dstArchive;
+    if(failRename || src == NULL || dst == NULL || !src->exists || dst->exists)
+        return -1;
+
+    memcpy(dst->data, src->data, src->size);
+    dst->size = src->size;
+    dst->exists = true;
+    src->exists = false;
+    nbRenames++;
+    return 0;
+}
+
+static void resetCard(void)
+{
+    for(u32 i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+        files[i].exists = false;
+    failSetSize = failWrite = shortWrite = failIniDelete = failRename = false;
+}
+
+// The settings
+
+#define TEST_VERSION    SYSTEM_VERSION(13, 1, 0)
+
+static void getDefaultConfig(CfgData *cfg)
+{
+    static const ScreenFilter defaultFilter = { 6500, false, 1.0f, 1.0f, 0.0f };
+
+    memset(cfg, 0, sizeof(CfgData));
+    cfg->formatVersionMajor = 3;
+    cfg->formatVersionMinor = 9;
+    cfg->config = 1 << PATCHGAMES | 1 << SHOWGBABOOT;
+    cfg->multiConfig = 1 << (2 * SPLASH) | 3 << (2 * NEWCPU);
+    cfg->splashDurationMsec = 3000;
+    cfg->hbldr3dsxTitleId = 0x000400000D921E00ull;
+    cfg->rosalinaMenuCombo = KEY_L | KEY_DDOWN | KEY_SELECT;
+    cfg->pluginLoaderFlags = 2 | 4 << 8;
+    cfg->topScreenFilter = defaultFilter;
+    cfg->bottomScreenFilter = defaultFilter;
+}
+
+static u32 serialize(char *out, const CfgData *cfg)
+{
+    u32 n = LumaConfig_SaveLumaIniConfigToStr(out, cfg, TEST_VERSION, 0x1234abcd, false);
+
+    CHECK(n != 0 && n < LUMA_INI_BUFFER_SIZE && strlen(out) == n);
+    return n;
+}
+
+static bool hasLine(const char *ini, const char *line)
+{
+    size_t len = strlen(line);
+
+    for(const char *p = strstr(ini, line); p != NULL; p = strstr(p + 1, line))
+    {
+        if((p == ini || p[-1] == '\n') && p[len] == '\n')
+            return true;
+    }
+
+    return false;
+}
+
+// What a save does: serialize, then write unless the file already holds exactly that
+static Result save(const CfgData *cfg)
+{
+    static char ini[LUMA_INI_BUFFER_SIZE];
+    u32 n = serialize(ini, cfg);
+
+    return LumaConfig_WriteFileIfChanged(0, INI_PATH, TMP_PATH, ini, n);
+}
+
+// Number of lines which differ between the saved file and the given settings
+static u32 countChangedLines(const CfgData *cfg)
+{
+    static char ini[LUMA_INI_BUFFER_SIZE], saved[LUMA_INI_BUFFER_SIZE];
+    u32 nbChanged = 0;
+
+    serialize(ini, cfg);
+    memcpy(saved, files[0].data, files[0].size);
+    saved[files[0].size] = 0;
+
+    for(char *a = ini, *b = saved; *a != 0 || *b != 0;)
+    {
+        size_t lenA = strcspn(a, "\n"), lenB = strcspn(b, "\n");
+
+        nbChanged += lenA != lenB || memcmp(a, b, lenA) != 0;
+        a += lenA + (a[lenA] != 0);
+        b += lenB + (b[lenB] != 0);
+    }
+
+    return nbChanged;
+}
+
+static void testSerialize(void)
+{
+    static char ini[LUMA_INI_BUFFER_SIZE];
+    CfgData cfg;
+
+    getDefaultConfig(&cfg);
+    serialize(ini, &cfg);
+
+    CHECK(strncmp(ini, "; This configuration file was automatically generated by Luma3DS v13.1-1234abcd\n", 80) == 0);
+    CHECK(hasLine(ini, "config_version_major = 3"));
+    CHECK(hasLine(ini, "config_version_minor = 9"));
+    CHECK(hasLine(ini, "enable_game_patching = 1"));
+    CHECK(hasLine(ini, "autoboot_emunand = 0"));
+    CHECK(hasLine(ini, "splash_position = before payloads"));
+    CHECK(hasLine(ini, "splash_duration_ms = 3000"));
+    CHECK(hasLine(ini, "app_launch_new_3ds_cpu = clock+l2"));
+    CHECK(hasLine(ini, "hbldr_3dsx_titleid = 000400000d921e00"));
+    CHECK(hasLine(ini, "rosalina_menu_combo = L+Down+Select"));
+    CHECK(hasLine(ini, "plugin_loader_enabled = 0"));
+    CHECK(hasLine(ini, "plugin_loader_swap_compression = 1"));
+    CHECK(hasLine(ini, "plugin_loader_cache_size_mb = 4"));
+    CHECK(hasLine(ini, "screen_filters_top_gamma = 1"));
+    CHECK(hasLine(ini, "screen_filters_bot_brightness = 0"));
+    CHECK(hasLine(ini, "save_boot_trace = 0"));
+
+    // Release builds don't name the commit
+    LumaConfig_SaveLumaIniConfigToStr(ini, &cfg, SYSTEM_VERSION(13, 1, 2), 0x1234abcd, true);
+    CHECK(strncmp(ini, "; This configuration file was automatically generated by Luma3DS v13.1.2\n", 73) == 0);
+}
+
+static void testUnchangedSettingsAreNotWritten(void)
+{
+    CfgData cfg;
+
+    resetCard();
+    getDefaultConfig(&cfg);
+
+    // First save: there is no config.ini yet
+    nbFileWrites = nbRenames = 0;
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && nbRenames == 1);
+    CHECK(files[0].exists && !files[1].exists && countChangedLines(&cfg) == 0);
+
+    // Saving the same settings again, as after a toggle set back to its former value, writes nothing
+    nbFileWrites = nbRenames = 0;
+    for(u32 i = 0; i < 5; i++)
+        CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 0 && nbRenames == 0);
+
+    // A file with the same settings but other contents, edited by hand say, is replaced
+    files[0].data[files[0].size - 2] = '1';
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && nbRenames == 1 && countChangedLines(&cfg) == 0);
+
+    // As are ones cut short, or with more after the same contents
+    nbFileWrites = nbRenames = 0;
+    files[0].size -= 10;
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && nbRenames == 1 && countChangedLines(&cfg) == 0);
+
+    nbFileWrites = nbRenames = 0;
+    memcpy(files[0].data + files[0].size, "a = 1\n", 6);
+    files[0].size += 6;
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && nbRenames == 1 && countChangedLines(&cfg) == 0);
+}
+
+static void testOneChangedSetting(void)
+{
+    CfgData cfg;
+
+    resetCard();
+    getDefaultConfig(&cfg);
+    save(&cfg);
+
+    cfg.topScreenFilter.gamma = 1.25f;
+    CHECK(countChangedLines(&cfg) == 1);
+
+    nbFileWrites = nbRenames = 0;
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && nbRenames == 1);
+    CHECK(files[0].exists && !files[1].exists && countChangedLines(&cfg) == 0);
+
+    files[0].data[files[0].size] = 0;
+    CHECK(hasLine(files[0].data, "screen_filters_top_gamma = 1.25"));
+    CHECK(hasLine(files[0].data, "screen_filters_bot_gamma = 1"));
+}
+
+static void testCoalescedChanges(void)
+{
+    CfgData cfg;
+
+    resetCard();
+    getDefaultConfig(&cfg);
+    save(&cfg);
+
+    // Everything changed while the menu was open is saved at once
+    cfg.topScreenFilter.cct = cfg.bottomScreenFilter.cct = 2700;
+    cfg.bottomScreenFilter.invert = true;
+    cfg.rosalinaMenuCombo = KEY_L | KEY_R | KEY_START;
+    cfg.pluginLoaderFlags |= 1;
+    cfg.ntpTzOffetMinutes = -90;
+    cfg.hbldr3dsxTitleId = 0x0004000000123400ull;
+    CHECK(countChangedLines(&cfg) == 7);
+
+    nbFileWrites = nbRenames = 0;
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && nbRenames == 1 && countChangedLines(&cfg) == 0);
+
+    files[0].data[files[0].size] = 0;
+    CHECK(hasLine(files[0].data, "screen_filters_top_cct = 2700"));
+    CHECK(hasLine(files[0].data, "screen_filters_bot_cct = 2700"));
+    CHECK(hasLine(files[0].data, "screen_filters_bot_invert = 1"));
+    CHECK(hasLine(files[0].data, "rosalina_menu_combo = L+R+Start"));
+    CHECK(hasLine(files[0].data, "plugin_loader_enabled = 1"));
+    CHECK(hasLine(files[0].data, "ntp_tz_offset_min = -90"));
+    CHECK(hasLine(files[0].data, "hbldr_3dsx_titleid = 0004000000123400"));
+
+    // Some of them undone before the save: only what differs from the file counts
+    cfg.pluginLoaderFlags &= ~1;
+    cfg.pluginLoaderFlags |= 1;
+    cfg.bottomScreenFilter.invert = false;
+    CHECK(countChangedLines(&cfg) == 1);
+    nbFileWrites = 0;
+    CHECK(R_SUCCEEDED(save(&cfg)));
+    CHECK(nbFileWrites == 1 && countChangedLines(&cfg) == 0);
+}
+
+// A failed save leaves config.ini as it was, and no temporary file for arm9 to read, unless
+// that is all there is left of the settings
+static void testFailedWrites(void)
+{
+    static char saved[LUMA_INI_BUFFER_SIZE];
+    bool *failures[] = { &failSetSize, &failWrite, &shortWrite, &failIniDelete };
+    CfgData cfg, newCfg;
+
+    getDefaultConfig(&cfg);
+    newCfg = cfg;
+    newCfg.ntpTzOffetMinutes = 60;
+
+    for(u32 i = 0; i < sizeof(failures) / sizeof(failures[0]); i++)
+    {
+        resetCard();
+        save(&cfg);
+        memcpy(saved, files[0].data, files[0].size);
+
+        *failures[i] = true;
+        CHECK(R_FAILED(save(&newCfg)));
+        CHECK(files[0].exists && memcmp(files[0].data, saved, files[0].size) == 0 && countChangedLines(&cfg) == 0);
+        CHECK(!files[1].exists);
+    }
+
+    // Also when there was no config.ini to begin with
+    for(u32 i = 0; i < 3; i++)
+    {
+        resetCard();
+        *failures[i] = true;
+        CHECK(R_FAILED(save(&newCfg)));
+        CHECK(!files[0].exists && !files[1].exists);
+    }
+
+    // config.ini deleted, but not replaced: the complete temporary file stays
+    resetCard();
+    save(&cfg);
+    failRename = true;
+    CHECK(R_FAILED(save(&newCfg)));
+    CHECK(!files[0].exists && files[1].exists);
+    failRename = false;
+    memcpy(&files[0], &files[1], sizeof(MockFile));
+    files[0].path = INI_PATH;
+    CHECK(countChangedLines(&newCfg) == 0);
+
+    // The next save goes through all the same
+    resetCard();
+    files[1].exists = true;
+    files[1].size = 10;
+    CHECK(R_SUCCEEDED(save(&newCfg)));
+    CHECK(files[0].exists && !files[1].exists && countChangedLines(&newCfg) == 0);
+}
+
+int main(void)
+{
+    testSerialize();
+    testUnchangedSettingsAreNotWritten();
+    testOneChangedSetting();
+    testCoalescedChanges();
+    testFailedWrites();
+
+    printf("luma_config_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+// Host test of the plugin image cache (plugin/plgcache.c): hits and misses, LRU eviction within
+// the entry count and the memory budget, and giving the memory back with PluginCache__Free.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../source/plugin/plgcache.c"
+
+#include "test_common.h"
+
+// Kernel side: the SYSTEM region
+
+static u32 systemFree = 64 << 20, cacheAllocatedSize;
+
+Result svcControlMemoryEx(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm, bool isLoader)
+{
+    (void)addr1;
+    (void)op;
+    (void)perm;
+    (void)isLoader;
+    if(size > systemFree || addr0 != PLUGIN_CACHE_ADDR || cacheAllocatedSize != 0)
+        return MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_KERNEL, RD_OUT_OF_MEMORY);
+
+    void *p = mmap((void *)(uintptr_t)addr0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(p == MAP_FAILED)
+        return -1;
+
+    memset(p, 0xA5, size);
+    systemFree -= size;
+    cacheAllocatedSize = size;
+    *addr_out = addr0;
+    return 0;
+}
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr_out;
+    (void)addr1;
+    (void)op;
+    (void)perm;
+    CHECK(addr0 == PLUGIN_CACHE_ADDR && size == cacheAllocatedSize);
+    munmap((void *)(uintptr_t)addr0, size);
+    systemFree += size;
+    cacheAllocatedSize = 0;
+    return 0;
+}
+
+// A parsed plugin: header, then the author and title messages and the targets, like
+// Read_3gx_ParseHeader leaves it, followed by its decoded segments
+
+typedef struct TestPlugin
+{
+    char path[64];
+    u64 fileSize;
+    u64 timestamp;
+    _3gx_Header *header;
+    _3gx_EmbeddedPayloads payloads;
+    u8 *segments;
+} TestPlugin;
+
+static void makePlugin(TestPlugin *plugin, u32 id, u32 segmentsSize, u64 timestamp)
+{
+    static const char author[] = "author", title[] = "title";
+    u32 nbTitles = 1 + id % 3;
+    u8 *buf = calloc(1, sizeof(_3gx_Header) + sizeof(author) + sizeof(title) + 4 * nbTitles);
+    _3gx_Header *header = (_3gx_Header *)buf;
+
+    sprintf(plugin->path, "/luma/plugins/%016llX/p%u.3gx", 0x0004000000000000ULL | id << 8, id);
+    plugin->fileSize = segmentsSize + 0x1000;
+    plugin->timestamp = timestamp;
+
+    header->magic = _3GX_MAGIC;
+    header->infos.embeddedExeLoadFunc = 1;
+    header->infos.exeLoadChecksum = id * 0x9E3779B9;
+    header->executable.codeSize = segmentsSize / 2;
+    header->executable.rodataSize = segmentsSize / 4;
+    header->executable.dataSize = segmentsSize - segmentsSize / 2 - segmentsSize / 4;
+    header->infos.authorMsg = memcpy(buf + sizeof(_3gx_Header), author, sizeof(author));
+    header->infos.titleMsg = memcpy(buf + sizeof(_3gx_Header) + sizeof(author), title, sizeof(title));
+    header->targets.count = nbTitles;
+    header->targets.titles = (u32 *)(buf + sizeof(_3gx_Header) + sizeof(author) + sizeof(title));
+    for(u32 i = 0; i < nbTitles; i++)
+        header->targets.titles[i] = id + i;
+    plugin->header = header;
+
+    for(u32 i = 0; i < 32; i++)
+        plugin->payloads.exeLoadFunc[i] = id + i;
+
+    plugin->segments = malloc(segmentsSize);
+    for(u32 i = 0; i < segmentsSize; i++)
+        plugin->segments[i] = (u8)(i * 7 + id);
+}
+
+static void freePlugin(TestPlugin *plugin)
+{
+    free(plugin->header);
+    free(plugin->segments);
+}
+
+static u32 segmentsSizeOf(const TestPlugin *plugin)
+{
+    const _3gx_Executable *exe = &plugin->header->executable;
+    return exe->codeSize + exe->rodataSize + exe->dataSize;
+}
+
+static void insert(const TestPlugin *plugin)
+{
+    PluginCache__Insert(plugin->path, plugin->fileSize, plugin->timestamp, plugin->header, &plugin->payloads, plugin->segments);
+}
+
+// Finds the plugin and checks that what comes back is what was inserted
+static bool findAndCheck(const TestPlugin *plugin)
+{
+    PluginCacheEntry *entry = PluginCache__Find(plugin->path, plugin->fileSize, plugin->timestamp);
+    if(entry == NULL)
+        return false;
+
+    static u8 headerBuf[0x1000], segments[1 << 20];
+    _3gx_Header *header = (_3gx_Header *)headerBuf;
+
+    PluginCache__RestoreHeader(entry, header);
+    CHECK(header->infos.exeLoadChecksum == plugin->header->infos.exeLoadChecksum);
+    CHECK(strcmp(header->infos.authorMsg, "author") == 0 && strcmp(header->infos.titleMsg, "title") == 0);
+    CHECK(header->targets.count == plugin->header->targets.count);
+    for(u32 i = 0; i < header->targets.count; i++)
+        CHECK(header->targets.titles[i] == plugin->header->targets.titles[i]);
+    CHECK(PluginCache__GetHeader(entry)->executable.codeSize == plugin->header->executable.codeSize);
+    CHECK(memcmp(&entry->payloads, &plugin->payloads, sizeof(_3gx_EmbeddedPayloads)) == 0);
+
+    memset(segments, 0, segmentsSizeOf(plugin));
+    PluginCache__RestoreSegments(entry, segments);
+    CHECK(memcmp(segments, plugin->segments, segmentsSizeOf(plugin)) == 0);
+    return true;
+}
+
+static void testHitsAndEviction(void)
+{
+    TestPlugin plugins[6];
+    PluginCacheStats stats;
+
+    PluginCache__Init(1 << 20);
+    CHECK(PluginCache__IsEnabled());
+    for(u32 i = 0; i < 6; i++)
+        makePlugin(&plugins[i], i, 0x10000 + i * 0x1000, 1000 + i);
+
+    CHECK(!findAndCheck(&plugins[0]));
+    CHECK(cacheAllocatedSize == 0);
+
+    for(u32 i = 0; i < 4; i++)
+        insert(&plugins[i]);
+    CHECK(cacheAllocatedSize == 1 << 20);
+    for(u32 i = 0; i < 4; i++)
+        CHECK(findAndCheck(&plugins[i]));
+
+    // Use 0 so that 1 is the least recently used, then insert past the entry count
+    CHECK(findAndCheck(&plugins[0]));
+    insert(&plugins[4]);
+    CHECK(!findAndCheck(&plugins[1]));
+    CHECK(findAndCheck(&plugins[0]) && findAndCheck(&plugins[2]) && findAndCheck(&plugins[3]) && findAndCheck(&plugins[4]));
+
+    // Changed file, unknown timestamp
+    plugins[2].timestamp++;
+    CHECK(!findAndCheck(&plugins[2]));
+    plugins[2].fileSize++;
+    insert(&plugins[2]);
+    CHECK(findAndCheck(&plugins[2]));
+    plugins[3].timestamp = 0;
+    CHECK(!findAndCheck(&plugins[3]));
+    insert(&plugins[3]);
+    PluginCache__GetStats(&stats);
+    CHECK(stats.nbEntries == 4);
+    CHECK(stats.hits > 0 && stats.misses > 0 && stats.budget == 1 << 20 && stats.usedSize <= stats.budget);
+
+    for(u32 i = 0; i < 6; i++)
+        freePlugin(&plugins[i]);
+}
+
+static void testBudget(void)
+{
+    TestPlugin big[3], huge;
+    PluginCacheStats stats;
+
+    PluginCache__Free();
+    PluginCache__Init(1 << 20);
+
+    // Only two of these fit in the budget
+    for(u32 i = 0; i < 3; i++)
+    {
+        makePlugin(&big[i], 10 + i, 400 << 10, 1);
+        insert(&big[i]);
+        PluginCache__GetStats(&stats);
+        CHECK(stats.usedSize <= stats.budget);
+    }
+    CHECK(!findAndCheck(&big[0]) && findAndCheck(&big[1]) && findAndCheck(&big[2]));
+
+    // Never cached
+    makePlugin(&huge, 20, 1 << 20, 1);
+    insert(&huge);
+    CHECK(!findAndCheck(&huge));
+    CHECK(findAndCheck(&big[1]) && findAndCheck(&big[2]));
+
+    for(u32 i = 0; i < 3; i++)
+        freePlugin(&big[i]);
+    freePlugin(&huge);
+}
+
+// The memory goes back to the SYSTEM region, and comes back on the next insert
+static void testFree(void)
+{
+    TestPlugin plugin;
+    PluginCacheStats stats;
+
+    PluginCache__Free();
+    PluginCache__Init(2 << 20);
+    makePlugin(&plugin, 30, 0x8000, 5);
+    insert(&plugin);
+    CHECK(cacheAllocatedSize == 2 << 20);
+
+    u32 freeBefore = systemFree;
+    PluginCache__Free();
+    CHECK(cacheAllocatedSize == 0 && systemFree == freeBefore + (2 << 20));
+    CHECK(!findAndCheck(&plugin));
+    PluginCache__GetStats(&stats);
+    CHECK(stats.nbEntries == 0 && stats.usedSize == 0);
+    CHECK(PluginCache__IsEnabled());
+
+    PluginCache__Free();
+    CHECK(systemFree == freeBefore + (2 << 20));
+
+    insert(&plugin);
+    CHECK(findAndCheck(&plugin));
+    CHECK(cacheAllocatedSize == 2 << 20);
+
+    // Not enough memory left: the cache disables itself
+    PluginCache__Free();
+    systemFree = 1 << 20;
+    insert(&plugin);
+    CHECK(!findAndCheck(&plugin));
+    CHECK(!PluginCache__IsEnabled());
+
+    freePlugin(&plugin);
+}
+
+int main(void)
+{
+    testHitsAndEviction();
+    testBudget();
+    testFree();
+
+    printf("plgcache_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
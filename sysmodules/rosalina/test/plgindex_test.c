@@ -0,0 +1,632 @@
+// Host test of the plugin index (plugin/plgindex.c) and of the plugin lookup built on it
+// (OpenPluginFile in plugin/file_loader.c), against a mock SD card. The mock follows FAT:
+// adding or removing a file doesn't necessarily change the directory timestamp. An indexed
+// launch still counts the directory entries, but never looks at their names.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../source/plugin/file_loader.c"
+#include "../source/plugin/plgindex.c"
+
+PluginLoaderContext PluginLoaderCtx;
+
+#include "test_common.h"
+
+// The SD card
+
+#define MAX_DIRS    200
+#define MAX_FILES   24
+
+typedef struct MockDir
+{
+    u64     titleId;
+    bool    exists;
+    u64     timestamp;
+    u32     nbFiles;
+    char    names[MAX_FILES][64];
+    bool    isDirectory[MAX_FILES];
+} MockDir;
+
+static MockDir dirs[MAX_DIRS];
+static bool hasDefaultPlugin;
+static u8 indexFile[sizeof(PluginIndex)];
+static u32 indexFileSize;
+static bool indexFileExists;
+
+static u32 nbDirOpens, nbNameConversions, nbIndexWrites;
+
+typedef struct MockDirHandle
+{
+    MockDir *dir;
+    u32 pos;
+} MockDirHandle;
+
+static MockDirHandle dirHandles[4];
+
+static MockDir *findDir(u64 titleId)
+{
+    for(u32 i = 0; i < MAX_DIRS; i++)
+    {
+        if(dirs[i].exists && dirs[i].titleId == titleId)
+            return &dirs[i];
+    }
+
+    return NULL;
+}
+
+static MockDir *dirFromPath(const char *path)
+{
+    unsigned long long titleId;
+
+    if(sscanf(path, "/luma/plugins/%16llX", &titleId) != 1 || strlen(path) < 30)
+        return NULL;
+
+    return findDir(titleId);
+}
+
+static void addFile(MockDir *dir, const char *name, bool isDirectory)
+{
+    strcpy(dir->names[dir->nbFiles], name);
+    dir->isDirectory[dir->nbFiles++] = isDirectory;
+}
+
+// Listed before the other files, so that a scan finds it first
+static void addPluginFirst(MockDir *dir, const char *name)
+{
+    memmove(&dir->names[1], &dir->names[0], dir->nbFiles * sizeof(dir->names[0]));
+    memmove(&dir->isDirectory[1], &dir->isDirectory[0], dir->nbFiles * sizeof(dir->isDirectory[0]));
+    strcpy(dir->names[0], name);
+    dir->isDirectory[0] = false;
+    dir->nbFiles++;
+}
+
+static bool hasFile(const MockDir *dir, const char *name)
+{
+    for(u32 i = 0; i < dir->nbFiles; i++)
+    {
+        if(strcmp(dir->names[i], name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static bool removeFile(MockDir *dir, const char *name)
+{
+    for(u32 i = 0; i < dir->nbFiles; i++)
+    {
+        if(strcmp(dir->names[i], name) == 0)
+        {
+            memmove(&dir->names[i], &dir->names[i + 1], (dir->nbFiles - i - 1) * sizeof(dir->names[0]));
+            memmove(&dir->isDirectory[i], &dir->isDirectory[i + 1], (dir->nbFiles - i - 1) * sizeof(dir->isDirectory[0]));
+            dir->nbFiles--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static MockDir *createDir(u64 titleId, u64 timestamp)
+{
+    for(u32 i = 0; i < MAX_DIRS; i++)
+    {
+        if(!dirs[i].exists)
+        {
+            memset(&dirs[i], 0, sizeof(MockDir));
+            dirs[i].exists = true;
+            dirs[i].titleId = titleId;
+            dirs[i].timestamp = timestamp;
+            return &dirs[i];
+        }
+    }
+
+    abort();
+}
+
+static bool isPlugin(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 5 && strcmp(name + len - 3, "3gx") == 0;
+}
+
+static void resetCard(void)
+{
+    memset(dirs, 0, sizeof(dirs));
+    hasDefaultPlugin = false;
+    indexFileExists = false;
+    indexFileSize = 0;
+}
+
+// Rosalina restarting, the SD card is kept
+static void reboot(void)
+{
+    g_pluginIndexLoaded = false;
+    memset(&g_pluginIndex, 0xCC, sizeof(g_pluginIndex));
+}
+
+ssize_t utf16_to_utf8(u8 *out, const u16 *in, size_t len)
+{
+    size_t n = 0;
+    nbNameConversions++;
+    for(; n < len && in[n] != 0; n++)
+        out[n] = (u8)in[n];
+    return n;
+}
+
+ssize_t utf8_to_utf16(u16 *out, const u8 *in, size_t len)
+{
+    size_t n = 0;
+    for(; n < len && in[n] != 0; n++)
+        out[n] = in[n];
+    return n;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_ControlArchive(FS_Archive archive, u32 action, void *input, u32 inputSize, void *output, u32 outputSize)
+{
+    char path[256];
+    const u16 *path16 = (const u16 *)input;
+
+    (void)archive;
+    if(action != ARCHIVE_ACTION_GET_TIMESTAMP || outputSize != sizeof(u64))
+        return -1;
+
+    u32 i;
+    for(i = 0; i < inputSize / 2 && path16[i] != 0; i++)
+        path[i] = (char)path16[i];
+    path[i] = 0;
+
+    MockDir *dir = dirFromPath(path);
+    if(dir == NULL)
+        return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+
+    *(u64 *)output = dir->timestamp;
+    return 0;
+}
+
+Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path)
+{
+    (void)archive;
+    MockDir *dir = dirFromPath((const char *)path.data);
+
+    if(dir == NULL)
+        return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+
+    for(u32 i = 0; i < 4; i++)
+    {
+        if(dirHandles[i].dir == NULL)
+        {
+            dirHandles[i].dir = dir;
+            dirHandles[i].pos = 0;
+            *out = i + 1;
+            nbDirOpens++;
+            return 0;
+        }
+    }
+
+    abort();
+}
+
+Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries)
+{
+    MockDirHandle *h = &dirHandles[handle - 1];
+    u32 n = 0;
+
+    for(; n < entryCount && h->pos < h->dir->nbFiles; n++, h->pos++)
+    {
+        memset(&entries[n], 0, sizeof(FS_DirectoryEntry));
+        utf8_to_utf16(entries[n].name, (const u8 *)h->dir->names[h->pos], 0x105);
+        entries[n].attributes = h->dir->isDirectory[h->pos] ? FS_ATTRIBUTE_DIRECTORY : 0;
+    }
+
+    *entriesRead = n;
+    return 0;
+}
+
+Result FSDIR_Close(Handle handle)
+{
+    dirHandles[handle - 1].dir = NULL;
+    return 0;
+}
+
+static bool pluginFileExists(const char *path)
+{
+    if(strcmp(path, "/luma/plugins/default.3gx") == 0)
+        return hasDefaultPlugin;
+
+    MockDir *dir = dirFromPath(path);
+    if(dir == NULL || path[30] != '/')
+        return false;
+
+    for(u32 i = 0; i < dir->nbFiles; i++)
+    {
+        if(!dir->isDirectory[i] && strcmp(dir->names[i], path + 31) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+// Handle 1 is the index, 2 is a plugin
+Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+{
+    (void)archiveId;
+    (void)archivePath;
+    if(flags != FS_OPEN_READ || !pluginFileExists((const char *)filePath.data))
+        return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+
+    file->handle = 2;
+    file->pos = 0;
+    file->size = 0;
+    return 0;
+}
+
+Result IFile_OpenFromArchive(IFile *file, FS_Archive archive, FS_Path filePath, u32 flags)
+{
+    (void)archive;
+    if(strcmp((const char *)filePath.data, PLUGIN_INDEX_PATH) != 0)
+        return -1;
+
+    if(!indexFileExists)
+    {
+        if(!(flags & FS_OPEN_CREATE))
+            return MAKERESULT(RL_PERMANENT, RS_NOTFOUND, RM_FS, 120);
+        indexFileExists = true;
+        indexFileSize = 0;
+    }
+
+    file->handle = 1;
+    file->pos = 0;
+    file->size = indexFileSize;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    u32 n = file->pos >= indexFileSize ? 0 : (indexFileSize - file->pos < len ? indexFileSize - file->pos : len);
+
+    if(file->handle != 1)
+        return -1;
+
+    memcpy(buffer, indexFile + file->pos, n);
+    file->pos += n;
+    *total = n;
+    return 0;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    (void)flags;
+    if(file->handle != 1 || file->pos + len > sizeof(indexFile))
+        return -1;
+
+    memcpy(indexFile + file->pos, buffer, len);
+    file->pos += len;
+    if(file->pos > indexFileSize)
+        indexFileSize = file->pos;
+    *total = len;
+    nbIndexWrites++;
+    return 0;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+    if(file->handle != 1)
+        return -1;
+
+    indexFileSize = size;
+    return 0;
+}
+
+// What a launch of that title gets: the plugin path, NULL if there is none at all
+static const char *launch(u64 titleId)
+{
+    IFile plugin;
+
+    PluginLoaderCtx.pluginPath = NULL;
+    PluginLoaderCtx.header.isDefaultPlugin = 0;
+    if(R_FAILED(OpenPluginFile(titleId, &plugin)))
+        return NULL;
+
+    CHECK(plugin.handle == 2);
+    CHECK(PluginLoaderCtx.pluginPath != NULL);
+    CHECK(pluginFileExists(PluginLoaderCtx.pluginPath));
+    CHECK((PluginLoaderCtx.header.isDefaultPlugin != 0) == (strcmp(PluginLoaderCtx.pluginPath, g_defaultPath) == 0));
+    return PluginLoaderCtx.pluginPath;
+}
+
+static bool launchGets(u64 titleId, const char *fileName)
+{
+    const char *path = launch(titleId);
+
+    if(fileName == NULL)
+        return path == NULL;
+    if(path == NULL)
+        return false;
+    if(strcmp(fileName, "default.3gx") == 0)
+        return strcmp(path, g_defaultPath) == 0;
+
+    return strlen(path) > 31 && strcmp(path + 31, fileName) == 0;
+}
+
+static void testIndexedLaunch(void)
+{
+    resetCard();
+    reboot();
+
+    MockDir *dir = createDir(0x0004000000055D00ULL, 1000);
+    addFile(dir, "readme.txt", false);
+    addFile(dir, "old.3gx", true);
+    addFile(dir, "a.3g", false);
+    addFile(dir, "plugin.3gx", false);
+
+    nbDirOpens = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, "plugin.3gx"));
+    CHECK(nbDirOpens == 1);
+    CHECK(indexFileExists);
+
+    // Later launches, also after a reboot, only count the directory entries
+    nbDirOpens = 0;
+    nbNameConversions = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, "plugin.3gx"));
+    reboot();
+    CHECK(launchGets(0x0004000000055D00ULL, "plugin.3gx"));
+    CHECK(nbDirOpens == 2);
+    CHECK(nbNameConversions == 0);
+
+    // Another plugin replaces it, the directory timestamp and entry count are unchanged
+    removeFile(dir, "plugin.3gx");
+    addFile(dir, "other.3gx", false);
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    nbNameConversions = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    CHECK(nbNameConversions == 0);
+
+    // A plugin listed first is added, the directory timestamp is unchanged: the entry count isn't
+    addPluginFirst(dir, "added.3gx");
+    CHECK(launchGets(0x0004000000055D00ULL, "added.3gx"));
+    removeFile(dir, "added.3gx");
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    nbNameConversions = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    CHECK(nbNameConversions == 0);
+
+    // Also with more entries than a single directory read returns
+    for(u32 i = 0; i < 15; i++)
+    {
+        char name[16];
+        sprintf(name, "n%u.txt", i);
+        addFile(dir, name, false);
+    }
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    nbNameConversions = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    CHECK(nbNameConversions == 0);
+    addPluginFirst(dir, "first0.3gx");
+    CHECK(launchGets(0x0004000000055D00ULL, "first0.3gx"));
+    removeFile(dir, "first0.3gx");
+    CHECK(launchGets(0x0004000000055D00ULL, "other.3gx"));
+    for(u32 i = 0; i < 15; i++)
+    {
+        char name[16];
+        sprintf(name, "n%u.txt", i);
+        removeFile(dir, name);
+    }
+
+    // The timestamp changed: rescan even though the indexed plugin is still there
+    addPluginFirst(dir, "first.3gx");
+    dir->timestamp++;
+    nbDirOpens = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, "first.3gx"));
+    CHECK(nbDirOpens == 1);
+
+    // The plugin is removed: falls back to the default plugin, if any
+    dir->nbFiles = 0;
+    CHECK(launchGets(0x0004000000055D00ULL, NULL));
+    hasDefaultPlugin = true;
+    CHECK(launchGets(0x0004000000055D00ULL, "default.3gx"));
+}
+
+// A plugin copied into a directory which had none must be found right away, even though the
+// directory timestamp didn't change (FAT)
+static void testPluginAddedToEmptyDirectory(void)
+{
+    resetCard();
+    reboot();
+    hasDefaultPlugin = true;
+
+    MockDir *dir = createDir(0x0004000000030800ULL, 5000);
+    addFile(dir, "notes.txt", false);
+
+    CHECK(launchGets(0x0004000000030800ULL, "default.3gx"));
+    CHECK(launchGets(0x0004000000030800ULL, "default.3gx"));
+
+    addFile(dir, "new.3gx", false);
+    CHECK(launchGets(0x0004000000030800ULL, "new.3gx"));
+    reboot();
+    CHECK(launchGets(0x0004000000030800ULL, "new.3gx"));
+
+    // Same without the default plugin, and for a directory created after a first launch
+    hasDefaultPlugin = false;
+    CHECK(launchGets(0x0004000000030900ULL, NULL));
+    dir = createDir(0x0004000000030900ULL, 6000);
+    CHECK(launchGets(0x0004000000030900ULL, NULL));
+    addFile(dir, "late.3gx", false);
+    CHECK(launchGets(0x0004000000030900ULL, "late.3gx"));
+}
+
+static void testBadIndexFile(void)
+{
+    resetCard();
+    reboot();
+
+    MockDir *dir = createDir(0x0004000000123400ULL, 77);
+    addFile(dir, "plg.3gx", false);
+    CHECK(launchGets(0x0004000000123400ULL, "plg.3gx"));
+
+    u32 savedSize = indexFileSize;
+    static const struct { u32 offset; u8 value; } corruptions[] = {
+        { 0, 0 },                                                           // Magic
+        { 4, 1 },                                                           // Version 1 had entries without plugin
+        { 8, PLUGIN_INDEX_MAX_ENTRIES + 1 },                                // Entry count
+        { 12, PLUGIN_INDEX_MAX_ENTRIES },                                   // Next victim
+        { offsetof(PluginIndex, entries[0].nbDirEntries), 0 },              // Empty directory
+        { offsetof(PluginIndex, entries[0].fileName), 0 },                  // Empty file name
+    };
+
+    for(u32 i = 0; i < sizeof(corruptions) / sizeof(corruptions[0]); i++)
+    {
+        u8 saved = indexFile[corruptions[i].offset];
+        indexFile[corruptions[i].offset] = corruptions[i].value;
+        reboot();
+        nbDirOpens = 0;
+        CHECK(launchGets(0x0004000000123400ULL, "plg.3gx"));
+        CHECK(nbDirOpens == 1);
+        indexFile[corruptions[i].offset] = saved;
+    }
+
+    // Truncated
+    indexFileSize = savedSize - 1;
+    reboot();
+    nbDirOpens = 0;
+    CHECK(launchGets(0x0004000000123400ULL, "plg.3gx"));
+    CHECK(nbDirOpens == 1);
+
+    // Unterminated file name
+    memset(indexFile + offsetof(PluginIndex, entries[0].fileName), 'x', PLUGIN_INDEX_NAME_SIZE);
+    reboot();
+    CHECK(launchGets(0x0004000000123400ULL, "plg.3gx"));
+
+    // Missing
+    indexFileExists = false;
+    reboot();
+    CHECK(launchGets(0x0004000000123400ULL, "plg.3gx"));
+    CHECK(indexFileExists);
+}
+
+static void testIndexEviction(void)
+{
+    PluginIndex index;
+
+    PluginIndex__Reset(&index);
+    for(u64 i = 0; i < 3 * PLUGIN_INDEX_MAX_ENTRIES; i++)
+    {
+        PluginIndex__Insert(&index, i, i + 1, 3, "x.3gx");
+        CHECK(PluginIndex__Lookup(&index, i, i + 1, 3) != NULL);
+        CHECK(PluginIndex__Lookup(&index, i, i + 2, 3) == NULL);
+        CHECK(PluginIndex__Lookup(&index, i, i + 1, 4) == NULL);
+        CHECK(PluginIndex__Lookup(&index, i, 0, 3) == NULL);
+        CHECK(PluginIndex__IsValid(&index));
+    }
+    CHECK(index.nbEntries == PLUGIN_INDEX_MAX_ENTRIES);
+    for(u64 i = 0; i < 3 * PLUGIN_INDEX_MAX_ENTRIES; i++)
+        CHECK((PluginIndex__Lookup(&index, i, i + 1, 3) != NULL) == (i >= 2 * PLUGIN_INDEX_MAX_ENTRIES));
+
+    // Names are truncated to fit
+    char longName[300];
+    memset(longName, 'a', sizeof(longName) - 1);
+    longName[sizeof(longName) - 1] = 0;
+    PluginIndex__Insert(&index, 1000, 1, 1, longName);
+    CHECK(strlen(PluginIndex__Lookup(&index, 1000, 1, 1)->fileName) == PLUGIN_INDEX_NAME_SIZE - 1);
+
+    while(index.nbEntries > 0)
+        CHECK(PluginIndex__Remove(&index, index.entries[index.nbEntries / 2].titleId));
+    CHECK(!PluginIndex__Remove(&index, 1000));
+    CHECK(PluginIndex__GetUsedSize(&index) == offsetof(PluginIndex, entries));
+}
+
+// Random SD card edits between launches, more titles than the index holds: every launch must
+// get one of the plugins of its directory, or the default one when there is none
+static void testRandomEdits(void)
+{
+    resetCard();
+    reboot();
+
+    u32 nbTitles = 100, nbLaunches = 0, nbScansTotal = 0;
+    char name[64];
+
+    for(u32 iter = 0; iter < 50000 && nbFailures == 0; iter++)
+    {
+        u64 titleId = 0x0004000000000000ULL | (rnd() % nbTitles) << 8;
+        MockDir *dir = findDir(titleId);
+        u32 action = rnd() % 16;
+
+        if(dir == NULL && action < 2)
+            dir = createDir(titleId, rnd() % 4);
+        else if(dir != NULL && action == 2)
+            dir->exists = false;
+        else if(dir != NULL && action < 6 && dir->nbFiles < MAX_FILES)
+        {
+            static const char *const exts[] = { "3gx", "txt", "3gx", "bin" };
+            sprintf(name, "f%u.%s", rnd() % 8, exts[rnd() % 4]);
+            if(!hasFile(dir, name))
+                addFile(dir, name, rnd() % 8 == 0);
+        }
+        else if(dir != NULL && action < 8 && dir->nbFiles > 0)
+        {
+            strcpy(name, dir->names[rnd() % dir->nbFiles]);
+            removeFile(dir, name);
+        }
+        else if(dir != NULL && action == 8)
+            dir->timestamp = rnd() % 4; // Sometimes 0, sometimes back to an older value
+        else if(action == 9)
+            hasDefaultPlugin = !hasDefaultPlugin;
+        else if(action == 10)
+            reboot();
+
+        u32 nbPlugins = 0;
+        for(u32 i = 0; dir != NULL && dir->exists && i < dir->nbFiles; i++)
+            nbPlugins += !dir->isDirectory[i] && isPlugin(dir->names[i]);
+
+        nbNameConversions = 0;
+        const char *path = launch(titleId);
+        nbScansTotal += nbNameConversions != 0;
+        nbLaunches++;
+
+        if(nbPlugins > 0)
+            CHECK(path != NULL && strcmp(path, g_defaultPath) != 0 && dirFromPath(path) == dir && isPlugin(path));
+        else if(hasDefaultPlugin)
+            CHECK(path != NULL && strcmp(path, g_defaultPath) == 0);
+        else
+            CHECK(path == NULL);
+
+        if(nbFailures != 0)
+            printf("iteration %u, title %016llX, %u plugins\n", iter, (unsigned long long)titleId, nbPlugins);
+    }
+
+    // The index must still save most scans
+    CHECK(nbScansTotal < nbLaunches);
+}
+
+int main(void)
+{
+    testIndexedLaunch();
+    testPluginAddedToEmptyDirectory();
+    testBadIndexFile();
+    testIndexEviction();
+    testRandomEdits();
+
+    printf("plgindex_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
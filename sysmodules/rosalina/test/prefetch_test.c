@@ -0,0 +1,656 @@
+// Host test of the plugin prefetch (PrefetchPlugin and TryToLoadPlugin in plugin/file_loader.c):
+// the prefetch runs on a real second thread standing in for the task runner, while the test
+// thread plays plg:ldr's. The plugin file, the memory block and the process are stubs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define PA_FROM_VA_PTR(addr)    ((void *)(addr))
+
+#include "../source/plugin/file_loader.c"
+#include "../source/plugin/plgindex.c"
+
+PluginLoaderContext PluginLoaderCtx;
+u32 g_memBlockSize = 5 * 1024 * 1024;
+u32 g_savedGameInstr[2];
+
+void gamePatchFunc(void) {}
+
+#include "test_common.h"
+
+// Threads: the test thread is plg:ldr's, the task runner gets its own
+
+static pthread_mutex_t syncMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t syncCond = PTHREAD_COND_INITIALIZER;
+static __thread u32 currentThreadTag;
+static u32 nbThreadTags;
+static bool runnerBusy;
+
+static u32 threadTag(void)
+{
+    if(currentThreadTag == 0)
+        currentThreadTag = __atomic_add_fetch(&nbThreadTags, 1, __ATOMIC_SEQ_CST);
+    return currentThreadTag;
+}
+
+void RecursiveLock_Init(RecursiveLock *lock)
+{
+    memset(lock, 0, sizeof(RecursiveLock));
+}
+
+void RecursiveLock_Lock(RecursiveLock *lock)
+{
+    pthread_mutex_lock(&syncMutex);
+    while(lock->counter != 0 && lock->thread_tag != threadTag())
+        pthread_cond_wait(&syncCond, &syncMutex);
+    lock->thread_tag = threadTag();
+    lock->counter++;
+    pthread_mutex_unlock(&syncMutex);
+}
+
+void RecursiveLock_Unlock(RecursiveLock *lock)
+{
+    pthread_mutex_lock(&syncMutex);
+    if(lock->counter == 0 || lock->thread_tag != threadTag())
+    {
+        printf("prefetch_test: unlocking a lock not held\n");
+        exit(1);
+    }
+    if(--lock->counter == 0)
+        lock->thread_tag = 0;
+    pthread_cond_broadcast(&syncCond);
+    pthread_mutex_unlock(&syncMutex);
+}
+
+static bool isLockedByOtherThread(RecursiveLock *lock)
+{
+    pthread_mutex_lock(&syncMutex);
+    bool locked = lock->counter != 0 && lock->thread_tag != threadTag();
+    pthread_mutex_unlock(&syncMutex);
+    return locked;
+}
+
+void LightEvent_Init(LightEvent *event, ResetType reset_type)
+{
+    event->val = 0;
+    event->autoclear = reset_type == RESET_ONESHOT;
+}
+
+void LightEvent_Signal(LightEvent *event)
+{
+    pthread_mutex_lock(&syncMutex);
+    event->val = 1;
+    pthread_cond_broadcast(&syncCond);
+    pthread_mutex_unlock(&syncMutex);
+}
+
+void LightEvent_Wait(LightEvent *event)
+{
+    pthread_mutex_lock(&syncMutex);
+    while(event->val == 0)
+        pthread_cond_wait(&syncCond, &syncMutex);
+    if(event->autoclear)
+        event->val = 0;
+    pthread_mutex_unlock(&syncMutex);
+}
+
+typedef struct RunnerTask
+{
+    void (*task)(void *argdata);
+    u8 argStorage[0x40];
+} RunnerTask;
+
+static u32 runnerThreadTag;
+
+static void *runnerThread(void *arg)
+{
+    RunnerTask *t = arg;
+
+    runnerThreadTag = threadTag();
+    t->task(t->argStorage);
+    free(t);
+
+    pthread_mutex_lock(&syncMutex);
+    runnerBusy = false;
+    pthread_cond_broadcast(&syncCond);
+    pthread_mutex_unlock(&syncMutex);
+    return NULL;
+}
+
+bool TaskRunner_TryRunTask(void (*task)(void *argdata), void *argdata, size_t argsize)
+{
+    pthread_t thread;
+    RunnerTask *t = malloc(sizeof(RunnerTask));
+
+    pthread_mutex_lock(&syncMutex);
+    bool busy = runnerBusy;
+    runnerBusy = true;
+    pthread_mutex_unlock(&syncMutex);
+
+    if(busy)
+    {
+        free(t);
+        return false;
+    }
+
+    t->task = task;
+    memcpy(t->argStorage, argdata, argsize);
+    pthread_create(&thread, NULL, runnerThread, t);
+    pthread_detach(thread);
+    return true;
+}
+
+static void waitRunnerIdle(void)
+{
+    pthread_mutex_lock(&syncMutex);
+    while(runnerBusy)
+        pthread_cond_wait(&syncCond, &syncMutex);
+    pthread_mutex_unlock(&syncMutex);
+}
+
+// Kernel
+
+u64 svcGetSystemTick(void)
+{
+    static u64 tick;
+    return __atomic_add_fetch(&tick, 1, __ATOMIC_SEQ_CST);
+}
+
+static u64 processTitleId;
+
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type)
+{
+    (void)process;
+    (void)type;
+    *out = (s64)processTitleId;
+    return 0;
+}
+
+Result svcControlProcess(Handle process, ProcessOp op, u32 varg2, u32 varg3)
+{
+    (void)process;
+    (void)op;
+    (void)varg2;
+    (void)varg3;
+    return 0;
+}
+
+Result svcMapProcessMemoryEx(Handle dstProcessHandle, u32 destAddress, Handle srcProcessHandle, u32 vaSrc, u32 size)
+{
+    (void)dstProcessHandle;
+    (void)srcProcessHandle;
+    (void)vaSrc;
+    void *p = mmap((void *)(uintptr_t)destAddress, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    return p == MAP_FAILED ? -1 : 0;
+}
+
+Result svcUnmapProcessMemoryEx(Handle process, u32 destAddress, u32 size)
+{
+    (void)process;
+    munmap((void *)(uintptr_t)destAddress, size);
+    return 0;
+}
+
+void svcFlushEntireDataCache(void) {}
+
+// The SD card: every title has /luma/plugins/<tid>/game.3gx, user load parameters point to user.3gx
+
+ssize_t utf16_to_utf8(u8 *out, const u16 *in, size_t len)
+{
+    size_t n = 0;
+    for(; n < len && in[n] != 0; n++)
+        out[n] = (u8)in[n];
+    return n;
+}
+
+ssize_t utf8_to_utf16(u16 *out, const u8 *in, size_t len)
+{
+    size_t n = 0;
+    for(; n < len && in[n] != 0; n++)
+        out[n] = in[n];
+    return n;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path)
+{
+    (void)path;
+    *archive = id;
+    return 0;
+}
+
+Result FSUSER_CloseArchive(FS_Archive archive)
+{
+    (void)archive;
+    return 0;
+}
+
+Result FSUSER_ControlArchive(FS_Archive archive, u32 action, void *input, u32 inputSize, void *output, u32 outputSize)
+{
+    (void)archive;
+    (void)action;
+    (void)input;
+    (void)inputSize;
+    (void)outputSize;
+    *(u64 *)output = 1;
+    return 0;
+}
+
+static u32 nbDirEntriesRead;
+
+Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path)
+{
+    (void)archive;
+    (void)path;
+    nbDirEntriesRead = 0;
+    *out = 1;
+    return 0;
+}
+
+Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries)
+{
+    (void)handle;
+    (void)entryCount;
+    *entriesRead = nbDirEntriesRead++ == 0;
+    memset(entries, 0, sizeof(FS_DirectoryEntry));
+    utf8_to_utf16(entries->name, (const u8 *)"game.3gx", 0x105);
+    return 0;
+}
+
+Result FSDIR_Close(Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+{
+    (void)archiveId;
+    (void)archivePath;
+    (void)filePath;
+    (void)flags;
+    file->handle = 1;
+    return 0;
+}
+
+// No plugin index on this card, and it can't be written
+Result IFile_OpenFromArchive(IFile *file, FS_Archive archive, FS_Path filePath, u32 flags)
+{
+    (void)file;
+    (void)archive;
+    (void)filePath;
+    (void)flags;
+    return -1;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_GetSize(IFile *file, u64 *size)
+{
+    (void)file;
+    *size = 0x1000;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    (void)file;
+    (void)buffer;
+    (void)len;
+    *total = 0;
+    return -1;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    (void)file;
+    (void)buffer;
+    (void)len;
+    (void)flags;
+    *total = 0;
+    return -1;
+}
+
+Result IFile_SetSize(IFile *file, u64 size)
+{
+    (void)file;
+    (void)size;
+    return -1;
+}
+
+// 3GX parsing
+
+static Result magicResult;
+
+Result Check_3gx_Magic(IFile *file)
+{
+    (void)file;
+    return magicResult;
+}
+
+Result Read_3gx_Header(IFile *file, _3gx_Header *header)
+{
+    (void)file;
+    memset(header, 0, sizeof(_3gx_Header));
+    header->magic = _3GX_MAGIC;
+    header->infos.exeLoadChecksum = 0x1234;
+    header->executable.codeSize = 0x100;
+    return 0;
+}
+
+Result Read_3gx_ParseHeader(IFile *file, _3gx_Header *header)
+{
+    (void)file;
+    header->targets.count = 0;
+    return 0;
+}
+
+Result Read_3gx_EmbeddedPayloads(IFile *file, _3gx_Header *header, _3gx_EmbeddedPayloads *payloads)
+{
+    (void)file;
+    (void)header;
+    (void)payloads;
+    return 0;
+}
+
+Result Apply_3gx_EmbeddedPayloads(_3gx_Header *header, _3gx_EmbeddedPayloads *payloads)
+{
+    (void)header;
+    (void)payloads;
+    return 0;
+}
+
+Result Read_3gx_LoadSegments(IFile *file, _3gx_Header *header, void *dst)
+{
+    (void)file;
+    (void)header;
+    (void)dst;
+    return 0;
+}
+
+void Reset_3gx_LoadParams(void) {}
+
+// Memory block and plugin cache
+
+static bool failAllocation, gateAllocation;
+static LightEvent allocationReached, allocationGate;
+static u32 allocationThreadTag, nbAllocationFailures, allocationFailureThreadTag;
+static u8 allocationStrategy;
+
+Result MemoryBlock__SetSize(u32 size)
+{
+    g_memBlockSize = size;
+    return 0;
+}
+
+Result MemoryBlock__Allocate(void)
+{
+    MemoryBlock *memblock = &PluginLoaderCtx.memblock;
+
+    allocationThreadTag = threadTag();
+    allocationStrategy = PluginLoaderCtx.pluginMemoryStrategy;
+    if(gateAllocation)
+    {
+        LightEvent_Signal(&allocationReached);
+        LightEvent_Wait(&allocationGate);
+    }
+
+    if(failAllocation)
+        return MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_OS, RD_OUT_OF_MEMORY);
+
+    if(!memblock->isReady)
+    {
+        memblock->memblock = malloc(g_memBlockSize);
+        memblock->isReady = true;
+    }
+    return 0;
+}
+
+void MemoryBlock__AllocationFailed(Result res)
+{
+    (void)res;
+    allocationFailureThreadTag = threadTag();
+    nbAllocationFailures++;
+}
+
+Result MemoryBlock__Free(void)
+{
+    MemoryBlock *memblock = &PluginLoaderCtx.memblock;
+
+    if(memblock->isReady)
+    {
+        free(memblock->memblock);
+        memblock->memblock = NULL;
+        memblock->isReady = false;
+    }
+    return 0;
+}
+
+Result MemoryBlock__MountInProcess(void)
+{
+    return 0;
+}
+
+bool MemoryBlock__UsesAppRegion(void)
+{
+    return true;
+}
+
+void MemoryBlock__ResetSwapSettings(void) {}
+
+void PLG__NotifyEvent(PLG_Event event, bool signal)
+{
+    (void)event;
+    (void)signal;
+}
+
+bool PluginCache__IsEnabled(void)
+{
+    return false;
+}
+
+PluginCacheEntry *PluginCache__Find(const char *path, u64 fileSize, u64 timestamp)
+{
+    (void)path;
+    (void)fileSize;
+    (void)timestamp;
+    return NULL;
+}
+
+const _3gx_Header *PluginCache__GetHeader(const PluginCacheEntry *entry)
+{
+    (void)entry;
+    return NULL;
+}
+
+void PluginCache__RestoreHeader(const PluginCacheEntry *entry, _3gx_Header *dst)
+{
+    (void)entry;
+    (void)dst;
+}
+
+void PluginCache__RestoreSegments(const PluginCacheEntry *entry, void *dst)
+{
+    (void)entry;
+    (void)dst;
+}
+
+void PluginCache__Insert(const char *path, u64 fileSize, u64 timestamp, const _3gx_Header *header,
+                         const _3gx_EmbeddedPayloads *payloads, const void *segments)
+{
+    (void)path;
+    (void)fileSize;
+    (void)timestamp;
+    (void)header;
+    (void)payloads;
+    (void)segments;
+}
+
+// Test driver
+
+#define TITLE_ID    0x0004000000055D00ULL
+
+static void resetState(void)
+{
+    waitRunnerIdle();
+    CancelPluginPrefetch();
+    MemoryBlock__Free();
+
+    memset(&PluginLoaderCtx, 0, sizeof(PluginLoaderCtx));
+    RecursiveLock_Init(&PluginLoaderCtx.lock);
+    PluginLoaderCtx.isEnabled = true;
+    PluginLoaderCtx.pluginMemoryStrategy = PLG_STRATEGY_SWAP;
+    g_pluginIndexLoaded = false;
+
+    magicResult = 0;
+    failAllocation = false;
+    gateAllocation = false;
+    LightEvent_Init(&allocationReached, RESET_ONESHOT);
+    LightEvent_Init(&allocationGate, RESET_STICKY);
+    allocationThreadTag = 0;
+    allocationFailureThreadTag = 0;
+    nbAllocationFailures = 0;
+    processTitleId = TITLE_ID;
+}
+
+// What plg:ldr command 4 does
+static void setUserLoadParameters(u32 lowTitleId, const char *path, u8 strategy)
+{
+    PluginLoadParameters *params = &PluginLoaderCtx.userLoadParameters;
+
+    PluginLoaderCtx.useUserLoadParameters = true;
+    params->lowTitleId = lowTitleId;
+    params->pluginMemoryStrategy = strategy;
+    strncpy(params->path, path, 255);
+    for(u32 i = 0; i < 32; i++)
+        params->config[i] = i;
+}
+
+static bool isGamePluginPath(const char *path)
+{
+    return path != NULL && strstr(path, "/game.3gx") != NULL;
+}
+
+static void testPrefetchedLoad(void)
+{
+    resetState();
+
+    PrefetchPlugin(TITLE_ID);
+    CHECK(g_prefetch.isActive);
+
+    CHECK(TryToLoadPlugin(1));
+    CHECK(g_launchTimeline.usedPrefetch);
+    CHECK(allocationThreadTag == runnerThreadTag && runnerThreadTag != threadTag());
+    CHECK(isGamePluginPath(PluginLoaderCtx.pluginPath));
+    CHECK(PluginLoaderCtx.exeLoadChecksum == 0x1234);
+    CHECK(PluginLoaderCtx.memblock.isReady);
+    CHECK(!isLockedByOtherThread(&PluginLoaderCtx.lock) && PluginLoaderCtx.lock.counter == 0);
+}
+
+// The prefetch holds the context lock while preparing, and user load parameters sent meanwhile
+// are left for the next launch
+static void testCommandsDuringPrefetch(void)
+{
+    resetState();
+    gateAllocation = true;
+
+    PrefetchPlugin(TITLE_ID);
+    LightEvent_Wait(&allocationReached);
+    CHECK(isLockedByOtherThread(&PluginLoaderCtx.lock));
+
+    setUserLoadParameters((u32)TITLE_ID, "/user.3gx", PLG_STRATEGY_MODE3);
+    LightEvent_Signal(&allocationGate);
+
+    CHECK(TryToLoadPlugin(1));
+    CHECK(g_launchTimeline.usedPrefetch);
+    CHECK(isGamePluginPath(PluginLoaderCtx.pluginPath));
+    CHECK(allocationStrategy == PLG_STRATEGY_SWAP);
+    CHECK(PluginLoaderCtx.useUserLoadParameters);
+    CHECK(PluginLoaderCtx.header.config[5] == 0);
+
+    // They are used by the next launch, which doesn't get prefetched
+    MemoryBlock__Free();
+    PrefetchPlugin(TITLE_ID);
+    CHECK(!g_prefetch.isActive);
+    CHECK(TryToLoadPlugin(1));
+    CHECK(!PluginLoaderCtx.useUserLoadParameters);
+    CHECK(PluginLoaderCtx.pluginPath != NULL && strcmp(PluginLoaderCtx.pluginPath, "/user.3gx") == 0);
+    CHECK(allocationStrategy == PLG_STRATEGY_MODE3 && PluginLoaderCtx.pluginMemoryStrategy == PLG_STRATEGY_MODE3);
+    CHECK(PluginLoaderCtx.header.config[5] == 5);
+
+    // Later commands don't change the path of the loaded plugin
+    setUserLoadParameters((u32)TITLE_ID, "/other.3gx", PLG_STRATEGY_SWAP);
+    CHECK(strcmp(PluginLoaderCtx.pluginPath, "/user.3gx") == 0);
+}
+
+// Failures are only reported, or lead to a reboot, on plg:ldr's thread when the load is consumed
+static void testPrefetchFailures(void)
+{
+    resetState();
+    failAllocation = true;
+
+    PrefetchPlugin(TITLE_ID);
+    LightEvent_Wait(&g_prefetch.doneEvent);
+    CHECK(nbAllocationFailures == 0);
+    CHECK(PluginLoaderCtx.error.message == NULL);
+
+    CHECK(!TryToLoadPlugin(1));
+    CHECK(nbAllocationFailures == 1 && allocationFailureThreadTag == threadTag());
+    CHECK(PluginLoaderCtx.lock.counter == 0);
+
+    resetState();
+    magicResult = MAKERESULT(RL_PERMANENT, RS_INVALIDARG, RM_LDR, 1);
+
+    PrefetchPlugin(TITLE_ID);
+    LightEvent_Wait(&g_prefetch.doneEvent);
+    CHECK(PluginLoaderCtx.error.message == NULL);
+
+    CHECK(!TryToLoadPlugin(1));
+    CHECK(PluginLoaderCtx.error.message != NULL && strstr(PluginLoaderCtx.error.message, "Invalid plugin file") != NULL);
+    CHECK(nbAllocationFailures == 0);
+    CHECK(!PluginLoaderCtx.memblock.isReady);
+    CHECK(PluginLoaderCtx.lock.counter == 0);
+}
+
+static void testCancelAndMismatch(void)
+{
+    resetState();
+
+    PrefetchPlugin(TITLE_ID);
+    CancelPluginPrefetch();
+    CHECK(!g_prefetch.isActive);
+    CHECK(!PluginLoaderCtx.memblock.isReady);
+
+    // Prefetched for another title: dropped, then loaded inline
+    PrefetchPlugin(TITLE_ID + 0x100);
+    CHECK(TryToLoadPlugin(1));
+    CHECK(!g_launchTimeline.usedPrefetch);
+    CHECK(allocationThreadTag == threadTag());
+    CHECK(PluginLoaderCtx.memblock.isReady);
+    CHECK(PluginLoaderCtx.lock.counter == 0);
+
+    // Nothing is prefetched while the memory block is in use
+    waitRunnerIdle();
+    PrefetchPlugin(TITLE_ID);
+    CHECK(!g_prefetch.isActive);
+}
+
+int main(void)
+{
+    for(u32 i = 0; i < 200 && nbFailures == 0; i++)
+    {
+        testPrefetchedLoad();
+        testCommandsDuringPrefetch();
+        testPrefetchFailures();
+        testCancelAndMismatch();
+    }
+
+    printf("prefetch_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+// Benchmark of the QOI screenshot encoder: size relative to the 24-bit BMP rosalina writes
+// otherwise, and encoding speed, for top screen sized images of each kind. The images are
+// synthetic (see synthetic_fixture.h), real screenshots of games vary.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../source/qoi.c"
+#include "synthetic_fixture.h"
+
+#define WIDTH       400
+#define HEIGHT      240
+#define NB_FRAMES   100
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    static u8 img[3 * WIDTH * HEIGHT];
+    static u8 encoded[QOI_HEADER_SIZE + QOI_MAX_ENCODED_SIZE(WIDTH * HEIGHT) + QOI_MAX_FINISH_SIZE];
+    const u32 bmpSize = 54 + sizeof(img);
+
+    printf("%-10s %10s %10s %8s %10s\n", "image", "BMP bytes", "QOI bytes", "ratio", "MP/s");
+    for(SyntheticKind kind = 0; kind < SYNTH_COUNT; kind++)
+    {
+        QoiEncoder enc;
+        u32 size = 0;
+
+        fillSynthetic(img, sizeof(img), GSP_BGR8_OES, WIDTH, kind, 1);
+
+        // Line by line, like RosalinaMenu_WriteScreenshotQoi
+        double t0 = now();
+        for(u32 i = 0; i < NB_FRAMES; i++)
+        {
+            size = QoiEncoder_Init(&enc, encoded, WIDTH, HEIGHT);
+            for(u32 y = 0; y < HEIGHT; y++)
+                size += QoiEncoder_EncodeBGR8(&enc, encoded + size, img + 3 * WIDTH * y, WIDTH);
+            size += QoiEncoder_Finish(&enc, encoded + size);
+        }
+        double elapsed = now() - t0;
+
+        printf("%-10s %10u %10u %7.1f%% %10.1f\n", syntheticKindNames[kind], bmpSize, size, 100.0 * size / bmpSize,
+               NB_FRAMES * WIDTH * HEIGHT / 1e6 / elapsed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+// Host test of the streaming QOI encoder (qoi.c): images encoded in random batches must decode
+// back to the same pixels with an independent decoder, and no call may write more than the
+// worst case sizes from qoi.h.
+
+#include <stdio.h>
+
+#include "../source/qoi.c"
+#include "synthetic_fixture.h"
+
+#include "test_common.h"
+
+#define MAX_PIXELS  (400 * 240)
+
+// Decoder written from the QOI specification (https://qoiformat.org/qoi-specification.pdf)
+
+static u32 readBE32(const u8 *p)
+{
+    return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3];
+}
+
+// Decodes a QOI file to BGR8 (alpha must stay opaque); false if it is malformed or doesn't
+// hold exactly width * height pixels followed by the end marker
+static bool qoiDecode(u8 *out, const u8 *data, u32 size, u32 *pWidth, u32 *pHeight)
+{
+    static const u8 endMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    u8 index[64][4];
+    u8 px[4] = { 0, 0, 0, 255 };
+
+    if(size < 14 + 8 || memcmp(data, "qoif", 4) != 0 || data[12] < 3 || data[12] > 4 || data[13] > 1)
+        return false;
+
+    u32 width = readBE32(data + 4), height = readBE32(data + 8);
+    u32 numPixels = width * height;
+    u32 pos = 14, end = size - 8;
+
+    memset(index, 0, sizeof(index));
+    for(u32 i = 0; i < numPixels;)
+    {
+        u32 run = 1;
+
+        if(pos >= end)
+            return false;
+
+        u8 b1 = data[pos++];
+        if(b1 == 0xFE || b1 == 0xFF)
+        {
+            u32 n = b1 == 0xFE ? 3 : 4;
+            if(end - pos < n)
+                return false;
+            memcpy(px, data + pos, n);
+            pos += n;
+        }
+        else
+        {
+            switch(b1 >> 6)
+            {
+                case 0: // QOI_OP_INDEX
+                    memcpy(px, index[b1], 4);
+                    break;
+                case 1: // QOI_OP_DIFF
+                    px[0] += ((b1 >> 4) & 3) - 2;
+                    px[1] += ((b1 >> 2) & 3) - 2;
+                    px[2] += (b1 & 3) - 2;
+                    break;
+                case 2: // QOI_OP_LUMA
+                {
+                    if(pos >= end)
+                        return false;
+                    u8 b2 = data[pos++];
+                    int vg = (b1 & 0x3F) - 32;
+                    px[0] += vg - 8 + ((b2 >> 4) & 0xF);
+                    px[1] += vg;
+                    px[2] += vg - 8 + (b2 & 0xF);
+                    break;
+                }
+                case 3: // QOI_OP_RUN
+                    run = (b1 & 0x3F) + 1;
+                    break;
+            }
+        }
+
+        memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        if(run > numPixels - i || px[3] != 255)
+            return false;
+
+        for(; run != 0; run--, i++)
+        {
+            out[3 * i + 0] = px[2];
+            out[3 * i + 1] = px[1];
+            out[3 * i + 2] = px[0];
+        }
+    }
+
+    *pWidth = width;
+    *pHeight = height;
+    return pos == end && memcmp(data + end, endMarker, sizeof(endMarker)) == 0;
+}
+
+static u8 img[3 * MAX_PIXELS], decoded[3 * MAX_PIXELS];
+static u8 encoded[QOI_HEADER_SIZE + QOI_MAX_ENCODED_SIZE(MAX_PIXELS) + QOI_MAX_FINISH_SIZE + 64];
+
+// Encodes in batches of batchSize pixels (random sizes, 0 included, if 0) and decodes the result
+static bool roundTrip(u32 width, u32 height, u32 batchSize)
+{
+    QoiEncoder enc;
+    u32 numPixels = width * height, size, width2 = 0, height2 = 0;
+
+    memset(&enc, 0xCC, sizeof(enc)); // Init must reset whatever was left in there
+    memset(encoded, 0xCC, sizeof(encoded));
+    size = QoiEncoder_Init(&enc, encoded, width, height);
+    CHECK(size == QOI_HEADER_SIZE);
+
+    for(u32 i = 0; i < numPixels;)
+    {
+        u32 n = batchSize != 0 ? batchSize : rnd() % 300;
+        n = n > numPixels - i ? numPixels - i : n;
+
+        u32 written = QoiEncoder_EncodeBGR8(&enc, encoded + size, img + 3 * i, n);
+        CHECK(written <= QOI_MAX_ENCODED_SIZE(n));
+        CHECK(encoded[size + QOI_MAX_ENCODED_SIZE(n)] == 0xCC);
+        size += written;
+        i += n;
+    }
+
+    u32 written = QoiEncoder_Finish(&enc, encoded + size);
+    CHECK(written >= QOI_FOOTER_SIZE && written <= QOI_MAX_FINISH_SIZE);
+    size += written;
+    CHECK(encoded[size] == 0xCC);
+
+    memset(decoded, 0, sizeof(decoded));
+    bool ok = qoiDecode(decoded, encoded, size, &width2, &height2);
+    CHECK(ok && width2 == width && height2 == height);
+    CHECK(encoded[12] == 3 && encoded[13] == 0);
+
+    return ok && memcmp(decoded, img, 3 * numPixels) == 0;
+}
+
+static void testImages(void)
+{
+    static const u32 sizes[][2] = { { 400, 240 }, { 320, 240 }, { 1, 1 }, { 7, 3 }, { 63, 2 } };
+
+    for(SyntheticKind kind = 0; kind < SYNTH_COUNT; kind++)
+    {
+        for(u32 s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            u32 width = sizes[s][0], height = sizes[s][1];
+
+            fillSynthetic(img, 3 * width * height, GSP_BGR8_OES, width, kind, kind * 31 + s);
+            CHECK(roundTrip(width, height, width * height)); // All at once
+            CHECK(roundTrip(width, height, width));          // Line by line
+            CHECK(roundTrip(width, height, 1));
+            CHECK(roundTrip(width, height, 0));
+        }
+    }
+}
+
+// Runs around the 62 pixel limit, split across batches, including the leading run of black
+// pixels matching the initial previous pixel
+static void testRuns(void)
+{
+    for(u32 len = 1; len <= 200; len++)
+    {
+        u32 numPixels = 3 * len + 5;
+        for(u32 i = 0; i < numPixels; i++)
+        {
+            u8 *p = img + 3 * i;
+            u32 segment = i < len ? 0 : i < 2 * len ? 1 : 2;
+            p[0] = segment == 1 ? 0x80 : 0;
+            p[1] = segment == 2 ? 0x81 : 0;
+            p[2] = 0;
+        }
+
+        CHECK(roundTrip(numPixels, 1, numPixels));
+        CHECK(roundTrip(numPixels, 1, 61));
+        CHECK(roundTrip(numPixels, 1, 62));
+        CHECK(roundTrip(numPixels, 1, 0));
+    }
+}
+
+// Few colors, so that every operation (index, diff, luma, run, rgb) shows up often
+static void testRandomPalettes(void)
+{
+    for(u32 n = 0; n < 2000; n++)
+    {
+        u32 palette[8], nbColors = 1 + rnd() % 8;
+        u32 width = 1 + rnd() % 64, height = 1 + rnd() % 16;
+
+        for(u32 i = 0; i < nbColors; i++)
+        {
+            palette[i] = rnd();
+            if(i > 0 && rnd() % 2)
+                palette[i] = palette[i - 1] + (rnd() % 5) * 0x010101 - 0x020202 + (rnd() % 3 << 8);
+        }
+
+        u32 color = palette[0];
+        for(u32 i = 0; i < width * height; i++)
+        {
+            if(rnd() % 4 == 0)
+                color = palette[rnd() % nbColors];
+            img[3 * i + 0] = (u8)color;
+            img[3 * i + 1] = (u8)(color >> 8);
+            img[3 * i + 2] = (u8)(color >> 16);
+        }
+
+        CHECK(roundTrip(width, height, 0));
+    }
+}
+
+int main(void)
+{
+    testImages();
+    testRuns();
+    testRandomPalettes();
+
+    printf("qoi_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+// Host stand-in for the parts of libctru rosalina uses, see test/Makefile.
+// Only declarations: tests define whichever functions they end up calling.
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/synchronization.h>
+#include <3ds/srv.h>
+#include <3ds/ipc.h>
+#include <3ds/os.h>
+#include <3ds/env.h>
+#include <3ds/util/utf.h>
+#include <3ds/gfx.h>
+#include <3ds/services/fs.h>
+#include <3ds/services/gspgpu.h>
+#include <3ds/services/hid.h>
+#include <3ds/services/soc.h>
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <3ds/types.h>
+
+enum {
+    RUNFLAG_APTWORKAROUND = BIT(0),
+    RUNFLAG_APTREINIT     = BIT(1),
+    RUNFLAG_APTCHAINLOAD  = BIT(2),
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/services/gspgpu.h>
+
+#define RGB565(r,g,b)  (((b)&0x1f)|(((g)&0x3f)<<5)|(((r)&0x1f)<<11))
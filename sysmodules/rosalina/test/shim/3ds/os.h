@@ -0,0 +1,20 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/svc.h>
+
+#define SYSCLOCK_SOC       (16756991)
+#define SYSCLOCK_ARM9      (SYSCLOCK_SOC * 8)
+#define SYSCLOCK_ARM11     (SYSCLOCK_ARM9 * 2)
+#define SYSCLOCK_ARM11_NEW (SYSCLOCK_ARM11 * 3)
+
+#define CPU_TICKS_PER_MSEC (SYSCLOCK_ARM11 / 1000.0)
+#define CPU_TICKS_PER_USEC (SYSCLOCK_ARM11 / 1000000.0)
+
+#define SYSTEM_VERSION(major, minor, revision) (((major) << 24) | ((minor) << 16) | ((revision) << 8))
+#define GET_VERSION_MAJOR(version)    ((version) >> 24)
+#define GET_VERSION_MINOR(version)    (((version) >> 16) & 0xFF)
+#define GET_VERSION_REVISION(version) (((version) >> 8) & 0xFF)
+
+u32 osGetKernelVersion(void);
+s64 osGetMemRegionFree(MemRegion region);
@@ -0,0 +1,73 @@
+#pragma once
+
+#define R_SUCCEEDED(res)    ((res)>=0)
+#define R_FAILED(res)       ((res)<0)
+#define R_LEVEL(res)        (((res)>>27)&0x1F)
+#define R_SUMMARY(res)      (((res)>>21)&0x3F)
+#define R_MODULE(res)       (((res)>>10)&0xFF)
+#define R_DESCRIPTION(res)  ((res)&0x3FF)
+
+#define MAKERESULT(level,summary,module,description) \
+    ((((level)&0x1F)<<27) | (((summary)&0x3F)<<21) | (((module)&0xFF)<<10) | ((description)&0x3FF))
+
+enum {
+    RD_SUCCESS = 0,
+    RD_INVALID_RESULT_VALUE = 1023,
+    RD_TIMEOUT = 1022,
+    RD_OUT_OF_RANGE = 1021,
+    RD_ALREADY_EXISTS = 1020,
+    RD_CANCEL_REQUESTED = 1019,
+    RD_NOT_FOUND = 1018,
+    RD_ALREADY_INITIALIZED = 1017,
+    RD_NOT_INITIALIZED = 1016,
+    RD_INVALID_HANDLE = 1015,
+    RD_INVALID_POINTER = 1014,
+    RD_INVALID_ADDRESS = 1013,
+    RD_NOT_IMPLEMENTED = 1012,
+    RD_OUT_OF_MEMORY = 1011,
+    RD_MISALIGNED_SIZE = 1010,
+    RD_MISALIGNED_ADDRESS = 1009,
+    RD_BUSY = 1008,
+    RD_NO_DATA = 1007,
+};
+
+enum {
+    RL_SUCCESS = 0,
+    RL_INFO = 1,
+    RL_FATAL = 0x1F,
+    RL_RESET = 0x1E,
+    RL_REINITIALIZE = 0x1D,
+    RL_USAGE = 0x1C,
+    RL_PERMANENT = 0x1B,
+    RL_TEMPORARY = 0x1A,
+    RL_STATUS = 0x19,
+};
+
+enum {
+    RS_SUCCESS = 0,
+    RS_NOP = 1,
+    RS_WOULDBLOCK = 2,
+    RS_OUTOFRESOURCE = 3,
+    RS_NOTFOUND = 4,
+    RS_INVALIDSTATE = 5,
+    RS_NOTSUPPORTED = 6,
+    RS_INVALIDARG = 7,
+    RS_WRONGARG = 8,
+    RS_CANCELED = 9,
+    RS_STATUSCHANGED = 10,
+    RS_INTERNAL = 11,
+};
+
+enum {
+    RM_COMMON = 0,
+    RM_KERNEL = 1,
+    RM_UTIL = 2,
+    RM_FILE_SERVER = 3,
+    RM_LOADER_SERVER = 4,
+    RM_OS = 6,
+    RM_FS = 17,
+    RM_PM = 22,
+    RM_SRV = 25,
+    RM_LDR = 29,
+    RM_APPLICATION = 254,
+};
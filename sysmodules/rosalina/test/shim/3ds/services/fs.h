@@ -0,0 +1,72 @@
+#pragma once
+
+#include <3ds/types.h>
+
+enum {
+    FS_OPEN_READ = BIT(0), FS_OPEN_WRITE = BIT(1), FS_OPEN_CREATE = BIT(2),
+};
+
+enum {
+    FS_WRITE_FLUSH = BIT(0), FS_WRITE_UPDATE_TIME = BIT(8),
+};
+
+enum {
+    FS_ATTRIBUTE_DIRECTORY = BIT(0), FS_ATTRIBUTE_HIDDEN = BIT(8), FS_ATTRIBUTE_ARCHIVE = BIT(16), FS_ATTRIBUTE_READ_ONLY = BIT(24),
+};
+
+typedef enum {
+    ARCHIVE_SDMC = 0x00000009, ARCHIVE_NAND_RW = 0x1234567D,
+} FS_ArchiveID;
+
+typedef enum {
+    ARCHIVE_ACTION_COMMIT_SAVE_DATA = 0, ARCHIVE_ACTION_GET_TIMESTAMP = 1,
+} FS_ArchiveAction;
+
+typedef enum {
+    PATH_INVALID = 0, PATH_EMPTY = 1, PATH_BINARY = 2, PATH_ASCII = 3, PATH_UTF16 = 4,
+} FS_PathType;
+
+typedef struct {
+    FS_PathType type;
+    u32 size;
+    const void *data;
+} FS_Path;
+
+typedef u64 FS_Archive;
+
+typedef struct {
+    u16 name[0x106];
+    char shortName[0x0A];
+    char shortExt[0x04];
+    u8 valid;
+    u8 reserved;
+    u32 attributes;
+    u64 fileSize;
+} FS_DirectoryEntry;
+
+static inline FS_Path fsMakePath(FS_PathType type, const void *path)
+{
+    FS_Path p = { type, 0, path };
+    if(type == PATH_ASCII)
+    {
+        const char *s = (const char *)path;
+        while(s[p.size++] != 0);
+    }
+    return p;
+}
+
+Result FSUSER_OpenArchive(FS_Archive *archive, FS_ArchiveID id, FS_Path path);
+Result FSUSER_CloseArchive(FS_Archive archive);
+Result FSUSER_OpenFile(Handle *out, FS_Archive archive, FS_Path path, u32 openFlags, u32 attributes);
+Result FSUSER_OpenDirectory(Handle *out, FS_Archive archive, FS_Path path);
+Result FSUSER_DeleteFile(FS_Archive archive, FS_Path path);
+Result FSUSER_RenameFile(FS_Archive srcArchive, FS_Path srcPath, FS_Archive dstArchive, FS_Path dstPath);
+Result FSUSER_CreateDirectory(FS_Archive archive, FS_Path path, u32 attributes);
+Result FSUSER_ControlArchive(FS_Archive archive, u32 action, void *input, u32 inputSize, void *output, u32 outputSize);
+Result FSFILE_Read(Handle handle, u32 *bytesRead, u64 offset, void *buffer, u32 size);
+Result FSFILE_Write(Handle handle, u32 *bytesWritten, u64 offset, const void *buffer, u32 size, u32 flags);
+Result FSFILE_GetSize(Handle handle, u64 *size);
+Result FSFILE_SetSize(Handle handle, u64 size);
+Result FSFILE_Close(Handle handle);
+Result FSDIR_Read(Handle handle, u32 *entriesRead, u32 entryCount, FS_DirectoryEntry *entries);
+Result FSDIR_Close(Handle handle);
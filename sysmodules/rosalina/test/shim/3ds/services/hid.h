@@ -0,0 +1,9 @@
+#pragma once
+
+enum {
+    KEY_A = BIT(0), KEY_B = BIT(1), KEY_SELECT = BIT(2), KEY_START = BIT(3),
+    KEY_DRIGHT = BIT(4), KEY_DLEFT = BIT(5), KEY_DUP = BIT(6), KEY_DDOWN = BIT(7),
+    KEY_R = BIT(8), KEY_L = BIT(9), KEY_X = BIT(10), KEY_Y = BIT(11),
+    KEY_ZL = BIT(14), KEY_ZR = BIT(15),
+    KEY_UP = KEY_DUP, KEY_DOWN = KEY_DDOWN, KEY_LEFT = KEY_DLEFT, KEY_RIGHT = KEY_DRIGHT,
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <3ds/types.h>
+
+long socGethostid(void);
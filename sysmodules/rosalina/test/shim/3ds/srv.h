@@ -0,0 +1,9 @@
+#pragma once
+
+#include <3ds/types.h>
+
+Result srvIsServiceRegistered(bool *registered, const char *name);
+Result srvGetServiceHandle(Handle *out, const char *name);
+Result srvRegisterService(Handle *out, const char *name, int maxSessions);
+Result srvUnregisterService(const char *name);
+Result srvPublishToSubscriber(u32 notificationId, u32 flags);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <3ds/types.h>
+
+typedef enum {
+    MEMOP_FREE = 1, MEMOP_RESERVE = 2, MEMOP_ALLOC = 3, MEMOP_MAP = 4, MEMOP_UNMAP = 5, MEMOP_PROT = 6,
+    MEMOP_REGION_APP = 0x100, MEMOP_REGION_SYSTEM = 0x200, MEMOP_REGION_BASE = 0x300,
+    MEMOP_LINEAR_FLAG = 0x10000,
+} MemOp;
+
+typedef enum {
+    MEMSTATE_FREE = 0, MEMSTATE_PRIVATE = 10,
+} MemState;
+
+typedef enum {
+    MEMPERM_READ = 1, MEMPERM_WRITE = 2, MEMPERM_EXECUTE = 4, MEMPERM_READWRITE = 3, MEMPERM_DONTCARE = 0x10000000,
+} MemPerm;
+
+typedef enum {
+    MEMREGION_ALL = 0, MEMREGION_APPLICATION = 1, MEMREGION_SYSTEM = 2, MEMREGION_BASE = 3,
+} MemRegion;
+
+typedef enum {
+    RESET_ONESHOT = 0, RESET_STICKY = 1, RESET_PULSE = 2,
+} ResetType;
+
+typedef enum {
+    USERBREAK_PANIC = 0, USERBREAK_ASSERT = 1, USERBREAK_USER = 2,
+} UserBreakType;
+
+typedef struct {
+    u32 base_addr;
+    u32 size;
+    u32 perm;
+    u32 state;
+} MemInfo;
+
+typedef struct {
+    u32 flags;
+} PageInfo;
+
+typedef struct {
+    u8 name[8];
+    u16 version;
+    u16 padding[3];
+    u32 text_addr;
+    u32 text_size;
+    u32 ro_addr;
+    u32 ro_size;
+    u32 rw_addr;
+    u32 rw_size;
+    u32 text_size_total;
+    u32 ro_size_total;
+    u32 rw_size_total;
+    u32 padding2;
+    u64 program_id;
+} CodeSetHeader;
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm);
+Result svcFlushProcessDataCache(Handle process, u32 addr, u32 size);
+Result svcQueryMemory(MemInfo *info, PageInfo *out, u32 addr);
+Result svcQueryProcessMemory(MemInfo *info, PageInfo *out, Handle process, u32 addr);
+Result svcCreateEvent(Handle *event, ResetType reset_type);
+Result svcSignalEvent(Handle handle);
+Result svcClearEvent(Handle handle);
+Result svcCreateMutex(Handle *mutex, bool initially_locked);
+Result svcReleaseMutex(Handle handle);
+Result svcCreateSemaphore(Handle *semaphore, s32 initial_count, s32 max_count);
+Result svcReleaseSemaphore(s32 *count, Handle semaphore, s32 release_count);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds);
+Result svcCloseHandle(Handle handle);
+Result svcBindInterrupt(u32 interruptId, Handle eventOrSemaphore, s32 priority, bool isManualClear);
+Result svcUnbindInterrupt(u32 interruptId, Handle eventOrSemaphore);
+Result svcAcceptSession(Handle *session, Handle port);
+Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handleCount, Handle replyTarget);
+void svcSleepThread(s64 ns);
+void svcBreak(UserBreakType breakReason);
+u64 svcGetSystemTick(void);
+Result svcGetSystemInfo(s64 *out, u32 type, s32 param);
+Result svcGetProcessInfo(s64 *out, Handle process, u32 type);
+Result svcGetProcessId(u32 *out, Handle handle);
+Result svcKernelSetState(u32 type, ...);
+Result svcCreateCodeSet(Handle *out, const CodeSetHeader *info, u32 code_ptr, u32 ro_ptr, u32 data_ptr);
+Result svcCreateThread(Handle *thread, ThreadFunc entrypoint, u32 arg, u32 *stack_top, s32 thread_priority, s32 processor_id);
+void svcExitThread(void) __attribute__((noreturn));
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <3ds/types.h>
+
+typedef s32 LightLock;
+
+typedef struct {
+    LightLock lock;
+    u32 thread_tag;
+    u32 counter;
+} RecursiveLock;
+
+typedef struct {
+    s32 val;
+    bool autoclear;
+} LightEvent;
+
+static inline void __dsb(void) { __sync_synchronize(); }
+static inline void __dmb(void) { __sync_synchronize(); }
+static inline void __clrex(void) {}
+
+void LightLock_Init(LightLock *lock);
+void LightLock_Lock(LightLock *lock);
+void LightLock_Unlock(LightLock *lock);
+void RecursiveLock_Init(RecursiveLock *lock);
+void RecursiveLock_Lock(RecursiveLock *lock);
+void RecursiveLock_Unlock(RecursiveLock *lock);
+void LightEvent_Init(LightEvent *event, ResetType reset_type);
+void LightEvent_Signal(LightEvent *event);
+void LightEvent_Clear(LightEvent *event);
+void LightEvent_Wait(LightEvent *event);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <sys/types.h>
+#include <3ds/types.h>
+
+ssize_t utf16_to_utf8(u8 *out, const u16 *in, size_t len);
+ssize_t utf8_to_utf16(u16 *out, const u8 *in, size_t len);
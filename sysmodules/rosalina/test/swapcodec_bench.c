@@ -0,0 +1,86 @@
+// Host benchmark of the plugin swap codec: ratio and compress/decompress speed, chunk by chunk
+// like memoryblock.c does, on synthetic plugin memory (see synthetic_fixture.h)
+
+#include <stdio.h>
+#include <time.h>
+
+#include "../source/plugin/swapcodec.c"
+#include "../include/plugin/swapindex.h"
+#include "synthetic_fixture.h"
+
+#define IMAGE_SIZE  (5 * 1024 * 1024)
+#define NB_RUNS     5
+
+static SwapCodecState state;
+static u8 image[IMAGE_SIZE], restored[IMAGE_SIZE];
+static u8 compressed[IMAGE_SIZE / SWAP_CHUNK_SIZE][SWAP_CHUNK_SIZE];
+static u32 compressedSizes[IMAGE_SIZE / SWAP_CHUNK_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name)
+{
+    u32 nbChunks = IMAGE_SIZE / SWAP_CHUNK_SIZE;
+    u64 total = 0;
+    double compressTime = 1e9, decompressTime = 1e9;
+
+    for(u32 run = 0; run < NB_RUNS; run++)
+    {
+        double t0 = now();
+        total = 0;
+        for(u32 i = 0; i < nbChunks; i++)
+        {
+            // Incompressible chunks are stored raw, as in memoryblock.c
+            compressedSizes[i] = SwapCodec__Compress(&state, compressed[i], SWAP_CHUNK_SIZE - 1, image + i * SWAP_CHUNK_SIZE, SWAP_CHUNK_SIZE);
+            total += compressedSizes[i] != 0 ? compressedSizes[i] : SWAP_CHUNK_SIZE;
+        }
+        double t1 = now();
+
+        for(u32 i = 0; i < nbChunks; i++)
+        {
+            if(compressedSizes[i] == 0)
+                memcpy(restored + i * SWAP_CHUNK_SIZE, image + i * SWAP_CHUNK_SIZE, SWAP_CHUNK_SIZE);
+            else if(!SwapCodec__Decompress(restored + i * SWAP_CHUNK_SIZE, SWAP_CHUNK_SIZE, compressed[i], compressedSizes[i]))
+            {
+                printf("swapcodec_bench: %s: chunk %lu doesn't decompress\n", name, (unsigned long)i);
+                exit(1);
+            }
+        }
+        double t2 = now();
+
+        compressTime = t1 - t0 < compressTime ? t1 - t0 : compressTime;
+        decompressTime = t2 - t1 < decompressTime ? t2 - t1 : decompressTime;
+    }
+
+    if(memcmp(image, restored, IMAGE_SIZE) != 0)
+    {
+        printf("swapcodec_bench: %s: round trip mismatch\n", name);
+        exit(1);
+    }
+
+    printf("%-28s ratio %5.1f%%, compress %7.1f MB/s, decompress %7.1f MB/s\n", name, 100.0 * total / IMAGE_SIZE,
+           IMAGE_SIZE / compressTime / 1e6, IMAGE_SIZE / decompressTime / 1e6);
+}
+
+int main(void)
+{
+    for(SyntheticKind kind = 0; kind < SYNTH_COUNT; kind++)
+    {
+        fillSynthetic(image, IMAGE_SIZE, GSP_RGBA8_OES, 240, kind, 1);
+        bench(syntheticKindNames[kind]);
+    }
+
+    // A 5 MiB plugin block: 512 KiB of code, 1 MiB of used heap, the rest untouched
+    fillSynthetic(image, IMAGE_SIZE, GSP_RGBA8_OES, 240, SYNTH_ZERO, 1);
+    fillSynthetic(image, 512 * 1024, GSP_RGBA8_OES, 240, SYNTH_CODE, 1);
+    fillSynthetic(image + 512 * 1024, 1024 * 1024, GSP_RGBA8_OES, 240, SYNTH_HEAP, 2);
+    fillSynthetic(image + 1536 * 1024, 256 * 1024, GSP_RGBA8_OES, 240, SYNTH_SPARSE, 3);
+    bench("plugin-like (code+heap+0)");
+
+    return 0;
+}
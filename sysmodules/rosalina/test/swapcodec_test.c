@@ -0,0 +1,107 @@
+// Host test of the plugin swap codec: round trips, output capacity limits, and corrupted input
+
+#include <stdio.h>
+
+#include "../source/plugin/swapcodec.c"
+#include "synthetic_fixture.h"
+
+#include "test_common.h"
+
+#define MAX_SIZE    0x10000
+
+static SwapCodecState state;
+static u8 src[MAX_SIZE], comp[MAX_SIZE + MAX_SIZE / 255 + 16], out[MAX_SIZE];
+
+static void testRoundTrips(void)
+{
+    u32 seed = 1;
+
+    for(u32 iter = 0; iter < 3000; iter++)
+    {
+        SyntheticKind kind = rndFrom(&seed) % SYNTH_COUNT;
+        u32 size = iter < 20 ? iter : rndFrom(&seed) % (MAX_SIZE + 1);
+        if(iter % 4 == 0)
+            size = 0x4000;
+
+        fillSynthetic(src, size & ~3, GSP_RGBA8_OES, 240, kind, seed);
+        for(u32 i = size & ~3; i < size; i++)
+            src[i] = rndFrom(&seed);
+
+        // Mix kinds within a block, like a plugin image does
+        if(iter % 3 == 0 && size >= 0x2000)
+            fillSynthetic(src + 0x1000, 0x1000, GSP_RGBA8_OES, 240, rndFrom(&seed) % SYNTH_COUNT, seed);
+
+        u32 compSize = SwapCodec__Compress(&state, comp, sizeof(comp), src, size);
+        CHECK(compSize != 0 || size == 0);
+        if(compSize == 0)
+            continue;
+
+        memset(out, 0xCC, sizeof(out));
+        CHECK(SwapCodec__Decompress(out, size, comp, compSize));
+        CHECK(memcmp(out, src, size) == 0);
+        CHECK(out[size < MAX_SIZE ? size : 0] == (size < MAX_SIZE ? 0xCC : src[0]));
+
+        // Too small an output buffer makes the compressor give up, never overflow
+        if(compSize > 1)
+        {
+            memset(comp, 0xEE, sizeof(comp));
+            CHECK(SwapCodec__Compress(&state, comp, compSize - 1, src, size) == 0);
+            CHECK(comp[compSize - 1] == 0xEE);
+        }
+
+        // Wrong expected sizes are reported
+        if(size != 0)
+        {
+            SwapCodec__Compress(&state, comp, sizeof(comp), src, size);
+            CHECK(!SwapCodec__Decompress(out, size - 1, comp, compSize));
+        }
+
+        if(nbFailures > 10)
+            return;
+    }
+}
+
+static void testZeroChunk(void)
+{
+    memset(src, 0, 0x4000);
+    u32 compSize = SwapCodec__Compress(&state, comp, sizeof(comp), src, 0x4000);
+    CHECK(compSize != 0 && compSize < 100);
+    CHECK(SwapCodec__Decompress(out, 0x4000, comp, compSize) && memcmp(out, src, 0x4000) == 0);
+}
+
+// Corrupted swap files must be detected (or at least not write out of bounds)
+static void testCorruptedInput(void)
+{
+    static u8 guarded[0x4000 + 64];
+    u32 seed = 7;
+
+    for(u32 iter = 0; iter < 20000; iter++)
+    {
+        fillSynthetic(src, 0x4000, GSP_RGBA8_OES, 240, iter % 2 ? SYNTH_HEAP : SYNTH_SPARSE, iter);
+        u32 compSize = SwapCodec__Compress(&state, comp, sizeof(comp), src, 0x4000);
+
+        u32 nbFlips = 1 + rndFrom(&seed) % 4;
+        for(u32 i = 0; i < nbFlips; i++)
+            comp[rndFrom(&seed) % compSize] ^= 1 << (rndFrom(&seed) % 8);
+        if(iter % 5 == 0)
+            compSize = rndFrom(&seed) % compSize;
+
+        memset(guarded, 0x5A, sizeof(guarded));
+        SwapCodec__Decompress(guarded, 0x4000, comp, compSize);
+        for(u32 i = 0x4000; i < sizeof(guarded); i++)
+            CHECK(guarded[i] == 0x5A);
+
+        if(nbFailures > 10)
+            return;
+    }
+}
+
+int main(void)
+{
+    testRoundTrips();
+    testZeroChunk();
+    testCorruptedInput();
+
+    printf("swapcodec_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,375 @@
+// Host test of the plugin swap file (plugin/memoryblock.c, swapindex.c, swapcodec.c):
+// random mutation patterns are swapped out and back in through a RAM-backed swap file,
+// checking that the image is restored exactly and that only the changed pages are written.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../source/plugin/memoryblock.c"
+#include "../source/plugin/swapindex.c"
+#include "../source/plugin/swapcodec.c"
+
+PluginLoaderContext PluginLoaderCtx;
+bool isN3DS = false;
+
+#include "test_common.h"
+
+// The SD card
+
+#define SWAP_FILE_CAPACITY  (SWAP_DATA_OFFSET + SWAP_MAX_PAGES * SWAP_PAGE_SIZE)
+
+static u8 *swapFile;
+static u64 swapFileSize, nbBytesWritten, nbBytesRead;
+
+Result IFile_Open(IFile *file, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 flags)
+{
+    (void)archiveId;
+    (void)archivePath;
+    (void)filePath;
+    (void)flags;
+    file->handle = 1;
+    file->pos = 0;
+    file->size = swapFileSize;
+    return 0;
+}
+
+Result IFile_Close(IFile *file)
+{
+    file->handle = 0;
+    return 0;
+}
+
+Result IFile_Read(IFile *file, u64 *total, void *buffer, u32 len)
+{
+    u32 n = file->pos >= swapFileSize ? 0 : (swapFileSize - file->pos < len ? (u32)(swapFileSize - file->pos) : len);
+    memcpy(buffer, swapFile + file->pos, n);
+    file->pos += n;
+    *total = n;
+    nbBytesRead += n;
+    return 0;
+}
+
+Result IFile_Write(IFile *file, u64 *total, const void *buffer, u32 len, u32 flags)
+{
+    (void)flags;
+    if(file->pos + len > SWAP_FILE_CAPACITY)
+        return -1;
+
+    if(file->pos > swapFileSize)
+        memset(swapFile + swapFileSize, 0, file->pos - swapFileSize);
+    memcpy(swapFile + file->pos, buffer, len);
+    file->pos += len;
+    swapFileSize = file->pos > swapFileSize ? file->pos : swapFileSize;
+    *total = len;
+    nbBytesWritten += len;
+    return 0;
+}
+
+// Kernel and plugin side
+
+static u32 nbWorkAreaAllocations, nbCacheFrees;
+static bool failNextAllocation;
+
+Result svcControlMemoryEx(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm, bool isLoader)
+{
+    (void)addr1;
+    (void)op;
+    (void)perm;
+    (void)isLoader;
+    if(failNextAllocation)
+    {
+        failNextAllocation = false;
+        return MAKERESULT(RL_PERMANENT, RS_OUTOFRESOURCE, RM_KERNEL, RD_OUT_OF_MEMORY);
+    }
+
+    void *p = mmap((void *)(uintptr_t)addr0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(p == MAP_FAILED)
+        return -1;
+
+    // Not cleared on the console either
+    memset(p, 0xA5, size);
+    *addr_out = addr0;
+    nbWorkAreaAllocations++;
+    return 0;
+}
+
+Result svcControlMemory(u32 *addr_out, u32 addr0, u32 addr1, u32 size, MemOp op, MemPerm perm)
+{
+    (void)addr_out;
+    (void)addr1;
+    (void)op;
+    (void)perm;
+    munmap((void *)(uintptr_t)addr0, size);
+    nbWorkAreaAllocations--;
+    return 0;
+}
+
+// The plugin image cache gives its SYSTEM memory back
+void PluginCache__Free(void)
+{
+    nbCacheFrees++;
+}
+
+void svcFlushDataCacheRange(void *addr, u32 len)
+{
+    (void)addr;
+    (void)len;
+}
+
+Result svcKernelSetState(u32 type, ...)
+{
+    printf("swapfile_test: reboot requested (%lu)\n", (unsigned long)type);
+    exit(1);
+}
+
+void PluginLoader__Error(const char *message, Result res)
+{
+    printf("swapfile_test: %s (0x%08lx)\n", message, (unsigned long)res);
+}
+
+static u32 checksum(const u8 *start, const u8 *end)
+{
+    u32 sum = 0;
+    for(const u8 *p = start; p < end; p += 4)
+        sum = (sum << 1 | sum >> 31) ^ *(const u32 *)p;
+    return sum;
+}
+
+u32 saveSwapFunc(void *startAddr, void *endAddr, void *args)
+{
+    (void)args;
+    return checksum(startAddr, endAddr);
+}
+
+u32 loadSwapFunc(void *startAddr, void *endAddr, void *args)
+{
+    (void)args;
+    return checksum(startAddr, endAddr);
+}
+
+// Test driver
+
+static u32 randU32(void)
+{
+    return ((u32)rand() << 16) ^ (u32)rand();
+}
+
+// Returns how many pages were actually changed
+static u32 mutate(u8 *mem, u32 nbPages)
+{
+    static u8 before[SWAP_PAGE_SIZE];
+    u32 nbTouched = rand() % 4 == 0 ? 0 : 1 + rand() % (nbPages / 8);
+    u32 nbChanged = 0;
+
+    for(u32 i = 0; i < nbTouched; i++)
+    {
+        u32 page = rand() % 3 == 0 ? (u32)rand() % 32 : (u32)rand() % nbPages; // mostly the start, like a plugin heap
+        u8 *p = mem + page * SWAP_PAGE_SIZE;
+        memcpy(before, p, SWAP_PAGE_SIZE);
+
+        switch(rand() % 5)
+        {
+            case 0: // one word
+                ((u32 *)p)[rand() % (SWAP_PAGE_SIZE / 4)] = randU32();
+                break;
+            case 1: // the whole page, random
+                for(u32 j = 0; j < SWAP_PAGE_SIZE / 4; j++)
+                    ((u32 *)p)[j] = randU32();
+                break;
+            case 2: // freed
+                memset(p, 0, SWAP_PAGE_SIZE);
+                break;
+            case 3: // structured, compressible
+                for(u32 j = 0; j < SWAP_PAGE_SIZE / 4; j++)
+                    ((u32 *)p)[j] = j % 16 == 0 ? randU32() & 0xFFFF : 0x08000000 + 4 * j;
+                break;
+            default: // run of pages
+            {
+                u32 n = 1 + rand() % 8;
+                n = page + n > nbPages ? nbPages - page : n;
+                u8 v = rand();
+                for(u32 j = 0; j < n; j++)
+                {
+                    u8 *q = p + j * SWAP_PAGE_SIZE;
+                    bool changed = false;
+                    for(u32 k = 0; k < SWAP_PAGE_SIZE; k += 64)
+                    {
+                        changed = changed || q[k] != v;
+                        q[k] = v;
+                    }
+                    nbChanged += changed && j != 0;
+                }
+                break;
+            }
+        }
+
+        nbChanged += memcmp(before, p, SWAP_PAGE_SIZE) != 0;
+    }
+
+    return nbChanged;
+}
+
+static void testSwapCycles(u32 memBlockSize, bool compress, u32 nbCycles)
+{
+    MemoryBlock *memblock = &PluginLoaderCtx.memblock;
+    u32 nbPages = memBlockSize / SWAP_PAGE_SIZE;
+    u8 *image = malloc(memBlockSize);
+    u64 totalWritten = 0, fullWrites = 0;
+
+    memset(&PluginLoaderCtx, 0, sizeof(PluginLoaderCtx));
+    PluginLoaderCtx.isSwapFunctionset = true;
+    PluginLoaderCtx.useSwapCompression = compress;
+    CHECK(R_SUCCEEDED(MemoryBlock__SetSize(memBlockSize)));
+    swapFileSize = 0;
+
+    memblock->memblock = malloc(memBlockSize);
+    memset(memblock->memblock, 0, memBlockSize);
+
+    for(u32 cycle = 0; cycle < nbCycles; cycle++)
+    {
+        u32 nbChanged = cycle == 0 ? nbPages : mutate(memblock->memblock, nbPages);
+        if(cycle == 0)
+        {
+            for(u32 i = 0; i < memBlockSize / 4; i += 1 + rand() % 64)
+                ((u32 *)memblock->memblock)[i] = randU32();
+        }
+
+        memcpy(image, memblock->memblock, memBlockSize);
+
+        nbBytesWritten = 0;
+        MemoryBlock__ToSwapFile();
+        CHECK(nbWorkAreaAllocations == 0);
+
+        // Besides the changed pages, only the header and the page hashes are written
+        u64 maxWritten = (u64)nbChanged * SWAP_PAGE_SIZE + sizeof(SwapFileHeader) + nbPages * sizeof(u64);
+        if(compress)
+            maxWritten = (u64)nbChanged * SWAP_CHUNK_SIZE + sizeof(SwapFileHeader) + nbPages * sizeof(u64);
+        CHECK(nbBytesWritten <= maxWritten);
+        totalWritten += nbBytesWritten;
+        fullWrites += memBlockSize;
+
+        // Freed while swapped out, the new allocation is cleared
+        memset(memblock->memblock, 0, memBlockSize);
+        nbBytesRead = 0;
+        MemoryBlock__FromSwapFile();
+        CHECK(nbWorkAreaAllocations == 0);
+        CHECK(memcmp(memblock->memblock, image, memBlockSize) == 0);
+        if(nbFailures > 10)
+            break;
+    }
+
+    // A new memblock size (or swap file name) means everything gets written again
+    CHECK(R_SUCCEEDED(MemoryBlock__SetSize(memBlockSize)));
+    nbBytesWritten = 0;
+    MemoryBlock__ToSwapFile();
+    if(!compress)
+        CHECK(nbBytesWritten == (u64)memBlockSize + sizeof(SwapFileHeader) + nbPages * sizeof(u64));
+
+    printf("swapfile_test: %4lu KiB, %s: wrote %3lu%% of the full image over %lu swaps\n",
+           (unsigned long)(memBlockSize >> 10), compress ? "compressed" : "raw       ",
+           (unsigned long)(100 * totalWritten / fullWrites), (unsigned long)nbCycles);
+
+    free(memblock->memblock);
+    free(image);
+}
+
+// With the SYSTEM region full, swapping drops the plugin image cache rather than rebooting
+static void testSwapWithoutMemory(void)
+{
+    MemoryBlock *memblock = &PluginLoaderCtx.memblock;
+    u32 memBlockSize = 2 << 20;
+    u8 *image = malloc(memBlockSize);
+
+    memset(&PluginLoaderCtx, 0, sizeof(PluginLoaderCtx));
+    PluginLoaderCtx.isSwapFunctionset = true;
+    CHECK(R_SUCCEEDED(MemoryBlock__SetSize(memBlockSize)));
+    swapFileSize = 0;
+
+    memblock->memblock = malloc(memBlockSize);
+    for(u32 i = 0; i < memBlockSize / 4; i++)
+        ((u32 *)memblock->memblock)[i] = randU32();
+    memcpy(image, memblock->memblock, memBlockSize);
+
+    nbCacheFrees = 0;
+    failNextAllocation = true;
+    CHECK(R_SUCCEEDED(MemoryBlock__ToSwapFile()));
+    CHECK(nbCacheFrees == 1);
+    CHECK(nbWorkAreaAllocations == 0);
+
+    memset(memblock->memblock, 0, memBlockSize);
+    failNextAllocation = true;
+    CHECK(R_SUCCEEDED(MemoryBlock__FromSwapFile()));
+    CHECK(nbCacheFrees == 2);
+    CHECK(memcmp(memblock->memblock, image, memBlockSize) == 0);
+
+    free(memblock->memblock);
+    free(image);
+}
+
+static void testHeaderValidation(void)
+{
+    SwapIndex *index = malloc(sizeof(SwapIndex));
+
+    SwapIndex__Reset(index, 1 << 20);
+    CHECK(SwapIndex__IsHeaderValid(&index->header, 1 << 20));
+    CHECK(!SwapIndex__IsHeaderValid(&index->header, 2 << 20));
+
+    index->header.version = 2;
+    CHECK(!SwapIndex__IsHeaderValid(&index->header, 1 << 20));
+
+    SwapIndex__Reset(index, 1 << 20);
+    index->header.chunkSizes[3] = SWAP_CHUNK_SIZE + 1;
+    CHECK(!SwapIndex__IsHeaderValid(&index->header, 1 << 20));
+
+    SwapIndex__Reset(index, SWAP_MAX_PAGES * SWAP_PAGE_SIZE + SWAP_CHUNK_SIZE);
+    CHECK(!SwapIndex__IsHeaderValid(&index->header, SWAP_MAX_PAGES * SWAP_PAGE_SIZE + SWAP_CHUNK_SIZE));
+
+    free(index);
+}
+
+static void testNextRun(void)
+{
+    u32 bitmap[4] = {0};
+    u32 ref[128];
+
+    for(u32 iter = 0; iter < 10000; iter++)
+    {
+        for(u32 i = 0; i < 4; i++)
+            bitmap[i] = randU32() & randU32();
+        for(u32 i = 0; i < 128; i++)
+            ref[i] = 0;
+
+        u32 nbPages = 1 + rand() % 128, pos = 0, start, count, prevEnd = 0;
+        while(SwapIndex__NextRun(bitmap, nbPages, &pos, &start, &count))
+        {
+            CHECK(count != 0 && start >= prevEnd && start + count <= nbPages);
+            CHECK(start == 0 || start == prevEnd || !((bitmap[(start - 1) / 32] >> ((start - 1) % 32)) & 1));
+            for(u32 i = start; i < start + count; i++)
+                ref[i] = 1;
+            prevEnd = start + count;
+        }
+
+        for(u32 i = 0; i < nbPages; i++)
+            CHECK(ref[i] == ((bitmap[i / 32] >> (i % 32)) & 1));
+    }
+}
+
+int main(void)
+{
+    swapFile = malloc(SWAP_FILE_CAPACITY);
+    srand(1);
+
+    testHeaderValidation();
+    testNextRun();
+    testSwapCycles(1 << 20, false, 200);
+    testSwapCycles(1 << 20, true, 200);
+    testSwapCycles(5 << 20, false, 40);
+    testSwapCycles(5 << 20, true, 40);
+    testSwapCycles(SWAP_MAX_PAGES * SWAP_PAGE_SIZE, true, 10);
+    testSwapWithoutMemory();
+
+    printf("swapfile_test: %s\n", nbFailures == 0 ? "OK" : "FAILED");
+    return nbFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Synthetic data for the swap codec, framebuffer conversion and QOI tests and benchmarks. There
+// are no captured plugin images or screenshots to ship, so these mimic what they hold: plugin
+// memory (a code section, a heap with small objects and pointers, a mostly untouched tail) and
+// screen contents, in any of the framebuffer pixel formats.
+
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <3ds/types.h>
+#include <3ds/services/gspgpu.h>
+#include "test_common.h"
+
+typedef enum SyntheticKind
+{
+    SYNTH_ZERO = 0,
+    SYNTH_RANDOM,
+    SYNTH_CODE,         ///< ARM instructions
+    SYNTH_HEAP,
+    SYNTH_SPARSE,       ///< A few scattered words
+    SYNTH_MENU,         ///< Flat background, boxes and text-like detail, like rosalina's menus or a game UI
+    SYNTH_GRADIENT,     ///< Smooth shading, small pixel to pixel differences
+    SYNTH_DITHERED,     ///< Gradient with low-bit noise, like a 3D scene rendered at RGB565
+    SYNTH_COUNT,
+} SyntheticKind;
+
+static const char *const syntheticKindNames[SYNTH_COUNT] = { "zero", "random", "code", "heap", "sparse", "menu", "gradient", "dithered" };
+
+static const u8 syntheticFormatSizes[] = { 4, 3, 2, 2, 2 };
+
+static void storeSyntheticPixel(u8 *p, GSPGPU_FramebufferFormat format, u32 b, u32 g, u32 r)
+{
+    u32 px;
+
+    switch(format)
+    {
+        case GSP_RGBA8_OES:     px = 0xFF | b << 8 | g << 16 | r << 24; memcpy(p, &px, 4); break;
+        case GSP_BGR8_OES:      p[0] = b; p[1] = g; p[2] = r; break;
+        case GSP_RGB565_OES:    px = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3; memcpy(p, &px, 2); break;
+        case GSP_RGB5_A1_OES:   px = (r >> 3) << 11 | (g >> 3) << 6 | (b >> 3) << 1 | 1; memcpy(p, &px, 2); break;
+        default:                px = (r >> 4) << 12 | (g >> 4) << 8 | (b >> 4) << 4 | 0xF; memcpy(p, &px, 2); break;
+    }
+}
+
+// Fills size bytes with the given kind of data. Screen contents are stored as lines of width
+// pixels of the given format; plugin memory is made of words, whatever the format
+static void fillSynthetic(u8 *dst, u32 size, GSPGPU_FramebufferFormat format, u32 width, SyntheticKind kind, u32 seed)
+{
+    u32 *w = (u32 *)dst, n = size / 4, state = seed | 1;
+    u32 pixelSize = syntheticFormatSizes[format], nbPixels = size / pixelSize;
+
+    memset(dst, 0, size);
+    switch(kind)
+    {
+        case SYNTH_ZERO:
+            break;
+        case SYNTH_RANDOM:
+            for(u32 i = 0; i < size; i++)
+                dst[i] = rndFrom(&state);
+            break;
+        case SYNTH_CODE:
+            // A few opcodes, registers and small immediates, relative branches
+            for(u32 i = 0; i < n; i++)
+            {
+                static const u32 ops[] = { 0xE5900000, 0xE5800000, 0xE1A00000, 0xE2800000, 0xE3500000, 0xEB000000, 0x1A000000, 0xE92D4000, 0xE8BD8000 };
+                u32 r = rndFrom(&state);
+                u32 op = ops[r % (sizeof(ops) / sizeof(ops[0]))];
+                w[i] = (op & 0xFF000000) == 0xEB000000 || (op & 0xFF000000) == 0x1A000000 ?
+                       op | ((r >> 8) & 0x3FF) : op | ((r >> 8) & 0xF) << 12 | ((r >> 12) & 0xF) << 16 | ((r >> 16) & 0x3F);
+            }
+            break;
+        case SYNTH_HEAP:
+            // Allocations with headers, pointers into the heap, small integers, some strings
+            for(u32 i = 0; i < n;)
+            {
+                u32 r = rndFrom(&state), len = 2 + r % 30;
+                w[i++] = len * 4 | 1;
+                for(u32 j = 0; j < len && i < n; j++, i++)
+                {
+                    u32 v = rndFrom(&state);
+                    switch(v % 4)
+                    {
+                        case 0: w[i] = 0x06000000 + (v >> 8) % size; break;
+                        case 1: w[i] = (v >> 8) & 0xFF; break;
+                        case 2: w[i] = 0x20202020 | (0x41414141 & v); break;
+                        default: w[i] = 0; break;
+                    }
+                }
+            }
+            break;
+        case SYNTH_SPARSE:
+            for(u32 i = 0; i < n; i += 1 + rndFrom(&state) % 256)
+                w[i] = rndFrom(&state);
+            break;
+        default:
+            for(u32 i = 0; i < nbPixels; i++)
+            {
+                u32 x = i % width, y = i / width, b, g, r;
+
+                if(kind == SYNTH_MENU)
+                {
+                    bool inBox = x % 160 > 16 && x % 160 < 144 && y % 80 > 10 && y % 80 < 70;
+                    bool inText = inBox && y % 10 < 7 && (x * 7 + y * 3 + seed) % 11 < 5;
+                    b = inText ? 0xFF : inBox ? 0x40 : 0x10;
+                    g = inText ? 0xFF : inBox ? 0x20 : 0x10;
+                    r = inText ? 0xFF : inBox ? 0x20 : 0x18;
+                }
+                else if(kind == SYNTH_GRADIENT)
+                {
+                    b = (x + seed) & 0xFF;
+                    g = (y * 2 + x / 4) & 0xFF;
+                    r = (x / 2 + y / 2) & 0xFF;
+                }
+                else
+                {
+                    b = ((x + seed) & 0xF8) | (rndFrom(&state) & 7);
+                    g = ((y * 2 + x / 4) & 0xFC) | (rndFrom(&state) & 3);
+                    r = ((x / 2 + y / 2) & 0xF8) | (rndFrom(&state) & 7);
+                }
+
+                storeSyntheticPixel(dst + i * pixelSize, format, b, g, r);
+            }
+            break;
+    }
+}
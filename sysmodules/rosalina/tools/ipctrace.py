@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Decodes the IPC trace stream rosalina serves on TCP port 4960 (Debugger options -> IPC trace),
+# see sysmodules/rosalina/include/ipc_trace.h for the format.
+#
+# usage: ipctrace.py trace.bin               decode a saved stream (e.g. "nc <3ds ip> 4960 > trace.bin")
+#        ipctrace.py <3ds ip> [seconds]      record live for a while (10 s by default), then decode
+#
+# -v prints every event, -o FILE also saves the raw stream when recording live.
+
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x54435049  # "IPCT"
+VERSION = 1
+PORT = 4960
+
+HEADER = struct.Struct("<IIQ")
+EVENT = struct.Struct("<QIII12s")
+
+
+def record(host, duration):
+    data = bytearray()
+    with socket.create_connection((host, PORT), timeout=5) as sock:
+        sock.settimeout(0.5)
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            try:
+                chunk = sock.recv(65536)
+            except socket.timeout:
+                continue
+            if not chunk:
+                break
+            data += chunk
+
+    return bytes(data)
+
+
+def decode(data):
+    if len(data) < HEADER.size:
+        sys.exit("truncated IPC trace")
+
+    magic, version, tickRate = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION or tickRate == 0:
+        sys.exit("not a version {0} IPC trace".format(VERSION))
+
+    nbEvents = (len(data) - HEADER.size) // EVENT.size
+    events = []
+    for i in range(nbEvents):
+        timestamp, latency, pid, cmdHeader, name = EVENT.unpack_from(data, HEADER.size + i * EVENT.size)
+        name = name.split(b"\0", 1)[0].decode("ascii", "replace") or "?"
+        events.append((timestamp, latency, pid, cmdHeader, name))
+
+    # Each core's ring is drained separately, put everything back in order
+    events.sort()
+    return tickRate, events
+
+
+def main(argv):
+    verbose = "-v" in argv
+    argv = [arg for arg in argv if arg != "-v"]
+
+    output = None
+    if "-o" in argv:
+        i = argv.index("-o")
+        if i + 1 >= len(argv):
+            sys.exit("-o needs a file name")
+        output = argv[i + 1]
+        del argv[i:i + 2]
+
+    if len(argv) not in (2, 3):
+        sys.exit("usage: {0} [-v] [-o FILE] trace.bin | <3ds ip> [seconds]".format(argv[0]))
+
+    try:
+        with open(argv[1], "rb") as f:
+            data = f.read()
+    except FileNotFoundError:
+        data = record(argv[1], float(argv[2]) if len(argv) == 3 else 10.0)
+        if output is not None:
+            with open(output, "wb") as f:
+                f.write(data)
+
+    tickRate, events = decode(data)
+    us = lambda ticks: 1000000.0 * ticks / tickRate
+
+    if verbose:
+        print("{0:>12} {1:>5} {2:<12} {3:>10} {4:>10}".format("Time (ms)", "PID", "Service", "Command", "Lat. (us)"))
+        for timestamp, latency, pid, cmdHeader, name in events:
+            print("{0:>12.3f} {1:>5} {2:<12} {3:>#10x} {4:>10.1f}".format(
+                us(timestamp - events[0][0]) / 1000.0, pid, name, cmdHeader, us(latency)))
+        print()
+
+    # Per service and command ID, the ones with the highest total latency first
+    stats = {}
+    for timestamp, latency, pid, cmdHeader, name in events:
+        count, total, maxLatency = stats.get((name, cmdHeader >> 16), (0, 0, 0))
+        stats[(name, cmdHeader >> 16)] = (count + 1, total + latency, max(maxLatency, latency))
+
+    print("{0:<12} {1:>7} {2:>8} {3:>12} {4:>10} {5:>10}".format("Service", "Cmd", "Count", "Total (ms)", "Avg (us)", "Max (us)"))
+    for (name, cmdId), (count, total, maxLatency) in sorted(stats.items(), key=lambda item: -item[1][1]):
+        print("{0:<12} {1:>#7x} {2:>8} {3:>12.2f} {4:>10.1f} {5:>10.1f}".format(
+            name, cmdId, count, us(total) / 1000.0, us(total) / count, us(maxLatency)))
+
+    if events:
+        print()
+        print("{0} events over {1:.2f} ms".format(len(events), us(events[-1][0] - events[0][0]) / 1000.0))
+
+
+if __name__ == "__main__":
+    main(sys.argv)